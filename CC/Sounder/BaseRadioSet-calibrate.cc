@@ -8,16 +8,22 @@
 
  This procedure is adapted from original code that calibrate radio by itself in FDD mode
  To work in TDD mode, this code uses a reference radio to calibrate the whole array.
- Note: Because of OTA calibration, the code is (cannot be) parallelized so this a slow procedure.
+ Note: The rx paths snoop their own samples and are calibrated in parallel. The tx
+ paths are measured over the air by the reference radio, so one radio at a time.
+ Results are kept in the calibration cache, the corrections of a later start are
+ applied from it when one measurement of the rx paths confirms them.
 ---------------------------------------------------------------------
 */
 
 #include "include/BaseRadioSet.h"
 #include "include/Radio.h"
+#include "include/calibration_cache.h"
 #include "include/comms-lib.h"
+#include "include/dciq_optimizer.h"
 #include "include/macros.h"
 //#include "include/matplotlibcpp.h"
 #include "include/utils.h"
+#include "include/worker_pool.h"
 
 //namespace plt = matplotlibcpp;
 
@@ -31,8 +37,10 @@ static std::vector<std::complex<float>> snoopSamples(
     return samps;
 }
 
+// The rx radios are set up and measured in parallel on pool, the gain
+// decisions are taken once all of them are measured
 static void adjustCalibrationGains(std::vector<SoapySDR::Device*> rxDevs,
-    SoapySDR::Device* txDev, size_t channel, double fftBin)
+    SoapySDR::Device* txDev, size_t channel, double fftBin, WorkerPool& pool)
 {
     using std::cout;
     using std::endl;
@@ -51,7 +59,7 @@ static void adjustCalibrationGains(std::vector<SoapySDR::Device*> rxDevs,
         txDev->setGain(SOAPY_SDR_TX, ch, "ATTN", attnMax);
     }
 
-    for (size_t r = 0; r < rxDevsSize; r++) {
+    pool.parallelFor(rxDevsSize, [&](size_t r) {
         for (size_t ch = 0; ch < 2; ch++) {
             rxDevs[r]->setGain(SOAPY_SDR_RX, ch, "LNA", 0);
             rxDevs[r]->setGain(SOAPY_SDR_RX, ch, "PGA", 0);
@@ -59,28 +67,42 @@ static void adjustCalibrationGains(std::vector<SoapySDR::Device*> rxDevs,
             rxDevs[r]->setGain(SOAPY_SDR_RX, ch, "ATTN", attnMax);
             rxDevs[r]->setGain(SOAPY_SDR_RX, ch, "LNA2", 14.0);
         }
-    }
+    });
 
     txDev->setGain(SOAPY_SDR_TX, channel, "PAD", 40);
     std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_TIME_MS));
 
-    float maxToneLevel = -200;
     std::vector<bool> adjustedRadios(rxDevsSize, 0);
     std::vector<float> toneLevels(rxDevsSize, 0);
+    std::vector<std::vector<std::complex<float>>> samps(rxDevsSize);
     size_t remainingRadios = adjustedRadios.size();
-    for (size_t r = 0; r < rxDevsSize; r++) {
-        const auto samps = snoopSamples(rxDevs[r], channel, N);
-        auto toneLevel
-            = CommsLib::measureTone(samps, win, windowGain, fftBin, N);
-        if (toneLevel >= targetLevel) {
-            adjustedRadios[r] = true;
-            remainingRadios--;
+    // Measures the tone on the radios not adjusted yet, a radio is done
+    // once its tone reaches the target (or exceeds it when strict)
+    auto measureToneLevels = [&](int stage, bool strict) {
+        pool.parallelFor(rxDevsSize, [&](size_t r) {
+            if (adjustedRadios[r])
+                return;
+            samps[r] = snoopSamples(rxDevs[r], channel, N);
+            toneLevels[r]
+                = CommsLib::measureTone(samps[r], win, windowGain, fftBin, N);
+        });
+        for (size_t r = 0; r < rxDevsSize; r++) {
+            if (adjustedRadios[r])
+                continue;
+            if (strict ? (toneLevels[r] > targetLevel)
+                       : (toneLevels[r] >= targetLevel)) {
+                adjustedRadios[r] = true;
+                remainingRadios--;
+            }
+            cout << "Node " << r << ": toneLevel" << stage << "="
+                 << toneLevels[r] << endl;
         }
-        toneLevels[r] = toneLevel;
-        if (toneLevel > maxToneLevel)
-            maxToneLevel = toneLevel;
-        cout << "Node " << r << ": toneLevel0=" << toneLevel << endl;
-    }
+    };
+
+    measureToneLevels(0, false);
+    float maxToneLevel = -200;
+    for (size_t r = 0; r < rxDevsSize; r++)
+        maxToneLevel = std::max(maxToneLevel, toneLevels[r]);
 
     std::string nextGainStage;
     if (remainingRadios == rxDevsSize) {
@@ -104,19 +126,7 @@ static void adjustCalibrationGains(std::vector<SoapySDR::Device*> rxDevs,
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_TIME_MS));
 
-    for (size_t r = 0; r < rxDevsSize; r++) {
-        if (adjustedRadios[r])
-            continue;
-        const auto samps = snoopSamples(rxDevs[r], channel, N);
-        float toneLevel
-            = CommsLib::measureTone(samps, win, windowGain, fftBin, N);
-        if (toneLevel >= targetLevel) {
-            adjustedRadios[r] = true;
-            remainingRadios--;
-        }
-        toneLevels[r] = toneLevel;
-        cout << "Node " << r << ": toneLevel1=" << toneLevel << endl;
-    }
+    measureToneLevels(1, false);
 
     if (remainingRadios == 0)
         return;
@@ -139,19 +149,7 @@ static void adjustCalibrationGains(std::vector<SoapySDR::Device*> rxDevs,
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_TIME_MS));
 
-    for (size_t r = 0; r < rxDevsSize; r++) {
-        if (adjustedRadios[r])
-            continue;
-        const auto samps = snoopSamples(rxDevs[r], channel, N);
-        auto toneLevel
-            = CommsLib::measureTone(samps, win, windowGain, fftBin, N);
-        if (toneLevel > targetLevel) {
-            adjustedRadios[r] = true;
-            remainingRadios--;
-        }
-        toneLevels[r] = toneLevel;
-        cout << "Node " << r << ": toneLevel2=" << toneLevel << endl;
-    }
+    measureToneLevels(2, true);
 
     if (remainingRadios == 0 || nextGainStage == "LNA")
         return;
@@ -170,20 +168,15 @@ static void adjustCalibrationGains(std::vector<SoapySDR::Device*> rxDevs,
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_TIME_MS));
 
+#if DEBUG_PLOT
+    std::vector<bool> plotRadios(adjustedRadios.begin(), adjustedRadios.end());
+#endif
+    measureToneLevels(3, true);
+#if DEBUG_PLOT
     for (size_t r = 0; r < rxDevsSize; r++) {
-        if (adjustedRadios[r])
+        if (plotRadios[r])
             continue;
-        auto samps = snoopSamples(rxDevs[r], channel, N);
-        float toneLevel
-            = CommsLib::measureTone(samps, win, windowGain, fftBin, N);
-        if (toneLevel > targetLevel) {
-            adjustedRadios[r] = true;
-            remainingRadios--;
-        }
-        toneLevels[r] = toneLevel;
-        cout << "Node " << r << ": toneLevel3=" << toneLevel << endl;
-#if DEBUG_PLOT
-        auto fftMag = CommsLib::magnitudeFFT(samps, win, N);
+        auto fftMag = CommsLib::magnitudeFFT(samps[r], win, N);
         std::vector<double> magDouble(N);
         std::transform(
             fftMag.begin(), fftMag.end(), magDouble.begin(), [](float cf) {
@@ -205,8 +198,8 @@ static void adjustCalibrationGains(std::vector<SoapySDR::Device*> rxDevs,
         plt::legend();
         plt::save("rx" + std::to_string(rxDevsSize) + "_" + std::to_string(r)
             + "_ch" + std::to_string(channel) + ".png");
-#endif
     }
+#endif
 
     std::cout << rxDevsSize - remainingRadios << " radios reached target level"
               << std::endl;
@@ -224,8 +217,52 @@ static void setIQBalance(
     dev->setIQBalance(direction, channel, IQcorr);
 }
 
-static void dciqMinimize(SoapySDR::Device* targetDev, SoapySDR::Device* refDev,
-    int direction, size_t channel, double rxCenterTone, double txCenterTone)
+static void applyDciqCorrection(SoapySDR::Device* dev, int direction,
+    size_t channel, const DciqCorrection& corr)
+{
+    const int fixedScale = (direction == SOAPY_SDR_RX) ? 64 : 128;
+    dev->setDCOffset(direction, channel,
+        std::complex<double>(
+            double(corr.dc_i) / fixedScale, double(corr.dc_q) / fixedScale));
+    setIQBalance(dev, direction, channel, corr.gcorr, corr.iqcorr);
+}
+
+// A cached rx path correction holds when one snoop of the reference tone
+// shows DC and image levels within kDciqVerifyMarginDb of the calibrated
+// ones, relative to the tone
+static bool verifyDciqCorrection(SoapySDR::Device* dev, size_t channel,
+    double txCenterTone, const DciqCorrection& corr, const std::string& name)
+{
+    static const float kDciqVerifyMarginDb = 6;
+    size_t N = 1024;
+    std::vector<float> win = CommsLib::hannWindowFunction(N);
+    const auto windowGain = CommsLib::windowFunctionPower(win);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_TIME_MS));
+    const auto samps = snoopSamples(dev, channel, N);
+    const auto toneLevel
+        = CommsLib::measureTone(samps, win, windowGain, txCenterTone, N);
+    const auto dcLevel
+        = CommsLib::measureTone(samps, win, windowGain, 0.0, N) - toneLevel;
+    const auto imLevel
+        = CommsLib::measureTone(samps, win, windowGain, -txCenterTone, N)
+        - toneLevel;
+    const bool holds = (dcLevel <= corr.dc_level + kDciqVerifyMarginDb)
+        && (imLevel <= corr.image_level + kDciqVerifyMarginDb);
+    std::printf("%s cached correction %s: dcLvl=%g dB (calibrated %g dB), "
+                "imLvl=%g dB (calibrated %g dB) below the tone\n",
+        name.c_str(), holds ? "holds" : "fails", dcLevel, corr.dc_level,
+        imLevel, corr.image_level);
+    return holds;
+}
+
+// Runs concurrently on the rx paths of the array, every line it prints
+// starts with name. Returns the correction applied, its levels taken from
+// the final measurement.
+static DciqCorrection dciqMinimize(SoapySDR::Device* targetDev,
+    SoapySDR::Device* refDev, int direction, size_t channel,
+    double rxCenterTone, double txCenterTone, const DciqOptimizer& optimizer,
+    const std::string& name)
 {
     size_t N = 1024;
     std::vector<float> win = CommsLib::hannWindowFunction(N);
@@ -247,56 +284,39 @@ static void dciqMinimize(SoapySDR::Device* targetDev, SoapySDR::Device* refDev,
             samps, win, windowGain, rxCenterTone - txCenterTone, N);
         const auto desiredToneLevel = CommsLib::measureTone(
             samps, win, windowGain, rxCenterTone + txCenterTone, N);
-        std::cout << "dciqMinimize initial: dcLvl=" << measDCLevel
-                  << " dB, imLvl=" << measImbalanceLevel
-                  << " dB, toneLevel=" << desiredToneLevel << "dB" << std::endl;
+        std::printf("%s dciqMinimize initial: dcLvl=%g dB, imLvl=%g dB, "
+                    "toneLevel=%gdB\n",
+            name.c_str(), measDCLevel, measImbalanceLevel, desiredToneLevel);
     }
 
-    //look through each correction arm twice
-    float minDcLevel(0);
-    std::complex<double> bestDcCorr(0.0, 0.0);
-    for (size_t iter = 0; iter < 4; iter++) {
-        int start = -fixedScale, stop = +fixedScale, step = 8;
-        if (iter == 2)
-            minDcLevel = 0; //restart with finer search
-        if (iter > 1) //narrow in for the final iteration set
-        {
-            const int center = int(
-                (((iter % 2) == 0) ? bestDcCorr.imag() : bestDcCorr.real())
-                * fixedScale);
-            start = std::max<int>(start, center - 8),
-            stop = std::min<int>(stop, center + 8), step = 1;
-        }
-        for (int i = start; i < stop; i += step) {
-            //try I or Q arm based on iteration
-            const auto dcCorr = ((iter % 2) == 0)
-                ? std::complex<double>(
-                      bestDcCorr.real(), double(i) / fixedScale)
-                : std::complex<double>(
-                      double(i) / fixedScale, bestDcCorr.imag());
-            targetDev->setDCOffset(direction, channel, dcCorr);
+    // The DC correction arms are searched as x = Q and y = I
+    const auto dcResult = optimizer.minimize(
+        [&](int q, int i) {
+            targetDev->setDCOffset(direction, channel,
+                std::complex<double>(double(i) / fixedScale,
+                    double(q) / fixedScale));
 
             //measure the efficacy
             std::this_thread::sleep_for(
                 std::chrono::milliseconds(SETTLE_TIME_MS));
             const auto samps = snoopSamples(refDev, channel, N);
-            const auto measDcLevel = CommsLib::measureTone(
+            return CommsLib::measureTone(
                 samps, win, windowGain, rxCenterTone, N);
-
-            //save desired results
-            if (measDcLevel < minDcLevel) {
-                minDcLevel = measDcLevel;
-                bestDcCorr = dcCorr;
-            }
-        }
-    }
+        },
+        -fixedScale, fixedScale);
+    DciqCorrection corr;
+    corr.dc_i = dcResult.y;
+    corr.dc_q = dcResult.x;
+    const std::complex<double> bestDcCorr(
+        double(corr.dc_i) / fixedScale, double(corr.dc_q) / fixedScale);
 
     targetDev->setDCOffset(direction, channel, bestDcCorr);
     if (direction == SOAPY_SDR_TX) {
         long dccorri = std::lround(bestDcCorr.real() * 128);
         long dccorrq = std::lround(bestDcCorr.imag() * 128);
-        std::cout << "Optimized TX DC Offset: (" << dccorri << "," << dccorrq
-                  << ")\n";
+        std::printf("%s Optimized TX DC Offset: (%ld,%ld) after %zu "
+                    "measurements\n",
+            name.c_str(), dccorri, dccorrq, dcResult.measurements);
     } else {
         long dcoffi = std::lround(bestDcCorr.real() * 64);
         if (dcoffi < 0)
@@ -305,50 +325,36 @@ static void dciqMinimize(SoapySDR::Device* targetDev, SoapySDR::Device* refDev,
         long dcoffq = std::lround(bestDcCorr.imag() * 64);
         if (dcoffq < 0)
             dcoffq = (1 << 6) | std::abs(dcoffq);
-        std::cout << "Optimized RX DC Offset: (" << dcoffi << "," << dcoffq
-                  << ")\n";
+        std::printf("%s Optimized RX DC Offset: (%ld,%ld) after %zu "
+                    "measurements\n",
+            name.c_str(), dcoffi, dcoffq, dcResult.measurements);
     }
 
     //correct IQ imbalance
-    float minImbalanceLevel(0);
-    int bestgcorr = 0, bestiqcorr = 0;
-    for (size_t iter = 0; iter < 4; iter++) {
-        int start = -512, stop = 512, step = 8;
-        if (iter == 2)
-            minImbalanceLevel = 0; //restart with finer search
-        if (iter > 1) {
-            const int center = ((iter % 2) == 0) ? bestgcorr : bestiqcorr;
-            start = std::max<int>(start, center - 8);
-            stop = std::min<int>(stop, center + 8), step = 1;
-        }
-        //SoapySDR::logf(debugLogLevel, "start=%d, stop=%d, step=%d", start, stop, step);
-        for (int i = start; i < stop; i += step) {
-            const int gcorr = ((iter % 2) == 0) ? i : bestgcorr;
-            const int iqcorr = ((iter % 2) == 1) ? i : bestiqcorr;
+    const auto iqResult = optimizer.minimize(
+        [&](int gcorr, int iqcorr) {
             setIQBalance(targetDev, direction, channel, gcorr, iqcorr);
 
             //measure the efficacy
             std::this_thread::sleep_for(
                 std::chrono::milliseconds(SETTLE_TIME_MS));
             const auto samps = snoopSamples(refDev, channel, N);
-            const auto measImbalanceLevel = CommsLib::measureTone(
+            return CommsLib::measureTone(
                 samps, win, windowGain, rxCenterTone - txCenterTone, N);
-
-            //save desired results
-            if (measImbalanceLevel < minImbalanceLevel) {
-                minImbalanceLevel = measImbalanceLevel;
-                bestgcorr = gcorr;
-                bestiqcorr = iqcorr;
-            }
-        }
-    }
+        },
+        -512, 512);
+    corr.gcorr = iqResult.x;
+    corr.iqcorr = iqResult.y;
+    const int bestgcorr = corr.gcorr;
+    const int bestiqcorr = corr.iqcorr;
 
     //apply the ideal correction
     setIQBalance(targetDev, direction, channel, bestgcorr, bestiqcorr);
     auto gcorri = (bestgcorr < 0) ? 2047 - std::abs(bestgcorr) : 2047;
     auto gcorrq = (bestgcorr > 0) ? 2047 - std::abs(bestgcorr) : 2047;
-    std::cout << "Optimized IQ Imbalance Setting: GCorr (" << gcorri << ","
-              << gcorrq << "), iqcorr=" << bestiqcorr << "\n";
+    std::printf("%s Optimized IQ Imbalance Setting: GCorr (%d,%d), "
+                "iqcorr=%d after %zu measurements\n",
+        name.c_str(), gcorri, gcorrq, bestiqcorr, iqResult.measurements);
 
     //measure corrections
     {
@@ -360,10 +366,13 @@ static void dciqMinimize(SoapySDR::Device* targetDev, SoapySDR::Device* refDev,
             samps, win, windowGain, rxCenterTone - txCenterTone, N);
         const auto desiredToneLevel = CommsLib::measureTone(
             samps, win, windowGain, rxCenterTone + txCenterTone, N);
-        std::cout << "dciqMinimize final: dcLvl=" << measDCLevel
-                  << " dB, imLvl=" << measImbalanceLevel
-                  << " dB, toneLevel=" << desiredToneLevel << "dB" << std::endl;
+        std::printf("%s dciqMinimize final: dcLvl=%g dB, imLvl=%g dB, "
+                    "toneLevel=%gdB\n",
+            name.c_str(), measDCLevel, measImbalanceLevel, desiredToneLevel);
+        corr.dc_level = measDCLevel - desiredToneLevel;
+        corr.image_level = measImbalanceLevel - desiredToneLevel;
     }
+    return corr;
 }
 
 void BaseRadioSet::dciqCalibrationProc(size_t channel)
@@ -372,6 +381,15 @@ void BaseRadioSet::dciqCalibrationProc(size_t channel)
     std::cout << "   DC Offset and IQ Imbalance Calibration: Ch " << channel
               << std::endl;
     std::cout << "****************************************************\n";
+    auto calStart = std::chrono::steady_clock::now();
+    auto lapStart = calStart;
+    // Seconds since the previous lap
+    auto lap = [&lapStart]() {
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed = now - lapStart;
+        lapStart = now;
+        return elapsed.count();
+    };
     double sampleRate = _cfg->rate();
     double centerRfFreq = _cfg->radio_rf_freq();
     double toneBBFreq = sampleRate / 7;
@@ -381,6 +399,47 @@ void BaseRadioSet::dciqCalibrationProc(size_t channel)
     Radio* refRadio = bsRadios[0][referenceRadio];
     SoapySDR::Device* refDev = refRadio->dev;
 
+    // Indices and names of the radios in allButRefDevs order
+    std::vector<size_t> allButRefIds;
+    std::vector<std::string> allButRefNames;
+    std::vector<SoapySDR::Device*> allButRefDevs;
+    for (size_t r = 0; r < radioSize; r++) {
+        if (r == referenceRadio)
+            continue;
+        allButRefIds.push_back(r);
+        allButRefNames.push_back(_cfg->bs_sdr_ids().at(0).at(r));
+        allButRefDevs.push_back(bsRadios[0][r]->dev);
+    }
+    const std::string& refName = _cfg->bs_sdr_ids().at(0).at(referenceRadio);
+    WorkerPool pool(std::min<size_t>(_cfg->ctrl_thread_num(), radioSize));
+    auto optimizer = DciqOptimizer::create(_cfg->dciq_optimizer());
+
+    // Corrections of each radio, from the cache or calibrated below
+    std::vector<DciqCorrection> rxCorr(radioSize);
+    std::vector<DciqCorrection> txCorr(radioSize);
+    std::vector<std::string> cacheKeys(radioSize);
+    bool cached = (calCache != nullptr);
+    for (size_t r = 0; (r < radioSize) && (calCache != nullptr); r++) {
+        cacheKeys[r]
+            = CalibrationCache::key(_cfg, _cfg->bs_sdr_ids().at(0).at(r));
+        const std::string& key = cacheKeys[r];
+        cached = cached
+            && calCache->findDciq(key, SOAPY_SDR_RX, channel, rxCorr[r])
+            && calCache->findDciq(key, SOAPY_SDR_TX, channel, txCorr[r]);
+    }
+    if (cached == true) {
+        std::cout << "Applying cached corrections of " << calCache->path()
+                  << std::endl;
+        // The auto RX DC correction of the radio, the reference included,
+        // would override the cached one
+        pool.parallelFor(radioSize, [&](size_t r) {
+            SoapySDR::Device* dev = bsRadios[0][r]->dev;
+            dev->setDCOffsetMode(SOAPY_SDR_RX, channel, false);
+            applyDciqCorrection(dev, SOAPY_SDR_RX, channel, rxCorr[r]);
+            applyDciqCorrection(dev, SOAPY_SDR_TX, channel, txCorr[r]);
+        });
+    }
+
     /* 
      * Start with calibrating the rx paths on all radios using the reference radio
      */
@@ -389,19 +448,14 @@ void BaseRadioSet::dciqCalibrationProc(size_t channel)
         SOAPY_SDR_TX, channel, "RF", centerRfFreq + toneBBFreq);
     refDev->setFrequency(SOAPY_SDR_RX, channel, "RF", centerRfFreq);
     refDev->setFrequency(SOAPY_SDR_TX, channel, "BB", 0);
-    std::vector<SoapySDR::Device*> allButRefDevs;
-    for (size_t r = 0; r < radioSize; r++) {
-        if (r == referenceRadio)
-            continue;
-        Radio* bsRadio = bsRadios[0][r];
-        SoapySDR::Device* dev = bsRadio->dev;
+    pool.parallelFor(allButRefDevs.size(), [&](size_t r) {
+        SoapySDR::Device* dev = allButRefDevs[r];
         // must set TX "RF" Freq to make sure, we continue using the same LO for rx cal
         dev->setFrequency(SOAPY_SDR_TX, channel, "RF", centerRfFreq);
         dev->setFrequency(SOAPY_SDR_RX, channel, "RF", centerRfFreq);
         dev->setFrequency(SOAPY_SDR_RX, channel, "BB", 0);
         dev->setDCOffsetMode(SOAPY_SDR_RX, channel, false);
-        allButRefDevs.push_back(dev);
-    }
+    });
     refDev->writeSetting(
         SOAPY_SDR_TX, channel, "TSP_TSG_CONST", std::to_string(1 << 14));
     refDev->writeSetting(SOAPY_SDR_TX, channel, "TX_ENB_OVERRIDE", "true");
@@ -409,22 +463,39 @@ void BaseRadioSet::dciqCalibrationProc(size_t channel)
     // Tune rx gains for calibration on all radios except reference radio
     // Tune tx gain on reference radio
     adjustCalibrationGains(
-        allButRefDevs, refDev, channel, toneBBFreq / sampleRate);
+        allButRefDevs, refDev, channel, toneBBFreq / sampleRate, pool);
+
+    // The cached corrections of all radios are kept when those of the rx
+    // paths of the array still hold
+    if (cached == true) {
+        std::vector<char> holds(allButRefDevs.size());
+        pool.parallelFor(allButRefDevs.size(), [&](size_t r) {
+            holds[r] = verifyDciqCorrection(allButRefDevs[r], channel,
+                toneBBFreq / sampleRate, rxCorr[allButRefIds[r]],
+                allButRefNames[r] + " RX");
+        });
+        cached = std::find(holds.begin(), holds.end(), false) == holds.end();
+    }
 
-    // Minimize Rx DC offset and IQ Imbalance on all receiving radios
-    // TODO: Parallelize this loop
-    for (size_t r = 0; r < radioSize - 1; r++) {
-        dciqMinimize(allButRefDevs[r], allButRefDevs[r], SOAPY_SDR_RX, channel,
-            0.0, toneBBFreq / sampleRate);
+    // Minimize Rx DC offset and IQ Imbalance on all receiving radios, each
+    // snoops the tone of the reference radio on its own rx path
+    if (cached == false) {
+        pool.parallelFor(allButRefDevs.size(), [&](size_t r) {
+            rxCorr[allButRefIds[r]] = dciqMinimize(allButRefDevs[r],
+                allButRefDevs[r], SOAPY_SDR_RX, channel, 0.0,
+                toneBBFreq / sampleRate, *optimizer, allButRefNames[r] + " RX");
+        });
     }
 
     refDev->writeSetting(SOAPY_SDR_TX, channel, "TSP_TSG_CONST", "NONE");
     refDev->writeSetting(SOAPY_SDR_TX, channel, "TX_ENB_OVERRIDE", "false");
+    double rxArrayTime = lap();
 
     /* 
      * Calibrate the rx path of the reference radio
      */
-    std::cout << "Calibrating Rx Channel of the Reference Radio\n";
+    std::cout << (cached ? "Verifying" : "Calibrating")
+              << " Rx Channel of the Reference Radio\n";
     std::vector<SoapySDR::Device*> refDevContainer;
     refDevContainer.push_back(refDev);
     SoapySDR::Device* refRefDev = allButRefDevs[referenceRadio - 1];
@@ -445,12 +516,29 @@ void BaseRadioSet::dciqCalibrationProc(size_t channel)
     // Tune rx gain for calibraion on reference radio
     // Tune tx gain on neighboring radio to reference radio
     adjustCalibrationGains(
-        refDevContainer, refRefDev, channel, toneBBFreq / sampleRate);
-    dciqMinimize(
-        refDev, refDev, SOAPY_SDR_RX, channel, 0.0, toneBBFreq / sampleRate);
+        refDevContainer, refRefDev, channel, toneBBFreq / sampleRate, pool);
+    // The cached corrections are kept when the one of the reference
+    // radio's rx path holds as well. The verified rx paths of the array
+    // keep theirs otherwise, all tx paths get calibrated.
+    if (cached == true) {
+        cached = verifyDciqCorrection(refDev, channel,
+            toneBBFreq / sampleRate, rxCorr[referenceRadio], refName + " RX");
+    }
+    if (cached == false) {
+        rxCorr[referenceRadio] = dciqMinimize(refDev, refDev, SOAPY_SDR_RX,
+            channel, 0.0, toneBBFreq / sampleRate, *optimizer,
+            refName + " RX");
+    }
 
     refRefDev->writeSetting(SOAPY_SDR_TX, channel, "TSP_TSG_CONST", "NONE");
     refRefDev->writeSetting(SOAPY_SDR_TX, channel, "TX_ENB_OVERRIDE", "false");
+    if (cached == true) {
+        refRefDev->setFrequency(SOAPY_SDR_TX, channel, "RF", centerRfFreq);
+        std::printf("DC/IQ calibration of ch %zu on %zu radios restored from "
+                    "the cache and verified in %.2f s\n",
+            channel, radioSize, rxArrayTime + lap());
+        return;
+    }
 
     /* 
      * Calibrate the tx path of the reference radio
@@ -474,15 +562,17 @@ void BaseRadioSet::dciqCalibrationProc(size_t channel)
     // Tune tx gain for calibraion on reference antenna
     // Tune rx gain on neighboring radio to reference radio
     adjustCalibrationGains(refRefDevContainer, refDev, channel,
-        (toneBBFreq + txToneBBFreq) / sampleRate);
-    dciqMinimize(refDev, refRefDev, SOAPY_SDR_TX, channel,
-        toneBBFreq / sampleRate, txToneBBFreq / sampleRate);
+        (toneBBFreq + txToneBBFreq) / sampleRate, pool);
+    txCorr[referenceRadio] = dciqMinimize(refDev, refRefDev, SOAPY_SDR_TX,
+        channel, toneBBFreq / sampleRate, txToneBBFreq / sampleRate,
+        *optimizer, refName + " TX");
 
     // kill TX on ref at the end
     refDev->writeSetting(SOAPY_SDR_TX, channel, "TSP_TSG_CONST", "NONE");
     refDev->writeSetting(SOAPY_SDR_TX, channel, "TX_ENB_OVERRIDE", "false");
     refDev->setFrequency(SOAPY_SDR_TX, channel, "BB", 0);
     refRefDev->setFrequency(SOAPY_SDR_RX, channel, "BB", 0);
+    double refTime = lap();
 
     /* 
      * Now calibrate the tx paths on all other radios using the reference radio
@@ -491,11 +581,16 @@ void BaseRadioSet::dciqCalibrationProc(size_t channel)
     // refDev->setFrequency(SOAPY_SDR_RX, channel, "RF", centerRfFreq);
     refDev->setFrequency(SOAPY_SDR_RX, channel, "BB",
         -toneBBFreq); // Should this be nagative if we need centerRfFreq-toneBBFreq at true center?
-    for (size_t r = 0; r < radioSize - 1; r++) {
+    // Only the reference radio listens, so the radios are measured one at
+    // a time. Tuning does not enable the tone, all of them are tuned
+    // before and reset after the measurements.
+    pool.parallelFor(allButRefDevs.size(), [&](size_t r) {
         allButRefDevs[r]->setFrequency(
             SOAPY_SDR_TX, channel, "RF", centerRfFreq);
         allButRefDevs[r]->setFrequency(
             SOAPY_SDR_TX, channel, "BB", txToneBBFreq);
+    });
+    for (size_t r = 0; r < radioSize - 1; r++) {
         allButRefDevs[r]->writeSetting(
             SOAPY_SDR_TX, channel, "TSP_TSG_CONST", std::to_string(1 << 14));
         allButRefDevs[r]->writeSetting(
@@ -503,23 +598,104 @@ void BaseRadioSet::dciqCalibrationProc(size_t channel)
         // Tune tx gain for calibraion of the current radio
         // Tune rx gain on the reference radio
         adjustCalibrationGains(refDevContainer, allButRefDevs[r], channel,
-            (toneBBFreq + txToneBBFreq) / sampleRate);
-        dciqMinimize(allButRefDevs[r], refDev, SOAPY_SDR_TX, channel,
-            toneBBFreq / sampleRate, txToneBBFreq / sampleRate);
+            (toneBBFreq + txToneBBFreq) / sampleRate, pool);
+        txCorr[allButRefIds[r]] = dciqMinimize(allButRefDevs[r], refDev,
+            SOAPY_SDR_TX, channel, toneBBFreq / sampleRate,
+            txToneBBFreq / sampleRate, *optimizer, allButRefNames[r] + " TX");
         allButRefDevs[r]->writeSetting(
             SOAPY_SDR_TX, channel, "TX_ENB_OVERRIDE", "false");
         allButRefDevs[r]->writeSetting(
             SOAPY_SDR_TX, channel, "TSP_TSG_CONST", "NONE");
+    }
+    pool.parallelFor(allButRefDevs.size(), [&](size_t r) {
         allButRefDevs[r]->setFrequency(SOAPY_SDR_TX, channel, "BB", 0);
+    });
+    double txArrayTime = lap();
+    std::chrono::duration<double> calTime
+        = std::chrono::steady_clock::now() - calStart;
+
+    if (calCache != nullptr) {
+        for (size_t r = 0; r < radioSize; r++) {
+            calCache->storeDciq(
+                cacheKeys[r], SOAPY_SDR_RX, channel, rxCorr[r]);
+            calCache->storeDciq(
+                cacheKeys[r], SOAPY_SDR_TX, channel, txCorr[r]);
+        }
+        calCache->save();
     }
+
     std::cout << "****************************************************\n";
     std::cout << "   Ending DC Offset and IQ Imbalance Calibration\n";
     std::cout << "****************************************************\n";
+    std::printf("DC/IQ calibration of ch %zu on %zu radios with %zu threads "
+                "and the %s optimizer: rx paths %.2f s, reference radio "
+                "%.2f s, tx paths %.2f s, total %.2f s\n",
+        channel, radioSize, pool.num_threads(), optimizer->name(),
+        rxArrayTime, refTime, txArrayTime, calTime.count());
+}
+
+// Moves the trigger of the radio by delta samples. The radios only take
+// unit steps, the radios of the array are adjusted concurrently instead.
+static void adjustDelay(SoapySDR::Device* dev, int delta)
+{
+    while (delta < 0) {
+        dev->writeSetting("ADJUST_DELAYS", "-1");
+        ++delta;
+    }
+    while (delta > 0) {
+        dev->writeSetting("ADJUST_DELAYS", "1");
+        --delta;
+    }
+}
+
+// Applies the cached trigger delays of the array when every radio has
+// one, delays then holds them. Nothing is applied otherwise.
+bool BaseRadioSet::restoreDelays(std::vector<int>& delays)
+{
+    size_t R = bsRadios[0].size();
+    delays.assign(R, 0);
+    if ((calCache == nullptr) || (R < 2))
+        return false;
+    std::vector<int> cached(R);
+    for (size_t i = 0; i < R; i++) {
+        const std::string key
+            = CalibrationCache::key(_cfg, _cfg->bs_sdr_ids().at(0).at(i));
+        if (calCache->findDelay(key, cached[i]) == false)
+            return false;
+    }
+    std::cout << "Applying cached trigger delays of " << calCache->path()
+              << std::endl;
+    for (size_t i = 0; i < R; i++) {
+        std::cout << "adjusting delay of node " << i << " by " << cached[i]
+                  << std::endl;
+    }
+    WorkerPool pool(std::min<size_t>(_cfg->ctrl_thread_num(), R));
+    pool.parallelFor(
+        R, [&](size_t i) { adjustDelay(bsRadios[0][i]->dev, cached[i]); });
+    delays = cached;
+    return true;
 }
 
-void BaseRadioSet::collectCSI(bool& adjust)
+void BaseRadioSet::storeDelays(const std::vector<int>& delays)
+{
+    if ((calCache == nullptr) || (delays.size() != bsRadios[0].size()))
+        return;
+    for (size_t i = 0; i < delays.size(); i++) {
+        calCache->storeDelay(
+            CalibrationCache::key(_cfg, _cfg->bs_sdr_ids().at(0).at(i)),
+            delays[i]);
+    }
+    calCache->save();
+}
+
+// Adds the ADJUST_DELAYS steps it takes on each radio to delays. Only
+// two rounds are needed: every radio hears the reference radio, and the
+// reference radio hears its neighbour. The radios of a round are set up
+// and read concurrently.
+void BaseRadioSet::collectCSI(bool& adjust, std::vector<int>& delays)
 {
     int R = bsRadios[0].size();
+    delays.resize(R, 0);
     if (R < 2) {
         std::cout << "No need to sample calibrate with one Iris! skipping ..."
                   << std::endl;
@@ -552,43 +728,53 @@ void BaseRadioSet::collectCSI(bool& adjust)
         txbuff[1] = pilot_cint16.data(); //pilot_cf32.data();
     }
 
-    //std::vector<std::vector<std::complex<float>>> buff;
-    std::vector<std::vector<std::complex<int16_t>>> buff;
-    //int ant = _cfg->bsChannel.length();
-    //int M = bsRadios[0].size() * ant;
-    buff.resize(R * R);
-    for (int i = 0; i < R; i++) {
-        for (int j = 0; j < R; j++) {
-            buff[i * R + j].resize(_cfg->samps_per_symbol());
-        }
-    }
-
-    std::vector<std::complex<int16_t>> dummyBuff0(_cfg->samps_per_symbol());
-    std::vector<std::complex<int16_t>> dummyBuff1(_cfg->samps_per_symbol());
-    std::vector<void*> dummybuffs(2);
-    dummybuffs[0] = dummyBuff0.data();
-    dummybuffs[1] = dummyBuff1.data();
-
+    int ref_ant = _cfg->cal_ref_sdr_id();
+    int ref_offset = ref_ant == 0 ? 1 : 0;
+    // Radio i keeps the pilot of radio tx[i] only
+    std::vector<int> tx(R, ref_ant);
+    tx[ref_ant] = ref_offset;
+    std::vector<std::vector<std::complex<int16_t>>> buff(R);
     for (int i = 0; i < R; i++)
+        buff[i].resize(_cfg->samps_per_symbol());
+
+    WorkerPool pool(std::min<size_t>(_cfg->ctrl_thread_num(), R));
+    // Each task drains into its own scratch buffers
+    auto drain = [&](int i) {
+        std::vector<std::complex<int16_t>> dummyBuff0(
+            _cfg->samps_per_symbol());
+        std::vector<std::complex<int16_t>> dummyBuff1(
+            _cfg->samps_per_symbol());
+        std::vector<void*> dummybuffs(2);
+        dummybuffs[0] = dummyBuff0.data();
+        dummybuffs[1] = dummyBuff1.data();
         bsRadios[0][i]->drain_buffers(dummybuffs, _cfg->samps_per_symbol());
+    };
 
-    for (int i = 0; i < R; i++) {
+    pool.parallelFor(R, [&](size_t i) {
+        drain(i);
         Radio* bsRadio = bsRadios[0][i];
         SoapySDR::Device* dev = bsRadio->dev;
         dev->setGain(SOAPY_SDR_TX, ch, "PAD", _cfg->cal_tx_gain().at(ch));
         dev->writeSetting("TDD_CONFIG", "{\"tdd_enabled\":false}");
         dev->writeSetting("TDD_MODE", "false");
         bsRadios[0][i]->activateXmit();
-    }
+    });
 
     long long txTime(0);
     long long rxTime(0);
-    for (int i = 0; i < R; i++) {
-        // All write, or prepare to receive.
+    for (int i : { ref_ant, ref_offset }) {
+        std::vector<int> round;
         for (int j = 0; j < R; j++) {
+            if ((j == i) || (tx[j] == i))
+                round.push_back(j);
+        }
+        // The sender writes, its listeners prepare to receive.
+        pool.parallelFor(round.size(), [&](size_t n) {
+            int j = round[n];
             if (j == i) {
+                long long time = txTime;
                 int ret = bsRadios[0][j]->xmit(
-                    txbuff.data(), _cfg->samps_per_symbol(), 3, txTime);
+                    txbuff.data(), _cfg->samps_per_symbol(), 3, time);
                 if (ret < 0)
                     std::cout << "bad write" << std::endl;
             } else {
@@ -597,40 +783,43 @@ void BaseRadioSet::collectCSI(bool& adjust)
                 if (ret < 0)
                     std::cout << "bad activate at node " << j << std::endl;
             }
-        }
+        });
 
         radioTrigger();
 
-        // All but one receive.
-        for (int j = 0; j < R; j++) {
+        // The listeners receive.
+        pool.parallelFor(round.size(), [&](size_t n) {
+            int j = round[n];
             if (j == i)
-                continue;
+                return;
+            std::vector<std::complex<int16_t>> dummy(
+                _cfg->samps_per_symbol());
             std::vector<void*> rxbuff(2);
-            rxbuff[0] = buff[(i * R + j)].data();
-            //rxbuff[1] = ant == 2 ? buff[(i*M+j)*ant+1].data() : dummyBuff.data();
-            rxbuff[1] = dummyBuff0.data();
+            rxbuff[0] = buff[j].data();
+            rxbuff[1] = dummy.data();
+            long long time = rxTime;
             int ret = bsRadios[0][j]->recv(
-                rxbuff.data(), _cfg->samps_per_symbol(), rxTime);
+                rxbuff.data(), _cfg->samps_per_symbol(), time);
             if (ret < 0)
                 std::cout << "bad read at node " << j << std::endl;
-        }
+        });
     }
 
-    int ref_ant = _cfg->cal_ref_sdr_id();
-    int ref_offset = ref_ant == 0 ? 1 : 0;
+    // Each pool thread runs its own LTS detector
     std::vector<int> offset(R);
+    pool.parallelFor(R, [&](size_t i) {
+        int peak = CommsLib::findLTS(Utils::cint16_to_cfloat(buff[i]), seqLen);
+        offset[i] = peak < 128 ? 0 : peak - 128;
+    });
 
     bool good_csi = true;
     for (int i = 0; i < R; i++) {
-        int k = ((i == ref_ant) ? ref_offset : ref_ant) * R + i;
-        auto rx = Utils::cint16_to_cfloat(buff[k]);
-        int peak = CommsLib::findLTS(rx, seqLen);
-        offset[i] = peak < 128 ? 0 : peak - 128;
         //std::cout << i << " " << offset[i] << std::endl;
         if (offset[i] == 0)
             good_csi = false;
 
 #if DEBUG_PLOT
+        auto rx = Utils::cint16_to_cfloat(buff[i]);
         std::vector<double> rx_I(_cfg->samps_per_symbol());
         std::transform(rx.begin(), rx.end(), rx_I.begin(),
             [](std::complex<double> cf) { return cf.real(); });
@@ -647,30 +836,24 @@ void BaseRadioSet::collectCSI(bool& adjust)
     // adjusting trigger delays based on lts peak index
     adjust &= good_csi;
     if (adjust) {
+        std::vector<int> delta(R);
         for (int i = 0; i < R; i++) {
-            Radio* bsRadio = bsRadios[0][i];
-            SoapySDR::Device* dev = bsRadio->dev;
             // if offset[i] == 0, then good_csi is false and we never get here???
-            int delta = (offset[i] == 0) ? 0 : offset[ref_offset] - offset[i];
-            std::cout << "adjusting delay of node " << i << " by " << delta
+            delta[i] = (offset[i] == 0) ? 0 : offset[ref_offset] - offset[i];
+            std::cout << "adjusting delay of node " << i << " by " << delta[i]
                       << std::endl;
-            while (delta < 0) {
-                dev->writeSetting("ADJUST_DELAYS", "-1");
-                ++delta;
-            }
-            while (delta > 0) {
-                dev->writeSetting("ADJUST_DELAYS", "1");
-                --delta;
-            }
+            delays[i] += delta[i];
         }
+        pool.parallelFor(
+            R, [&](size_t i) { adjustDelay(bsRadios[0][i]->dev, delta[i]); });
     }
 
-    for (int i = 0; i < R; i++) {
+    pool.parallelFor(R, [&](size_t i) {
         Radio* bsRadio = bsRadios[0][i];
         SoapySDR::Device* dev = bsRadio->dev;
         bsRadio->deactivateRecv();
         bsRadio->deactivateXmit();
         dev->setGain(SOAPY_SDR_TX, ch, "PAD", _cfg->tx_gain().at(ch)); //[0,30]
-        bsRadio->drain_buffers(dummybuffs, _cfg->samps_per_symbol());
-    }
+        drain(i);
+    });
 }
@@ -15,7 +15,9 @@
 #include "include/comms-lib.h"
 #include "include/logger.h"
 #include "include/macros.h"
+#include "include/startup_report.h"
 #include "include/utils.h"
+#include "include/worker_pool.h"
 
 #include "nlohmann/json.hpp"
 #include <SoapySDR/Errors.hpp>
@@ -27,52 +29,58 @@ using json = nlohmann::json;
 BaseRadioSet::BaseRadioSet(Config* cfg)
     : _cfg(cfg)
 {
+    StartupReport report("BaseRadioSet");
     std::vector<size_t> num_bs_antenntas(_cfg->num_cells());
     bsRadios.resize(_cfg->num_cells());
     radioNotFound = false;
     std::vector<std::string> radio_serial_not_found;
+    if (((_cfg->imbalance_cal_en() == true) || (_cfg->sample_cal_en() == true))
+        && (_cfg->calib_cache().empty() == false)) {
+        calCache = std::make_unique<CalibrationCache>(_cfg->calib_cache());
+    }
 
+    size_t total_radios = 0;
     for (size_t c = 0; c < _cfg->num_cells(); c++) {
         size_t num_radios = _cfg->n_bs_sdrs()[c];
         num_bs_antenntas[c] = num_radios * _cfg->bs_channel().length();
         MLPD_TRACE("Setting up radio: %zu, cells: %zu\n", num_radios,
             _cfg->num_cells());
-        if ((kUseUHD == false) && (_cfg->hub_ids().empty() == false)) {
-            SoapySDR::Kwargs args;
-            args["driver"] = "remote";
-            args["timeout"] = "1000000";
-            args["serial"] = _cfg->hub_ids().at(c);
-            hubs.push_back(SoapySDR::Device::make(args));
-        }
         bsRadios.at(c).resize(num_radios);
-        std::atomic_ulong thread_count = ATOMIC_VAR_INIT(num_radios);
-
-        MLPD_TRACE("Init base radios: %zu\n", num_radios);
-        for (size_t i = 0; i < num_radios; i++) {
-            BaseRadioContext* context = new BaseRadioContext;
-            context->brs = this;
-            context->thread_count = &thread_count;
-            context->tid = i;
-            context->cell = c;
+        total_radios += num_radios;
+    }
+    // The radios of all cells are brought up together, one task per radio
 #ifdef THREADED_INIT
-            pthread_t init_thread_;
-
-            if (pthread_create(
-                    &init_thread_, NULL, BaseRadioSet::init_launch, context)
-                != 0) {
-                delete context;
-                throw std::runtime_error(
-                    "BaseRadioSet - init thread create failed");
-            }
+    WorkerPool pool(std::min<size_t>(_cfg->ctrl_thread_num(), total_radios));
 #else
-            init(context);
+    WorkerPool pool(1);
 #endif
-        }
 
-        // Wait for init
-        while (thread_count.load() > 0) {
-        }
+    if ((kUseUHD == false) && (_cfg->hub_ids().empty() == false)) {
+        hubs.resize(_cfg->num_cells());
+        pool.parallelFor(_cfg->num_cells(), [&](size_t c) {
+            SoapySDR::Kwargs args;
+            args["driver"] = "remote";
+            args["timeout"] = "1000000";
+            args["serial"] = _cfg->hub_ids().at(c);
+            hubs.at(c) = SoapySDR::Device::make(args);
+        });
+        report.endStage("hubs");
+    }
+
+    MLPD_TRACE("Init base radios: %zu\n", total_radios);
+    std::vector<std::future<double>> inits;
+    for (size_t c = 0; c < _cfg->num_cells(); c++) {
+        for (size_t i = 0; i < bsRadios.at(c).size(); i++)
+            inits.push_back(pool.submit([this, c, i]() { return init(c, i); }));
+    }
+    for (size_t c = 0, k = 0; c < _cfg->num_cells(); c++) {
+        for (size_t i = 0; i < bsRadios.at(c).size(); i++, k++)
+            report.addRadio(_cfg->bs_sdr_ids().at(c).at(i), inits.at(k).get());
+    }
+    report.endStage("init");
 
+    for (size_t c = 0; c < _cfg->num_cells(); c++) {
+        size_t num_radios = bsRadios.at(c).size();
         // Strip out broken radios.
         for (size_t i = 0; i < num_radios; i++) {
             if (bsRadios.at(c).at(i) == NULL) {
@@ -92,42 +100,36 @@ BaseRadioSet::BaseRadioSet(Config* cfg)
         }
         bsRadios.at(c).shrink_to_fit();
         _cfg->n_bs_sdrs().at(c) = num_radios;
-        if (radioNotFound == true) {
-            break;
-        }
+    }
 
+    if (radioNotFound == false) {
         // Perform DC Offset & IQ Imbalance Calibration
         if (_cfg->imbalance_cal_en() == true) {
             if (_cfg->bs_channel().find('A') != std::string::npos)
                 dciqCalibrationProc(0);
             if (_cfg->bs_channel().find('B') != std::string::npos)
                 dciqCalibrationProc(1);
+            report.endStage("dciq calibration");
         }
 
-        thread_count.store(num_radios);
-        for (size_t i = 0; i < num_radios; i++) {
-            BaseRadioContext* context = new BaseRadioContext;
-            context->brs = this;
-            context->thread_count = &thread_count;
-            context->tid = i;
-            context->cell = c;
-#ifdef THREADED_INIT
-            pthread_t configure_thread_;
-            if (pthread_create(&configure_thread_, NULL,
-                    BaseRadioSet::configure_launch, context)
-                != 0) {
-                delete context;
-                throw std::runtime_error(
-                    "BaseRadioSet - configure thread create failed");
+        std::vector<std::future<double>> configures;
+        for (size_t c = 0; c < _cfg->num_cells(); c++) {
+            for (size_t i = 0; i < bsRadios.at(c).size(); i++) {
+                configures.push_back(
+                    pool.submit([this, c, i]() { return configure(c, i); }));
             }
-#else
-            configure(context);
-#endif
         }
-
-        while (thread_count.load() > 0) {
+        for (size_t c = 0, k = 0; c < _cfg->num_cells(); c++) {
+            for (size_t i = 0; i < bsRadios.at(c).size(); i++, k++) {
+                report.addRadio(_cfg->bs_sdr_ids().at(c).at(i),
+                    configures.at(k).get());
+            }
         }
+        report.endStage("configure");
+    }
 
+    for (size_t c = 0; (radioNotFound == false) && (c < _cfg->num_cells());
+         c++) {
         auto channels = Utils::strToChannels(_cfg->bs_channel());
 
         for (size_t i = 0; i < bsRadios.at(c).size(); i++) {
@@ -211,22 +213,41 @@ BaseRadioSet::BaseRadioSet(Config* cfg)
                      "discovered in the network!\033[0m"
                   << std::endl;
     } else {
+        report.endStage("sync delays");
         if (_cfg->sample_cal_en() == true) {
             bool adjust = false;
             int cal_cnt = 0;
-            while (!adjust) {
-                if (++cal_cnt > 10) {
-                    std::cout << "10 attemps of sample offset calibration, "
-                                 "stopping..."
-                              << std::endl;
-                    break;
-                }
+            // Sum of the ADJUST_DELAYS steps of each radio
+            std::vector<int> delays;
+            bool restored = restoreDelays(delays);
+            if (restored == true) {
+                // run 0: the cached delays hold when nothing moves
+                const std::vector<int> cached = delays;
                 adjust = true;
-                collectCSI(adjust); // run 1: find offsets and adjust
+                collectCSI(adjust, delays);
+                restored = (adjust == true) && (delays == cached);
+            }
+            if (restored == false) {
+                while (!adjust) {
+                    if (++cal_cnt > 10) {
+                        std::cout << "10 attemps of sample offset calibration, "
+                                     "stopping..."
+                                  << std::endl;
+                        break;
+                    }
+                    // run 1: find offsets and adjust
+                    adjust = true;
+                    collectCSI(adjust, delays);
+                }
+                collectCSI(adjust, delays); // run 2: verify adjustments
+                if (adjust == true)
+                    storeDelays(delays);
             }
-            collectCSI(adjust); // run 2: verify adjustments
             usleep(100000);
-            std::cout << "sample offset calibration done!" << std::endl;
+            std::cout << "sample offset calibration "
+                      << (restored ? "restored from cache" : "done!")
+                      << std::endl;
+            report.endStage("sample calibration");
         }
 
         nlohmann::json tddConf;
@@ -340,6 +361,8 @@ BaseRadioSet::BaseRadioSet(Config* cfg)
                 }
             }
         }
+        report.endStage("tdd setup");
+        report.print();
         MLPD_INFO("%s done!\n", __func__);
     }
 }
@@ -355,25 +378,18 @@ BaseRadioSet::~BaseRadioSet(void)
             delete bsRadios.at(c).at(i);
 }
 
-void* BaseRadioSet::init_launch(void* in_context)
-{
-    BaseRadioContext* context = reinterpret_cast<BaseRadioContext*>(in_context);
-    context->brs->init(context);
-    return 0;
-}
-
-void BaseRadioSet::init(BaseRadioContext* context)
+double BaseRadioSet::init(size_t c, size_t i)
 {
-    int i = context->tid;
-    int c = context->cell;
-    std::atomic_ulong* thread_count = context->thread_count;
-    delete context;
-
-    MLPD_TRACE("Deleting context for tid: %d\n", i);
-
+    auto start = std::chrono::steady_clock::now();
     auto channels = Utils::strToChannels(_cfg->bs_channel());
     SoapySDR::Kwargs args;
-    if (kUseUHD == false) {
+    if (_cfg->sim_mode() == true) {
+        args["driver"] = "sim";
+        args["serial"] = _cfg->bs_sdr_ids().at(c).at(i);
+        args["mode"] = "bs";
+        args["cell"] = std::to_string(c);
+        args["radio"] = std::to_string(i);
+    } else if (kUseUHD == false) {
         args["driver"] = "iris";
         args["serial"] = _cfg->bs_sdr_ids().at(c).at(i);
     } else {
@@ -385,7 +401,7 @@ void BaseRadioSet::init(BaseRadioContext* context)
     try {
         bsRadios.at(c).at(i) = nullptr;
         bsRadios.at(c).at(i)
-            = new Radio(args, SOAPY_SDR_CS16, channels, _cfg->rate());
+            = new Radio(args, SOAPY_SDR_CS16, channels, _cfg->rate(), _cfg);
     } catch (std::runtime_error& err) {
         if (kUseUHD == false) {
             std::cerr << "Ignoring iris " << _cfg->bs_sdr_ids().at(c).at(i)
@@ -401,24 +417,14 @@ void BaseRadioSet::init(BaseRadioContext* context)
         }
     }
     MLPD_TRACE("BaseRadioSet: Init complete\n");
-    assert(thread_count->load() != 0);
-    thread_count->store(thread_count->load() - 1);
-}
-
-void* BaseRadioSet::configure_launch(void* in_context)
-{
-    BaseRadioContext* context = reinterpret_cast<BaseRadioContext*>(in_context);
-    context->brs->configure(context);
-    return 0;
+    std::chrono::duration<double> elapsed
+        = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
 }
 
-void BaseRadioSet::configure(BaseRadioContext* context)
+double BaseRadioSet::configure(size_t c, size_t i)
 {
-    int i = context->tid;
-    int c = context->cell;
-    std::atomic_ulong* thread_count = context->thread_count;
-    delete context;
-
+    auto start = std::chrono::steady_clock::now();
     //load channels
     auto channels = Utils::strToChannels(_cfg->bs_channel());
     Radio* bsRadio = bsRadios.at(c).at(i);
@@ -429,9 +435,9 @@ void BaseRadioSet::configure(BaseRadioContext* context)
         double txgain = _cfg->tx_gain().at(ch);
         bsRadios.at(c).at(i)->dev_init(_cfg, ch, rxgain, txgain);
     }
-
-    assert(thread_count->load() != 0);
-    thread_count->store(thread_count->load() - 1);
+    std::chrono::duration<double> elapsed
+        = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
 }
 
 SoapySDR::Device* BaseRadioSet::baseRadio(size_t cellId)
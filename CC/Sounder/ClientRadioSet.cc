@@ -12,7 +12,9 @@
 #include "include/comms-lib.h"
 #include "include/logger.h"
 #include "include/macros.h"
+#include "include/startup_report.h"
 #include "include/utils.h"
+#include "include/worker_pool.h"
 #include "nlohmann/json.hpp"
 #include <SoapySDR/Errors.hpp>
 #include <SoapySDR/Formats.hpp>
@@ -39,28 +41,19 @@ ClientRadioSet::ClientRadioSet(Config* cfg)
     radios.resize(num_radios);
     radioNotFound = false;
     std::vector<std::string> radioSerialNotFound;
-    std::atomic_ulong thread_count = ATOMIC_VAR_INIT(num_radios);
-    for (size_t i = 0; i < num_radios; i++) {
-        ClientRadioContext* context = new ClientRadioContext;
-        context->crs = this;
-        context->thread_count = &thread_count;
-        context->tid = i;
+    StartupReport report("ClientRadioSet");
+    {
 #ifdef THREADED_INIT
-        pthread_t init_thread_;
-
-        if (pthread_create(
-                &init_thread_, NULL, ClientRadioSet::init_launch, context)
-            != 0) {
-            delete context;
-            throw std::runtime_error(
-                "ClientRadioSet - init thread create failed");
-        }
+        WorkerPool pool(std::min<size_t>(_cfg->ctrl_thread_num(), num_radios));
 #else
-        init(context);
+        WorkerPool pool(1);
 #endif
-    }
-    // Wait for init
-    while (thread_count.load() > 0) {
+        std::vector<std::future<double>> inits;
+        for (size_t i = 0; i < num_radios; i++)
+            inits.push_back(pool.submit([this, i]() { return init(i); }));
+        for (size_t i = 0; i < num_radios; i++)
+            report.addRadio(_cfg->cl_sdr_ids().at(i), inits.at(i).get());
+        report.endStage("init");
     }
     // Strip out broken radios.
     for (size_t i = 0; i < num_radios; i++) {
@@ -235,42 +228,39 @@ ClientRadioSet::ClientRadioSet(Config* cfg)
                 }
             }
         }
+        report.endStage("tdd setup");
+        report.print();
         MLPD_INFO("%s done!\n", __func__);
     }
 }
 
-void* ClientRadioSet::init_launch(void* in_context)
+double ClientRadioSet::init(size_t i)
 {
-    ClientRadioContext* context
-        = reinterpret_cast<ClientRadioContext*>(in_context);
-    context->crs->init(context);
-    return 0;
-}
-
-void ClientRadioSet::init(ClientRadioContext* context)
-{
-    int i = context->tid;
-    std::atomic_ulong* thread_count = context->thread_count;
-    delete context;
-
-    MLPD_TRACE("Deleting context for tid: %d\n", i);
-
+    auto start = std::chrono::steady_clock::now();
     bool has_runtime_error(false);
     auto channels = Utils::strToChannels(_cfg->cl_channel());
     MLPD_TRACE("ClientRadioSet setting up radio: %zu : %zu\n", (i + 1),
         _cfg->num_cl_sdrs());
     SoapySDR::Kwargs args;
     args["timeout"] = "1000000";
-    if (kUseUHD == false) {
+    if (_cfg->sim_mode() == true) {
+        args["driver"] = "sim";
+        args["serial"] = _cfg->cl_sdr_ids().at(i);
+        args["mode"] = "client";
+        args["cell"] = "0";
+        args["radio"] = std::to_string(i);
+    } else if (kUseUHD == false) {
         args["driver"] = "iris";
         args["serial"] = _cfg->cl_sdr_ids().at(i);
     } else {
         args["driver"] = "uhd";
         args["addr"] = _cfg->cl_sdr_ids().at(i);
     }
+    const char* format = _cfg->cl_stream_format() == "cs16" ? SOAPY_SDR_CS16
+                                                            : SOAPY_SDR_CF32;
     try {
         radios.at(i) = nullptr;
-        radios.at(i) = new Radio(args, SOAPY_SDR_CF32, channels, _cfg->rate());
+        radios.at(i) = new Radio(args, format, channels, _cfg->rate(), _cfg);
     } catch (std::runtime_error& err) {
         has_runtime_error = true;
 
@@ -305,8 +295,9 @@ void ClientRadioSet::init(ClientRadioContext* context)
         }
     }
     MLPD_TRACE("BaseRadioSet: Init complete\n");
-    assert(thread_count->load() != 0);
-    thread_count->store(thread_count->load() - 1);
+    std::chrono::duration<double> elapsed
+        = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
 }
 
 ClientRadioSet::~ClientRadioSet(void) { freeRadios(radios); }
@@ -1,4 +1,5 @@
 #include "include/Radio.h"
+#include "include/SimDevice.h"
 #include "include/logger.h"
 #include "include/macros.h"
 #include <SoapySDR/Errors.hpp>
@@ -81,9 +82,13 @@ void Radio::drain_buffers(std::vector<void*> buffs, int symSamp)
 }
 
 Radio::Radio(const SoapySDR::Kwargs& args, const char soapyFmt[],
-    const std::vector<size_t>& channels, double rate)
+    const std::vector<size_t>& channels, double rate, Config* cfg)
 {
-    dev = SoapySDR::Device::make(args);
+    sim_ = (args.count("driver") != 0) && (args.at("driver") == "sim");
+    if (sim_ == true)
+        dev = new SimDevice(cfg, args);
+    else
+        dev = SoapySDR::Device::make(args);
     if (dev == NULL)
         throw std::invalid_argument("error making SoapySDR::Device\n");
     for (auto ch : channels) {
@@ -93,7 +98,7 @@ Radio::Radio(const SoapySDR::Kwargs& args, const char soapyFmt[],
     rxs = dev->setupStream(SOAPY_SDR_RX, soapyFmt, channels);
     txs = dev->setupStream(SOAPY_SDR_TX, soapyFmt, channels);
 
-    if (!kUseUHD)
+    if (!kUseUHD && !sim_)
         reset_DATA_clk_domain();
 }
 
@@ -103,14 +108,20 @@ Radio::~Radio(void)
     deactivateXmit();
     dev->closeStream(rxs);
     dev->closeStream(txs);
-    SoapySDR::Device::unmake(dev);
+    // simulated devices are not known to the SoapySDR factory
+    if (sim_ == true)
+        delete dev;
+    else
+        SoapySDR::Device::unmake(dev);
 }
 
 int Radio::recv(void* const* buffs, int samples, long long& frameTime)
 {
     int flags(0);
     int r = dev->readStream(rxs, buffs, samples, flags, frameTime, 1000000);
-    if (r < 0) {
+    if ((r == 0) && ((flags & SOAPY_SDR_END_BURST) != 0)) {
+        MLPD_TRACE("Time: %lld, the receive stream ended\n", frameTime);
+    } else if (r < 0) {
         MLPD_ERROR("Time: %lld, readStream error: %d - %s, flags: %d\n",
             frameTime, r, SoapySDR::errToStr(r), flags);
         MLPD_TRACE("Samples: %d, Frame time: %lld\n", samples, frameTime);
@@ -0,0 +1,330 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Simulated SoapySDR device producing timestamped frames from the
+ Config schedule, used to load-test Sounder without Iris hardware
+---------------------------------------------------------------------
+*/
+
+#include "include/SimDevice.h"
+#include "include/logger.h"
+#include "include/macros.h"
+
+#include <SoapySDR/Errors.hpp>
+#include <SoapySDR/Formats.hpp>
+#include <SoapySDR/Time.hpp>
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <thread>
+
+const size_t SimDevice::kNumChannels = 2;
+
+SimDevice::SimDevice(Config* cfg, const SoapySDR::Kwargs& args)
+    : cfg_(cfg)
+    , serial_(args.at("serial"))
+    , cell_(std::stoul(args.at("cell")))
+    , radio_(std::stoul(args.at("radio")))
+    , client_(args.at("mode") == "client")
+    , rate_(cfg->rate())
+    , rx_cursor_(0)
+    , rx_offset_(0)
+    , rx_sample_(0)
+    , rx_start_sample_(0)
+    , rx_started_(false)
+    , frame_count_(0)
+{
+    framed_ = (client_ == false) || cfg_->hw_framer();
+    symbol_len_ = cfg_->samps_per_symbol();
+    frame_len_ = symbol_len_ * cfg_->symbols_per_frame();
+    buildFrame();
+    MLPD_TRACE("Simulated %s radio %s: %zu rx symbols per frame\n",
+        client_ ? "client" : "base station", serial_.c_str(),
+        framed_ ? rx_symbols_.size() : cfg_->symbols_per_frame());
+}
+
+SimDevice::~SimDevice(void) {}
+
+void SimDevice::buildFrame(void)
+{
+    // Schedule of what this radio hears over the air; the beacon is the
+    // only signal clients look for, base stations receive what the
+    // clients transmit
+    std::string schedule;
+    std::string rx_types;
+    if (client_ == false) {
+        schedule = cfg_->reciprocal_calib()
+            ? cfg_->calib_frames().at(cell_).at(radio_)
+            : cfg_->frames().at(cell_);
+        rx_types = cfg_->reciprocal_calib() ? "R" : "PNU";
+    } else if (framed_ == true) {
+        schedule = cfg_->cl_frames().at(radio_);
+        rx_types = "D";
+    } else {
+        schedule = cfg_->bs_present() ? cfg_->frames().at(0)
+                                      : std::string(1, 'B');
+        schedule.resize(cfg_->symbols_per_frame(), 'G');
+        rx_types = schedule;
+    }
+
+    std::mt19937 gen(std::hash<std::string>()(serial_));
+    std::normal_distribution<float> noise(0, cfg_->sim_noise_level());
+    auto& ul_data = cfg_->txdata_time_dom();
+    const std::vector<std::complex<float>>& pilot = cfg_->pilot_cf32();
+    const std::vector<std::complex<int16_t>>& beacon = cfg_->beacon_ci16();
+
+    frame_cf32_.resize(kNumChannels);
+    frame_cs16_.resize(kNumChannels);
+    for (size_t ch = 0; ch < kNumChannels; ch++) {
+        std::vector<std::complex<float>>& frame = frame_cf32_.at(ch);
+        frame.resize(frame_len_);
+        for (auto& s : frame)
+            s = std::complex<float>(noise(gen), noise(gen));
+
+        size_t ul_sym = 0;
+        for (size_t s = 0; s < schedule.size(); s++) {
+            std::complex<float>* sym = frame.data() + s * symbol_len_;
+            char sym_type = schedule.at(s);
+            if ((sym_type == 'P') || (sym_type == 'R')) {
+                for (size_t i = 0; i < symbol_len_ && i < pilot.size(); i++)
+                    sym[i] += pilot.at(i);
+            } else if (sym_type == 'U') {
+                // Uplink from all client antennas superimposed
+                for (auto& ant_data : ul_data) {
+                    if (ant_data.size() < (ul_sym + 1) * symbol_len_)
+                        continue;
+                    for (size_t i = 0; i < symbol_len_; i++)
+                        sym[i] += ant_data.at(ul_sym * symbol_len_ + i);
+                }
+                ul_sym++;
+            } else if ((sym_type == 'B') && (client_ == true)) {
+                for (size_t i = 0; i < symbol_len_ && i < beacon.size(); i++)
+                    sym[i] += std::complex<float>(
+                        beacon.at(i).real() / 32768.0,
+                        beacon.at(i).imag() / 32768.0);
+            }
+            if ((ch == 0) && (rx_types.find(sym_type) != std::string::npos))
+                rx_symbols_.push_back(s);
+        }
+
+        frame_cs16_.at(ch).resize(frame_len_);
+        for (size_t i = 0; i < frame_len_; i++) {
+            frame_cs16_.at(ch).at(i) = std::complex<int16_t>(
+                std::max(-32768.f, std::min(32767.f, frame[i].real() * 32768)),
+                std::max(-32768.f, std::min(32767.f, frame[i].imag() * 32768)));
+        }
+    }
+
+    // Start clients part way into a frame so that beacon detection and
+    // alignment are exercised
+    if (framed_ == false)
+        rx_start_sample_ = (radio_ * 97 + symbol_len_ / 2) % frame_len_;
+    rx_sample_ = rx_start_sample_;
+}
+
+void SimDevice::waitForSample(unsigned long long sample) const
+{
+    if (cfg_->sim_max_speed() == true)
+        return;
+    std::chrono::duration<double> elapsed(sample / rate_);
+    std::this_thread::sleep_until(start_time_
+        + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            elapsed));
+}
+
+std::string SimDevice::getDriverKey(void) const { return "sim"; }
+
+std::string SimDevice::getHardwareKey(void) const { return serial_; }
+
+SoapySDR::Kwargs SimDevice::getHardwareInfo(void) const
+{
+    SoapySDR::Kwargs info;
+    info["frontend"] = "SIM";
+    info["serial"] = serial_;
+    return info;
+}
+
+size_t SimDevice::getNumChannels(const int direction) const
+{
+    (void)direction;
+    return kNumChannels;
+}
+
+void SimDevice::setSampleRate(
+    const int direction, const size_t channel, const double rate)
+{
+    (void)direction;
+    (void)channel;
+    rate_ = rate;
+}
+
+double SimDevice::getSampleRate(
+    const int direction, const size_t channel) const
+{
+    (void)direction;
+    (void)channel;
+    return rate_;
+}
+
+SoapySDR::Stream* SimDevice::setupStream(const int direction,
+    const std::string& format, const std::vector<size_t>& channels,
+    const SoapySDR::Kwargs& args)
+{
+    (void)args;
+    if ((format != SOAPY_SDR_CS16) && (format != SOAPY_SDR_CF32))
+        throw std::runtime_error("SimDevice: unsupported format " + format);
+    SimStream* stream = new SimStream;
+    stream->direction = direction;
+    stream->cs16 = (format == SOAPY_SDR_CS16);
+    stream->channels = channels.empty() ? std::vector<size_t>(1, 0) : channels;
+    stream->active = false;
+    return reinterpret_cast<SoapySDR::Stream*>(stream);
+}
+
+void SimDevice::closeStream(SoapySDR::Stream* stream)
+{
+    delete reinterpret_cast<SimStream*>(stream);
+}
+
+int SimDevice::activateStream(SoapySDR::Stream* stream, const int flags,
+    const long long timeNs, const size_t numElems)
+{
+    (void)flags;
+    (void)timeNs;
+    (void)numElems;
+    reinterpret_cast<SimStream*>(stream)->active = true;
+    return 0;
+}
+
+int SimDevice::deactivateStream(
+    SoapySDR::Stream* stream, const int flags, const long long timeNs)
+{
+    (void)flags;
+    (void)timeNs;
+    reinterpret_cast<SimStream*>(stream)->active = false;
+    return 0;
+}
+
+int SimDevice::readStream(SoapySDR::Stream* stream, void* const* buffs,
+    const size_t numElems, int& flags, long long& timeNs,
+    const long timeoutUs)
+{
+    SimStream* sim_stream = reinterpret_cast<SimStream*>(stream);
+    flags = 0;
+    // Like the Iris TDD framer, stop producing frames after max_frame. The
+    // stream ends as a burst would, with no samples and no error.
+    if ((cfg_->max_frame() != 0)
+        && (frame_count_.load() >= cfg_->max_frame())) {
+        flags = SOAPY_SDR_END_BURST;
+        return 0;
+    }
+    if ((sim_stream->active == false) || (rx_symbols_.empty() == true)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(timeoutUs));
+        return SOAPY_SDR_TIMEOUT;
+    }
+    // Samples are paced from the first read rather than from activation
+    if (rx_started_ == false) {
+        start_time_ = std::chrono::steady_clock::now();
+        rx_started_ = true;
+    }
+
+    size_t num_samps;
+    size_t frame_pos;
+    if (framed_ == true) {
+        size_t symbol_id = rx_symbols_.at(rx_cursor_);
+        unsigned long long frame_id = frame_count_.load();
+        num_samps = std::min(numElems, symbol_len_ - rx_offset_);
+        frame_pos = symbol_id * symbol_len_ + rx_offset_;
+        waitForSample(frame_id * frame_len_ + frame_pos + num_samps);
+        timeNs = (frame_id << 32) | (symbol_id << 16) | rx_offset_;
+        flags |= SOAPY_SDR_HAS_TIME;
+    } else {
+        num_samps = numElems;
+        frame_pos = rx_sample_ % frame_len_;
+        waitForSample(rx_sample_ - rx_start_sample_ + num_samps);
+        timeNs = SoapySDR::ticksToTimeNs(rx_sample_, rate_);
+        flags |= SOAPY_SDR_HAS_TIME;
+    }
+
+    for (size_t i = 0; i < sim_stream->channels.size(); i++) {
+        size_t ch = sim_stream->channels.at(i) % kNumChannels;
+        size_t samp_size = sim_stream->cs16 ? sizeof(std::complex<int16_t>)
+                                            : sizeof(std::complex<float>);
+        const char* src = sim_stream->cs16
+            ? reinterpret_cast<const char*>(frame_cs16_.at(ch).data())
+            : reinterpret_cast<const char*>(frame_cf32_.at(ch).data());
+        char* dst = reinterpret_cast<char*>(buffs[i]);
+        // Continuous streams may wrap around the end of the frame
+        size_t copied = 0;
+        size_t pos = frame_pos;
+        while (copied < num_samps) {
+            size_t n = std::min(num_samps - copied, frame_len_ - pos);
+            std::memcpy(
+                dst + copied * samp_size, src + pos * samp_size, n * samp_size);
+            copied += n;
+            pos = 0;
+        }
+    }
+
+    if (framed_ == true) {
+        rx_offset_ += num_samps;
+        if (rx_offset_ == symbol_len_) {
+            rx_offset_ = 0;
+            if (++rx_cursor_ == rx_symbols_.size()) {
+                rx_cursor_ = 0;
+                frame_count_++;
+            }
+        }
+    } else {
+        rx_sample_ += num_samps;
+        frame_count_.store(rx_sample_ / frame_len_);
+    }
+    return num_samps;
+}
+
+int SimDevice::writeStream(SoapySDR::Stream* stream, const void* const* buffs,
+    const size_t numElems, int& flags, const long long timeNs,
+    const long timeoutUs)
+{
+    // Transmitted samples are dropped, the receive side is generated
+    // from the schedule. Like a radio, a continuous stream rejects
+    // samples timed before the sample it is receiving.
+    (void)stream;
+    (void)buffs;
+    (void)timeoutUs;
+    if ((framed_ == false) && (rx_started_ == true)
+        && ((flags & SOAPY_SDR_HAS_TIME) != 0)) {
+        long long tx_sample = SoapySDR::timeNsToTicks(timeNs, rate_);
+        if (tx_sample < static_cast<long long>(currentSample()))
+            return SOAPY_SDR_TIME_ERROR;
+    }
+    return numElems;
+}
+
+unsigned long long SimDevice::currentSample(void) const
+{
+    if (rx_started_ == false)
+        return framed_ ? 0 : rx_start_sample_;
+    if (cfg_->sim_max_speed() == true)
+        return framed_ ? frame_count_.load() * frame_len_ : rx_sample_;
+    std::chrono::duration<double> elapsed
+        = std::chrono::steady_clock::now() - start_time_;
+    return (framed_ ? 0 : rx_start_sample_)
+        + static_cast<unsigned long long>(elapsed.count() * rate_);
+}
+
+long long SimDevice::getHardwareTime(const std::string& what) const
+{
+    (void)what;
+    return SoapySDR::ticksToTimeNs(
+        static_cast<long long>(currentSample()), rate_);
+}
+
+std::string SimDevice::readSetting(const std::string& key) const
+{
+    if (key == "TRIGGER_COUNT")
+        return std::to_string(frame_count_.load());
+    return "";
+}
@@ -0,0 +1,158 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Streaming detection of the two repetition gold sequence beacon over
+ consecutive receive buffers, same decision as CommsLib::find_beacon_avx
+---------------------------------------------------------------------
+*/
+
+#include "include/beacon_detector.h"
+#include "include/comms-lib.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Largest CS16 correlation shift, the threshold is scaled by
+// 2^(2 * (30 - shift)) and the correlation of longer sequences may saturate
+static constexpr int kMaxCs16Shift = 30;
+
+BeaconDetector::BeaconDetector(
+    const std::vector<std::complex<float>>& seq, size_t max_samples)
+    : correlator_(seq)
+    , seq_len_(seq.size())
+    , max_samples_(max_samples)
+    , window_(seq.size() - 1 + max_samples, 0)
+    , corr_(max_samples)
+    , energy_(seq.size(), 0)
+    , window_cs16_(seq.size() - 1 + max_samples, 0)
+    , corr_cs16_(max_samples)
+    , energy_cs16_(seq.size(), 0)
+{
+    // Q15 sequence, the correlation kernel takes +-32767
+    auto to_q15 = [](float x) {
+        return static_cast<int16_t>(
+            std::min(std::max(std::round(x * 32768.f), -32767.f), 32767.f));
+    };
+    std::vector<std::complex<int16_t>> seq_cs16(seq.size());
+    int64_t max_sum = 0;
+    for (size_t i = 0; i < seq.size(); i++) {
+        seq_cs16[i] = std::complex<int16_t>(
+            to_q15(seq[i].real()), to_q15(seq[i].imag()));
+        max_sum += 32768
+            * (std::abs(seq_cs16[i].real()) + std::abs(seq_cs16[i].imag()));
+    }
+    taps_cs16_ = CommsLib::correlate_taps(seq_cs16);
+
+    // Smallest shift keeping a full scale correlation, plus the rounding of
+    // each tap, below saturation
+    int64_t max_out = 32767 - static_cast<int64_t>(seq_len_) - 1;
+    cs16_shift_ = 0;
+    while ((max_sum >> cs16_shift_) > max_out)
+        cs16_shift_++;
+    // Energies are below 2^31, the threshold sum of L of them scaled by
+    // 2^(2 * (30 - shift)) has to fit 64 bits
+    int sum_bits = 31;
+    while ((size_t(1) << (sum_bits - 31)) < seq_len_)
+        sum_bits++;
+    while (sum_bits + 2 * (kMaxCs16Shift - cs16_shift_) > 63)
+        cs16_shift_++;
+    cs16_shift_ = std::min(cs16_shift_, kMaxCs16Shift);
+
+    reset();
+}
+
+void BeaconDetector::reset(void)
+{
+    std::fill(window_.begin(), window_.end(), 0);
+    std::fill(energy_.begin(), energy_.end(), 0);
+    std::fill(window_cs16_.begin(), window_cs16_.end(), 0);
+    std::fill(energy_cs16_.begin(), energy_cs16_.end(), 0);
+    thresh_cs16_ = 0;
+    samples_ = 0;
+    peak_index_ = -1;
+    peak_sample_ = -1;
+    confidence_ = 0;
+}
+
+bool BeaconDetector::process(const std::complex<float>* samples, size_t length)
+{
+    size_t pad = seq_len_ - 1;
+    peak_index_ = -1;
+    for (size_t done = 0; done < length;) {
+        size_t count = std::min(max_samples_, length - done);
+        std::copy(
+            samples + done, samples + done + count, window_.begin() + pad);
+        correlator_.correlateValid(window_.data(), pad + count, corr_.data());
+
+        // Summed over again for every buffer so the running sum can't drift
+        double thresh = std::accumulate(energy_.begin(), energy_.end(), 0.0);
+        for (size_t i = 0; i < count; i++) {
+            long long sample = samples_ + i;
+            float& energy_dly = energy_[sample % seq_len_];
+            float energy = corr_[i].real() * corr_[i].real()
+                + corr_[i].imag() * corr_[i].imag();
+            // |c[n] * conj(c[n - L])|^2, the gold repetitions correlated
+            float metric = energy * energy_dly;
+            // thresh includes e[n - L], so it is positive here
+            if ((peak_index_ < 0) && (metric > thresh))
+                found(done + i, sample, metric / thresh);
+            thresh += energy - energy_dly;
+            energy_dly = energy;
+        }
+
+        // Keep the samples the next windows start with
+        std::copy(window_.begin() + count, window_.begin() + count + pad,
+            window_.begin());
+        samples_ += count;
+        done += count;
+    }
+    return peak_index_ >= 0;
+}
+
+bool BeaconDetector::process(
+    const std::complex<int16_t>* samples, size_t length)
+{
+    peak_index_ = -1;
+    size_t pad = seq_len_ - 1;
+    // e16 = e * 2^(2 * (30 - shift)), so e * e_dly > thresh becomes
+    // e16 * e16_dly > thresh16 * 2^(2 * (30 - shift))
+    int thresh_shift = 2 * (kMaxCs16Shift - cs16_shift_);
+    for (size_t done = 0; done < length;) {
+        size_t count = std::min(max_samples_, length - done);
+        std::copy(
+            samples + done, samples + done + count, window_cs16_.begin() + pad);
+        CommsLib::correlate_avx(window_cs16_.data(), pad + count, taps_cs16_,
+            cs16_shift_, corr_cs16_.data());
+
+        for (size_t i = 0; i < count; i++) {
+            long long sample = samples_ + i;
+            uint32_t& energy_dly = energy_cs16_[sample % seq_len_];
+            int32_t re = corr_cs16_[i].real();
+            int32_t im = corr_cs16_[i].imag();
+            uint32_t energy = static_cast<uint32_t>(re * re)
+                + static_cast<uint32_t>(im * im);
+            uint64_t metric = static_cast<uint64_t>(energy) * energy_dly;
+            uint64_t thresh = thresh_cs16_ << thresh_shift;
+            if ((peak_index_ < 0) && (metric > thresh))
+                found(done + i, sample, double(metric) / thresh);
+            thresh_cs16_ += energy;
+            thresh_cs16_ -= energy_dly;
+            energy_dly = energy;
+        }
+
+        std::copy(window_cs16_.begin() + count,
+            window_cs16_.begin() + count + pad, window_cs16_.begin());
+        samples_ += count;
+        done += count;
+    }
+    return peak_index_ >= 0;
+}
+
+void BeaconDetector::found(size_t index, long long sample, float confidence)
+{
+    peak_index_ = index;
+    peak_sample_ = sample;
+    confidence_ = confidence;
+}
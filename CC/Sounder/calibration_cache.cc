@@ -0,0 +1,145 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ On-disk cache of the DC offset, IQ imbalance and trigger delay
+ calibration of the base station radios
+---------------------------------------------------------------------
+*/
+
+#include "include/calibration_cache.h"
+#include "include/logger.h"
+#include <SoapySDR/Constants.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using json = nlohmann::json;
+
+// Path of a DC/IQ correction within an entry, e.g. "rx0"
+static std::string pathName(int direction, size_t channel)
+{
+    return ((direction == SOAPY_SDR_RX) ? "rx" : "tx")
+        + std::to_string(channel);
+}
+
+CalibrationCache::CalibrationCache(const std::string& path)
+    : path_(path)
+    , entries_(json::object())
+{
+    std::ifstream file(this->path_);
+    if (file.is_open() == false)
+        return;
+    try {
+        this->entries_ = json::parse(file);
+        if (this->entries_.is_object() == false)
+            throw std::invalid_argument("not a JSON object");
+        MLPD_INFO("Loaded %zu calibration cache entries from %s\n",
+            this->entries_.size(), this->path_.c_str());
+    } catch (const std::exception& e) {
+        MLPD_WARN("Ignoring calibration cache %s: %s\n", this->path_.c_str(),
+            e.what());
+        this->entries_ = json::object();
+    }
+}
+
+std::string CalibrationCache::key(const Config* cfg, const std::string& serial)
+{
+    std::ostringstream key;
+    key << serial << " freq " << std::llround(cfg->radio_rf_freq())
+        << " rate " << std::llround(cfg->rate()) << " rx";
+    for (double gain : cfg->rx_gain())
+        key << " " << gain;
+    key << " tx";
+    for (double gain : cfg->tx_gain())
+        key << " " << gain;
+    key << " cal";
+    for (double gain : cfg->cal_tx_gain())
+        key << " " << gain;
+    return key.str();
+}
+
+bool CalibrationCache::findDciq(const std::string& key, int direction,
+    size_t channel, DciqCorrection& corr) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto entry = this->entries_.find(key);
+    if (entry == this->entries_.end())
+        return false;
+    auto path = entry->find(pathName(direction, channel));
+    if (path == entry->end())
+        return false;
+    try {
+        corr.dc_i = path->at("dc_i");
+        corr.dc_q = path->at("dc_q");
+        corr.gcorr = path->at("gcorr");
+        corr.iqcorr = path->at("iqcorr");
+        corr.dc_level = path->at("dc_level");
+        corr.image_level = path->at("image_level");
+    } catch (const json::exception& e) {
+        MLPD_WARN("Bad calibration cache entry %s: %s\n", key.c_str(),
+            e.what());
+        return false;
+    }
+    return true;
+}
+
+void CalibrationCache::storeDciq(const std::string& key, int direction,
+    size_t channel, const DciqCorrection& corr)
+{
+    json path;
+    path["dc_i"] = corr.dc_i;
+    path["dc_q"] = corr.dc_q;
+    path["gcorr"] = corr.gcorr;
+    path["iqcorr"] = corr.iqcorr;
+    path["dc_level"] = corr.dc_level;
+    path["image_level"] = corr.image_level;
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->entries_[key][pathName(direction, channel)] = path;
+}
+
+bool CalibrationCache::findDelay(const std::string& key, int& delay) const
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    auto entry = this->entries_.find(key);
+    if (entry == this->entries_.end())
+        return false;
+    auto value = entry->find("adjust_delays");
+    if ((value == entry->end()) || (value->is_number_integer() == false))
+        return false;
+    delay = *value;
+    return true;
+}
+
+void CalibrationCache::storeDelay(const std::string& key, int delay)
+{
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->entries_[key]["adjust_delays"] = delay;
+}
+
+void CalibrationCache::save(void) const
+{
+    std::string tmp = this->path_ + ".tmp";
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        std::ofstream file(tmp, std::ios::trunc);
+        if (file.is_open() == false) {
+            MLPD_ERROR("Could not write the calibration cache %s\n",
+                tmp.c_str());
+            return;
+        }
+        file << this->entries_.dump(4) << std::endl;
+        file.close();
+        if (file.fail() == true) {
+            MLPD_ERROR("Could not write the calibration cache %s\n",
+                tmp.c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), this->path_.c_str()) != 0) {
+        MLPD_ERROR("Could not replace the calibration cache %s\n",
+            this->path_.c_str());
+    }
+}
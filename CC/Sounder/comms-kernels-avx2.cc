@@ -0,0 +1,427 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ AVX2 and FMA CommsLib kernels, only this file is built with -mavx2
+ -mfma. The remainders past the last full vector use the scalar table.
+---------------------------------------------------------------------
+*/
+
+#if defined(__x86_64__)
+
+#include "include/comms-kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+#define AVX_PACKED_SP 8 // single-precision
+#define AVX_PACKED_CF 4 // complex float
+#define AVX_PACKED_CS 8 // complex short int
+#define AVX_PACKED_DP 4 // double-precision
+
+// Saturates the int32 real and imaginary parts to interleaved 16 bit I/Q
+static inline __m256i __m256_cs16_pack(__m256i re, __m256i im)
+{
+    // packs gives [re0..3 im0..3] in each 128 bit lane
+    const __m256i interleave = _mm256_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4,
+        5, 12, 13, 6, 7, 14, 15, 0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7,
+        14, 15);
+    return _mm256_shuffle_epi8(_mm256_packs_epi32(re, im), interleave);
+}
+
+// a * b or a * conj(b) for 4 complex floats
+static inline __m256 __m256_complex_cf32_mult(__m256 a, __m256 b, bool conj)
+{
+    __m256 b_re = _mm256_moveldup_ps(b);
+    __m256 b_im = _mm256_movehdup_ps(b);
+    __m256 cross = _mm256_mul_ps(_mm256_permute_ps(a, 0xb1), b_im);
+    return conj ? _mm256_fmsubadd_ps(a, b_re, cross)
+                : _mm256_fmaddsub_ps(a, b_re, cross);
+}
+
+// Q15 a * b or a * conj(b) for 8 complex shorts
+static inline __m256i __m256_complex_cs16_mult(__m256i a, __m256i b, bool conj)
+{
+    const __m256i neg0 = _mm256_set1_epi32(0xFFFF0000);
+    const __m256i neg1 = _mm256_set1_epi32(0x00010000);
+
+    // b with the imaginary part negated
+    __m256i b_neg = _mm256_add_epi32(_mm256_xor_si256(b, neg0), neg1);
+    __m256i swapped = _mm256_shufflehi_epi16(conj ? b_neg : b, 0xb1);
+    swapped = _mm256_shufflelo_epi16(swapped, 0xb1);
+
+    __m256i re = _mm256_madd_epi16(a, conj ? b : b_neg);
+    __m256i im = _mm256_madd_epi16(a, swapped);
+    return __m256_cs16_pack(
+        _mm256_srai_epi32(re, 15), _mm256_srai_epi32(im, 15));
+}
+
+static void correlate_cf32(const std::complex<float>* in, size_t count,
+    const std::complex<float>* seq, size_t seq_len, std::complex<float>* out)
+{
+    const float* in_f = reinterpret_cast<const float*>(in);
+    const float* seq_f = reinterpret_cast<const float*>(seq);
+    float* out_f = reinterpret_cast<float*>(out);
+
+    // Two vectors of outputs per pass for four independent FMA chains
+    size_t step = 2 * AVX_PACKED_CF;
+    size_t vec_count = count - count % step;
+    for (size_t k = 0; k < vec_count; k += step) {
+        // [x_re * g_re, x_im * g_re] and -[x_im * g_im, x_re * g_im]
+        __m256 direct0 = _mm256_setzero_ps();
+        __m256 direct1 = _mm256_setzero_ps();
+        __m256 cross0 = _mm256_setzero_ps();
+        __m256 cross1 = _mm256_setzero_ps();
+        for (size_t j = 0; j < seq_len; j++) {
+            const float* x = in_f + 2 * (k + j);
+            __m256 x0 = _mm256_loadu_ps(x);
+            __m256 x1 = _mm256_loadu_ps(x + AVX_PACKED_SP);
+            __m256 g_re = _mm256_broadcast_ss(seq_f + 2 * j);
+            __m256 g_im = _mm256_broadcast_ss(seq_f + 2 * j + 1);
+            direct0 = _mm256_fmadd_ps(x0, g_re, direct0);
+            direct1 = _mm256_fmadd_ps(x1, g_re, direct1);
+            cross0 = _mm256_fnmadd_ps(
+                _mm256_permute_ps(x0, 0xb1), g_im, cross0);
+            cross1 = _mm256_fnmadd_ps(
+                _mm256_permute_ps(x1, 0xb1), g_im, cross1);
+        }
+        _mm256_storeu_ps(out_f + 2 * k, _mm256_addsub_ps(direct0, cross0));
+        _mm256_storeu_ps(
+            out_f + 2 * k + AVX_PACKED_SP, _mm256_addsub_ps(direct1, cross1));
+    }
+    kScalarKernels.correlate_cf32(
+        in + vec_count, count - vec_count, seq, seq_len, out + vec_count);
+}
+
+static void correlate_cs16(const std::complex<int16_t>* in, size_t count,
+    const uint32_t* taps, size_t seq_len, int tap_shift, int out_shift,
+    std::complex<int16_t>* out)
+{
+    const __m256i rounding
+        = _mm256_set1_epi32(out_shift > 0 ? 1 << (out_shift - 1) : 0);
+    const __m128i tap_count = _mm_cvtsi32_si128(tap_shift);
+    const __m128i out_count = _mm_cvtsi32_si128(out_shift);
+
+    size_t vec_count = count - count % AVX_PACKED_CS;
+    for (size_t k = 0; k < vec_count; k += AVX_PACKED_CS) {
+        __m256i re = _mm256_setzero_si256();
+        __m256i im = _mm256_setzero_si256();
+        for (size_t j = 0; j < seq_len; j++) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(in + k + j));
+            __m256i tap_re = _mm256_set1_epi32(taps[2 * j]);
+            __m256i tap_im = _mm256_set1_epi32(taps[2 * j + 1]);
+            re = _mm256_add_epi32(
+                re, _mm256_sra_epi32(_mm256_madd_epi16(x, tap_re), tap_count));
+            im = _mm256_add_epi32(
+                im, _mm256_sra_epi32(_mm256_madd_epi16(x, tap_im), tap_count));
+        }
+        re = _mm256_sra_epi32(_mm256_add_epi32(re, rounding), out_count);
+        im = _mm256_sra_epi32(_mm256_add_epi32(im, rounding), out_count);
+        _mm256_storeu_si256((__m256i*)(out + k), __m256_cs16_pack(re, im));
+    }
+    kScalarKernels.correlate_cs16(in + vec_count, count - vec_count, taps,
+        seq_len, tap_shift, out_shift, out + vec_count);
+}
+
+static void complex_mult_cf32(const std::complex<float>* a,
+    const std::complex<float>* b, size_t length, bool conj,
+    std::complex<float>* out)
+{
+    size_t vec_len = length - length % AVX_PACKED_CF;
+    for (size_t i = 0; i < vec_len; i += AVX_PACKED_CF) {
+        __m256 a_vec = _mm256_loadu_ps(reinterpret_cast<const float*>(a + i));
+        __m256 b_vec = _mm256_loadu_ps(reinterpret_cast<const float*>(b + i));
+        _mm256_storeu_ps(reinterpret_cast<float*>(out + i),
+            __m256_complex_cf32_mult(a_vec, b_vec, conj));
+    }
+    kScalarKernels.complex_mult_cf32(
+        a + vec_len, b + vec_len, length - vec_len, conj, out + vec_len);
+}
+
+static void complex_mult_cs16(const std::complex<int16_t>* a,
+    const std::complex<int16_t>* b, size_t length, bool conj,
+    std::complex<int16_t>* out)
+{
+    size_t vec_len = length - length % AVX_PACKED_CS;
+    for (size_t i = 0; i < vec_len; i += AVX_PACKED_CS) {
+        __m256i a_vec = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i b_vec = _mm256_loadu_si256((const __m256i*)(b + i));
+        _mm256_storeu_si256(
+            (__m256i*)(out + i), __m256_complex_cs16_mult(a_vec, b_vec, conj));
+    }
+    kScalarKernels.complex_mult_cs16(
+        a + vec_len, b + vec_len, length - vec_len, conj, out + vec_len);
+}
+
+static void abs2_cf32(const std::complex<float>* in, size_t length, float* out)
+{
+    const float* in_f = reinterpret_cast<const float*>(in);
+    const __m256i perm = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    size_t step = 2 * AVX_PACKED_CF;
+    size_t vec_len = length - length % step;
+    for (size_t i = 0; i < vec_len; i += step) {
+        __m256 x0 = _mm256_loadu_ps(in_f + 2 * i);
+        __m256 x1 = _mm256_loadu_ps(in_f + 2 * i + AVX_PACKED_SP);
+        __m256 sum
+            = _mm256_hadd_ps(_mm256_mul_ps(x0, x0), _mm256_mul_ps(x1, x1));
+        _mm256_storeu_ps(out + i, _mm256_permutevar8x32_ps(sum, perm));
+    }
+    kScalarKernels.abs2_cf32(in + vec_len, length - vec_len, out + vec_len);
+}
+
+static void abs2_cs16(
+    const std::complex<int16_t>* in, size_t length, int32_t* out)
+{
+    size_t vec_len = length - length % AVX_PACKED_CS;
+    for (size_t i = 0; i < vec_len; i += AVX_PACKED_CS) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_madd_epi16(x, x));
+    }
+    kScalarKernels.abs2_cs16(in + vec_len, length - vec_len, out + vec_len);
+}
+
+static void csign(
+    const std::complex<float>* in, size_t length, std::complex<float>* out)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+    size_t vec_len = length - length % AVX_PACKED_CF;
+    for (size_t i = 0; i < vec_len; i += AVX_PACKED_CF) {
+        __m256 x = _mm256_loadu_ps(reinterpret_cast<const float*>(in + i));
+        __m256 pos = _mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_GT_OQ), one);
+        __m256 neg = _mm256_and_ps(_mm256_cmp_ps(x, zero, _CMP_LT_OQ), one);
+        __m256 sign = _mm256_sub_ps(pos, neg);
+        // The real part's sign where it is not zero (NaN included), the
+        // imaginary part's otherwise, and a zero imaginary part
+        __m256 real_set = _mm256_cmp_ps(x, zero, _CMP_NEQ_UQ);
+        __m256 res = _mm256_blendv_ps(
+            _mm256_permute_ps(sign, 0xb1), sign, real_set);
+        _mm256_storeu_ps(reinterpret_cast<float*>(out + i),
+            _mm256_blend_ps(res, zero, 0xaa));
+    }
+    kScalarKernels.csign(in + vec_len, length - vec_len, out + vec_len);
+}
+
+// Inclusive prefix sum of the 4 doubles
+static inline __m256d __m256d_prefix_sum(__m256d x)
+{
+    const __m256d zero = _mm256_setzero_pd();
+    x = _mm256_add_pd(x,
+        _mm256_blend_pd(_mm256_permute4x64_pd(x, 0x90), zero, 0x1));
+    x = _mm256_add_pd(x,
+        _mm256_blend_pd(_mm256_permute4x64_pd(x, 0x40), zero, 0x3));
+    return x;
+}
+
+static void moving_sum(
+    const float* in, size_t length, size_t window, float* out)
+{
+    // out[i + 1] - out[i] = in[i] - in[i - window], so out is the exclusive
+    // prefix sum of these differences
+    __m256d carry = _mm256_setzero_pd();
+    size_t vec_len = length - length % AVX_PACKED_DP;
+    for (size_t i = 0; i < vec_len; i += AVX_PACKED_DP) {
+        __m256d diff = _mm256_cvtps_pd(_mm_loadu_ps(in + i));
+        if (i >= window) {
+            diff = _mm256_sub_pd(
+                diff, _mm256_cvtps_pd(_mm_loadu_ps(in + i - window)));
+        } else {
+            for (size_t j = i; j < i + AVX_PACKED_DP; j++) {
+                if (j >= window)
+                    diff[j - i] -= in[j - window];
+            }
+        }
+        __m256d sum = _mm256_add_pd(__m256d_prefix_sum(diff), carry);
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(_mm256_sub_pd(sum, diff)));
+        carry = _mm256_permute4x64_pd(sum, 0xff);
+    }
+
+    double sum = _mm256_cvtsd_f64(carry);
+    for (size_t i = vec_len; i < length; i++) {
+        out[i] = sum;
+        sum += in[i];
+        if (i >= window)
+            sum -= in[i - window];
+    }
+}
+
+static void qam_modulate(const uint8_t* in, size_t length,
+    const QamAxis& axis, std::complex<float>* out)
+{
+    float* out_f = reinterpret_cast<float*>(out);
+    const __m256 levels = _mm256_loadu_ps(axis.levels);
+    const __m256i mask = _mm256_set1_epi32((1 << axis.bits) - 1);
+    const __m256i seven = _mm256_set1_epi32(7);
+    size_t vec_len = length - length % AVX_PACKED_SP;
+    for (size_t i = 0; i < vec_len; i += AVX_PACKED_SP) {
+        __m256i label = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+        __m256 re = _mm256_permutevar8x32_ps(levels,
+            _mm256_and_si256(_mm256_srli_epi32(label, axis.bits), seven));
+        __m256 im = _mm256_permutevar8x32_ps(
+            levels, _mm256_and_si256(label, mask));
+        // [0 1 4 5] and [2 3 6 7] interleaved
+        __m256 lo = _mm256_unpacklo_ps(re, im);
+        __m256 hi = _mm256_unpackhi_ps(re, im);
+        _mm256_storeu_ps(out_f + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out_f + 2 * i + AVX_PACKED_SP,
+            _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    kScalarKernels.qam_modulate(
+        in + vec_len, length - vec_len, axis, out + vec_len);
+}
+
+// Real and imaginary parts of 8 complex floats
+static inline void __m256_cf32_split(const float* in, __m256& re, __m256& im)
+{
+    __m256 x0 = _mm256_loadu_ps(in);
+    __m256 x1 = _mm256_loadu_ps(in + AVX_PACKED_SP);
+    // The shuffles give the pairs [0 1 4 5 2 3 6 7]
+    re = _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(_mm256_shuffle_ps(x0, x1, 0x88)), 0xd8));
+    im = _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(_mm256_shuffle_ps(x0, x1, 0xdd)), 0xd8));
+}
+
+static inline __m256i __m256_qam_axis_label(
+    __m256 x, const QamAxis& axis, __m256i labels)
+{
+    __m256i level = _mm256_setzero_si256();
+    for (int m = 0; m < (1 << axis.bits) - 1; m++) {
+        __m256 above = _mm256_cmp_ps(
+            x, _mm256_set1_ps(axis.thresholds[m]), _CMP_GE_OQ);
+        level = _mm256_sub_epi32(level, _mm256_castps_si256(above));
+    }
+    return _mm256_permutevar8x32_epi32(labels, level);
+}
+
+static void qam_demod_hard(const std::complex<float>* in, size_t length,
+    const QamAxis& axis, uint8_t* out)
+{
+    const float* in_f = reinterpret_cast<const float*>(in);
+    const __m256i labels
+        = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(axis.labels));
+    size_t vec_len = length - length % AVX_PACKED_SP;
+    for (size_t i = 0; i < vec_len; i += AVX_PACKED_SP) {
+        __m256 re, im;
+        __m256_cf32_split(in_f + 2 * i, re, im);
+        __m256i label = _mm256_or_si256(
+            _mm256_slli_epi32(__m256_qam_axis_label(re, axis, labels),
+                axis.bits),
+            __m256_qam_axis_label(im, axis, labels));
+        // Bytes [0 1 2 3] and [4 5 6 7] at the bottom of each lane
+        __m256i packed = _mm256_packus_epi16(
+            _mm256_packs_epi32(label, label), _mm256_setzero_si256());
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i),
+            _mm_unpacklo_epi32(_mm256_castsi256_si128(packed),
+                _mm256_extracti128_si256(packed, 1)));
+    }
+    kScalarKernels.qam_demod_hard(
+        in + vec_len, length - vec_len, axis, out + vec_len);
+}
+
+// LLRs of the label bits of each lane of x, as qam_axis_llr. split[j]
+// holds the levels with bit j clear, then those with it set.
+template <int kBits>
+static inline void __m256_qam_axis_llr(
+    __m256 x, const float (*split)[1 << kBits], __m256 scale, __m256* llr)
+{
+    const int half = 1 << (kBits - 1);
+    for (int j = 0; j < kBits; j++) {
+        __m256 min0 = _mm256_set1_ps(INFINITY);
+        __m256 min1 = min0;
+        // Operands in the order that keeps a NaN distance out, as
+        // std::min
+        for (int k = 0; k < half; k++) {
+            __m256 diff0 = _mm256_sub_ps(x, _mm256_set1_ps(split[j][k]));
+            __m256 diff1 = _mm256_sub_ps(x, _mm256_set1_ps(split[j][half + k]));
+            min0 = _mm256_min_ps(_mm256_mul_ps(diff0, diff0), min0);
+            min1 = _mm256_min_ps(_mm256_mul_ps(diff1, diff1), min1);
+        }
+        llr[j] = _mm256_mul_ps(scale, _mm256_sub_ps(min1, min0));
+    }
+}
+
+// Lane n of the result is lane index[n] of llr[j], j being 1 in the lanes
+// of kOne, 2 in those of kTwo and 0 in the others
+template <int kOne, int kTwo>
+static inline __m256 __m256_interleave3(const __m256* llr, __m256i index)
+{
+    __m256 res = _mm256_permutevar8x32_ps(llr[0], index);
+    res = _mm256_blend_ps(res, _mm256_permutevar8x32_ps(llr[1], index), kOne);
+    return _mm256_blend_ps(
+        res, _mm256_permutevar8x32_ps(llr[2], index), kTwo);
+}
+
+// Both axes share the levels, so the interleaved samples are demodulated
+// as they are and the kBits LLRs of each lane are consecutive in out
+template <int kBits>
+static void qam_demod_soft_bits(const std::complex<float>* in, size_t length,
+    const QamAxis& axis, float scale, float* out)
+{
+    const float* in_f = reinterpret_cast<const float*>(in);
+    const __m256 scale_vec = _mm256_set1_ps(scale);
+    const size_t bits = 2 * kBits;
+    // Every bit is set for half of the levels, the labels being all the
+    // values of kBits bits
+    float split[kBits][1 << kBits];
+    for (int j = 0; j < kBits; j++) {
+        int clear = 0;
+        int set = 1 << (kBits - 1);
+        for (int k = 0; k < (1 << kBits); k++) {
+            float level = axis.levels[axis.labels[k]];
+            if (((axis.labels[k] >> (kBits - 1 - j)) & 1) != 0)
+                split[j][set++] = level;
+            else
+                split[j][clear++] = level;
+        }
+    }
+    size_t vec_len = length - length % AVX_PACKED_CF;
+    for (size_t i = 0; i < vec_len; i += AVX_PACKED_CF) {
+        __m256 llr[kBits];
+        __m256_qam_axis_llr<kBits>(
+            _mm256_loadu_ps(in_f + 2 * i), split, scale_vec, llr);
+        float* dst = out + i * bits;
+        if constexpr (kBits == 1) {
+            _mm256_storeu_ps(dst, llr[0]);
+        } else if constexpr (kBits == 2) {
+            // Lanes [0 2] and [1 3] of the points
+            __m256 lo = _mm256_unpacklo_ps(llr[0], llr[1]);
+            __m256 hi = _mm256_unpackhi_ps(llr[0], llr[1]);
+            _mm256_storeu_ps(dst, _mm256_permute2f128_ps(lo, hi, 0x20));
+            _mm256_storeu_ps(
+                dst + AVX_PACKED_SP, _mm256_permute2f128_ps(lo, hi, 0x31));
+        } else {
+            _mm256_storeu_ps(dst,
+                __m256_interleave3<0x92, 0x24>(
+                    llr, _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2)));
+            _mm256_storeu_ps(dst + AVX_PACKED_SP,
+                __m256_interleave3<0x24, 0x49>(
+                    llr, _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5)));
+            _mm256_storeu_ps(dst + 2 * AVX_PACKED_SP,
+                __m256_interleave3<0x49, 0x92>(
+                    llr, _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7)));
+        }
+    }
+    kScalarKernels.qam_demod_soft(
+        in + vec_len, length - vec_len, axis, scale, out + vec_len * bits);
+}
+
+static void qam_demod_soft(const std::complex<float>* in, size_t length,
+    const QamAxis& axis, float scale, float* out)
+{
+    if (axis.bits == 1)
+        qam_demod_soft_bits<1>(in, length, axis, scale, out);
+    else if (axis.bits == 2)
+        qam_demod_soft_bits<2>(in, length, axis, scale, out);
+    else
+        qam_demod_soft_bits<3>(in, length, axis, scale, out);
+}
+
+const CommsKernels kAvx2Kernels = { "avx2", 256, correlate_cf32,
+    correlate_cs16, complex_mult_cf32, complex_mult_cs16, abs2_cf32,
+    abs2_cs16, csign, moving_sum, qam_modulate, qam_demod_hard,
+    qam_demod_soft };
+
+#endif
@@ -0,0 +1,449 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ AVX-512 (F and BW) CommsLib kernels, only this file is built with
+ -mavx512f -mavx512bw. The remainders past the last full vector use the
+ scalar table.
+---------------------------------------------------------------------
+*/
+
+#if defined(__x86_64__)
+
+#include "include/comms-kernels.h"
+#include <algorithm>
+#include <cmath>
+// GCC 12 reports the undefined pass-through operands of the AVX-512
+// intrinsics as uninitialized (GCC bug 105593)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+
+#define AVX512_PACKED_SP 16 // single-precision
+#define AVX512_PACKED_CF 8 // complex float
+#define AVX512_PACKED_CS 16 // complex short int
+#define AVX512_PACKED_DP 8 // double-precision
+
+// Real lanes of interleaved complex floats
+static const __mmask16 kRealLanes = 0x5555;
+
+// Saturates the int32 real and imaginary parts to interleaved 16 bit I/Q
+static inline __m512i __m512_cs16_pack(__m512i re, __m512i im)
+{
+    // packs gives [re0..3 im0..3] in each 128 bit lane
+    const __m512i interleave = _mm512_broadcast_i32x4(_mm_setr_epi8(
+        0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15));
+    return _mm512_shuffle_epi8(_mm512_packs_epi32(re, im), interleave);
+}
+
+// a * b or a * conj(b) for 8 complex floats
+static inline __m512 __m512_complex_cf32_mult(__m512 a, __m512 b, bool conj)
+{
+    __m512 b_re = _mm512_moveldup_ps(b);
+    __m512 b_im = _mm512_movehdup_ps(b);
+    __m512 cross = _mm512_mul_ps(_mm512_permute_ps(a, 0xb1), b_im);
+    return conj ? _mm512_fmsubadd_ps(a, b_re, cross)
+                : _mm512_fmaddsub_ps(a, b_re, cross);
+}
+
+// Q15 a * b or a * conj(b) for 16 complex shorts
+static inline __m512i __m512_complex_cs16_mult(__m512i a, __m512i b, bool conj)
+{
+    const __m512i neg0 = _mm512_set1_epi32(0xFFFF0000);
+    const __m512i neg1 = _mm512_set1_epi32(0x00010000);
+
+    // b with the imaginary part negated
+    __m512i b_neg = _mm512_add_epi32(_mm512_xor_si512(b, neg0), neg1);
+    __m512i swapped = _mm512_shufflehi_epi16(conj ? b_neg : b, 0xb1);
+    swapped = _mm512_shufflelo_epi16(swapped, 0xb1);
+
+    __m512i re = _mm512_madd_epi16(a, conj ? b : b_neg);
+    __m512i im = _mm512_madd_epi16(a, swapped);
+    return __m512_cs16_pack(
+        _mm512_srai_epi32(re, 15), _mm512_srai_epi32(im, 15));
+}
+
+static void correlate_cf32(const std::complex<float>* in, size_t count,
+    const std::complex<float>* seq, size_t seq_len, std::complex<float>* out)
+{
+    const float* in_f = reinterpret_cast<const float*>(in);
+    const float* seq_f = reinterpret_cast<const float*>(seq);
+    float* out_f = reinterpret_cast<float*>(out);
+    const __m512 one = _mm512_set1_ps(1.f);
+
+    // Two vectors of outputs per pass for four independent FMA chains
+    size_t step = 2 * AVX512_PACKED_CF;
+    size_t vec_count = count - count % step;
+    for (size_t k = 0; k < vec_count; k += step) {
+        // [x_re * g_re, x_im * g_re] and -[x_im * g_im, x_re * g_im]
+        __m512 direct0 = _mm512_setzero_ps();
+        __m512 direct1 = _mm512_setzero_ps();
+        __m512 cross0 = _mm512_setzero_ps();
+        __m512 cross1 = _mm512_setzero_ps();
+        for (size_t j = 0; j < seq_len; j++) {
+            const float* x = in_f + 2 * (k + j);
+            __m512 x0 = _mm512_loadu_ps(x);
+            __m512 x1 = _mm512_loadu_ps(x + AVX512_PACKED_SP);
+            __m512 g_re = _mm512_set1_ps(seq_f[2 * j]);
+            __m512 g_im = _mm512_set1_ps(seq_f[2 * j + 1]);
+            direct0 = _mm512_fmadd_ps(x0, g_re, direct0);
+            direct1 = _mm512_fmadd_ps(x1, g_re, direct1);
+            cross0 = _mm512_fnmadd_ps(
+                _mm512_permute_ps(x0, 0xb1), g_im, cross0);
+            cross1 = _mm512_fnmadd_ps(
+                _mm512_permute_ps(x1, 0xb1), g_im, cross1);
+        }
+        // There is no 512 bit addsub, multiplying by one is exact
+        _mm512_storeu_ps(
+            out_f + 2 * k, _mm512_fmaddsub_ps(direct0, one, cross0));
+        _mm512_storeu_ps(out_f + 2 * k + AVX512_PACKED_SP,
+            _mm512_fmaddsub_ps(direct1, one, cross1));
+    }
+    kScalarKernels.correlate_cf32(
+        in + vec_count, count - vec_count, seq, seq_len, out + vec_count);
+}
+
+static void correlate_cs16(const std::complex<int16_t>* in, size_t count,
+    const uint32_t* taps, size_t seq_len, int tap_shift, int out_shift,
+    std::complex<int16_t>* out)
+{
+    const __m512i rounding
+        = _mm512_set1_epi32(out_shift > 0 ? 1 << (out_shift - 1) : 0);
+    const __m128i tap_count = _mm_cvtsi32_si128(tap_shift);
+    const __m128i out_count = _mm_cvtsi32_si128(out_shift);
+
+    size_t vec_count = count - count % AVX512_PACKED_CS;
+    for (size_t k = 0; k < vec_count; k += AVX512_PACKED_CS) {
+        __m512i re = _mm512_setzero_si512();
+        __m512i im = _mm512_setzero_si512();
+        for (size_t j = 0; j < seq_len; j++) {
+            __m512i x = _mm512_loadu_si512(in + k + j);
+            __m512i tap_re = _mm512_set1_epi32(taps[2 * j]);
+            __m512i tap_im = _mm512_set1_epi32(taps[2 * j + 1]);
+            re = _mm512_add_epi32(
+                re, _mm512_sra_epi32(_mm512_madd_epi16(x, tap_re), tap_count));
+            im = _mm512_add_epi32(
+                im, _mm512_sra_epi32(_mm512_madd_epi16(x, tap_im), tap_count));
+        }
+        re = _mm512_sra_epi32(_mm512_add_epi32(re, rounding), out_count);
+        im = _mm512_sra_epi32(_mm512_add_epi32(im, rounding), out_count);
+        _mm512_storeu_si512(out + k, __m512_cs16_pack(re, im));
+    }
+    kScalarKernels.correlate_cs16(in + vec_count, count - vec_count, taps,
+        seq_len, tap_shift, out_shift, out + vec_count);
+}
+
+static void complex_mult_cf32(const std::complex<float>* a,
+    const std::complex<float>* b, size_t length, bool conj,
+    std::complex<float>* out)
+{
+    size_t vec_len = length - length % AVX512_PACKED_CF;
+    for (size_t i = 0; i < vec_len; i += AVX512_PACKED_CF) {
+        __m512 a_vec = _mm512_loadu_ps(a + i);
+        __m512 b_vec = _mm512_loadu_ps(b + i);
+        _mm512_storeu_ps(
+            out + i, __m512_complex_cf32_mult(a_vec, b_vec, conj));
+    }
+    kScalarKernels.complex_mult_cf32(
+        a + vec_len, b + vec_len, length - vec_len, conj, out + vec_len);
+}
+
+static void complex_mult_cs16(const std::complex<int16_t>* a,
+    const std::complex<int16_t>* b, size_t length, bool conj,
+    std::complex<int16_t>* out)
+{
+    size_t vec_len = length - length % AVX512_PACKED_CS;
+    for (size_t i = 0; i < vec_len; i += AVX512_PACKED_CS) {
+        __m512i a_vec = _mm512_loadu_si512(a + i);
+        __m512i b_vec = _mm512_loadu_si512(b + i);
+        _mm512_storeu_si512(
+            out + i, __m512_complex_cs16_mult(a_vec, b_vec, conj));
+    }
+    kScalarKernels.complex_mult_cs16(
+        a + vec_len, b + vec_len, length - vec_len, conj, out + vec_len);
+}
+
+static void abs2_cf32(const std::complex<float>* in, size_t length, float* out)
+{
+    const float* in_f = reinterpret_cast<const float*>(in);
+    // The even lanes of both sums
+    const __m512i evens = _mm512_setr_epi32(
+        0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    size_t step = 2 * AVX512_PACKED_CF;
+    size_t vec_len = length - length % step;
+    for (size_t i = 0; i < vec_len; i += step) {
+        __m512 x0 = _mm512_loadu_ps(in_f + 2 * i);
+        __m512 x1 = _mm512_loadu_ps(in_f + 2 * i + AVX512_PACKED_SP);
+        __m512 sq0 = _mm512_mul_ps(x0, x0);
+        __m512 sq1 = _mm512_mul_ps(x1, x1);
+        __m512 sum0 = _mm512_add_ps(sq0, _mm512_permute_ps(sq0, 0xb1));
+        __m512 sum1 = _mm512_add_ps(sq1, _mm512_permute_ps(sq1, 0xb1));
+        _mm512_storeu_ps(out + i, _mm512_permutex2var_ps(sum0, evens, sum1));
+    }
+    kScalarKernels.abs2_cf32(in + vec_len, length - vec_len, out + vec_len);
+}
+
+static void abs2_cs16(
+    const std::complex<int16_t>* in, size_t length, int32_t* out)
+{
+    size_t vec_len = length - length % AVX512_PACKED_CS;
+    for (size_t i = 0; i < vec_len; i += AVX512_PACKED_CS) {
+        __m512i x = _mm512_loadu_si512(in + i);
+        _mm512_storeu_si512(out + i, _mm512_madd_epi16(x, x));
+    }
+    kScalarKernels.abs2_cs16(in + vec_len, length - vec_len, out + vec_len);
+}
+
+static void csign(
+    const std::complex<float>* in, size_t length, std::complex<float>* out)
+{
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 one = _mm512_set1_ps(1.f);
+    const __m512 minus_one = _mm512_set1_ps(-1.f);
+    size_t vec_len = length - length % AVX512_PACKED_CF;
+    for (size_t i = 0; i < vec_len; i += AVX512_PACKED_CF) {
+        __m512 x = _mm512_loadu_ps(in + i);
+        __m512 sign = _mm512_mask_blend_ps(
+            _mm512_cmp_ps_mask(x, zero, _CMP_GT_OQ), zero, one);
+        sign = _mm512_mask_blend_ps(
+            _mm512_cmp_ps_mask(x, zero, _CMP_LT_OQ), sign, minus_one);
+        // The real part's sign where it is not zero (NaN included), the
+        // imaginary part's otherwise, and a zero imaginary part
+        __mmask16 real_set = _mm512_cmp_ps_mask(x, zero, _CMP_NEQ_UQ);
+        __m512 res = _mm512_mask_blend_ps(
+            real_set, _mm512_permute_ps(sign, 0xb1), sign);
+        _mm512_storeu_ps(out + i, _mm512_maskz_mov_ps(kRealLanes, res));
+    }
+    kScalarKernels.csign(in + vec_len, length - vec_len, out + vec_len);
+}
+
+// Inclusive prefix sum of the 8 doubles
+static inline __m512d __m512d_prefix_sum(__m512d x)
+{
+    const __m512i shift1 = _mm512_setr_epi64(0, 0, 1, 2, 3, 4, 5, 6);
+    const __m512i shift2 = _mm512_setr_epi64(0, 0, 0, 1, 2, 3, 4, 5);
+    const __m512i shift4 = _mm512_setr_epi64(0, 0, 0, 0, 0, 1, 2, 3);
+    x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xfe, shift1, x));
+    x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xfc, shift2, x));
+    x = _mm512_add_pd(x, _mm512_maskz_permutexvar_pd(0xf0, shift4, x));
+    return x;
+}
+
+static void moving_sum(
+    const float* in, size_t length, size_t window, float* out)
+{
+    // out[i + 1] - out[i] = in[i] - in[i - window], so out is the exclusive
+    // prefix sum of these differences
+    const __m512i last = _mm512_set1_epi64(AVX512_PACKED_DP - 1);
+    __m512d carry = _mm512_setzero_pd();
+    size_t vec_len = length - length % AVX512_PACKED_DP;
+    for (size_t i = 0; i < vec_len; i += AVX512_PACKED_DP) {
+        __m512d diff = _mm512_cvtps_pd(_mm256_loadu_ps(in + i));
+        if (i >= window) {
+            diff = _mm512_sub_pd(
+                diff, _mm512_cvtps_pd(_mm256_loadu_ps(in + i - window)));
+        } else {
+            for (size_t j = i; j < i + AVX512_PACKED_DP; j++) {
+                if (j >= window)
+                    diff[j - i] -= in[j - window];
+            }
+        }
+        __m512d sum = _mm512_add_pd(__m512d_prefix_sum(diff), carry);
+        _mm256_storeu_ps(out + i, _mm512_cvtpd_ps(_mm512_sub_pd(sum, diff)));
+        carry = _mm512_permutexvar_pd(last, sum);
+    }
+
+    double sum = _mm512_cvtsd_f64(carry);
+    for (size_t i = vec_len; i < length; i++) {
+        out[i] = sum;
+        sum += in[i];
+        if (i >= window)
+            sum -= in[i - window];
+    }
+}
+
+static void qam_modulate(const uint8_t* in, size_t length,
+    const QamAxis& axis, std::complex<float>* out)
+{
+    float* out_f = reinterpret_cast<float*>(out);
+    const __m512 levels = _mm512_maskz_loadu_ps(0xff, axis.levels);
+    const __m512i mask = _mm512_set1_epi32((1 << axis.bits) - 1);
+    const __m512i seven = _mm512_set1_epi32(7);
+    const __m512i interleave_lo = _mm512_setr_epi32(
+        0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    const __m512i interleave_hi = _mm512_setr_epi32(
+        8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+    size_t vec_len = length - length % AVX512_PACKED_SP;
+    for (size_t i = 0; i < vec_len; i += AVX512_PACKED_SP) {
+        __m512i label = _mm512_cvtepu8_epi32(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        __m512 re = _mm512_permutexvar_ps(
+            _mm512_and_si512(_mm512_srli_epi32(label, axis.bits), seven),
+            levels);
+        __m512 im
+            = _mm512_permutexvar_ps(_mm512_and_si512(label, mask), levels);
+        _mm512_storeu_ps(
+            out_f + 2 * i, _mm512_permutex2var_ps(re, interleave_lo, im));
+        _mm512_storeu_ps(out_f + 2 * i + AVX512_PACKED_SP,
+            _mm512_permutex2var_ps(re, interleave_hi, im));
+    }
+    kScalarKernels.qam_modulate(
+        in + vec_len, length - vec_len, axis, out + vec_len);
+}
+
+// Real and imaginary parts of 16 complex floats
+static inline void __m512_cf32_split(const float* in, __m512& re, __m512& im)
+{
+    const __m512i evens = _mm512_setr_epi32(
+        0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odds = _mm512_setr_epi32(
+        1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+    __m512 x0 = _mm512_loadu_ps(in);
+    __m512 x1 = _mm512_loadu_ps(in + AVX512_PACKED_SP);
+    re = _mm512_permutex2var_ps(x0, evens, x1);
+    im = _mm512_permutex2var_ps(x0, odds, x1);
+}
+
+static inline __m512i __m512_qam_axis_label(
+    __m512 x, const QamAxis& axis, __m512i labels)
+{
+    const __m512i one = _mm512_set1_epi32(1);
+    __m512i level = _mm512_setzero_si512();
+    for (int m = 0; m < (1 << axis.bits) - 1; m++) {
+        __mmask16 above = _mm512_cmp_ps_mask(
+            x, _mm512_set1_ps(axis.thresholds[m]), _CMP_GE_OQ);
+        level = _mm512_mask_add_epi32(level, above, level, one);
+    }
+    return _mm512_permutexvar_epi32(level, labels);
+}
+
+static void qam_demod_hard(const std::complex<float>* in, size_t length,
+    const QamAxis& axis, uint8_t* out)
+{
+    const float* in_f = reinterpret_cast<const float*>(in);
+    const __m512i labels = _mm512_maskz_loadu_epi32(0xff, axis.labels);
+    size_t vec_len = length - length % AVX512_PACKED_SP;
+    for (size_t i = 0; i < vec_len; i += AVX512_PACKED_SP) {
+        __m512 re, im;
+        __m512_cf32_split(in_f + 2 * i, re, im);
+        __m512i label = _mm512_or_si512(
+            _mm512_slli_epi32(__m512_qam_axis_label(re, axis, labels),
+                axis.bits),
+            __m512_qam_axis_label(im, axis, labels));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+            _mm512_cvtepi32_epi8(label));
+    }
+    kScalarKernels.qam_demod_hard(
+        in + vec_len, length - vec_len, axis, out + vec_len);
+}
+
+// LLRs of the label bits of each lane of x, as qam_axis_llr. split[j]
+// holds the levels with bit j clear, then those with it set.
+template <int kBits>
+static inline void __m512_qam_axis_llr(
+    __m512 x, const float (*split)[1 << kBits], __m512 scale, __m512* llr)
+{
+    const int half = 1 << (kBits - 1);
+    for (int j = 0; j < kBits; j++) {
+        __m512 min0 = _mm512_set1_ps(INFINITY);
+        __m512 min1 = min0;
+        // Operands in the order that keeps a NaN distance out, as
+        // std::min
+        for (int k = 0; k < half; k++) {
+            __m512 diff0 = _mm512_sub_ps(x, _mm512_set1_ps(split[j][k]));
+            __m512 diff1 = _mm512_sub_ps(x, _mm512_set1_ps(split[j][half + k]));
+            min0 = _mm512_min_ps(_mm512_mul_ps(diff0, diff0), min0);
+            min1 = _mm512_min_ps(_mm512_mul_ps(diff1, diff1), min1);
+        }
+        llr[j] = _mm512_mul_ps(scale, _mm512_sub_ps(min1, min0));
+    }
+}
+
+// Lane n of the result is lane index[n] of llr[j], j being 1 in the lanes
+// of one, 2 in those of two and 0 in the others
+static inline __m512 __m512_interleave3(
+    const __m512* llr, __m512i index, __mmask16 one, __mmask16 two)
+{
+    __m512 res = _mm512_permutexvar_ps(index, llr[0]);
+    res = _mm512_mask_permutexvar_ps(res, one, index, llr[1]);
+    return _mm512_mask_permutexvar_ps(res, two, index, llr[2]);
+}
+
+// Both axes share the levels, so the interleaved samples are demodulated
+// as they are and the kBits LLRs of each lane are consecutive in out
+template <int kBits>
+static void qam_demod_soft_bits(const std::complex<float>* in, size_t length,
+    const QamAxis& axis, float scale, float* out)
+{
+    const float* in_f = reinterpret_cast<const float*>(in);
+    const __m512 scale_vec = _mm512_set1_ps(scale);
+    const size_t bits = 2 * kBits;
+    // Every bit is set for half of the levels, the labels being all the
+    // values of kBits bits
+    float split[kBits][1 << kBits];
+    for (int j = 0; j < kBits; j++) {
+        int clear = 0;
+        int set = 1 << (kBits - 1);
+        for (int k = 0; k < (1 << kBits); k++) {
+            float level = axis.levels[axis.labels[k]];
+            if (((axis.labels[k] >> (kBits - 1 - j)) & 1) != 0)
+                split[j][set++] = level;
+            else
+                split[j][clear++] = level;
+        }
+    }
+    size_t vec_len = length - length % AVX512_PACKED_CF;
+    for (size_t i = 0; i < vec_len; i += AVX512_PACKED_CF) {
+        __m512 llr[kBits];
+        __m512_qam_axis_llr<kBits>(
+            _mm512_loadu_ps(in_f + 2 * i), split, scale_vec, llr);
+        float* dst = out + i * bits;
+        if constexpr (kBits == 1) {
+            _mm512_storeu_ps(dst, llr[0]);
+        } else if constexpr (kBits == 2) {
+            // Lanes [0 2 4 6] and [1 3 5 7] of the points
+            const __m512i first = _mm512_setr_epi32(
+                0, 1, 2, 3, 16, 17, 18, 19, 4, 5, 6, 7, 20, 21, 22, 23);
+            const __m512i second = _mm512_setr_epi32(
+                8, 9, 10, 11, 24, 25, 26, 27, 12, 13, 14, 15, 28, 29, 30, 31);
+            __m512 lo = _mm512_unpacklo_ps(llr[0], llr[1]);
+            __m512 hi = _mm512_unpackhi_ps(llr[0], llr[1]);
+            _mm512_storeu_ps(dst, _mm512_permutex2var_ps(lo, first, hi));
+            _mm512_storeu_ps(dst + AVX512_PACKED_SP,
+                _mm512_permutex2var_ps(lo, second, hi));
+        } else {
+            const __m512i index0 = _mm512_setr_epi32(
+                0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+            const __m512i index1 = _mm512_setr_epi32(
+                5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+            const __m512i index2 = _mm512_setr_epi32(
+                10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+            _mm512_storeu_ps(
+                dst, __m512_interleave3(llr, index0, 0x2492, 0x4924));
+            _mm512_storeu_ps(dst + AVX512_PACKED_SP,
+                __m512_interleave3(llr, index1, 0x9249, 0x2492));
+            _mm512_storeu_ps(dst + 2 * AVX512_PACKED_SP,
+                __m512_interleave3(llr, index2, 0x4924, 0x9249));
+        }
+    }
+    kScalarKernels.qam_demod_soft(
+        in + vec_len, length - vec_len, axis, scale, out + vec_len * bits);
+}
+
+static void qam_demod_soft(const std::complex<float>* in, size_t length,
+    const QamAxis& axis, float scale, float* out)
+{
+    if (axis.bits == 1)
+        qam_demod_soft_bits<1>(in, length, axis, scale, out);
+    else if (axis.bits == 2)
+        qam_demod_soft_bits<2>(in, length, axis, scale, out);
+    else
+        qam_demod_soft_bits<3>(in, length, axis, scale, out);
+}
+
+const CommsKernels kAvx512Kernels = { "avx512", 512, correlate_cf32,
+    correlate_cs16, complex_mult_cf32, complex_mult_cs16, abs2_cf32,
+    abs2_cs16, csign, moving_sum, qam_modulate, qam_demod_hard,
+    qam_demod_soft };
+
+#endif
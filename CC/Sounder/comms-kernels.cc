@@ -0,0 +1,263 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Scalar CommsLib kernels and the selection of the kernel table for the
+ CPU running the program
+---------------------------------------------------------------------
+*/
+
+#include "include/comms-kernels.h"
+#include "include/comms-lib.h"
+#include "include/logger.h"
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+static inline int16_t saturate_cs16(int32_t x)
+{
+    return static_cast<int16_t>(std::min(std::max(x, -32768), 32767));
+}
+
+static void correlate_cf32(const std::complex<float>* in, size_t count,
+    const std::complex<float>* seq, size_t seq_len, std::complex<float>* out)
+{
+    for (size_t k = 0; k < count; k++) {
+        float re = 0;
+        float im = 0;
+        for (size_t j = 0; j < seq_len; j++) {
+            const std::complex<float>& x = in[k + j];
+            re += x.real() * seq[j].real() + x.imag() * seq[j].imag();
+            im += x.imag() * seq[j].real() - x.real() * seq[j].imag();
+        }
+        out[k] = std::complex<float>(re, im);
+    }
+}
+
+// Multiply-add of the I/Q pair of a tap with x, like _mm256_madd_epi16
+static inline int32_t madd_cs16(std::complex<int16_t> x, uint32_t tap)
+{
+    return x.real() * static_cast<int32_t>(static_cast<int16_t>(tap))
+        + x.imag() * static_cast<int32_t>(static_cast<int16_t>(tap >> 16));
+}
+
+static void correlate_cs16(const std::complex<int16_t>* in, size_t count,
+    const uint32_t* taps, size_t seq_len, int tap_shift, int out_shift,
+    std::complex<int16_t>* out)
+{
+    int32_t round = out_shift > 0 ? 1 << (out_shift - 1) : 0;
+    for (size_t k = 0; k < count; k++) {
+        int32_t re = 0;
+        int32_t im = 0;
+        for (size_t j = 0; j < seq_len; j++) {
+            re += madd_cs16(in[k + j], taps[2 * j]) >> tap_shift;
+            im += madd_cs16(in[k + j], taps[2 * j + 1]) >> tap_shift;
+        }
+        out[k] = std::complex<int16_t>(
+            saturate_cs16((re + round) >> out_shift),
+            saturate_cs16((im + round) >> out_shift));
+    }
+}
+
+void correlate_cs16_taps(
+    const std::complex<int16_t>* seq, size_t seq_len, uint32_t* taps)
+{
+    for (size_t j = 0; j < seq_len; j++) {
+        int16_t g_re = std::max<int16_t>(seq[j].real(), -32767);
+        int16_t g_im = std::max<int16_t>(seq[j].imag(), -32767);
+        // x_re * g_re + x_im * g_im, then x_re * -g_im + x_im * g_re
+        taps[2 * j] = (uint32_t(uint16_t(g_im)) << 16) | uint16_t(g_re);
+        taps[2 * j + 1] = (uint32_t(uint16_t(g_re)) << 16) | uint16_t(-g_im);
+    }
+}
+
+static void complex_mult_cf32(const std::complex<float>* a,
+    const std::complex<float>* b, size_t length, bool conj,
+    std::complex<float>* out)
+{
+    // Written out to keep std::complex's NaN handling off this loop
+    float sign = conj ? -1.f : 1.f;
+    for (size_t i = 0; i < length; i++) {
+        float b_im = sign * b[i].imag();
+        out[i] = std::complex<float>(
+            a[i].real() * b[i].real() - a[i].imag() * b_im,
+            a[i].real() * b_im + a[i].imag() * b[i].real());
+    }
+}
+
+static void complex_mult_cs16(const std::complex<int16_t>* a,
+    const std::complex<int16_t>* b, size_t length, bool conj,
+    std::complex<int16_t>* out)
+{
+    // Same terms as the pairwise multiply-adds of the vector code, where
+    // -32768 negates to itself and only two -32768 * -32768 products wrap
+    for (size_t i = 0; i < length; i++) {
+        int32_t a_re = a[i].real();
+        int32_t a_im = a[i].imag();
+        int32_t b_re = b[i].real();
+        int32_t b_im = b[i].imag();
+        int32_t b_neg = static_cast<int16_t>(-b_im);
+        uint32_t re = static_cast<uint32_t>(a_re * b_re)
+            + static_cast<uint32_t>(a_im * (conj ? b_im : b_neg));
+        uint32_t im = static_cast<uint32_t>(a_re * (conj ? b_neg : b_im))
+            + static_cast<uint32_t>(a_im * b_re);
+        out[i] = std::complex<int16_t>(
+            saturate_cs16(static_cast<int32_t>(re) >> 15),
+            saturate_cs16(static_cast<int32_t>(im) >> 15));
+    }
+}
+
+static void abs2_cf32(const std::complex<float>* in, size_t length, float* out)
+{
+    for (size_t i = 0; i < length; i++)
+        out[i] = in[i].real() * in[i].real() + in[i].imag() * in[i].imag();
+}
+
+static void abs2_cs16(
+    const std::complex<int16_t>* in, size_t length, int32_t* out)
+{
+    for (size_t i = 0; i < length; i++) {
+        int32_t re = in[i].real();
+        int32_t im = in[i].imag();
+        out[i] = static_cast<int32_t>(
+            static_cast<uint32_t>(re * re) + static_cast<uint32_t>(im * im));
+    }
+}
+
+static void csign(
+    const std::complex<float>* in, size_t length, std::complex<float>* out)
+{
+    for (size_t i = 0; i < length; i++) {
+        float x = in[i].real() != 0 ? in[i].real() : in[i].imag();
+        out[i] = (x > 0) ? 1.f : (x < 0) ? -1.f : 0.f;
+    }
+}
+
+static void moving_sum(
+    const float* in, size_t length, size_t window, float* out)
+{
+    double sum = 0;
+    for (size_t i = 0; i < length; i++) {
+        out[i] = sum;
+        sum += in[i];
+        if (i >= window)
+            sum -= in[i - window];
+    }
+}
+
+static void qam_modulate(const uint8_t* in, size_t length,
+    const QamAxis& axis, std::complex<float>* out)
+{
+    int mask = (1 << axis.bits) - 1;
+    for (size_t i = 0; i < length; i++) {
+        // Masked to the padded table, as the permutes of the vector tables
+        out[i] = std::complex<float>(
+            axis.levels[(in[i] >> axis.bits) & 7], axis.levels[in[i] & mask]);
+    }
+}
+
+// Axis label of the level nearest to x. Comparing with the thresholds
+// rather than rounding a scaled x makes every table decide the same.
+static inline uint8_t qam_axis_label(float x, const QamAxis& axis)
+{
+    int level = 0;
+    for (int m = 0; m < (1 << axis.bits) - 1; m++)
+        level += (x >= axis.thresholds[m]) ? 1 : 0;
+    return axis.labels[level];
+}
+
+static void qam_demod_hard(const std::complex<float>* in, size_t length,
+    const QamAxis& axis, uint8_t* out)
+{
+    for (size_t i = 0; i < length; i++) {
+        out[i] = (qam_axis_label(in[i].real(), axis) << axis.bits)
+            | qam_axis_label(in[i].imag(), axis);
+    }
+}
+
+// The LLRs of the axis label bits, the other axis adds the same distance
+// to both sides of each
+static inline void qam_axis_llr(
+    float x, const QamAxis& axis, float scale, float* out)
+{
+    float min0[3];
+    float min1[3];
+    std::fill(min0, min0 + 3, INFINITY);
+    std::fill(min1, min1 + 3, INFINITY);
+    for (int k = 0; k < (1 << axis.bits); k++) {
+        float diff = x - axis.levels[axis.labels[k]];
+        float dist = diff * diff;
+        for (int j = 0; j < axis.bits; j++) {
+            if (((axis.labels[k] >> (axis.bits - 1 - j)) & 1) != 0)
+                min1[j] = std::min(min1[j], dist);
+            else
+                min0[j] = std::min(min0[j], dist);
+        }
+    }
+    for (int j = 0; j < axis.bits; j++)
+        out[j] = scale * (min1[j] - min0[j]);
+}
+
+static void qam_demod_soft(const std::complex<float>* in, size_t length,
+    const QamAxis& axis, float scale, float* out)
+{
+    for (size_t i = 0; i < length; i++) {
+        float* llr = out + 2 * axis.bits * i;
+        qam_axis_llr(in[i].real(), axis, scale, llr);
+        qam_axis_llr(in[i].imag(), axis, scale, llr + axis.bits);
+    }
+}
+
+const CommsKernels kScalarKernels = { "scalar", 32, correlate_cf32,
+    correlate_cs16, complex_mult_cf32, complex_mult_cs16, abs2_cf32,
+    abs2_cs16, csign, moving_sum, qam_modulate, qam_demod_hard,
+    qam_demod_soft };
+
+#if defined(__x86_64__)
+// Whether the OS saves the register state given by the XCR0 mask
+static bool os_saves(uint64_t mask)
+{
+    uint32_t eax, edx;
+    asm("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((static_cast<uint64_t>(edx) << 32 | eax) & mask) == mask;
+}
+#endif
+
+static const CommsKernels& detect_kernels(void)
+{
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    if ((__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0)
+        || ((ecx & bit_OSXSAVE) == 0))
+        return kScalarKernels;
+    bool fma = (ecx & bit_FMA) != 0;
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0)
+        return kScalarKernels;
+
+    // XMM and YMM state, then opmask and ZMM state
+    const uint64_t kYmmState = 0x6;
+    const uint64_t kZmmState = 0xe6;
+    if (((ebx & bit_AVX512F) != 0) && ((ebx & bit_AVX512BW) != 0)
+        && (os_saves(kZmmState) == true))
+        return kAvx512Kernels;
+    if (((ebx & bit_AVX2) != 0) && (fma == true)
+        && (os_saves(kYmmState) == true))
+        return kAvx2Kernels;
+#endif
+    return kScalarKernels;
+}
+
+static const CommsKernels& select_kernels(void)
+{
+    const CommsKernels& kernels = detect_kernels();
+    MLPD_INFO("CommsLib kernels: %s\n", kernels.name);
+    return kernels;
+}
+
+const CommsKernels& CommsLib::kernels(void)
+{
+    // Picked on first use, the CPU doesn't change under the program
+    static const CommsKernels& kernels = select_kernels();
+    return kernels;
+}
@@ -1,31 +1,25 @@
 /*
- Select signal processing and communications blocks implemented using Intel AVX
-
-find_beacon_avx: Correlation and Peak detection of a beacon with Gold code (2 repetitions)
----------------------------------------------------------------------
  Copyright (c) 2018-2020, Rice University 
  RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
  Author(s): Rahman Doost-Mohamamdy: doost@rice.edu
+
 ---------------------------------------------------------------------
-*/
+ Select signal processing and communications blocks on the CommsLib
+ kernels, which run the scalar, AVX2 or AVX-512 code the CPU supports
 
-#if defined(__x86_64__)
+ find_beacon_avx: Correlation and Peak detection of a beacon with Gold code
+ (2 repetitions)
+---------------------------------------------------------------------
+*/
 
+#include "include/comms-kernels.h"
 #include "include/comms-lib.h"
 #include "include/logger.h"
 #include <assert.h>
-#include <immintrin.h>
+#include <cstdlib>
 #include <iomanip>
 #include <queue>
 
-#define USE_AVX
-
-static const size_t kBytesIn256Bits = (256 / 8);
-
-#define AVX_PACKED_SP 8 //single-precision
-#define AVX_PACKED_SI 16 // short int
-#define AVX_PACKED_CS 8 // complex short int
-
 int CommsLib::find_beacon_avx(const std::vector<std::complex<float>>& iq,
     const std::vector<std::complex<float>>& seq)
 {
@@ -38,7 +32,9 @@ int CommsLib::find_beacon_avx(const std::vector<std::complex<float>>& iq,
 
     // correlate signal with beacon
     std::vector<std::complex<float>> gold_corr_avx
-        = CommsLib::correlate_avx(iq, seq);
+        = CommsLib::use_fft_correlation(iq.size(), seq.size())
+        ? CommsLib::correlate_fft(iq, seq)
+        : CommsLib::correlate_avx(iq, seq);
     clock_gettime(CLOCK_MONOTONIC, &tv2);
 #ifdef TEST_BENCH
     double diff1
@@ -58,12 +54,10 @@ int CommsLib::find_beacon_avx(const std::vector<std::complex<float>>& iq,
 #endif
 
     // calculate the adaptive theshold
-    std::vector<float> consts1(seqLen, 1);
     clock_gettime(CLOCK_MONOTONIC, &tv);
     // calculate the moving sum of the abs of corr result and use as threshold
     std::vector<float> corr_abs_avx = CommsLib::abs2_avx(gold_corr_avx);
-    std::vector<float> thresh_avx
-        = CommsLib::correlate_avx_s(corr_abs_avx, consts1);
+    std::vector<float> thresh_avx = CommsLib::moving_sum(corr_abs_avx, seqLen);
     clock_gettime(CLOCK_MONOTONIC, &tv2);
 #ifdef TEST_BENCH
     double diff3
@@ -113,236 +107,61 @@ int CommsLib::find_beacon_avx(const std::vector<std::complex<float>>& iq,
     return valid_peaks.front();
 }
 
-static inline __m256i __m256_complex_cs16_mult(
-    __m256i data1, __m256i data2, bool conj)
-{
-    const __m256i neg0 = _mm256_set1_epi32(0xFFFF0000);
-    const __m256i neg1 = _mm256_set1_epi32(0x00010000);
-    const __m256i mix = _mm256_set1_epi32(0x0000FFFF);
-
-    __m256i temp0 = _mm256_xor_si256(data2, neg0);
-    temp0 = _mm256_add_epi32(temp0, neg1);
-
-    __m256i temp1 = _mm256_shufflehi_epi16(conj ? temp0 : data2, 0xb1);
-    temp1 = _mm256_shufflelo_epi16(temp1, 0xb1);
-
-    __m256i re = _mm256_madd_epi16(data1, conj ? data2 : temp0);
-    __m256i im = _mm256_madd_epi16(data1, temp1);
-
-    re = _mm256_srai_epi32(re, 15);
-    im = _mm256_srai_epi32(im, 15);
-
-    re = _mm256_and_si256(re, mix);
-    im = _mm256_and_si256(im, mix);
-    im = _mm256_slli_epi32(im, 0x10);
-
-    return _mm256_or_si256(re, im);
-}
-
 std::vector<std::complex<int16_t>> CommsLib::complex_mult_avx(
     std::vector<std::complex<int16_t>> const& f,
     std::vector<std::complex<int16_t>> const& g, const bool conj)
 {
-    size_t length1 = g.size();
-    size_t length0 = f.size();
-    size_t res_len = std::min(length0, length1);
-
-    __m256i* in0 = (__m256i*)(f.data());
-    __m256i* in1 = (__m256i*)(g.data());
-    std::vector<std::complex<int16_t>> out(res_len, 0);
-    __m256i* outf = (__m256i*)out.data();
-
-    __m256i data0 __attribute__((aligned(kBytesIn256Bits)));
-    __m256i data1 __attribute__((aligned(kBytesIn256Bits)));
-
-    __m256i res __attribute__((aligned(kBytesIn256Bits)));
-
-    size_t vecSize = res_len / AVX_PACKED_CS;
-    for (size_t i = 0; i < vecSize; i++) {
-        data0 = _mm256_loadu_si256(in0 + i);
-        data1 = _mm256_loadu_si256(in1 + i);
-        res = __m256_complex_cs16_mult(data0, data1, conj);
-        _mm256_storeu_si256(outf + i, res);
-    }
-
-    for (size_t i = vecSize * AVX_PACKED_CS; i < res_len; i++) {
-        int16_t i0 = f[i].real();
-        int16_t i1 = g[i].real();
-        int16_t q0 = f[i].imag();
-        int16_t q1 = g[i].imag();
-        int16_t ires = (int16_t)((i0 * i1 + (conj ? 1 : -1) * q0 * q1) >> 15);
-        int16_t qres = (int16_t)((i1 * q0 + (conj ? -1 : 1) * i0 * q1) >> 15);
-        out[i] = std::complex<int16_t>(ires, qres);
-    }
-
+    std::vector<std::complex<int16_t>> out(std::min(f.size(), g.size()));
+    kernels().complex_mult_cs16(
+        f.data(), g.data(), out.size(), conj, out.data());
     return out;
 }
 
-static inline __m256 __m256_complex_cf32_mult(
-    __m256 data1, __m256 data2, bool conj)
-{
-    __m256 prod0 __attribute__((aligned(kBytesIn256Bits)));
-    __m256 prod1 __attribute__((aligned(kBytesIn256Bits)));
-    __m256 res __attribute__((aligned(kBytesIn256Bits)));
-
-    // https://stackoverflow.com/questions/39509746
-    const __m256 neg0
-        = _mm256_setr_ps(1.0, -1.0, 1.0, -1.0, 1.0, -1.0, 1.0, -1.0);
-    const __m256 neg1
-        = _mm256_set_ps(1.0, -1.0, 1.0, -1.0, 1.0, -1.0, 1.0, -1.0);
-    prod0 = _mm256_mul_ps(data1, data2); // q1*q2, i1*i2, ...
-
-    /* Step 2: Negate the imaginary elements of vec2 */
-    data2 = _mm256_mul_ps(data2, conj ? neg0 : neg1);
-
-    /* Step 3: Switch the real and imaginary elements of vec2 */
-    data2 = _mm256_permute_ps(data2, 0xb1);
-
-    /* Step 4: Multiply vec1 and the modified vec2 */
-    prod1 = _mm256_mul_ps(data1, data2); // i2*q1, -i1*q2, ...
-
-    /* Horizontally add the elements in vec3 and vec4 */
-    res = conj
-        ? _mm256_hadd_ps(prod0, prod1)
-        : _mm256_hsub_ps(prod0, prod1); // i2*q1+-i1*q2, i1*i2+-q1*q2, ...
-    res = _mm256_permute_ps(res, 0xd8);
-
-    return res;
-}
-
 std::vector<std::complex<float>> CommsLib::complex_mult_avx(
     std::vector<std::complex<float>> const& f,
     std::vector<std::complex<float>> const& g, const bool conj)
 {
-    size_t length1 = 2 * g.size();
-    size_t length0 = 2 * f.size();
-    size_t res_len = std::min(length0, length1);
-
-    float* in0 = (float*)(f.data());
-    float* in1 = (float*)(g.data());
-    std::vector<std::complex<float>> out(res_len / 2, 0);
-    float* outf = (float*)out.data();
-
-    __m256 data0 __attribute__((aligned(kBytesIn256Bits)));
-    __m256 data1 __attribute__((aligned(kBytesIn256Bits)));
-
-    __m256 res __attribute__((aligned(kBytesIn256Bits)));
-
-    size_t rem = res_len - (res_len % AVX_PACKED_SP);
-    for (size_t i = 0; i < rem; i += AVX_PACKED_SP) {
-        data0 = _mm256_loadu_ps(in0 + i);
-        data1 = _mm256_loadu_ps(in1 + i);
-        res = __m256_complex_cf32_mult(data0, data1, conj);
-        _mm256_storeu_ps(outf + i, res);
-    }
-
-    for (size_t i = rem; i < res_len; i += 2)
-        out[i / 2] = f[i / 2] * (conj ? std::conj(g[i / 2]) : g[i / 2]);
-
+    std::vector<std::complex<float>> out(std::min(f.size(), g.size()));
+    kernels().complex_mult_cf32(
+        f.data(), g.data(), out.size(), conj, out.data());
     return out;
 }
 
 std::vector<std::complex<float>> CommsLib::auto_corr_mult_avx(
     std::vector<std::complex<float>> const& f, const int dly, const bool conj)
 {
-#if 0
-    size_t length = 2 * f.size();
-    float* in = (float*)(f.data());
-    std::vector<std::complex<float>> out(length / 2, 0);
-    float* outf = (float*)(out.data());
-    int d = 2 * dly;
-
-    __m256 data1 __attribute__((aligned(kAlign256Bits)));
-    __m256 data2 __attribute__((aligned(kAlign256Bits)));
-    __m256 res __attribute__((aligned(kAlign256Bits)));
-
-    size_t rem = length - (length % AVX_PACKED_SP);
-    if (rem > 0) {
-        for (size_t i = d; i < rem; i += AVX_PACKED_SP) {
-            data1 = _mm256_loadu_ps(in + i);
-            data2 = _mm256_loadu_ps(in + i - d);
-            res = __m256_complex_cf32_mult(data1, data2, conj);
-            _mm256_storeu_ps(outf + i, res);
-        }
+    // f[i] times f[i - dly], zero for the first dly samples
+    std::vector<std::complex<float>> out(f.size(), 0);
+    if (static_cast<size_t>(dly) < f.size()) {
+        kernels().complex_mult_cf32(
+            f.data() + dly, f.data(), f.size() - dly, conj, out.data() + dly);
     }
-    for (size_t i = rem; i < length; i += 2)
-        out[i / 2] = f[i / 2] * (conj ? std::conj(f[i / 2 - dly]) : f[i / 2 - dly]);
     return out;
-#else
-    std::vector<std::complex<float>> g(f.begin(), f.end() - dly);
-    std::vector<std::complex<float>> z(dly, 0);
-    g.insert(g.begin(), z.begin(), z.end());
-    return CommsLib::complex_mult_avx(f, g, conj);
-#endif
 }
 
 std::vector<std::complex<int16_t>> CommsLib::auto_corr_mult_avx(
     std::vector<std::complex<int16_t>> const& f, const int dly, const bool conj)
 {
-    std::vector<std::complex<int16_t>> g(f.begin(), f.end() - dly);
-    std::vector<std::complex<int16_t>> z(dly, 0);
-    g.insert(g.begin(), z.begin(), z.end());
-    return CommsLib::complex_mult_avx(f, g, conj);
+    std::vector<std::complex<int16_t>> out(f.size(), 0);
+    if (static_cast<size_t>(dly) < f.size()) {
+        kernels().complex_mult_cs16(
+            f.data() + dly, f.data(), f.size() - dly, conj, out.data() + dly);
+    }
+    return out;
 }
 
 std::vector<float> CommsLib::abs2_avx(std::vector<std::complex<float>> const& f)
 {
-    size_t length = 2 * f.size();
-    float* in = (float*)(f.data());
-    std::vector<float> out(length / 2, 0);
-    float* outf = (float*)(out.data());
-
-    __m256 data1 __attribute__((aligned(kBytesIn256Bits)));
-    __m256 data2 __attribute__((aligned(kBytesIn256Bits)));
-    __m256 prod0 __attribute__((aligned(kBytesIn256Bits)));
-    __m256 prod1 __attribute__((aligned(kBytesIn256Bits)));
-    __m256 res __attribute__((aligned(kBytesIn256Bits)));
-    const __m256i perm0
-        = _mm256_set_epi32(0x7, 0x6, 0x3, 0x2, 0x5, 0x4, 0x1, 0x0);
-
-    size_t rem = length - (length % (2 * AVX_PACKED_SP));
-    if (rem > 0) {
-        for (size_t i = 0; i < rem; i += 2 * AVX_PACKED_SP) {
-            data1 = _mm256_loadu_ps(in
-                + i); // low index go to high bit of __m256 variable apparently
-            data2 = _mm256_loadu_ps(in + i + AVX_PACKED_SP);
-
-            prod0 = _mm256_mul_ps(data1, data1);
-            prod1 = _mm256_mul_ps(data2, data2);
-
-            res = _mm256_hadd_ps(prod0, prod1);
-            res = _mm256_permutevar8x32_ps(res, perm0);
-            _mm256_storeu_ps(outf + i / 2, res);
-        }
-    }
-
-    for (size_t i = rem; i < length; i += 2)
-        outf[i / 2] = in[i] * in[i] + in[i + 1] * in[i + 1];
+    std::vector<float> out(f.size());
+    kernels().abs2_cf32(f.data(), f.size(), out.data());
     return out;
 }
 
 std::vector<int32_t> CommsLib::abs2_avx(
     std::vector<std::complex<int16_t>> const& f)
 {
-    size_t len = f.size();
-
-    __m256i* in0 = (__m256i*)(f.data());
-    std::vector<int32_t> out(len, 0);
-    __m256i* outf = (__m256i*)out.data();
-
-    size_t vecSize = len / AVX_PACKED_CS;
-    for (size_t i = 0; i < vecSize; i++) {
-        __m256i data0 = _mm256_loadu_si256(in0 + i);
-        __m256i mag = _mm256_madd_epi16(data0, data0);
-        _mm256_storeu_si256(outf + i, mag);
-    }
-
-    for (size_t i = vecSize * AVX_PACKED_CS; i < len; i++) {
-        int16_t i0 = f[i].real();
-        int16_t q0 = f[i].imag();
-        out[i] = i0 * i0 + q0 * q0;
-    }
-
+    std::vector<int32_t> out(f.size());
+    kernels().abs2_cs16(f.data(), f.size(), out.data());
     return out;
 }
 
@@ -357,32 +176,48 @@ std::vector<std::complex<int16_t>> CommsLib::correlate_avx(
     in.insert(in.end(), f.begin(), f.end());
     size_t length = in.size();
 
-    int16_t* in1 = (int16_t*)(g.data());
+    // Q15 output like the float version scaled by 32768, outputs from
+    // length - length1 on are zero
     std::vector<std::complex<int16_t>> out(length, 0);
+    correlate_avx(in.data(), length - 1, g, 15, out.data());
+    return out;
+}
 
-    size_t sz = sizeof(std::complex<int16_t>);
-
-    __m256i seq_samp[length1] __attribute__((aligned(kBytesIn256Bits)));
-
-    for (size_t i = 0; i < length1; i++) {
-        __m256i samp_i = _mm256_set1_epi16(in1[i * 2]);
-        __m256i samp_q = _mm256_set1_epi16(in1[i * 2 + 1]);
-        seq_samp[i] = _mm256_unpackhi_epi16(samp_i, samp_q);
-    }
+void CommsLib::correlate_avx(const std::complex<int16_t>* f, size_t length,
+    std::vector<std::complex<int16_t>> const& g, int shift,
+    std::complex<int16_t>* out)
+{
+    correlate_avx(f, length, correlate_taps(g), shift, out);
+}
 
-    for (size_t i = 0; i < (length - length1); i += AVX_PACKED_SI) {
-        __m256i accm = _mm256_set1_epi16(0x0);
-        for (size_t j = 0; j < length1; j++) {
-            __m256i* in_temp = (__m256i*)(in.data() + (i + j) * sz);
-            __m256i data = _mm256_loadu_si256(in_temp);
-            __m256i prod = __m256_complex_cs16_mult(data, seq_samp[j], true);
-            accm = _mm256_add_epi16(prod, accm);
-        }
-        __m256i* out_temp = (__m256i*)(out.data() + i * sz);
-        _mm256_storeu_si256(out_temp, accm);
-    }
+Cs16CorrTaps CommsLib::correlate_taps(
+    std::vector<std::complex<int16_t>> const& g)
+{
+    Cs16CorrTaps taps;
+    taps.seq_len = g.size();
+    taps.taps.resize(2 * g.size());
+    correlate_cs16_taps(g.data(), g.size(), taps.taps.data());
+
+    // Each tap adds at most 32768 * (|g_re| + |g_im|), the taps are
+    // shifted by tap_shift before summing so the int32 sums and their
+    // rounding can't overflow
+    int64_t max_sum = 0;
+    for (auto& tap : g)
+        max_sum += 32768 * (std::abs(tap.real()) + std::abs(tap.imag()));
+    taps.tap_shift = 0;
+    while ((max_sum >> taps.tap_shift) > INT32_MAX / 2)
+        taps.tap_shift++;
+    return taps;
+}
 
-    return out;
+void CommsLib::correlate_avx(const std::complex<int16_t>* f, size_t length,
+    Cs16CorrTaps const& g, int shift, std::complex<int16_t>* out)
+{
+    if (length < g.seq_len)
+        return;
+    int tap_shift = std::min(g.tap_shift, shift);
+    kernels().correlate_cs16(f, length - g.seq_len + 1, g.taps.data(),
+        g.seq_len, tap_shift, shift - tap_shift, out);
 }
 
 std::vector<std::complex<float>> CommsLib::correlate_avx(
@@ -393,37 +228,15 @@ std::vector<std::complex<float>> CommsLib::correlate_avx(
     size_t length0 = f.size();
     size_t length1 = g.size();
 
-    std::vector<std::complex<float>> in(length0 + length1 - 1, 0);
-    //std::copy(f.begin(), f.end(), std::back_inserter(in));
-    //in.insert(in.end(), f.begin(), f.end());
-    for (size_t i = length1 - 1; i < in.size(); i++) {
-        size_t j = i - length1 + 1;
-        in[i] = f[j];
-    }
-    size_t length = in.size();
+    size_t length = length0 + length1 - 1;
+    std::vector<std::complex<float>> in(length, 0);
+    std::copy(f.begin(), f.end(), in.begin() + length1 - 1);
 
-    float* in0 = (float*)(in.data());
-    float* in1 = (float*)(g.data());
+    // outputs from length - length1 on are zero
     std::vector<std::complex<float>> out(length, 0);
-    float* outf = (float*)out.data();
-
-    __m256 seq_samp[length1] __attribute__((aligned(kBytesIn256Bits)));
-
-    for (size_t i = 0; i < length1; i++) {
-        __m256 samp_i = _mm256_broadcast_ss(&in1[i * 2]);
-        __m256 samp_q = _mm256_broadcast_ss(&in1[i * 2 + 1]);
-        seq_samp[i] = _mm256_shuffle_ps(samp_i, samp_q, 0x0);
-        seq_samp[i] = _mm256_permute_ps(seq_samp[i], 0xd8);
-    }
-
-    for (size_t i = 0; i < 2 * (length - length1); i += AVX_PACKED_SP) {
-        __m256 accm = _mm256_setzero_ps();
-        for (size_t j = 0; j < length1; j++) {
-            __m256 data = _mm256_loadu_ps(in0 + i + j * 2);
-            __m256 prod = __m256_complex_cf32_mult(data, seq_samp[j], true);
-            accm = _mm256_add_ps(prod, accm);
-        }
-        _mm256_storeu_ps(outf + i, accm);
+    if (length0 > 1) {
+        kernels().correlate_cf32(
+            in.data(), length0 - 1, g.data(), length1, out.data());
     }
     return out;
 }
@@ -438,30 +251,13 @@ std::vector<int16_t> CommsLib::correlate_avx_si(
     in.insert(in.end(), f.begin(), f.end());
     size_t length = in.size();
 
-    //int16_t* in1 = (int16_t*)(g.data());
+    // Saturated sums, outputs from length - length1 on are zero
     std::vector<int16_t> out(length, 0);
-
-    size_t sz = sizeof(int16_t);
-
-    __m256i seq_samp[length1] __attribute__((aligned(kBytesIn256Bits)));
-
-    //for (size_t i = 0; i < length1; i++) {
-    //    __m256i samp_i = _mm256_set1_epi16(in1[i]);
-    //}
-
-    for (size_t i = 0; i < length - length1; i += AVX_PACKED_SI) {
-        __m256i accm0 = _mm256_set1_epi16(0x0);
-        __m256i accm1 = _mm256_set1_epi16(0x0);
-        for (size_t j = 0; j < length1; j++) {
-            __m256i* in_temp = (__m256i*)(in.data() + (i + j) * sz);
-            __m256i data = _mm256_loadu_si256(in_temp);
-            __m256i prod0 = _mm256_mulhi_epi16(data, seq_samp[j]);
-            __m256i prod1 = _mm256_mullo_epi16(data, seq_samp[j]);
-            accm0 = _mm256_adds_epi16(prod0, accm0);
-            accm1 = _mm256_adds_epi16(prod1, accm1);
-        }
-        __m256i* out_temp = (__m256i*)(out.data() + i * sz);
-        _mm256_storeu_si256(out_temp, accm0);
+    for (size_t i = 0; i < length - length1; i++) {
+        int64_t acc = 0;
+        for (size_t j = 0; j < length1; j++)
+            acc += in[i + j] * g[j];
+        out[i] = std::min<int64_t>(std::max<int64_t>(acc, -32768), 32767);
     }
     return out;
 }
@@ -473,53 +269,22 @@ std::vector<float> CommsLib::correlate_avx_s(
     size_t length_g = g.size();
     assert(length_f > length_g);
 
-    std::vector<float> in(length_f + length_g);
-    size_t length = in.size();
-
-    //MLPD_TRACE("correlate_avx_s len_f: %zu, len_g: %zu, length: %zu\n", length_f, length_g, length);
-    //in[length_g:length] = f[0:length_f]
-    std::memset(in.data(), 0, length_g * sizeof(float));
-    for (size_t i = length_g; i < length; i++) {
-        size_t j = i - length_g;
-        in.at(i) = f.at(j);
+    // out[i] = sum_j f[i + j - length_g] * g[j], f being zero before 0
+    std::vector<float> out(length_f, 0);
+    for (size_t i = 0; i < length_f; i++) {
+        float acc = 0;
+        size_t first = i < length_g ? length_g - i : 0;
+        for (size_t j = first; j < length_g; j++)
+            acc += f[i + j - length_g] * g[j];
+        out[i] = acc;
     }
-
-    float* in_data_ptr_ = in.data();
-    const float* in_g = g.data();
-
-    __m256 data __attribute__((aligned(kBytesIn256Bits)));
-    __m256 prod __attribute__((aligned(kBytesIn256Bits)));
-    __m256 accm __attribute__((aligned(kBytesIn256Bits)));
-
-    __m256 seq_samp[length_g] __attribute__((aligned(kBytesIn256Bits)));
-
-    // Repeat the kernel across the vector
-    for (size_t i = 0; i < length_g; i++) {
-        seq_samp[i] = _mm256_broadcast_ss(&in_g[i]);
-    }
-
-    static const size_t kAddressIncrement = kBytesIn256Bits / sizeof(float);
-    static_assert((kBytesIn256Bits % sizeof(float)) == 0,
-        "Address alignment not correct");
-
-    size_t padding = kAddressIncrement - (length_f % kAddressIncrement);
-    std::vector<float> out(length_f + padding);
-
-    //Verify no memory overruns
-    assert((out.size() % kAddressIncrement) == 0);
-    for (size_t i = 0; i < (out.size() - 1); i += kAddressIncrement) {
-        accm = _mm256_setzero_ps();
-        for (size_t j = 0; j < length_g; j++) {
-            data = _mm256_loadu_ps(in_data_ptr_ + i + j);
-            prod = _mm256_mul_ps(data, seq_samp[j]);
-            accm = _mm256_add_ps(prod, accm);
-        }
-        _mm256_storeu_ps(out.data() + i, accm);
-    }
-    out.resize(length_f);
     return out;
 }
-#else
-// TODO: ADD NEON code for ARM support
 
-#endif
+std::vector<float> CommsLib::moving_sum(
+    std::vector<float> const& f, size_t window)
+{
+    std::vector<float> out(f.size());
+    kernels().moving_sum(f.data(), f.size(), window, out.data());
+    return out;
+}
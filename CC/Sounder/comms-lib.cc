@@ -20,11 +20,41 @@
 */
 
 #include "include/comms-lib.h"
+#include "include/comms-kernels.h"
 #include "include/constants.h"
+#include "include/fft_correlator.h"
+#include "include/sequence_detector.h"
 #include "include/utils.h"
+#include <map>
+#include <memory>
 #include <queue>
+#include <stdexcept>
 //#include <itpp/itbase.h>
 
+// Both LTS correlation peaks are above this fraction of the largest
+static constexpr float kLtsThresh = 0.8;
+
+// Detector of the last symbol of the seqLen sample LTS, only set up again
+// when seqLen changes
+static SequenceDetector& lts_detector(int seqLen)
+{
+    static thread_local std::unique_ptr<SequenceDetector> detector;
+    static thread_local int detector_len = -1;
+    if ((detector == nullptr) || (detector_len != seqLen)) {
+        // lts_seq is a 2x160 matrix (real/imag by seqLen=160 elements)
+        auto lts_seq = CommsLib::getSequence(CommsLib::LTS_SEQ, seqLen);
+        std::vector<std::complex<float>> lts_sym(Consts::kFftSize_80211);
+        size_t first = seqLen - lts_sym.size();
+        for (size_t i = 0; i < lts_sym.size(); i++) {
+            lts_sym[i] = std::complex<float>(
+                lts_seq[0][first + i], lts_seq[1][first + i]);
+        }
+        detector.reset(new SequenceDetector(lts_sym));
+        detector_len = seqLen;
+    }
+    return *detector;
+}
+
 int CommsLib::findLTS(const std::vector<std::complex<float>>& iq, int seqLen)
 {
     /*
@@ -35,82 +65,25 @@ int CommsLib::findLTS(const std::vector<std::complex<float>>& iq, int seqLen)
      * Output:
      *     best_peak - LTS peak index (correlation peak)
      */
+    return lts_detector(seqLen).findPeakPair(iq.data(), iq.size(), kLtsThresh);
+}
 
-    float lts_thresh = 0.8;
-    std::vector<std::vector<float>> lts_seq;
-    int best_peak;
-
-    // Original LTS sequence
-    lts_seq = CommsLib::getSequence(LTS_SEQ, seqLen);
-
-    // Re-arrange into complex vector, flip, and compute conjugate
-    const size_t lts_symbol_len = Consts::kFftSize_80211;
-    std::vector<std::complex<float>> lts_sym(lts_symbol_len);
-    std::vector<std::complex<float>> lts_sym_conj(lts_sym.size());
-    for (size_t i = 0; i < lts_sym.size(); i++) {
-        // lts_seq is a 2x160 matrix (real/imag by seqLen=160 elements)
-        // grab one symbol and flip around
-        lts_sym[i] = std::complex<float>(
-            lts_seq[0][seqLen - 1 - i], lts_seq[1][seqLen - 1 - i]);
-        // conjugate
-        lts_sym_conj[i] = std::conj(lts_sym[i]);
-    }
-
-    // Equivalent to numpy's sign function
-    auto iq_sign = CommsLib::csign(iq);
-
-    // Convolution
-    auto lts_corr = CommsLib::convolve(iq_sign, lts_sym_conj);
-    std::vector<float> lts_corr_abs(lts_corr.size());
-    std::transform(
-        lts_corr.begin(), lts_corr.end(), lts_corr_abs.begin(), computeAbs);
-    double lts_limit = lts_thresh
-        * *std::max_element(lts_corr_abs.begin(), lts_corr_abs.end());
-
-    // Find all peaks, and pairs that are lts_sym.size() samples apart
-    std::queue<int> valid_peaks;
-    for (size_t i = lts_sym.size(); i < lts_corr.size(); i++) {
-        if (lts_corr_abs[i] > lts_limit
-            && lts_corr_abs[i - lts_sym.size()] > lts_limit)
-            valid_peaks.push(i - lts_sym.size());
-    }
-
-    // Use first LTS found
-    if (valid_peaks.empty()) {
-        best_peak = -1;
-    } else {
-        best_peak = valid_peaks.front();
-    }
-
-    return best_peak;
+std::vector<int> CommsLib::findLTS(
+    const std::vector<std::vector<std::complex<float>>>& iq, int seqLen)
+{
+    return lts_detector(seqLen).findPeakPair(iq, kLtsThresh);
 }
 
 size_t CommsLib::find_pilot_seq(const std::vector<std::complex<float>>& iq,
     const std::vector<std::complex<float>>& pilot, size_t seq_len)
 {
-
-    // Re-arrange into complex vector, flip, and compute conjugate
-    std::vector<std::complex<float>> pilot_conj;
-    for (size_t i = 0; i < seq_len; i++) {
-        // conjugate
-        pilot_conj.push_back(std::conj(pilot[seq_len - i - 1]));
-    }
-
-    // Equivalent to numpy's sign function
-    auto iq_sign = CommsLib::csign(iq);
-
-    // Convolution
-    auto pilot_corr = CommsLib::convolve(iq_sign, pilot_conj);
-
-    std::vector<float> pilot_corr_abs(pilot_corr.size());
-    for (size_t i = 0; i < pilot_corr_abs.size(); i++)
-        pilot_corr_abs[i] = computePower(pilot_corr[i]);
-
-    // Find all peaks
-    auto best_peak
-        = std::max_element(pilot_corr_abs.begin(), pilot_corr_abs.end())
-        - pilot_corr_abs.begin();
-    return best_peak;
+    // Clients look for the same pilot every time
+    static thread_local std::unique_ptr<SequenceDetector> detector;
+    std::vector<std::complex<float>> seq(
+        pilot.begin(), pilot.begin() + seq_len);
+    if ((detector == nullptr) || (detector->matches(seq) == false))
+        detector.reset(new SequenceDetector(seq));
+    return detector->findMaxPeak(iq.data(), iq.size());
 }
 
 int CommsLib::find_beacon(const std::vector<std::complex<float>>& iq)
@@ -222,16 +195,8 @@ std::vector<std::complex<float>> CommsLib::csign(
      * where sign(x) is given by
      *     -1 if x < 0, 0 if x==0, 1 if x > 0
      */
-    std::vector<std::complex<float>> iq_sign;
-    for (int i = 0; i < static_cast<int>(iq.size()); i++) {
-        // sign(x.real) + 0j if x.real != 0 else sign(x.imag) + 0j
-        std::complex<float> x = iq[i];
-        if (x.real() != 0) {
-            iq_sign.push_back((x.real() > 0) ? 1 : (x.real() < 0) ? -1 : 0);
-        } else {
-            iq_sign.push_back((x.imag() > 0) ? 1 : (x.imag() < 0) ? -1 : 0);
-        }
-    }
+    std::vector<std::complex<float>> iq_sign(iq.size());
+    kernels().csign(iq.data(), iq.size(), iq_sign.data());
     return iq_sign;
 }
 
@@ -419,20 +384,93 @@ std::vector<size_t> CommsLib::getPilotScIndex(
     return pilot_sc;
 }
 
+namespace {
+// A muFFT plan with aligned blocks staging the vector and in place
+// transforms
+struct FftPlan {
+    FftPlan(size_t size, int direction)
+        : plan(mufft_create_plan_1d_c2c(size, direction, MUFFT_FLAG_CPU_ANY))
+        , input(static_cast<std::complex<float>*>(
+              mufft_alloc(size * sizeof(std::complex<float>))))
+        , output(static_cast<std::complex<float>*>(
+              mufft_alloc(size * sizeof(std::complex<float>))))
+    {
+    }
+    ~FftPlan()
+    {
+        if (plan != nullptr)
+            mufft_free_plan_1d(plan);
+        mufft_free(input);
+        mufft_free(output);
+    }
+    FftPlan(const FftPlan&) = delete;
+    FftPlan& operator=(const FftPlan&) = delete;
+
+    mufft_plan_1d* plan;
+    std::complex<float>* input;
+    std::complex<float>* output;
+};
+}
+
+// muFFT plans use internal scratch memory while executing, so they can't
+// be shared between threads. Each thread caches its own, freed on exit.
+static FftPlan& fft_plan(size_t size, int direction)
+{
+    static thread_local std::map<std::pair<size_t, int>,
+        std::unique_ptr<FftPlan>>
+        plans;
+    std::unique_ptr<FftPlan>& plan = plans[std::make_pair(size, direction)];
+    if (plan == nullptr) {
+        plan.reset(new FftPlan(size, direction));
+        if ((plan->plan == nullptr) || (plan->input == nullptr)
+            || (plan->output == nullptr)) {
+            plan.reset();
+            throw std::runtime_error(
+                "Failed to create FFT plan of size " + std::to_string(size));
+        }
+    }
+    return *plan;
+}
+
+static void fft_execute(const std::complex<float>* in,
+    std::complex<float>* out, size_t fftSize, size_t count, int direction)
+{
+    FftPlan& plan = fft_plan(fftSize, direction);
+    size_t bytes = fftSize * sizeof(std::complex<float>);
+    for (size_t i = 0; i < count; i++) {
+        const std::complex<float>* src = in + i * fftSize;
+        std::complex<float>* dst = out + i * fftSize;
+        // muFFT does not transform in place
+        if (src == dst) {
+            memcpy(plan.input, src, bytes);
+            src = plan.input;
+        }
+        mufft_execute_plan_1d(plan.plan, dst, src);
+    }
+}
+
+void CommsLib::FFT(const std::complex<float>* in, std::complex<float>* out,
+    size_t fftSize, size_t count)
+{
+    fft_execute(in, out, fftSize, count, MUFFT_FORWARD);
+}
+
+void CommsLib::IFFT(const std::complex<float>* in, std::complex<float>* out,
+    size_t fftSize, size_t count)
+{
+    fft_execute(in, out, fftSize, count, MUFFT_INVERSE);
+}
+
 std::vector<std::complex<float>> CommsLib::IFFT(
     const std::vector<std::complex<float>>& in, int fftSize, float scale,
     bool normalize)
 {
     std::vector<std::complex<float>> out(in.size());
 
-    void* fft_in = mufft_alloc(fftSize * sizeof(std::complex<float>));
-    void* fft_out = mufft_alloc(fftSize * sizeof(std::complex<float>));
-    mufft_plan_1d* mufftplan
-        = mufft_create_plan_1d_c2c(fftSize, MUFFT_INVERSE, MUFFT_FLAG_CPU_ANY);
-
-    memcpy(fft_in, in.data(), fftSize * sizeof(std::complex<float>));
-    mufft_execute_plan_1d(mufftplan, fft_out, fft_in);
-    memcpy(out.data(), fft_out, fftSize * sizeof(std::complex<float>));
+    FftPlan& plan = fft_plan(fftSize, MUFFT_INVERSE);
+    memcpy(plan.input, in.data(), fftSize * sizeof(std::complex<float>));
+    mufft_execute_plan_1d(plan.plan, plan.output, plan.input);
+    memcpy(out.data(), plan.output, fftSize * sizeof(std::complex<float>));
     float max_val = 1;
     if (normalize) {
         for (int i = 0; i < fftSize; i++) {
@@ -447,93 +485,170 @@ std::vector<std::complex<float>> CommsLib::IFFT(
     for (int i = 0; i < fftSize; i++)
         out[i] = (out[i] / max_val) * scale;
 
-    mufft_free_plan_1d(mufftplan);
-    mufft_free(fft_in);
-    mufft_free(fft_out);
     return out;
 }
 
+// Shortest signal correlated by FFT blocks, the shortest sequence depends
+// on how fast the kernels correlate directly
+static constexpr size_t kFftCorrMinLength = 2048;
+
+bool CommsLib::use_fft_correlation(size_t length, size_t seq_len)
+{
+    return (seq_len >= kernels().fft_corr_min_seq_len)
+        && (length >= kFftCorrMinLength);
+}
+
+std::vector<std::complex<float>> CommsLib::correlate_fft(
+    std::vector<std::complex<float>> const& f,
+    std::vector<std::complex<float>> const& g)
+{
+    // Clients search for the same gold sequence every time, so its
+    // spectrum and the block buffers are only set up again when g changes
+    static thread_local std::unique_ptr<FftCorrelator> correlator;
+    if ((correlator == nullptr) || (correlator->matches(g) == false))
+        correlator.reset(new FftCorrelator(g));
+    return correlator->correlate(f);
+}
+
 std::vector<std::complex<float>> CommsLib::FFT(
     const std::vector<std::complex<float>>& in, int fftSize)
 {
     std::vector<std::complex<float>> out(in.size());
 
-    void* fft_in = mufft_alloc(fftSize * sizeof(std::complex<float>));
-    void* fft_out = mufft_alloc(fftSize * sizeof(std::complex<float>));
-    mufft_plan_1d* mufftplan
-        = mufft_create_plan_1d_c2c(fftSize, MUFFT_FORWARD, MUFFT_FLAG_CPU_ANY);
+    FftPlan& plan = fft_plan(fftSize, MUFFT_FORWARD);
+    memcpy(plan.input, in.data(), fftSize * sizeof(std::complex<float>));
+    mufft_execute_plan_1d(plan.plan, plan.output, plan.input);
+    memcpy(out.data(), plan.output, fftSize * sizeof(std::complex<float>));
+    return out;
+}
+
+// Square QAM axis with the given labels from the lowest level up, the
+// levels being the odd multiples of scale
+static constexpr QamAxis make_qam_axis(
+    int bits, float scale, const int32_t (&labels)[8])
+{
+    QamAxis axis {};
+    int count = 1 << bits;
+    axis.bits = bits;
+    for (int k = 0; k < count; k++) {
+        axis.labels[k] = labels[k];
+        axis.levels[labels[k]] = (2 * k - count + 1) * scale;
+    }
+    for (int k = 1; k < count; k++)
+        axis.thresholds[k - 1] = (2 * k - count) * scale;
+    return axis;
+}
 
-    memcpy(fft_in, in.data(), fftSize * sizeof(std::complex<float>));
-    mufft_execute_plan_1d(mufftplan, fft_out, fft_in);
-    memcpy(out.data(), fft_out, fftSize * sizeof(std::complex<float>));
+// Unit average power, scaled by 1 / sqrt(2), 1 / sqrt(10) and 1 / sqrt(42)
+static constexpr QamAxis kQpskAxis
+    = make_qam_axis(1, 0.707106781186547524f, { 0, 1 });
+static constexpr QamAxis kQam16Axis
+    = make_qam_axis(2, 0.316227766016837933f, { 0, 1, 3, 2 });
+static constexpr QamAxis kQam64Axis
+    = make_qam_axis(3, 0.154303349962091910f, { 0, 1, 2, 3, 4, 5, 6, 7 });
 
-    mufft_free_plan_1d(mufftplan);
-    mufft_free(fft_in);
-    mufft_free(fft_out);
-    return out;
+const QamAxis* CommsLib::qamAxis(int type)
+{
+    switch (type) {
+    case QPSK:
+        return &kQpskAxis;
+    case QAM16:
+        return &kQam16Axis;
+    case QAM64:
+        return &kQam64Axis;
+    default:
+        return nullptr;
+    }
 }
 
-std::vector<std::complex<float>> CommsLib::modulate(
-    std::vector<uint8_t> in, int type)
+static const QamAxis* supported_axis(int type)
 {
-    std::vector<std::complex<float>> out(in.size());
-    if (type == QPSK) {
-        float qpsk_table[2][4]; // = init_qpsk();
-        float scale = 1 / sqrt(2);
-        float mod_qpsk[2] = { -scale, scale };
-        for (int i = 0; i < 4; i++) {
-            qpsk_table[0][i] = mod_qpsk[i / 2];
-            qpsk_table[1][i] = mod_qpsk[i % 2];
-        }
-        for (size_t i = 0; i < in.size(); i++) {
-            if (in[i] < 4u)
-                out[i] = std::complex<float>(
-                    qpsk_table[0][in[i]], qpsk_table[1][in[i]]);
-            else {
-                std::cout << "Error: No compatible input vector!" << std::endl;
-                break;
-            }
-        }
-    } else if (type == QAM16) {
-        float qam16_table[2][16]; //= init_qam16();
-        float scale = 1 / sqrt(10);
-        float mod_16qam[4] = { -3 * scale, -1 * scale, 3 * scale, scale };
-        for (int i = 0; i < 16; i++) {
-            qam16_table[0][i] = mod_16qam[i / 4];
-            qam16_table[1][i] = mod_16qam[i % 4];
-        }
-        for (size_t i = 0; i < in.size(); i++) {
-            if (in[i] < 16u)
-                out[i] = std::complex<float>(
-                    qam16_table[0][in[i]], qam16_table[1][in[i]]);
-            else {
-                std::cout << "Error: No compatible input vector!" << std::endl;
-                break;
-            }
-        }
-    } else if (type == QAM64) {
-        float qam64_table[2][64]; // = init_qam64();
-        float scale = 1 / sqrt(42);
-        float mod_64qam[8] = { -7 * scale, -5 * scale, -3 * scale, -1 * scale,
-            scale, 3 * scale, 5 * scale, 7 * scale };
-        for (int i = 0; i < 64; i++) {
-            qam64_table[0][i] = mod_64qam[i / 8];
-            qam64_table[1][i] = mod_64qam[i % 8];
-        }
-        for (size_t i = 0; i < in.size(); i++) {
-            if (in[i] < 64u)
-                out[i] = std::complex<float>(
-                    qam64_table[0][in[i]], qam64_table[1][in[i]]);
-            else {
-                std::cout << "Error: No compatible input vector!" << std::endl;
-                break;
-            }
-        }
-    } else {
+    const QamAxis* axis = CommsLib::qamAxis(type);
+    if (axis == nullptr) {
         // Not Supported
         std::cout << "Modulation Type " << type << " not supported!"
                   << std::endl;
     }
+    return axis;
+}
+
+std::vector<std::complex<float>> CommsLib::modulate(
+    std::vector<uint8_t> in, int type)
+{
+    std::vector<std::complex<float>> out(in.size());
+    modulate(in.data(), in.size(), type, out.data());
+    return out;
+}
+
+void CommsLib::modulate(
+    const uint8_t* in, size_t length, int type, std::complex<float>* out)
+{
+    const QamAxis* axis = supported_axis(type);
+    if (axis == nullptr)
+        return;
+
+    // The labels all fit in type bits when their OR does
+    uint8_t label_bits = 0;
+    for (size_t i = 0; i < length; i++)
+        label_bits |= in[i];
+    size_t valid = length;
+    if ((label_bits >> type) != 0) {
+        valid = std::find_if(in, in + length,
+                    [type](uint8_t label) { return (label >> type) != 0; })
+            - in;
+        std::cout << "Error: No compatible input vector!" << std::endl;
+    }
+    kernels().qam_modulate(in, valid, *axis, out);
+}
+
+std::vector<uint8_t> CommsLib::demodulate(
+    const std::vector<std::complex<float>>& in, int type)
+{
+    std::vector<uint8_t> out(in.size());
+    demodulate(in.data(), in.size(), type, out.data());
+    return out;
+}
+
+void CommsLib::demodulate(
+    const std::complex<float>* in, size_t length, int type, uint8_t* out)
+{
+    const QamAxis* axis = supported_axis(type);
+    if (axis != nullptr)
+        kernels().qam_demod_hard(in, length, *axis, out);
+}
+
+std::vector<std::vector<uint8_t>> CommsLib::demodulate(
+    const std::vector<std::vector<std::complex<float>>>& in, int type)
+{
+    std::vector<std::vector<uint8_t>> out(in.size());
+    for (size_t i = 0; i < in.size(); i++)
+        out[i] = demodulate(in[i], type);
+    return out;
+}
+
+std::vector<float> CommsLib::demodulateSoft(
+    const std::vector<std::complex<float>>& in, int type, float noiseVar)
+{
+    std::vector<float> out(in.size() * type);
+    demodulateSoft(in.data(), in.size(), type, noiseVar, out.data());
+    return out;
+}
+
+void CommsLib::demodulateSoft(const std::complex<float>* in, size_t length,
+    int type, float noiseVar, float* out)
+{
+    const QamAxis* axis = supported_axis(type);
+    if (axis != nullptr)
+        kernels().qam_demod_soft(in, length, *axis, 1 / noiseVar, out);
+}
+
+std::vector<std::vector<float>> CommsLib::demodulateSoft(
+    const std::vector<std::vector<std::complex<float>>>& in, int type,
+    float noiseVar)
+{
+    std::vector<std::vector<float>> out(in.size());
+    for (size_t i = 0; i < in.size(); i++)
+        out[i] = demodulateSoft(in[i], type, noiseVar);
     return out;
 }
 
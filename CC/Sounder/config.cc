@@ -20,6 +20,8 @@ static size_t kMaxSupportedFFTSize = 2048;
 static size_t kMinSupportedFFTSize = 64;
 static size_t kMaxSupportedCPSize = 128;
 
+const Config::SymbolInfo Config::kGuardSymbol = { SymbolType::kGuard, 0 };
+
 Config::Config(const std::string& jsonfile, const std::string& directory)
 {
     std::string conf;
@@ -76,13 +78,23 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
         beacon_seq_ = tddConf.value("beacon_seq", "gold_ifft");
         pilot_seq_ = tddConf.value("pilot_seq", "lts");
         data_mod_ = tddConf.value("modulation", "QPSK");
+        sim_mode_ = tddConf.value("simulation", false);
+        sim_max_speed_ = tddConf.value("sim_max_speed", false);
+        sim_noise_level_ = tddConf.value("sim_noise_level", 0.001);
+        telemetry_ = tddConf.value("telemetry", "");
+        telemetry_period_ms_ = tddConf.value("telemetry_period_ms", 1000);
 
         // BS
         if (kUseUHD == false) {
             hub_file_ = tddConf.value("hub_id", "hub_serials.txt");
         }
         auto sdr_id_files = tddConf.value("sdr_id", json::array());
-        num_cells_ = sdr_id_files.size();
+        // Simulated radios may be given as a number of SDRs per cell
+        // instead of serial files
+        auto sim_sdr_num = tddConf.value("sim_sdr_num", json::array());
+        bool sim_sdr_gen
+            = (sim_mode_ == true) && (sim_sdr_num.empty() == false);
+        num_cells_ = sim_sdr_gen ? sim_sdr_num.size() : sdr_id_files.size();
         bs_sdr_file_.assign(sdr_id_files.begin(), sdr_id_files.end());
         bs_channel_ = tddConf.value("channel", "A");
         if ((bs_channel_ != "A") && (bs_channel_ != "B")
@@ -120,6 +132,12 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
 
         sample_cal_en_ = tddConf.value("sample_calibrate", false);
         imbalance_cal_en_ = tddConf.value("imbalance_calibrate", false);
+        dciq_optimizer_ = tddConf.value("dciq_optimizer", "golden");
+        if ((dciq_optimizer_ != "golden")
+            && (dciq_optimizer_ != "exhaustive")) {
+            throw std::invalid_argument(
+                "dciq_optimizer must be golden or exhaustive");
+        }
         beam_sweep_ = tddConf.value("beamsweep", false);
         beacon_ant_ = tddConf.value("beacon_antenna", 0);
         max_frame_ = tddConf.value("max_frame", 0);
@@ -130,7 +148,14 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
         n_bs_antennas_.resize(num_cells_);
         num_bs_sdrs_all_ = 0;
         for (size_t i = 0u; i < num_cells_; i++) {
-            Utils::loadDevices(bs_sdr_file_.at(i), bs_sdr_ids_.at(i));
+            if (sim_sdr_gen == true) {
+                size_t num_sdrs = sim_sdr_num.at(i).get<size_t>();
+                for (size_t j = 0; j < num_sdrs; j++)
+                    bs_sdr_ids_.at(i).push_back("SIM-BS-" + std::to_string(i)
+                        + "-" + std::to_string(j));
+            } else {
+                Utils::loadDevices(bs_sdr_file_.at(i), bs_sdr_ids_.at(i));
+            }
             n_bs_sdrs_.at(i) = bs_sdr_ids_.at(i).size();
             n_bs_antennas_.at(i) = bs_channel_.length() * n_bs_sdrs_.at(i);
             num_bs_sdrs_all_ += bs_sdr_ids_.at(i).size();
@@ -146,7 +171,7 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
             n_bs_sdrs_agg_.at(i + 1) = n_bs_sdrs_agg_.at(i) + n_bs_sdrs_.at(i);
         }
 
-        if (kUseUHD == false)
+        if ((kUseUHD == false) && (sim_mode_ == false))
             Utils::loadDevices(hub_file_, hub_ids_);
         reciprocal_calib_ = tddConf.value("reciprocal_calibration", false);
         cal_ref_sdr_id_ = tddConf.value("ref_sdr_index", num_bs_sdrs_all_ - 1);
@@ -202,6 +227,8 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
         }
     }
 
+    buildSymbolTable();
+
     MLPD_TRACE("Starting clients -- %zu", num_bs_sdrs_all_);
 
     // Clients
@@ -224,6 +251,10 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
         hw_framer_ = tddConfCl.value("hw_framer", true);
         tx_advance_ = tddConfCl.value("tx_advance", 250); // 250
         ul_data_frame_num_ = tddConfCl.value("ul_data_frame_num", 1);
+        cl_stream_format_ = tddConfCl.value("stream_format", "cf32");
+        if ((cl_stream_format_ != "cf32") && (cl_stream_format_ != "cs16")) {
+            throw std::invalid_argument("stream_format must be cf32 or cs16");
+        }
 
         // Help verify whether gain exceeds max value
         struct compare {
@@ -293,9 +324,23 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
             symbols_per_frame_ = cl_frames_.at(0).size();
             single_gain_ = tddConfCl.value("single_gain", true);
             data_mod_ = tddConfCl.value("modulation", "QPSK");
+            sim_mode_ = tddConfCl.value("simulation", false);
+            sim_max_speed_ = tddConfCl.value("sim_max_speed", false);
+            sim_noise_level_ = tddConfCl.value("sim_noise_level", 0.001);
+            telemetry_ = tddConfCl.value("telemetry", "");
+            telemetry_period_ms_
+                = tddConfCl.value("telemetry_period_ms", 1000);
         }
     }
 
+    if ((bs_present_ == true) && (sim_mode_ == true)
+        && ((sample_cal_en_ == true) || (imbalance_cal_en_ == true))) {
+        MLPD_WARN("Calibration is not supported with simulated radios, "
+                  "disabling it\n");
+        sample_cal_en_ = false;
+        imbalance_cal_en_ = false;
+    }
+
     ul_data_sym_present_ = (reciprocal_calib_ == false)
         && ((bs_present_ && (ul_symbols_.at(0).empty() == false))
                || (client_present_ && !cl_ul_symbols_.at(0).empty()));
@@ -447,6 +492,49 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
                 + std::to_string(num_cl_antennas_) + ".hdf5";
         }
         trace_file_ = tddConf.value("trace_file", filename);
+        calib_cache_
+            = tddConf.value("calib_cache", directory + "/calib-cache.json");
+        record_batch_frames_ = tddConf.value("record_batch_frames", 1);
+        if (record_batch_frames_ == 0) {
+            MLPD_WARN("record_batch_frames must be at least 1\n");
+            record_batch_frames_ = 1;
+        }
+        record_chunk_frames_
+            = tddConf.value("record_chunk_frames", record_batch_frames_);
+        if (record_chunk_frames_ == 0)
+            record_chunk_frames_ = record_batch_frames_;
+        record_chunk_antennas_ = tddConf.value("record_chunk_antennas", 0);
+        // Either one filter chain for all datasets or a "pilot", "noise"
+        // and "data" entry each, e.g. "shuffle+deflate" or "lz4"
+        auto jCompression = tddConf.value("record_compression", json("none"));
+        if (jCompression.is_object() == true) {
+            record_pilot_compression_ = jCompression.value("pilot", "none");
+            record_noise_compression_ = jCompression.value("noise", "none");
+            record_data_compression_ = jCompression.value("data", "none");
+        } else {
+            record_pilot_compression_ = jCompression.get<std::string>();
+            record_noise_compression_ = record_pilot_compression_;
+            record_data_compression_ = record_pilot_compression_;
+        }
+        record_compression_level_
+            = tddConf.value("record_compression_level", 4);
+        record_cache_mb_ = tddConf.value("record_cache_mb", 0.0);
+        record_byte_order_ = tddConf.value("record_byte_order", "native");
+        if ((record_byte_order_ != "native") && (record_byte_order_ != "little")
+            && (record_byte_order_ != "big")) {
+            throw std::invalid_argument(
+                "record_byte_order must be native, little or big");
+        }
+        record_format_ = tddConf.value("record_format", "hdf5");
+        if ((record_format_ != "hdf5") && (record_format_ != "raw")) {
+            throw std::invalid_argument("record_format must be hdf5 or raw");
+        }
+        record_csi_ = tddConf.value("record_csi", false);
+        record_pilot_samples_
+            = tddConf.value("record_pilot_samples", !record_csi_);
+        if ((record_csi_ == true) && (record_format_ != "hdf5")) {
+            throw std::invalid_argument("record_csi needs record_format hdf5");
+        }
     }
 
     // Multi-threading settings
@@ -459,20 +547,28 @@ Config::Config(const std::string& jsonfile, const std::string& directory)
         rx_thread_num_ = (num_cores >= (2 * RX_THREAD_NUM))
             ? std::min(RX_THREAD_NUM, static_cast<int>(num_bs_sdrs_all_))
             : 1;
+        // At least one radio per rx thread
+        rx_thread_num_ = std::min<unsigned int>(
+            std::max(1u, tddConf.value("rx_thread", rx_thread_num_)),
+            num_bs_sdrs_all_);
         if (reciprocal_calib_ == true) {
             rx_thread_num_ = 2;
         }
-        if ((client_present_ == true)
-            && (num_cores
-                   < (1 + task_thread_num_ + rx_thread_num_ + num_cl_sdrs_))) {
+        size_t cl_cores = (client_present_ == true) ? num_cl_sdrs_ : 0;
+        if (num_cores < (task_thread_num_ + rx_thread_num_ + cl_cores)) {
             core_alloc_ = false;
         }
     } else {
         rx_thread_num_ = 0;
         task_thread_num_ = 0;
-        if (client_present_ && num_cores <= 1 + num_cl_sdrs_)
+        if (client_present_ && num_cores <= num_cl_sdrs_)
             core_alloc_ = false;
     }
+    // Radio control calls mostly wait on the network, so their threads
+    // are not allocated cores
+    const json& ctrlConf = (bs_present_ == true) ? tddConf : tddConfCl;
+    ctrl_thread_num_
+        = std::max<int>(1, ctrlConf.value("ctrl_thread", CTRL_THREAD_NUM));
     if ((bs_present_ == true) && (core_alloc_ == true)) {
         MLPD_INFO(
             "Allocating %d cores to receive threads ... \n", rx_thread_num_);
@@ -620,78 +716,52 @@ size_t Config::getTotNumAntennas()
 
 Config::~Config() {}
 
-int Config::getClientId(int frame_id, int symbol_id)
+void Config::buildSymbolTable(void)
 {
-    if (reciprocal_calib_)
-        return symbol_id;
-    std::vector<size_t>::iterator it;
-    int fid = frame_id % frames_.size();
-    it = find(pilot_symbols_.at(fid).begin(), pilot_symbols_.at(fid).end(),
-        symbol_id);
-    if (it != pilot_symbols_.at(fid).end()) {
-        return (it - pilot_symbols_.at(fid).begin());
+    symbol_table_.clear();
+    schedule_patterns_ = 0;
+    if (bs_present_ == false)
+        return;
+    if (reciprocal_calib_ == true) {
+        // Every received calibration symbol is a pilot indexed by symbol
+        schedule_patterns_ = 1;
+        for (size_t s = 0; s < symbols_per_frame_; s++)
+            symbol_table_.push_back({ SymbolType::kPilot, uint16_t(s) });
+        return;
     }
-    return -1;
-}
-
-int Config::getNoiseSFIndex(int frame_id, int symbol_id)
-{
-    std::vector<size_t>::iterator it;
-    int fid = frame_id % frames_.size();
-    it = find(noise_symbols_.at(fid).begin(), noise_symbols_.at(fid).end(),
-        symbol_id);
-    if (it != noise_symbols_.at(fid).end())
-        return (it - noise_symbols_.at(fid).begin());
-    return -1;
-}
 
-int Config::getUlSFIndex(int frame_id, int symbol_id)
-{
-    std::vector<size_t>::iterator it;
-    int fid = frame_id % frames_.size();
-    it = find(
-        ul_symbols_.at(fid).begin(), ul_symbols_.at(fid).end(), symbol_id);
-    if (it != ul_symbols_.at(fid).end()) {
-        return (it - ul_symbols_.at(fid).begin());
-    }
-    return -1;
-}
-
-int Config::getDlSFIndex(int frame_id, int symbol_id)
-{
-    std::vector<size_t>::iterator it;
-    int fid = frame_id % frames_.size();
-    it = find(
-        dl_symbols_.at(fid).begin(), dl_symbols_.at(fid).end(), symbol_id);
-    if (it != dl_symbols_.at(fid).end())
-        return (it - dl_symbols_.at(fid).begin());
-    return -1;
-}
-
-bool Config::isPilot(int frame_id, int symbol_id)
-{
-    try {
-        return frames_[frame_id % frames_.size()].at(symbol_id) == 'P';
-    } catch (const std::out_of_range&) {
-        return false;
-    }
-}
-
-bool Config::isNoise(int frame_id, int symbol_id)
-{
-    try {
-        return frames_[frame_id % frames_.size()].at(symbol_id) == 'N';
-    } catch (const std::out_of_range&) {
-        return false;
-    }
-}
-
-bool Config::isData(int frame_id, int symbol_id)
-{
-    try {
-        return frames_[frame_id % frames_.size()].at(symbol_id) == 'U';
-    } catch (const std::out_of_range&) {
-        return false;
+    schedule_patterns_ = frames_.size();
+    symbol_table_.resize(schedule_patterns_ * symbols_per_frame_,
+        { SymbolType::kGuard, 0 });
+    for (size_t f = 0; f < schedule_patterns_; f++) {
+        const std::string& frame = frames_.at(f);
+        size_t num_symbols = std::min(frame.size(), symbols_per_frame_);
+        uint16_t counts[6] = { 0, 0, 0, 0, 0, 0 };
+        for (size_t s = 0; s < num_symbols; s++) {
+            SymbolType type;
+            switch (frame.at(s)) {
+            case 'B':
+                type = SymbolType::kBeacon;
+                break;
+            case 'P':
+                type = SymbolType::kPilot;
+                break;
+            case 'N':
+                type = SymbolType::kNoise;
+                break;
+            case 'U':
+                type = SymbolType::kUplink;
+                break;
+            case 'D':
+                type = SymbolType::kDownlink;
+                break;
+            default:
+                type = SymbolType::kGuard;
+                break;
+            }
+            uint16_t index = counts[static_cast<size_t>(type)]++;
+            symbol_table_.at(f * symbols_per_frame_ + s) = { type, index };
+        }
     }
 }
 
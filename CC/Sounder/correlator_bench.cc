@@ -0,0 +1,159 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Compares the direct AVX correlation of a frame with the gold sequence
+ against the overlap-save FFT correlation over a range of frame sizes,
+ and find_beacon_avx against the streaming BeaconDetector on CF32 and
+ CS16 samples
+---------------------------------------------------------------------
+*/
+
+#include "include/beacon_detector.h"
+#include "include/comms-lib.h"
+#include "include/utils.h"
+#include <chrono>
+#include <gflags/gflags.h>
+#include <random>
+
+DEFINE_uint64(min_samples, 4096, "Smallest frame size in samples");
+DEFINE_uint64(max_samples, 65536, "Largest frame size in samples");
+DEFINE_uint64(iterations, 50, "Correlations timed per frame size");
+DEFINE_uint64(chunk, 1000, "Samples per buffer fed to the streaming detector");
+
+typedef std::vector<std::complex<float>> Samples;
+typedef std::vector<std::complex<int16_t>> SamplesCs16;
+
+// Microseconds per call of run on frame
+template <typename T, typename F>
+static double time_calls(const T& frame, F run)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < FLAGS_iterations; i++) {
+        auto out = run(frame);
+        asm volatile("" : : "r"(&out) : "memory");
+    }
+    std::chrono::duration<double, std::micro> elapsed
+        = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / FLAGS_iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    auto gold_ifft = CommsLib::getSequence(CommsLib::GOLD_IFFT);
+    Samples gold(gold_ifft[0].size());
+    for (size_t i = 0; i < gold.size(); i++)
+        gold[i] = std::complex<float>(gold_ifft[0][i], gold_ifft[1][i]);
+
+    std::printf("gold sequence of %zu samples, FFT blocks of %zu\n",
+        gold.size(), FftCorrelator::blockSize(gold.size()));
+    std::printf("%8s %10s %10s %9s %6s %10s %10s %10s %7s %7s %7s\n",
+        "samples",
+        "direct us", "fft us", "max err", "path", "find us", "detect us",
+        "cs16 us", "beacon", "stream", "cs16");
+
+    std::mt19937 gen(1);
+    std::normal_distribution<float> noise(0, 0.01);
+    // Beacon scaled by amplitude at offset in noise, none past the frame
+    auto make_frame = [&](size_t len, size_t offset, float amplitude) {
+        Samples frame(len);
+        for (auto& s : frame)
+            s = std::complex<float>(noise(gen), noise(gen));
+        for (size_t i = 0; i < 2 * gold.size() && offset + i < len; i++)
+            frame[offset + i] += amplitude * gold[i % gold.size()];
+        return frame;
+    };
+    bool failed = false;
+    for (size_t len = FLAGS_min_samples; len <= FLAGS_max_samples; len *= 2) {
+        // Beacon (two gold repetitions) in noise a quarter into the frame
+        size_t offset = len / 4;
+        size_t beacon_len = 2 * gold.size();
+        bool has_beacon = offset + beacon_len < len;
+        Samples frame = make_frame(len, has_beacon ? offset : len, 1.f);
+        SamplesCs16 frame_cs16(len);
+        Utils::cfloat_to_cint16(frame.data(), frame_cs16.data(), len);
+
+        double direct_us = time_calls(frame,
+            [&](const Samples& f) { return CommsLib::correlate_avx(f, gold); });
+        double fft_us = time_calls(frame,
+            [&](const Samples& f) { return CommsLib::correlate_fft(f, gold); });
+        double find_us = time_calls(frame, [&](const Samples& f) {
+            return CommsLib::find_beacon_avx(f, gold);
+        });
+        BeaconDetector detector(gold, len);
+        double detect_us = time_calls(frame, [&](const Samples& f) {
+            detector.reset();
+            return detector.process(f.data(), f.size());
+        });
+        double cs16_us = time_calls(frame_cs16, [&](const SamplesCs16& f) {
+            detector.reset();
+            return detector.process(f.data(), f.size());
+        });
+        detector.reset();
+        detector.process(frame_cs16.data(), len);
+        long long cs16_beacon = detector.peak_index();
+
+        Samples direct = CommsLib::correlate_avx(frame, gold);
+        Samples fft = CommsLib::correlate_fft(frame, gold);
+        float peak = 0;
+        float err = 0;
+        for (size_t i = 0; i < direct.size(); i++) {
+            peak = std::max(peak, std::abs(direct[i]));
+            err = std::max(err, std::abs(direct[i] - fft[i]));
+        }
+        err /= peak;
+        int beacon = CommsLib::find_beacon_avx(frame, gold);
+        const char* path = CommsLib::use_fft_correlation(len, gold.size())
+            ? "fft"
+            : "direct";
+
+        // The same frame in FLAGS_chunk sample buffers
+        BeaconDetector stream(gold, FLAGS_chunk);
+        long long stream_beacon = -1;
+        for (size_t i = 0; i < len; i += FLAGS_chunk) {
+            size_t count = std::min<size_t>(FLAGS_chunk, len - i);
+            if ((stream.process(&frame[i], count) == true)
+                && (stream_beacon < 0))
+                stream_beacon = stream.peak_sample();
+        }
+
+        std::printf("%8zu %10.1f %10.1f %9.2e %6s %10.1f %10.1f %10.1f %7d "
+                    "%7lld %7lld\n",
+            len, direct_us, fft_us, err, path, find_us, detect_us, cs16_us,
+            beacon, stream_beacon, cs16_beacon);
+        // The peak is at the end of the second repetition
+        int expected = has_beacon ? offset + beacon_len - 1 : -1;
+        if ((err > 1e-4) || (beacon != expected) || (stream_beacon != expected)
+            || (cs16_beacon != expected))
+            failed = true;
+    }
+
+    // CS16 decisions against CF32 ones on the quantized samples, down to
+    // beacons below the noise
+    size_t len = FLAGS_min_samples;
+    BeaconDetector cf32(gold, len);
+    BeaconDetector cs16(gold, len);
+    std::printf("CS16 correlation shift %d\n", cs16.cs16_shift());
+    std::printf("%10s %7s %7s\n", "amplitude", "cf32", "cs16");
+    for (float amplitude = 4; amplitude > 0.01; amplitude /= 2) {
+        Samples frame = make_frame(len, len / 4, amplitude);
+        SamplesCs16 frame_cs16(len);
+        Utils::cfloat_to_cint16(frame.data(), frame_cs16.data(), len);
+        Samples quantized = Utils::cint16_to_cfloat(frame_cs16);
+        cf32.reset();
+        cf32.process(quantized.data(), len);
+        cs16.reset();
+        cs16.process(frame_cs16.data(), len);
+        std::printf("%10.3f %7d %7d\n", amplitude, cf32.peak_index(),
+            cs16.peak_index());
+        if (cf32.peak_index() != cs16.peak_index())
+            failed = true;
+    }
+    if (failed == true) {
+        std::printf("FFT correlation or beacon detection mismatch\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Channel estimation on the data subcarriers from one received pilot
+ symbol, run by the recorder in place of storing the raw pilot samples
+---------------------------------------------------------------------
+*/
+
+#include "include/csi_extractor.h"
+#include "include/comms-kernels.h"
+#include "include/comms-lib.h"
+#include <algorithm>
+#include <stdexcept>
+
+CsiExtractor::CsiExtractor(Config* cfg)
+    : fft_size_(cfg->fft_size())
+    , samps_per_symbol_(cfg->samps_per_symbol())
+    , pilot_(cfg->fft_size())
+    , data_sc_(cfg->data_ind())
+    , inv_pilot_f_(cfg->data_ind().size())
+    , samples_(cfg->samps_per_symbol())
+    , timing_offset_(0)
+{
+    const auto& pilot_t = cfg->pilot_sym();
+    const auto& pilot_f = cfg->pilot_sym_f();
+    if ((pilot_t.at(0).size() != fft_size_)
+        || (pilot_f.at(0).size() != fft_size_)) {
+        throw std::invalid_argument(
+            "CSI extraction needs a pilot of fft_size samples");
+    }
+    size_t reps = cfg->symbol_per_subframe();
+    size_t rep_len = cfg->cp_size() + fft_size_;
+    for (size_t r = 0; r < reps; r++)
+        starts_.push_back(cfg->prefix() + r * rep_len + cfg->cp_size());
+    if (starts_.back() + fft_size_ > samps_per_symbol_) {
+        throw std::invalid_argument(
+            "The pilot does not fit samps_per_symbol for CSI extraction");
+    }
+    min_offset_ = -static_cast<int>(starts_.front());
+    max_offset_ = samps_per_symbol_ - fft_size_ - starts_.back();
+
+    for (size_t i = 0; i < fft_size_; i++)
+        pilot_[i] = std::complex<float>(pilot_t[0][i], pilot_t[1][i]);
+    for (size_t k = 0; k < data_sc_.size(); k++) {
+        std::complex<float> p(
+            pilot_f[0].at(data_sc_[k]), pilot_f[1].at(data_sc_[k]));
+        inv_pilot_f_[k] = std::norm(p) > 0
+            ? 1.f / (static_cast<float>(reps) * p)
+            : std::complex<float>(0, 0);
+    }
+
+    size_t windows = samps_per_symbol_ - fft_size_ + 1;
+    corr_.resize(windows);
+    power_.resize(windows);
+    size_t bytes = reps * fft_size_ * sizeof(std::complex<float>);
+    block_ = static_cast<std::complex<float>*>(mufft_alloc(bytes));
+    spectrum_ = static_cast<std::complex<float>*>(mufft_alloc(bytes));
+    if ((block_ == nullptr) || (spectrum_ == nullptr)) {
+        mufft_free(block_);
+        mufft_free(spectrum_);
+        throw std::runtime_error("Failed to set up the CSI extractor");
+    }
+}
+
+CsiExtractor::~CsiExtractor()
+{
+    mufft_free(block_);
+    mufft_free(spectrum_);
+}
+
+void CsiExtractor::extract(const short* iq, std::complex<float>* csi)
+{
+    const CommsKernels& kernels = CommsLib::kernels();
+    for (size_t i = 0; i < samps_per_symbol_; i++) {
+        samples_[i] = std::complex<float>(
+            iq[2 * i] / 32768.f, iq[2 * i + 1] / 32768.f);
+    }
+
+    // Correlation of the window starting at each sample with the pilot
+    kernels.correlate_cf32(samples_.data(), corr_.size(), pilot_.data(),
+        fft_size_, corr_.data());
+    kernels.abs2_cf32(corr_.data(), corr_.size(), power_.data());
+    float best = 0;
+    timing_offset_ = 0;
+    for (int d = min_offset_; d <= max_offset_; d++) {
+        float sum = 0;
+        for (size_t start : starts_)
+            sum += power_[start + d];
+        if (sum > best) {
+            best = sum;
+            timing_offset_ = d;
+        }
+    }
+
+    for (size_t r = 0; r < starts_.size(); r++) {
+        std::copy_n(samples_.begin() + starts_[r] + timing_offset_, fft_size_,
+            block_ + r * fft_size_);
+    }
+    CommsLib::FFT(block_, spectrum_, fft_size_, starts_.size());
+    for (size_t k = 0; k < data_sc_.size(); k++) {
+        std::complex<float> sum = 0;
+        for (size_t r = 0; r < starts_.size(); r++)
+            sum += spectrum_[r * fft_size_ + data_sc_[k]];
+        csi[k] = sum * inv_pilot_f_[k];
+    }
+}
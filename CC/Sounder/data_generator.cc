@@ -1,16 +1,202 @@
 #include "include/data_generator.h"
 #include "include/comms-lib.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
 
-void DataGenerator::GenerateData(const std::string& directory)
+typedef std::unique_ptr<std::complex<float>[], decltype(&std::free)>
+    AlignedSamples;
+
+// Bytes of time domain samples a thread generates before writing them
+static constexpr size_t kChunkBytes = 4 << 20;
+
+// Zeroed samples aligned for the pointer IFFT
+static AlignedSamples alloc_samples(size_t count)
+{
+    size_t bytes = count * sizeof(std::complex<float>);
+    bytes = (bytes + kFftAlignment - 1) / kFftAlignment * kFftAlignment;
+    auto* samples = static_cast<std::complex<float>*>(
+        std::aligned_alloc(kFftAlignment, bytes));
+    if (samples == nullptr)
+        throw std::bad_alloc();
+    std::fill(samples, samples + count, 0);
+    return AlignedSamples(samples, &std::free);
+}
+
+// SplitMix64, restarted for every client and frame
+class FrameRng {
+public:
+    FrameRng(uint64_t seed, size_t client, size_t frame)
+        : state_(seed ^ (client * 0xd1b54a32d192ed03ull)
+              ^ (frame * 0x8cb92ba72f3d8dd7ull))
+    {
+    }
+
+    inline uint64_t next(void)
+    {
+        uint64_t z = (state_ += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    uint64_t state_;
+};
+
+static void write_at(int fd, const void* data, size_t bytes, size_t offset)
+{
+    const char* buf = static_cast<const char*>(data);
+    while (bytes > 0) {
+        ssize_t written = pwrite(fd, buf, bytes, offset);
+        if (written < 0) {
+            throw std::runtime_error(
+                "UL data write failed: " + std::string(strerror(errno)));
+        }
+        buf += written;
+        bytes -= written;
+        offset += written;
+    }
+}
+
+DataGenerator::DataGenerator(Config* cfg, uint64_t seed, size_t num_threads)
+    : cfg_(cfg)
+    , seed_(seed)
+    , num_threads_(num_threads)
+{
+    if (this->seed_ == 0) {
+        this->seed_ = std::chrono::system_clock::now().time_since_epoch()
+                          .count();
+    }
+    if (this->num_threads_ == 0)
+        this->num_threads_ = std::max(1u, std::thread::hardware_concurrency());
+}
+
+void DataGenerator::generateChunks(const std::vector<Chunk>& chunks,
+    std::atomic<size_t>& next, const std::vector<int>& files)
 {
-    srand(time(NULL));
     int mod_type = cfg_->data_mod() == "64QAM"
         ? CommsLib::QAM64
         : (cfg_->data_mod() == "16QAM" ? CommsLib::QAM16 : CommsLib::QPSK);
-    int mod_order = 1 << mod_type;
+    uint8_t label_mask = (1 << mod_type) - 1;
+
+    size_t fft_size = cfg_->fft_size();
+    size_t cp_size = cfg_->cp_size();
+    size_t num_syms = cfg_->symbol_per_subframe();
+    size_t samps = cfg_->samps_per_symbol();
+    size_t num_data_sc = cfg_->data_ind().size();
+    size_t sc_num = cfg_->symbol_data_subcarrier_num();
+    // Rows of data bits per symbol, zero past the data subcarriers
+    size_t bits_stride = std::max(num_data_sc, sc_num);
+    float scale = 1.f / fft_size;
+
+    // The symbols of a chunk are modulated and transformed together in
+    // buffers grown to the largest chunk
+    size_t rows = 0;
+    std::vector<uint8_t> data_bits;
+    std::vector<uint8_t> file_bits;
+    std::vector<std::complex<float>> mod_data;
+    AlignedSamples data_freq_dom(nullptr, &std::free);
+    AlignedSamples tx_syms(nullptr, &std::free);
+    // The prefix and postfix zeros are never written
+    std::vector<std::complex<float>> data_time_dom;
+
+    for (size_t c = next++; c < chunks.size(); c = next++) {
+        const Chunk& chunk = chunks[c];
+        size_t slots = cfg_->cl_ul_symbols()[chunk.client].size()
+            * cfg_->cl_sdr_ch();
+        size_t frame_rows = slots * num_syms;
+        size_t chunk_rows = chunk.num_frames * frame_rows;
+        if (chunk_rows > rows) {
+            rows = chunk_rows;
+            data_bits.assign(rows * bits_stride, 0);
+            mod_data.resize(rows * bits_stride);
+            data_freq_dom = alloc_samples(rows * fft_size);
+            tx_syms = alloc_samples(rows * fft_size);
+            data_time_dom.assign(rows / num_syms * samps, 0);
+            for (size_t r = 0; r < rows; r++) {
+                std::complex<float>* ofdm_sym
+                    = data_freq_dom.get() + r * fft_size;
+                for (size_t p = 0; p < cfg_->pilot_sc().size(); p++) {
+                    ofdm_sym[cfg_->pilot_sc_ind().at(p)]
+                        = cfg_->pilot_sc().at(p);
+                }
+            }
+        }
+
+        for (size_t f = 0; f < chunk.num_frames; f++) {
+            FrameRng rng(this->seed_, chunk.client, chunk.first_frame + f);
+            for (size_t r = f * frame_rows; r < (f + 1) * frame_rows; r++) {
+                uint8_t* sym_bits = &data_bits[r * bits_stride];
+                for (size_t n = 0; n < num_data_sc; n += 8) {
+                    uint64_t bits = rng.next();
+                    for (size_t b = n; b < std::min(n + 8, num_data_sc); b++) {
+                        sym_bits[b] = bits & label_mask;
+                        bits >>= 8;
+                    }
+                }
+            }
+        }
+        CommsLib::modulate(data_bits.data(), chunk_rows * bits_stride,
+            mod_type, mod_data.data());
+        for (size_t r = 0; r < chunk_rows; r++) {
+            std::complex<float>* ofdm_sym = data_freq_dom.get() + r * fft_size;
+            for (size_t n = 0; n < num_data_sc; n++)
+                ofdm_sym[cfg_->data_ind()[n]] = mod_data[r * bits_stride + n];
+        }
+        CommsLib::IFFT(
+            data_freq_dom.get(), tx_syms.get(), fft_size, chunk_rows);
+        for (size_t slot = 0; slot < chunk_rows / num_syms; slot++) {
+            std::complex<float>* out
+                = data_time_dom.data() + slot * samps + cfg_->prefix();
+            for (size_t s = 0; s < num_syms; s++) {
+                const std::complex<float>* tx_sym
+                    = tx_syms.get() + (slot * num_syms + s) * fft_size;
+                // add CP
+                for (size_t n = fft_size - cp_size; n < fft_size; n++)
+                    *out++ = tx_sym[n] * scale;
+                for (size_t n = 0; n < fft_size; n++)
+                    *out++ = tx_sym[n] * scale;
+            }
+        }
 
-    std::vector<std::complex<float>> prefix_zpad_t(cfg_->prefix(), 0);
-    std::vector<std::complex<float>> postfix_zpad_t(cfg_->postfix(), 0);
+        // Frame * UL Slots * Channel * Samples, the bits file holding
+        // sc_num labels per symbol
+        const uint8_t* bits_out = data_bits.data();
+        if (bits_stride != sc_num) {
+            file_bits.resize(chunk_rows * sc_num);
+            for (size_t r = 0; r < chunk_rows; r++) {
+                std::copy_n(&data_bits[r * bits_stride], sc_num,
+                    &file_bits[r * sc_num]);
+            }
+            bits_out = file_bits.data();
+        }
+        size_t bits_bytes = frame_rows * sc_num;
+        size_t freq_bytes = frame_rows * fft_size * sizeof(float) * 2;
+        size_t time_bytes = slots * samps * sizeof(float) * 2;
+        const int* fds = &files[3 * chunk.client];
+        write_at(fds[0], bits_out, chunk.num_frames * bits_bytes,
+            chunk.first_frame * bits_bytes);
+        write_at(fds[1], data_freq_dom.get(), chunk.num_frames * freq_bytes,
+            chunk.first_frame * freq_bytes);
+        write_at(fds[2], data_time_dom.data(), chunk.num_frames * time_bytes,
+            chunk.first_frame * time_bytes);
+    }
+}
+
+void DataGenerator::GenerateData(const std::string& directory)
+{
+    size_t num_frames = cfg_->ul_data_frame_num();
+    std::vector<Chunk> chunks;
+    std::vector<int> files;
     for (size_t i = 0; i < cfg_->num_cl_sdrs(); i++) {
         std::string filename_tag = cfg_->data_mod() + "_"
             + std::to_string(cfg_->symbol_data_subcarrier_num()) + "_"
@@ -20,72 +206,59 @@ void DataGenerator::GenerateData(const std::string& directory)
             + std::to_string(cfg_->ul_data_frame_num()) + "_"
             + cfg_->cl_channel() + "_" + std::to_string(i) + ".bin";
 
-        std::string filename_ul_data_b
-            = directory + "/ul_data_b_" + filename_tag;
-        std::printf("Saving UL data bits for radio %zu to %s\n", i,
-            filename_ul_data_b.c_str());
-        FILE* fp_tx_b = std::fopen(filename_ul_data_b.c_str(), "wb");
-        std::string filename_ul_data_f
-            = directory + "/ul_data_f_" + filename_tag;
-        std::printf("Saving UL frequency-domain data for radio %zu to %s\n", i,
-            filename_ul_data_f.c_str());
-        FILE* fp_tx_f = std::fopen(filename_ul_data_f.c_str(), "wb");
-        std::string filename_ul_data_t
-            = directory + "/ul_data_t_" + filename_tag;
-        std::printf("Saving UL time-domain data for radio %zu to %s\n", i,
-            filename_ul_data_t.c_str());
-        FILE* fp_tx_t = std::fopen(filename_ul_data_t.c_str(), "wb");
-        // Frame * UL Slots * Channel * Samples
-        for (size_t f = 0; f < cfg_->ul_data_frame_num(); f++) {
-            for (size_t u = 0; u < cfg_->cl_ul_symbols()[i].size(); u++) {
-                for (size_t h = 0; h < cfg_->cl_sdr_ch(); h++) {
-                    std::vector<std::complex<float>> data_time_dom;
-                    std::vector<std::complex<float>> data_freq_dom;
-                    data_time_dom.insert(data_time_dom.begin(),
-                        prefix_zpad_t.begin(), prefix_zpad_t.end());
-                    for (size_t s = 0; s < cfg_->symbol_per_subframe(); s++) {
-                        std::vector<uint8_t> data_bits;
-                        for (size_t c = 0; c < cfg_->data_ind().size(); c++) {
-                            data_bits.push_back((uint8_t)(rand() % mod_order));
-                        }
-                        std::fwrite(data_bits.data(),
-                            cfg_->symbol_data_subcarrier_num(), sizeof(uint8_t),
-                            fp_tx_b);
-                        std::vector<std::complex<float>> mod_data
-                            = CommsLib::modulate(data_bits, mod_type);
-                        std::vector<std::complex<float>> ofdm_sym(
-                            cfg_->fft_size(), 0);
-                        size_t sc = 0;
-                        for (size_t c = 0; c < cfg_->data_ind().size(); c++) {
-                            sc = cfg_->data_ind()[c];
-                            ofdm_sym[sc] = mod_data[c];
-                        }
-                        for (size_t c = 0; c < cfg_->pilot_sc().size(); c++) {
-                            sc = cfg_->pilot_sc_ind().at(c);
-                            ofdm_sym[sc] = cfg_->pilot_sc().at(c);
-                        }
-                        auto tx_sym = CommsLib::IFFT(ofdm_sym, cfg_->fft_size(),
-                            1.f / cfg_->fft_size(), false);
-                        tx_sym.insert(tx_sym.begin(),
-                            tx_sym.end() - cfg_->cp_size(),
-                            tx_sym.end()); // add CP
-                        data_time_dom.insert(
-                            data_time_dom.end(), tx_sym.begin(), tx_sym.end());
-                        data_freq_dom.insert(data_freq_dom.end(),
-                            ofdm_sym.begin(), ofdm_sym.end());
-                    }
-                    data_time_dom.insert(data_time_dom.end(),
-                        postfix_zpad_t.begin(), postfix_zpad_t.end());
-                    std::fwrite(data_freq_dom.data(),
-                        cfg_->fft_size() * cfg_->symbol_per_subframe(),
-                        sizeof(float) * 2, fp_tx_f);
-                    std::fwrite(data_time_dom.data(), cfg_->samps_per_symbol(),
-                        sizeof(float) * 2, fp_tx_t);
-                }
+        const char* kinds[] = { "bits", "frequency-domain data",
+            "time-domain data" };
+        const char* prefixes[] = { "/ul_data_b_", "/ul_data_f_",
+            "/ul_data_t_" };
+        for (size_t k = 0; k < 3; k++) {
+            std::string filename = directory + prefixes[k] + filename_tag;
+            std::printf("Saving UL %s for radio %zu to %s\n", kinds[k], i,
+                filename.c_str());
+            int fd
+                = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                for (int f : files)
+                    close(f);
+                throw std::runtime_error(
+                    "Failed to open " + filename + ": " + strerror(errno));
             }
+            files.push_back(fd);
         }
-        std::fclose(fp_tx_b);
-        std::fclose(fp_tx_f);
-        std::fclose(fp_tx_t);
+
+        size_t slots = cfg_->cl_ul_symbols()[i].size() * cfg_->cl_sdr_ch();
+        if (slots == 0)
+            continue;
+        size_t frame_bytes
+            = slots * cfg_->samps_per_symbol() * sizeof(float) * 2;
+        size_t chunk_frames = std::max<size_t>(1, kChunkBytes / frame_bytes);
+        for (size_t f = 0; f < num_frames; f += chunk_frames)
+            chunks.push_back({ i, f, std::min(chunk_frames, num_frames - f) });
     }
+
+    // The first error of any thread is thrown once they are all done
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        try {
+            this->generateChunks(chunks, next, files);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (error == nullptr)
+                error = std::current_exception();
+            // Stops the other threads after their current chunk
+            next = chunks.size();
+        }
+    };
+    size_t num_threads = std::min(this->num_threads_, chunks.size());
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < num_threads; t++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+    for (int fd : files)
+        close(fd);
+    if (error != nullptr)
+        std::rethrow_exception(error);
 }
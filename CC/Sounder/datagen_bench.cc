@@ -0,0 +1,107 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Measures the uplink data generation of --gen_ul_bits in frames/s for
+ a range of thread counts, and checks that every thread count writes
+ the same files
+---------------------------------------------------------------------
+*/
+
+#include "include/data_generator.h"
+#include "include/utils.h"
+#include <chrono>
+#include <fstream>
+#include <gflags/gflags.h>
+
+DEFINE_string(conf, "files/conf.json", "JSON configuration file name");
+DEFINE_string(storepath, "logs", "Directory for the generated files");
+DEFINE_string(threads, "1,2,4", "Comma separated list of thread counts");
+DEFINE_uint64(seed, 1, "Seed of the generated bits");
+DEFINE_bool(keep, false, "Keep the generated files");
+
+static std::vector<size_t> parse_list(const std::string& list)
+{
+    std::vector<size_t> values;
+    for (auto& value : Utils::split(list, ','))
+        values.push_back(std::stoul(value));
+    return values;
+}
+
+// Files written by DataGenerator, named as in GenerateData
+static std::vector<std::string> data_files(Config* cfg)
+{
+    std::vector<std::string> files;
+    for (size_t i = 0; i < cfg->num_cl_sdrs(); i++) {
+        std::string filename_tag = cfg->data_mod() + "_"
+            + std::to_string(cfg->symbol_data_subcarrier_num()) + "_"
+            + std::to_string(cfg->fft_size()) + "_"
+            + std::to_string(cfg->symbol_per_subframe()) + "_"
+            + std::to_string(cfg->cl_ul_symbols()[i].size()) + "_"
+            + std::to_string(cfg->ul_data_frame_num()) + "_"
+            + cfg->cl_channel() + "_" + std::to_string(i) + ".bin";
+        for (const char* prefix : { "/ul_data_b_", "/ul_data_f_",
+                 "/ul_data_t_" })
+            files.push_back(FLAGS_storepath + prefix + filename_tag);
+    }
+    return files;
+}
+
+// FNV-1a of the file contents and their size
+static uint64_t hash_file(const std::string& filename, size_t& bytes)
+{
+    std::ifstream file(filename, std::ios::binary);
+    std::vector<char> buffer(1 << 20);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) {
+        for (std::streamsize i = 0; i < file.gcount(); i++) {
+            hash ^= static_cast<uint8_t>(buffer[i]);
+            hash *= 0x100000001b3ull;
+        }
+        bytes += file.gcount();
+    }
+    return hash;
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    Config cfg(FLAGS_conf, FLAGS_storepath);
+    std::vector<std::string> files = data_files(&cfg);
+    size_t frames = cfg.num_cl_sdrs() * cfg.ul_data_frame_num();
+
+    std::printf("%zu clients x %zu frames of %s, seed %zu\n",
+        cfg.num_cl_sdrs(), cfg.ul_data_frame_num(), cfg.data_mod().c_str(),
+        static_cast<size_t>(FLAGS_seed));
+    std::printf("%8s %10s %10s %10s %9s\n", "threads", "seconds", "frames/s",
+        "MB/s", "same");
+    std::vector<uint64_t> reference;
+    bool same_files = true;
+    for (size_t threads : parse_list(FLAGS_threads)) {
+        DataGenerator generator(&cfg, FLAGS_seed, threads);
+        auto start = std::chrono::steady_clock::now();
+        generator.GenerateData(FLAGS_storepath);
+        double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start)
+                             .count();
+
+        size_t bytes = 0;
+        std::vector<uint64_t> hashes;
+        for (auto& file : files)
+            hashes.push_back(hash_file(file, bytes));
+        if (reference.empty())
+            reference = hashes;
+        bool same = hashes == reference;
+        same_files &= same;
+        std::printf("%8zu %10.3f %10.1f %10.1f %9s\n", threads, seconds,
+            frames / seconds, bytes / seconds / 1e6, same ? "yes" : "no");
+    }
+    if (FLAGS_keep == false) {
+        for (auto& file : files)
+            std::remove(file.c_str());
+    }
+    if (same_files == false)
+        std::printf("Thread counts generated different files\n");
+    return same_files ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,134 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Search strategies for the DC offset and IQ imbalance corrections of
+ the radio calibration
+---------------------------------------------------------------------
+*/
+
+#include "include/dciq_optimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+std::unique_ptr<DciqOptimizer> DciqOptimizer::create(const std::string& name)
+{
+    if (name == "exhaustive")
+        return std::make_unique<ExhaustiveDciqOptimizer>();
+    if (name == "golden")
+        return std::make_unique<GoldenDciqOptimizer>();
+    throw std::invalid_argument(
+        "dciq_optimizer must be exhaustive or golden, not " + name);
+}
+
+DciqOptimizer::Result ExhaustiveDciqOptimizer::minimize(
+    const Measure& measure, int lo, int hi) const
+{
+    Result best = { 0, 0, 0, 0 };
+    //look through each correction arm twice
+    for (size_t iter = 0; iter < 4; iter++) {
+        int start = lo, stop = hi, step = 8;
+        if (iter == 2)
+            best.level = 0; //restart with finer search
+        if (iter > 1) { //narrow in for the final iteration set
+            const int center = ((iter % 2) == 0) ? best.x : best.y;
+            start = std::max<int>(start, center - 8);
+            stop = std::min<int>(stop, center + 8);
+            step = 1;
+        }
+        for (int i = start; i < stop; i += step) {
+            const int x = ((iter % 2) == 0) ? i : best.x;
+            const int y = ((iter % 2) == 1) ? i : best.y;
+            const float level = measure(x, y);
+            best.measurements++;
+            if (level < best.level) {
+                best.level = level;
+                best.x = x;
+                best.y = y;
+            }
+        }
+    }
+    return best;
+}
+
+// Point of [a, b] minimizing f, f being unimodal on it. Each step keeps
+// one of the two inner points and measures one new point.
+static int goldenSection(int a, int b, const std::function<float(int)>& f)
+{
+    const double kInvPhi = 0.6180339887498949;
+    int c = b - static_cast<int>(std::lround((b - a) * kInvPhi));
+    int d = a + static_cast<int>(std::lround((b - a) * kInvPhi));
+    while (b - a > 3) {
+        if (f(c) <= f(d)) {
+            b = d;
+            d = c;
+            c = b - static_cast<int>(std::lround((b - a) * kInvPhi));
+        } else {
+            a = c;
+            c = d;
+            d = a + static_cast<int>(std::lround((b - a) * kInvPhi));
+        }
+        // Rounding may leave no room for the new point
+        if ((a >= c) || (c >= d) || (d >= b)) {
+            c = a + (b - a) / 3;
+            d = b - (b - a) / 3;
+        }
+    }
+    int best = a;
+    for (int i = a + 1; i <= b; i++) {
+        if (f(i) < f(best))
+            best = i;
+    }
+    return best;
+}
+
+DciqOptimizer::Result GoldenDciqOptimizer::minimize(
+    const Measure& measure, int lo, int hi) const
+{
+    static const size_t kMaxPasses = 4;
+    // Half width of the window of the second pass, halved every pass
+    static const int kRefineWindow = 8;
+
+    Result best = { 0, 0, INFINITY, 0 };
+    // Points are measured once, the searches of a pass revisit them
+    std::map<std::pair<int, int>, float> levels;
+    auto level = [&](int x, int y) {
+        auto it = levels.find(std::make_pair(x, y));
+        if (it != levels.end())
+            return it->second;
+        float value = measure(x, y);
+        best.measurements++;
+        levels[std::make_pair(x, y)] = value;
+        if (value < best.level) {
+            best.level = value;
+            best.x = x;
+            best.y = y;
+        }
+        return value;
+    };
+
+    int x = 0;
+    int y = 0;
+    int window = hi - lo;
+    for (size_t pass = 0; pass < kMaxPasses; pass++) {
+        int x_lo = std::max(lo, x - window);
+        int x_hi = std::min(hi - 1, x + window);
+        int new_x = goldenSection(
+            x_lo, x_hi, [&](int i) { return level(i, y); });
+        int y_lo = std::max(lo, y - window);
+        int y_hi = std::min(hi - 1, y + window);
+        int new_y = goldenSection(
+            y_lo, y_hi, [&](int i) { return level(new_x, i); });
+        bool moved = (pass == 0) || (new_x != x) || (new_y != y);
+        x = new_x;
+        y = new_y;
+        if (moved == false)
+            break;
+        window = (pass == 0) ? kRefineWindow : std::max(2, window / 2);
+    }
+    return best;
+}
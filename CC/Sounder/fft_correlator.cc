@@ -0,0 +1,128 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Overlap-save correlation of a signal with a fixed sequence using
+ muFFT, producing the same output as CommsLib::correlate_avx
+---------------------------------------------------------------------
+*/
+
+#include "include/fft_correlator.h"
+#include "include/comms-lib.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// Each block of fft_size_ samples yields fft_size_ - L + 1 outputs, a
+// block 8 times the sequence keeps the overlap below 1/8 of the work
+const size_t FftCorrelator::kBlockToSeqRatio = 8;
+// Below this the plan overhead dominates the transform
+const size_t FftCorrelator::kMinFftSize = 256;
+
+size_t FftCorrelator::blockSize(size_t seq_len)
+{
+    size_t fft_size = kMinFftSize;
+    while (fft_size < kBlockToSeqRatio * seq_len)
+        fft_size *= 2;
+    return fft_size;
+}
+
+FftCorrelator::FftCorrelator(const std::vector<std::complex<float>>& seq)
+    : seq_(seq)
+    , fft_size_(blockSize(seq.size()))
+{
+    if (seq.empty() == true)
+        throw std::invalid_argument("Correlation sequence is empty");
+
+    size_t bytes = fft_size_ * sizeof(std::complex<float>);
+    seq_spectrum_ = static_cast<std::complex<float>*>(mufft_alloc(bytes));
+    block_ = static_cast<std::complex<float>*>(mufft_alloc(bytes));
+    spectrum_ = static_cast<std::complex<float>*>(mufft_alloc(bytes));
+    if ((seq_spectrum_ == nullptr) || (block_ == nullptr)
+        || (spectrum_ == nullptr)) {
+        release();
+        throw std::runtime_error("Failed to set up the FFT correlator");
+    }
+
+    std::fill(block_, block_ + fft_size_, 0);
+    std::copy(seq.begin(), seq.end(), block_);
+    CommsLib::FFT(block_, seq_spectrum_, fft_size_);
+    float scale = 1.f / fft_size_;
+    for (size_t i = 0; i < fft_size_; i++)
+        seq_spectrum_[i] = std::conj(seq_spectrum_[i]) * scale;
+}
+
+FftCorrelator::~FftCorrelator() { release(); }
+
+void FftCorrelator::release(void)
+{
+    mufft_free(seq_spectrum_);
+    mufft_free(block_);
+    mufft_free(spectrum_);
+}
+
+bool FftCorrelator::matches(const std::vector<std::complex<float>>& seq) const
+{
+    return seq == this->seq_;
+}
+
+void FftCorrelator::correlate(
+    const std::complex<float>* f, size_t length, std::complex<float>* out)
+{
+    // Works on the signal with L - 1 leading zeros like correlate_avx
+    size_t pad = seq_.size() - 1;
+    size_t valid = length > 0 ? length - 1 : 0;
+    correlateBlocks(f, length, pad, valid, out);
+    std::fill(out + valid, out + length + pad, 0);
+}
+
+void FftCorrelator::correlateValid(
+    const std::complex<float>* f, size_t length, std::complex<float>* out)
+{
+    if (length >= seq_.size())
+        correlateBlocks(f, length, 0, length - seq_.size() + 1, out);
+}
+
+void FftCorrelator::correlateBlocks(const std::complex<float>* f,
+    size_t length, size_t lead_zeros, size_t count, std::complex<float>* out)
+{
+    // Output k correlates samples [k, k + L) of f preceded by lead_zeros
+    // zeros with the sequence
+    size_t step = fft_size_ - seq_.size() + 1;
+    const float* spec = reinterpret_cast<const float*>(seq_spectrum_);
+    float* bins = reinterpret_cast<float*>(spectrum_);
+
+    for (size_t start = 0; start < count; start += step) {
+        // padded samples [start, start + fft_size_) hold f[first, last)
+        size_t first = start > lead_zeros ? start - lead_zeros : 0;
+        size_t last = std::min(start + fft_size_ - lead_zeros, length);
+        size_t lead = first + lead_zeros - start;
+        std::fill(block_, block_ + lead, 0);
+        std::memcpy(
+            block_ + lead, f + first, (last - first) * sizeof(*block_));
+        std::fill(block_ + lead + last - first, block_ + fft_size_, 0);
+
+        CommsLib::FFT(block_, spectrum_, fft_size_);
+        // Written out to keep std::complex's NaN handling off this loop
+        for (size_t i = 0; i < 2 * fft_size_; i += 2) {
+            float re = bins[i] * spec[i] - bins[i + 1] * spec[i + 1];
+            float im = bins[i] * spec[i + 1] + bins[i + 1] * spec[i];
+            bins[i] = re;
+            bins[i + 1] = im;
+        }
+        CommsLib::IFFT(spectrum_, block_, fft_size_);
+
+        // Outputs past fft_size_ - L wrap around the block
+        size_t outputs = std::min(step, count - start);
+        std::memcpy(out + start, block_, outputs * sizeof(*out));
+    }
+}
+
+std::vector<std::complex<float>> FftCorrelator::correlate(
+    const std::vector<std::complex<float>>& f)
+{
+    std::vector<std::complex<float>> out(f.size() + seq_.size() - 1);
+    correlate(f.data(), f.size(), out.data());
+    return out;
+}
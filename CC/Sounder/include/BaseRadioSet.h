@@ -1,3 +1,4 @@
+#include "calibration_cache.h"
 #include "config.h"
 #include <SoapySDR/Device.hpp>
 #include <chrono>
@@ -8,6 +9,7 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 
 class Radio;
@@ -29,23 +31,17 @@ public:
     bool getRadioNotFound() { return radioNotFound; }
 
 private:
-    // use for create pthread
-    struct BaseRadioContext {
-        BaseRadioSet* brs;
-        std::atomic_ulong* thread_count;
-        size_t tid;
-        size_t cell;
-    };
-    void init(BaseRadioContext* context);
-    void configure(BaseRadioContext* context);
-
-    static void* init_launch(void* in_context);
-    static void* configure_launch(void* in_context);
+    // Bring up radio i of cell c on a pool thread, return the seconds
+    // it took
+    double init(size_t c, size_t i);
+    double configure(size_t c, size_t i);
 
     void radioTrigger(void);
     void sync_delays(size_t cellIdx);
     SoapySDR::Device* baseRadio(size_t cellId);
-    void collectCSI(bool&);
+    void collectCSI(bool&, std::vector<int>&);
+    bool restoreDelays(std::vector<int>&);
+    void storeDelays(const std::vector<int>&);
     void dciqCalibrationProc(size_t);
     void readSensors(void);
 
@@ -53,4 +49,6 @@ private:
     std::vector<SoapySDR::Device*> hubs;
     std::vector<std::vector<Radio*>> bsRadios; // [cell, iris]
     bool radioNotFound;
+    // Calibration results of previous runs, null when disabled
+    std::unique_ptr<CalibrationCache> calCache;
 };
@@ -21,13 +21,8 @@ public:
     bool getRadioNotFound() { return radioNotFound; }
 
 private:
-    struct ClientRadioContext {
-        ClientRadioSet* crs;
-        std::atomic_ulong* thread_count;
-        size_t tid;
-    };
-    void init(ClientRadioContext* context);
-    static void* init_launch(void* in_context);
+    // Brings up radio i on a pool thread, returns the seconds it took
+    double init(size_t i);
 
     Config* _cfg;
     std::vector<Radio*> radios;
@@ -13,6 +13,7 @@ private:
     SoapySDR::Device* dev;
     SoapySDR::Stream* rxs;
     SoapySDR::Stream* txs;
+    bool sim_;
     void reset_DATA_clk_domain(void);
     void dev_init(Config* _cfg, int ch, double rxgain, double txgain);
     friend class ClientRadioSet;
@@ -20,8 +21,9 @@ private:
 
 public:
     Radio(const SoapySDR::Kwargs& args, const char soapyFmt[],
-        const std::vector<size_t>& channels, double rate);
+        const std::vector<size_t>& channels, double rate, Config* cfg);
     ~Radio(void);
+    // Samples read, 0 once the radio ended the stream, < 0 on errors
     int recv(void* const* buffs, int samples, long long& frameTime);
     int activateRecv(
         const long long rxTime = 0, const size_t numSamps = 0, int flags = 0);
@@ -0,0 +1,101 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Simulated SoapySDR device producing timestamped frames from the
+ Config schedule, used to load-test Sounder without Iris hardware
+---------------------------------------------------------------------
+*/
+
+#ifndef SIM_DEVICE_H_
+#define SIM_DEVICE_H_
+
+#include "config.h"
+#include <SoapySDR/Device.hpp>
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <string>
+#include <vector>
+
+class SimDevice : public SoapySDR::Device {
+public:
+    // args: "serial", "cell", "radio" and "mode" ("bs" or "client")
+    SimDevice(Config* cfg, const SoapySDR::Kwargs& args);
+    ~SimDevice(void);
+
+    std::string getDriverKey(void) const override;
+    std::string getHardwareKey(void) const override;
+    SoapySDR::Kwargs getHardwareInfo(void) const override;
+    size_t getNumChannels(const int direction) const override;
+    void setSampleRate(
+        const int direction, const size_t channel, const double rate) override;
+    double getSampleRate(
+        const int direction, const size_t channel) const override;
+
+    SoapySDR::Stream* setupStream(const int direction,
+        const std::string& format,
+        const std::vector<size_t>& channels = std::vector<size_t>(),
+        const SoapySDR::Kwargs& args = SoapySDR::Kwargs()) override;
+    void closeStream(SoapySDR::Stream* stream) override;
+    int activateStream(SoapySDR::Stream* stream, const int flags = 0,
+        const long long timeNs = 0, const size_t numElems = 0) override;
+    int deactivateStream(SoapySDR::Stream* stream, const int flags = 0,
+        const long long timeNs = 0) override;
+    int readStream(SoapySDR::Stream* stream, void* const* buffs,
+        const size_t numElems, int& flags, long long& timeNs,
+        const long timeoutUs = 100000) override;
+    int writeStream(SoapySDR::Stream* stream, const void* const* buffs,
+        const size_t numElems, int& flags, const long long timeNs = 0,
+        const long timeoutUs = 100000) override;
+
+    long long getHardwareTime(const std::string& what = "") const override;
+    std::string readSetting(const std::string& key) const override;
+
+    static const size_t kNumChannels;
+
+private:
+    struct SimStream {
+        int direction;
+        bool cs16;
+        std::vector<size_t> channels;
+        bool active;
+    };
+
+    void buildFrame(void);
+    void waitForSample(unsigned long long sample) const;
+    // Sample the radio is at, on the clock of the continuous stream
+    // timestamps. getHardwareTime gives it in nanoseconds, as
+    // activateStream and writeStream take their times.
+    unsigned long long currentSample(void) const;
+
+    Config* cfg_;
+    std::string serial_;
+    size_t cell_;
+    size_t radio_;
+    bool client_;
+    // Framed streams return one symbol per read with an Iris style
+    // frame<<32 | symbol<<16 timestamp, otherwise samples are returned
+    // as a continuous stream timestamped in nanoseconds
+    bool framed_;
+    double rate_;
+
+    size_t symbol_len_;
+    size_t frame_len_;
+    // [channel][sample] one frame worth of received samples
+    std::vector<std::vector<std::complex<float>>> frame_cf32_;
+    std::vector<std::vector<std::complex<int16_t>>> frame_cs16_;
+    // Symbols of the frame that the radio receives (framed mode only)
+    std::vector<size_t> rx_symbols_;
+
+    size_t rx_cursor_;
+    size_t rx_offset_;
+    unsigned long long rx_sample_;
+    unsigned long long rx_start_sample_;
+    bool rx_started_;
+    std::atomic<unsigned long long> frame_count_;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+#endif /* SIM_DEVICE_H_ */
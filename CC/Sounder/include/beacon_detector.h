@@ -0,0 +1,85 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Streaming detection of the two repetition gold sequence beacon over
+ consecutive receive buffers, same decision as CommsLib::find_beacon_avx
+---------------------------------------------------------------------
+*/
+
+#ifndef BEACON_DETECTOR_H_
+#define BEACON_DETECTOR_H_
+
+#include "comms-kernels.h"
+#include "fft_correlator.h"
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+// With c[n] the correlation of the L samples ending at n with the
+// sequence and e[n] = |c[n]|^2, sample n is a peak when
+// e[n] * e[n - L] > e[n - L] + ... + e[n - 1]. The last L - 1 samples and
+// L energies carry over between process() calls, so beacons across buffer
+// boundaries are found. All state, the correlation taps included, is
+// allocated in the constructor.
+//
+// The CS16 path correlates with the sequence in Q15 and scales the
+// correlation down by 2^shift so it can't saturate, which makes it the float
+// correlation times 2^(30 - shift) for samples taken as x / 32768. Energies
+// and their sums are then exact integers and the decision is the float one
+// scaled by 2^(4 * (30 - shift)) on both sides. A stream is either CF32 or
+// CS16 between reset() calls.
+class BeaconDetector {
+public:
+    // max_samples is the largest buffer given to process()
+    BeaconDetector(const std::vector<std::complex<float>>& seq,
+        size_t max_samples);
+
+    // Scans the next length samples of the stream, returns whether a peak
+    // was found among them. The first peak of the buffer is reported.
+    bool process(const std::complex<float>* samples, size_t length);
+    bool process(const std::complex<int16_t>* samples, size_t length);
+    // Forgets the previous samples, for a gap in the stream
+    void reset(void);
+
+    // Index of the peak in the last processed buffer, -1 if it had none
+    inline int peak_index(void) const { return this->peak_index_; }
+    // Position of the last peak found counted from the first sample
+    // processed since construction or reset()
+    inline long long peak_sample(void) const { return this->peak_sample_; }
+    // Peak metric over threshold of the last peak found, above 1
+    inline float confidence(void) const { return this->confidence_; }
+    inline long long samples(void) const { return this->samples_; }
+    // Right shift of the CS16 correlation
+    inline int cs16_shift(void) const { return this->cs16_shift_; }
+
+private:
+    void found(size_t index, long long sample, float confidence);
+
+    FftCorrelator correlator_;
+    size_t seq_len_;
+    size_t max_samples_;
+
+    // The L - 1 samples before the buffer followed by the buffer
+    std::vector<std::complex<float>> window_;
+    std::vector<std::complex<float>> corr_;
+    // e[n] of the last L samples, indexed by n % L
+    std::vector<float> energy_;
+
+    // Q15 sequence, prepared for the correlation kernel
+    Cs16CorrTaps taps_cs16_;
+    int cs16_shift_;
+    std::vector<std::complex<int16_t>> window_cs16_;
+    std::vector<std::complex<int16_t>> corr_cs16_;
+    std::vector<uint32_t> energy_cs16_;
+    // Sum of energy_cs16_
+    uint64_t thresh_cs16_;
+
+    long long samples_;
+    int peak_index_;
+    long long peak_sample_;
+    float confidence_;
+};
+
+#endif /* BEACON_DETECTOR_H_ */
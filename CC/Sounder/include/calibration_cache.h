@@ -0,0 +1,66 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ On-disk cache of the DC offset, IQ imbalance and trigger delay
+ calibration of the base station radios
+---------------------------------------------------------------------
+*/
+
+#ifndef CALIBRATION_CACHE_H_
+#define CALIBRATION_CACHE_H_
+
+#include "config.h"
+#include "nlohmann/json.hpp"
+#include <mutex>
+#include <string>
+
+// DC offset and IQ imbalance corrections of one path, in the register
+// steps dciqMinimize searches
+struct DciqCorrection {
+    // DC correction in 1/64 (RX) or 1/128 (TX) steps
+    int dc_i;
+    int dc_q;
+    int gcorr;
+    int iqcorr;
+    // DC and image levels relative to the calibration tone once
+    // corrected, in dB
+    float dc_level;
+    float image_level;
+};
+
+// Calibration results of each radio, indexed by its serial and the RF
+// frequency, sample rate and gains they were found at, so a change of
+// any of them misses the cache. Entries hold the corrections of each
+// path and the sum of the ADJUST_DELAYS steps of the radio. Lookups and
+// stores may come from several threads.
+class CalibrationCache {
+public:
+    // Loads path when it exists. A file that does not parse is replaced
+    // on the next save.
+    explicit CalibrationCache(const std::string& path);
+
+    // Entry of radio serial at the frequency, rate and gains of cfg
+    static std::string key(const Config* cfg, const std::string& serial);
+
+    bool findDciq(const std::string& key, int direction, size_t channel,
+        DciqCorrection& corr) const;
+    void storeDciq(const std::string& key, int direction, size_t channel,
+        const DciqCorrection& corr);
+    bool findDelay(const std::string& key, int& delay) const;
+    void storeDelay(const std::string& key, int delay);
+
+    // Writes the cache next to path and renames it over path, so an
+    // interrupted save keeps the previous file
+    void save(void) const;
+
+    inline const std::string& path(void) const { return this->path_; }
+
+private:
+    std::string path_;
+    nlohmann::json entries_;
+    mutable std::mutex mutex_;
+};
+
+#endif /* CALIBRATION_CACHE_H_ */
@@ -0,0 +1,112 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Scalar, AVX2 and AVX-512 implementations of the CommsLib signal
+ processing kernels, one table per instruction set
+---------------------------------------------------------------------
+*/
+
+#ifndef COMMS_KERNELS_H_
+#define COMMS_KERNELS_H_
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// One axis of a square QAM constellation. A label holds the bits of the
+// I axis above those of the Q axis.
+struct QamAxis {
+    // Label bits per axis, 1 to 3
+    int bits;
+    // Amplitude of each axis label, padded to 8
+    float levels[8];
+    // Axis label of each level, from the lowest amplitude up, padded to 8.
+    // Every value of bits bits appears once.
+    int32_t labels[8];
+    // Midpoints between adjacent levels, from the lowest up
+    float thresholds[7];
+};
+
+// Every table computes the same outputs, up to float rounding. The kernels
+// work on caller allocated buffers and never read or write past the given
+// lengths, so the vector instructions are confined to the files built for
+// them and the table is picked once at startup by CommsLib::kernels().
+struct CommsKernels {
+    const char* name;
+    // Shortest sequence the FFT block correlation beats correlate_cf32 for
+    size_t fft_corr_min_seq_len;
+
+    // out[k] = sum_j in[k + j] * conj(seq[j]) for k < count, in holds
+    // count + seq_len - 1 samples
+    void (*correlate_cf32)(const std::complex<float>* in, size_t count,
+        const std::complex<float>* seq, size_t seq_len,
+        std::complex<float>* out);
+    // Same on 16 bit I/Q with the taps of correlate_cs16_taps, each
+    // product is shifted right by tap_shift and the sum by out_shift with
+    // rounding, then saturated
+    void (*correlate_cs16)(const std::complex<int16_t>* in, size_t count,
+        const uint32_t* taps, size_t seq_len, int tap_shift, int out_shift,
+        std::complex<int16_t>* out);
+    // out[i] = a[i] * b[i], or a[i] * conj(b[i])
+    void (*complex_mult_cf32)(const std::complex<float>* a,
+        const std::complex<float>* b, size_t length, bool conj,
+        std::complex<float>* out);
+    // Q15 product, saturated
+    void (*complex_mult_cs16)(const std::complex<int16_t>* a,
+        const std::complex<int16_t>* b, size_t length, bool conj,
+        std::complex<int16_t>* out);
+    void (*abs2_cf32)(const std::complex<float>* in, size_t length, float* out);
+    // Wraps to INT32_MIN for -32768 - 32768j only
+    void (*abs2_cs16)(
+        const std::complex<int16_t>* in, size_t length, int32_t* out);
+    // sign(re) if re != 0, else sign(im)
+    void (*csign)(
+        const std::complex<float>* in, size_t length, std::complex<float>* out);
+    // out[i] = in[i - window] + ... + in[i - 1], in being zero before 0,
+    // summed as doubles
+    void (*moving_sum)(
+        const float* in, size_t length, size_t window, float* out);
+
+    // out[i] = levels[in[i] >> bits] + j * levels[in[i] & (2^bits - 1)],
+    // labels of more than 2 * bits bits give unspecified points
+    void (*qam_modulate)(const uint8_t* in, size_t length,
+        const QamAxis& axis, std::complex<float>* out);
+    // Label of the nearest constellation point, a point on a threshold
+    // goes to the level above
+    void (*qam_demod_hard)(const std::complex<float>* in, size_t length,
+        const QamAxis& axis, uint8_t* out);
+    // Max-log LLRs of the 2 * bits label bits of each point, most
+    // significant first: scale times the distance squared to the nearest
+    // point with the bit set less that to the nearest point with it clear
+    void (*qam_demod_soft)(const std::complex<float>* in, size_t length,
+        const QamAxis& axis, float scale, float* out);
+};
+
+// Taps of correlate_cs16 for seq, limited to +-32767. For each seq[j]
+// the I/Q pair whose multiply-add with a sample x gives the real part of
+// x * conj(seq[j]), then the one giving its imaginary part, so taps holds
+// 2 * seq_len pairs. Built once per sequence, they are shared by all
+// tables.
+void correlate_cs16_taps(
+    const std::complex<int16_t>* seq, size_t seq_len, uint32_t* taps);
+
+// A Q15 sequence prepared for correlate_cs16, built once for a sequence
+// correlated over many buffers by CommsLib::correlate_taps
+struct Cs16CorrTaps {
+    size_t seq_len;
+    // Right shift of each product keeping the sums in 31 bits
+    int tap_shift;
+    // 2 * seq_len taps of correlate_cs16_taps
+    std::vector<uint32_t> taps;
+};
+
+extern const CommsKernels kScalarKernels;
+#if defined(__x86_64__)
+extern const CommsKernels kAvx2Kernels;
+extern const CommsKernels kAvx512Kernels;
+#endif
+
+#endif /* COMMS_KERNELS_H_ */
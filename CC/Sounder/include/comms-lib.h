@@ -26,8 +26,14 @@
 #include <unistd.h>
 #include <vector>
 
+struct CommsKernels;
+struct Cs16CorrTaps;
+struct QamAxis;
+
 static constexpr size_t kPilotSubcarrierSpacing = 12;
 static constexpr size_t kDefaultPilotScOffset = 6;
+// Alignment of the buffers given to the pointer FFT and IFFT
+static constexpr size_t kFftAlignment = 64;
 
 static inline double computeAbs(std::complex<double> x) { return std::abs(x); }
 
@@ -58,7 +64,31 @@ public:
 
     static std::vector<std::vector<float>> getSequence(
         size_t type, size_t seq_len = 0);
+    // Gray mapped QPSK and 16QAM and natural 64QAM points of unit average
+    // power for labels of type bits, the I axis in the upper half. An
+    // invalid label stops the mapping.
     static std::vector<std::complex<float>> modulate(std::vector<uint8_t>, int);
+    static void modulate(
+        const uint8_t* in, size_t length, int type, std::complex<float>* out);
+    // Label of the nearest point to each sample
+    static std::vector<uint8_t> demodulate(
+        const std::vector<std::complex<float>>& in, int type);
+    static void demodulate(
+        const std::complex<float>* in, size_t length, int type, uint8_t* out);
+    // Max-log LLRs, log(P(0) / P(1)), of the type bits of each label, most
+    // significant first. noiseVar is that of the complex noise.
+    static std::vector<float> demodulateSoft(
+        const std::vector<std::complex<float>>& in, int type, float noiseVar);
+    static void demodulateSoft(const std::complex<float>* in, size_t length,
+        int type, float noiseVar, float* out);
+    // The same on each buffer of in, e.g. one per antenna
+    static std::vector<std::vector<uint8_t>> demodulate(
+        const std::vector<std::vector<std::complex<float>>>& in, int type);
+    static std::vector<std::vector<float>> demodulateSoft(
+        const std::vector<std::vector<std::complex<float>>>& in, int type,
+        float noiseVar);
+    // Constellation axis of a ModulationOrder, nullptr for other types
+    static const QamAxis* qamAxis(int type);
     static std::vector<size_t> getDataSc(size_t fftSize, size_t DataScNum,
         size_t PilotScOffset = kDefaultPilotScOffset);
     static std::vector<size_t> getNullSc(size_t fftSize, size_t DataScNum);
@@ -71,8 +101,19 @@ public:
     static std::vector<std::complex<float>> IFFT(
         const std::vector<std::complex<float>>&, int, float scale = 0.5,
         bool normalize = true);
+    // Unnormalized transforms of count consecutive blocks of fftSize
+    // samples. in and out are kFftAlignment aligned, caller owned and may
+    // be the same buffer. Plans are cached per thread, so repeated sizes
+    // allocate nothing.
+    static void FFT(const std::complex<float>* in, std::complex<float>* out,
+        size_t fftSize, size_t count = 1);
+    static void IFFT(const std::complex<float>* in, std::complex<float>* out,
+        size_t fftSize, size_t count = 1);
 
+    // First of the two LTS symbol correlation peaks, -1 if there is none
     static int findLTS(const std::vector<std::complex<float>>& iq, int seqLen);
+    static std::vector<int> findLTS(
+        const std::vector<std::vector<std::complex<float>>>& iq, int seqLen);
     static size_t find_pilot_seq(const std::vector<std::complex<float>>& iq,
         const std::vector<std::complex<float>>& pilot, size_t seqLen);
     template <typename T>
@@ -116,7 +157,11 @@ public:
         std::vector<float> const&, double, double, size_t,
         const size_t delta = 10);
 
-    // Functions using AVX
+    // Kernels of the instruction sets the CPU supports, picked on first use
+    static const CommsKernels& kernels(void);
+
+    // Functions on the CommsLib kernels, which use AVX2 or AVX-512 where
+    // available
     static int find_beacon(const std::vector<std::complex<float>>& iq);
     static int find_beacon_avx(const std::vector<std::complex<float>>& iq,
         const std::vector<std::complex<float>>& seq);
@@ -124,6 +169,9 @@ public:
         std::vector<float> const& f, std::vector<float> const& g);
     static std::vector<int16_t> correlate_avx_si(
         std::vector<int16_t> const& f, std::vector<int16_t> const& g);
+    // out[i] = f[i - window] + ... + f[i - 1]
+    static std::vector<float> moving_sum(
+        std::vector<float> const& f, size_t window);
     static std::vector<float> abs2_avx(
         std::vector<std::complex<float>> const& f);
     static std::vector<int32_t> abs2_avx(
@@ -137,12 +185,35 @@ public:
     static std::vector<std::complex<float>> correlate_avx(
         std::vector<std::complex<float>> const& f,
         std::vector<std::complex<float>> const& g);
+    // Q15 output, the float correlation of f / 32768 and g / 32768 scaled
+    // by 32768 and saturated
     static std::vector<std::complex<int16_t>> correlate_avx(
         std::vector<std::complex<int16_t>> const& f,
         std::vector<std::complex<int16_t>> const& g);
+    // out[k] = sum_j f[k + j] * conj(g[j]) / 2^shift, rounded and saturated,
+    // for the length - L + 1 windows of f that hold the whole g. The sum
+    // keeps 31 bits, bits below it are dropped per tap when it would need
+    // more, g is limited to +-32767.
+    static void correlate_avx(const std::complex<int16_t>* f, size_t length,
+        std::vector<std::complex<int16_t>> const& g, int shift,
+        std::complex<int16_t>* out);
+    // Taps of g for the overload below, which correlates the same without
+    // allocating
+    static Cs16CorrTaps correlate_taps(
+        std::vector<std::complex<int16_t>> const& g);
+    static void correlate_avx(const std::complex<int16_t>* f, size_t length,
+        Cs16CorrTaps const& g, int shift, std::complex<int16_t>* out);
+    // Same output as correlate_avx, by overlap-save FFT blocks. The
+    // correlator of the last g is kept per thread.
+    static std::vector<std::complex<float>> correlate_fft(
+        std::vector<std::complex<float>> const& f,
+        std::vector<std::complex<float>> const& g);
+    // Whether correlate_fft beats correlate_avx for these lengths
+    static bool use_fft_correlation(size_t length, size_t seq_len);
     static std::vector<std::complex<float>> complex_mult_avx(
         std::vector<std::complex<float>> const& f,
         std::vector<std::complex<float>> const& g, const bool conj);
+    // Q15 product, saturated
     static std::vector<std::complex<int16_t>> complex_mult_avx(
         std::vector<std::complex<int16_t>> const& f,
         std::vector<std::complex<int16_t>> const& g, const bool conj);
@@ -13,10 +13,26 @@
 
 #include <atomic>
 #include <complex.h>
+#include <cstdint>
 #include <vector>
 
 class Config {
 public:
+    enum class SymbolType : uint8_t {
+        kGuard,
+        kBeacon,
+        kPilot,
+        kNoise,
+        kUplink,
+        kDownlink
+    };
+    // Schedule entry of one symbol, index is the position of the symbol
+    // among the symbols of its type in the frame (client id for pilots)
+    struct SymbolInfo {
+        SymbolType type;
+        uint16_t index;
+    };
+
     Config(const std::string&, const std::string&);
     ~Config();
 
@@ -57,6 +73,15 @@ public:
     inline int cl_agc_gain_init(void) const { return this->cl_agc_gain_init_; }
     inline bool imbalance_cal_en(void) const { return this->imbalance_cal_en_; }
     inline bool sample_cal_en(void) const { return this->sample_cal_en_; }
+    inline const std::string& dciq_optimizer(void) const
+    {
+        return this->dciq_optimizer_;
+    }
+    // File of the calibration cache, empty when disabled
+    inline const std::string& calib_cache(void) const
+    {
+        return this->calib_cache_;
+    }
     inline size_t max_frame(void) const { return this->max_frame_; }
     inline size_t ul_data_frame_num(void) const
     {
@@ -86,6 +111,17 @@ public:
     inline double rate(void) const { return this->rate_; }
     inline int tx_advance(void) const { return this->tx_advance_; }
     inline size_t cl_sdr_ch(void) const { return this->cl_sdr_ch_; }
+    inline bool sim_mode(void) const { return this->sim_mode_; }
+    inline bool sim_max_speed(void) const { return this->sim_max_speed_; }
+    inline float sim_noise_level(void) const { return this->sim_noise_level_; }
+    inline const std::string& telemetry(void) const
+    {
+        return this->telemetry_;
+    }
+    inline size_t telemetry_period_ms(void) const
+    {
+        return this->telemetry_period_ms_;
+    }
 
     inline bool running(void) const { return this->running_.load(); }
     inline void running(bool value) { this->running_ = value; }
@@ -102,10 +138,57 @@ public:
     {
         return this->trace_file_;
     }
+    inline size_t record_batch_frames(void) const
+    {
+        return this->record_batch_frames_;
+    }
+    inline size_t record_chunk_frames(void) const
+    {
+        return this->record_chunk_frames_;
+    }
+    inline size_t record_chunk_antennas(void) const
+    {
+        return this->record_chunk_antennas_;
+    }
+    inline const std::string& record_pilot_compression(void) const
+    {
+        return this->record_pilot_compression_;
+    }
+    inline const std::string& record_noise_compression(void) const
+    {
+        return this->record_noise_compression_;
+    }
+    inline const std::string& record_data_compression(void) const
+    {
+        return this->record_data_compression_;
+    }
+    inline int record_compression_level(void) const
+    {
+        return this->record_compression_level_;
+    }
+    inline double record_cache_mb(void) const { return this->record_cache_mb_; }
+    inline const std::string& record_byte_order(void) const
+    {
+        return this->record_byte_order_;
+    }
+    inline const std::string& record_format(void) const
+    {
+        return this->record_format_;
+    }
+    inline bool record_csi(void) const { return this->record_csi_; }
+    inline bool record_pilot_samples(void) const
+    {
+        return this->record_pilot_samples_;
+    }
     inline const std::string& cl_channel(void) const
     {
         return this->cl_channel_;
     }
+    // Client sample format, cf32 or cs16
+    inline const std::string& cl_stream_format(void) const
+    {
+        return this->cl_stream_format_;
+    }
     inline const std::string& beacon_seq(void) const
     {
         return this->beacon_seq_;
@@ -137,6 +220,10 @@ public:
     {
         return this->pilot_cf32_;
     }
+    inline std::vector<std::complex<int16_t>>& pilot_ci16(void)
+    {
+        return this->pilot_ci16_;
+    }
     inline std::vector<size_t>& n_bs_sdrs(void) { return this->n_bs_sdrs_; }
 
     inline const std::vector<std::string>& cl_frames(void) const
@@ -232,6 +319,10 @@ public:
     {
         return this->task_thread_num_;
     }
+    inline unsigned int ctrl_thread_num(void) const
+    {
+        return this->ctrl_thread_num_;
+    }
 
     inline const std::vector<std::string>& hub_ids(void) const
     {
@@ -268,17 +359,63 @@ public:
     size_t getNumAntennas();
     size_t getMaxNumAntennas();
     size_t getTotNumAntennas();
-    int getClientId(int, int);
-    int getNoiseSFIndex(int, int);
-    int getUlSFIndex(int, int);
-    int getDlSFIndex(int, int);
-    bool isPilot(int, int);
-    bool isNoise(int, int);
-    bool isData(int, int);
+
+    // Base station schedule lookup for the per packet hot paths
+    inline const SymbolInfo& symbolInfo(size_t frame_id, size_t symbol_id) const
+    {
+        if ((symbol_id >= this->symbols_per_frame_)
+            || (this->symbol_table_.empty() == true)) {
+            return kGuardSymbol;
+        }
+        size_t pattern = (this->schedule_patterns_ == 1)
+            ? 0
+            : frame_id % this->schedule_patterns_;
+        return this->symbol_table_[pattern * this->symbols_per_frame_
+            + symbol_id];
+    }
+    inline int getClientId(int frame_id, int symbol_id) const
+    {
+        return symbolIndex(frame_id, symbol_id, SymbolType::kPilot);
+    }
+    inline int getNoiseSFIndex(int frame_id, int symbol_id) const
+    {
+        return symbolIndex(frame_id, symbol_id, SymbolType::kNoise);
+    }
+    inline int getUlSFIndex(int frame_id, int symbol_id) const
+    {
+        return symbolIndex(frame_id, symbol_id, SymbolType::kUplink);
+    }
+    inline int getDlSFIndex(int frame_id, int symbol_id) const
+    {
+        return symbolIndex(frame_id, symbol_id, SymbolType::kDownlink);
+    }
+    inline bool isPilot(int frame_id, int symbol_id) const
+    {
+        return symbolInfo(frame_id, symbol_id).type == SymbolType::kPilot;
+    }
+    inline bool isNoise(int frame_id, int symbol_id) const
+    {
+        return symbolInfo(frame_id, symbol_id).type == SymbolType::kNoise;
+    }
+    inline bool isData(int frame_id, int symbol_id) const
+    {
+        return symbolInfo(frame_id, symbol_id).type == SymbolType::kUplink;
+    }
     unsigned getCoreCount();
     void loadULData(const std::string&);
 
 private:
+    static const SymbolInfo kGuardSymbol;
+
+    void buildSymbolTable(void);
+    // Index of the symbol among the symbols of type in its frame, -1 if
+    // the symbol is of another type
+    inline int symbolIndex(int frame_id, int symbol_id, SymbolType type) const
+    {
+        const SymbolInfo& info = symbolInfo(frame_id, symbol_id);
+        return info.type == type ? info.index : -1;
+    }
+
     bool bs_present_;
     bool client_present_;
 
@@ -308,6 +445,12 @@ private:
     std::string beacon_seq_;
     bool ul_data_sym_present_;
     std::string data_mod_;
+    bool sim_mode_; // simulated radios instead of hardware
+    bool sim_max_speed_; // do not pace simulated radios to the sample rate
+    float sim_noise_level_;
+    // File or unix:<socket path> receiving the counter snapshots
+    std::string telemetry_;
+    size_t telemetry_period_ms_;
 
     // BS features
     size_t num_cells_;
@@ -338,13 +481,42 @@ private:
     std::vector<std::vector<size_t>>
         ul_symbols_; // Accessed through getUlSFIndex()
     std::vector<std::vector<size_t>> dl_symbols_; // No accessor
+    // [pattern][symbol] entries of the frames_ schedules, frame f uses
+    // pattern f % schedule_patterns_
+    std::vector<SymbolInfo> symbol_table_;
+    size_t schedule_patterns_;
     bool single_gain_;
     std::vector<double> tx_gain_;
     std::vector<double> rx_gain_;
     std::vector<double> cal_tx_gain_;
     bool sample_cal_en_;
     bool imbalance_cal_en_;
+    std::string dciq_optimizer_;
+    std::string calib_cache_;
     std::string trace_file_;
+    // Frames gathered by each recorder before writing them to the file
+    size_t record_batch_frames_;
+    // HDF5 chunk shape, 0 antennas means all antennas of a recorder
+    size_t record_chunk_frames_;
+    size_t record_chunk_antennas_;
+    // Filter chains ("none", "shuffle", "deflate", "lz4", "blosc" joined
+    // by '+') applied to each dataset
+    std::string record_pilot_compression_;
+    std::string record_noise_compression_;
+    std::string record_data_compression_;
+    int record_compression_level_;
+    // Chunk cache per dataset, 0 sizes it from the chunk shape
+    double record_cache_mb_;
+    // Byte order of the stored samples ("native", "little" or "big")
+    std::string record_byte_order_;
+    // Recorder backend, "hdf5" files or "raw" captures for offline
+    // conversion
+    std::string record_format_;
+    // Channel estimates of the pilots written to /Data/CSI
+    bool record_csi_;
+    // Raw pilot samples written to /Data/Pilot_Samples, by default only
+    // without the CSI
+    bool record_pilot_samples_;
     std::vector<std::vector<std::string>> calib_frames_;
     bool reciprocal_calib_;
     size_t cal_ref_sdr_id_;
@@ -356,6 +528,7 @@ private:
     size_t cl_sdr_ch_;
     size_t num_cl_antennas_;
     std::string cl_channel_;
+    std::string cl_stream_format_;
     bool cl_agc_en_;
     int cl_agc_gain_init_;
     int tx_advance_;
@@ -386,6 +559,7 @@ private:
     bool core_alloc_;
     unsigned int rx_thread_num_;
     unsigned int task_thread_num_;
+    unsigned int ctrl_thread_num_;
 };
 
 #endif /* CONFIG_HEADER */
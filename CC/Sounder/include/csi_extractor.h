@@ -0,0 +1,65 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Channel estimation on the data subcarriers from one received pilot
+ symbol, run by the recorder in place of storing the raw pilot samples
+---------------------------------------------------------------------
+*/
+
+#ifndef CSI_EXTRACTOR_H_
+#define CSI_EXTRACTOR_H_
+
+#include "config.h"
+#include <complex>
+#include <vector>
+
+// The pilot symbol holds symbol_per_subframe repetitions of a CP and the
+// time domain pilot after the prefix. The repetitions are aligned
+// together on the offset that maximizes the sum of their correlations
+// with the time domain pilot, then each is transformed without its CP and
+// divided by pilot_sym_f. The estimate is the mean over the repetitions.
+// All buffers are allocated in the constructor, an instance is not
+// thread safe.
+class CsiExtractor {
+public:
+    explicit CsiExtractor(Config* cfg);
+    ~CsiExtractor();
+    CsiExtractor(const CsiExtractor&) = delete;
+    CsiExtractor& operator=(const CsiExtractor&) = delete;
+
+    // Estimates the channel from the samps_per_symbol IQ pairs of one
+    // pilot symbol, csi receives data_sc_num() values
+    void extract(const short* iq, std::complex<float>* csi);
+
+    inline size_t data_sc_num(void) const { return this->data_sc_.size(); }
+    // Samples the last pilot was found away from its nominal position
+    inline int timing_offset(void) const { return this->timing_offset_; }
+
+private:
+    size_t fft_size_;
+    size_t samps_per_symbol_;
+    // Nominal first sample of each repetition without its CP
+    std::vector<size_t> starts_;
+    // Offsets searched around the nominal starts
+    int min_offset_;
+    int max_offset_;
+
+    std::vector<std::complex<float>> pilot_;
+    std::vector<size_t> data_sc_;
+    // 1 / (repetitions * pilot_sym_f) on the data subcarriers, 0 where
+    // the pilot is 0
+    std::vector<std::complex<float>> inv_pilot_f_;
+
+    std::vector<std::complex<float>> samples_;
+    std::vector<std::complex<float>> corr_;
+    std::vector<float> power_;
+    // kFftAlignment aligned repetitions and their spectra
+    std::complex<float>* block_;
+    std::complex<float>* spectrum_;
+
+    int timing_offset_;
+};
+
+#endif /* CSI_EXTRACTOR_H_ */
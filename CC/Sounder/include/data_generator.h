@@ -7,20 +7,39 @@
 #define DATA_GENERATOR_H_
 
 #include "config.h"
+#include <atomic>
 #include <random>
 #include <string>
+#include <vector>
 
 class DataGenerator {
 public:
-    // The profile of the input information bits
-    explicit DataGenerator(Config* cfg)
-        : cfg_(cfg)
-    {
-    }
+    // The profile of the input information bits. The bits of each client
+    // and frame only depend on seed, so the files are the same for any
+    // thread count. A seed of 0 takes one from the clock and num_threads
+    // 0 one thread per core.
+    explicit DataGenerator(
+        Config* cfg, uint64_t seed = 0, size_t num_threads = 0);
 
     void GenerateData(const std::string& directory);
 
+    inline uint64_t seed(void) const { return this->seed_; }
+    inline size_t num_threads(void) const { return this->num_threads_; }
+
 private:
+    // Frames generated and written at once by a thread
+    struct Chunk {
+        size_t client;
+        size_t first_frame;
+        size_t num_frames;
+    };
+
+    // Runs the chunks from next on until there are none left
+    void generateChunks(const std::vector<Chunk>& chunks,
+        std::atomic<size_t>& next, const std::vector<int>& files);
+
     Config* cfg_;
+    uint64_t seed_;
+    size_t num_threads_;
 };
 #endif
@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Search strategies for the DC offset and IQ imbalance corrections of
+ the radio calibration, each measurement being a settle, a register
+ snoop and a tone measurement on the radio
+---------------------------------------------------------------------
+*/
+
+#ifndef DCIQ_OPTIMIZER_H_
+#define DCIQ_OPTIMIZER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+// Minimizes a tone level in dB over integer corrections (x, y) with both
+// coordinates in [lo, hi). x and y are the Q and I arms of the DC
+// correction, or the gain and phase corrections of the IQ imbalance.
+class DciqOptimizer {
+public:
+    // Applies the correction and returns the measured level
+    typedef std::function<float(int x, int y)> Measure;
+
+    struct Result {
+        int x;
+        int y;
+        // Best level measured, at (x, y)
+        float level;
+        size_t measurements;
+    };
+
+    virtual ~DciqOptimizer() {}
+    virtual Result minimize(const Measure& measure, int lo, int hi) const = 0;
+    virtual const char* name(void) const = 0;
+
+    // "exhaustive" or "golden", throws std::invalid_argument otherwise
+    static std::unique_ptr<DciqOptimizer> create(const std::string& name);
+};
+
+// The original sweep: a step 8 pass over all of x then y, then a step 1
+// pass 8 around the best x then y. Every level must beat 0 dB.
+class ExhaustiveDciqOptimizer : public DciqOptimizer {
+public:
+    Result minimize(const Measure& measure, int lo, int hi) const override;
+    const char* name(void) const override { return "exhaustive"; }
+};
+
+// Coordinate descent alternating a golden-section search on x and on y.
+// The first pass searches the whole range and later passes a shrinking
+// window around the best point, until a pass moves neither coordinate.
+// The level is unimodal along each arm, it rises with the distance
+// from the residual offset in both coordinates.
+class GoldenDciqOptimizer : public DciqOptimizer {
+public:
+    Result minimize(const Measure& measure, int lo, int hi) const override;
+    const char* name(void) const override { return "golden"; }
+};
+
+#endif /* DCIQ_OPTIMIZER_H_ */
@@ -0,0 +1,67 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Overlap-save correlation of a signal with a fixed sequence using
+ muFFT, producing the same output as CommsLib::correlate_avx
+---------------------------------------------------------------------
+*/
+
+#ifndef FFT_CORRELATOR_H_
+#define FFT_CORRELATOR_H_
+
+#include "fft.h"
+#include <complex>
+#include <vector>
+
+// The conjugate spectrum of the sequence and the block buffers are set up
+// once and the transforms use the cached CommsLib plans, so correlate()
+// does not allocate with the pointer interface. An instance is not thread
+// safe, use one per thread.
+class FftCorrelator {
+public:
+    // Smallest block FFT size as a multiple of the sequence length
+    static const size_t kBlockToSeqRatio;
+    static const size_t kMinFftSize;
+
+    explicit FftCorrelator(const std::vector<std::complex<float>>& seq);
+    ~FftCorrelator();
+    FftCorrelator(const FftCorrelator&) = delete;
+    FftCorrelator& operator=(const FftCorrelator&) = delete;
+
+    // out[k] = sum_j f[k + j - (L - 1)] * conj(seq[j]) for k < length - 1,
+    // with f zero outside [0, length), and out[k] = 0 above, L being the
+    // sequence length. out must hold length + L - 1 samples.
+    void correlate(const std::complex<float>* f, size_t length,
+        std::complex<float>* out);
+    std::vector<std::complex<float>> correlate(
+        const std::vector<std::complex<float>>& f);
+    // out[k] = sum_j f[k + j] * conj(seq[j]) for the length - L + 1 windows
+    // of f that hold the whole sequence
+    void correlateValid(const std::complex<float>* f, size_t length,
+        std::complex<float>* out);
+
+    // Whether the correlator was set up for seq
+    bool matches(const std::vector<std::complex<float>>& seq) const;
+
+    inline size_t fft_size(void) const { return this->fft_size_; }
+    inline size_t seq_len(void) const { return this->seq_.size(); }
+
+    // Block FFT size used for a sequence of seq_len samples
+    static size_t blockSize(size_t seq_len);
+
+private:
+    void release(void);
+    void correlateBlocks(const std::complex<float>* f, size_t length,
+        size_t lead_zeros, size_t count, std::complex<float>* out);
+
+    std::vector<std::complex<float>> seq_;
+    size_t fft_size_;
+    // conj(FFT(seq)) / fft_size_, the inverse transform is unnormalized
+    std::complex<float>* seq_spectrum_;
+    std::complex<float>* block_;
+    std::complex<float>* spectrum_;
+};
+
+#endif /* FFT_CORRELATOR_H_ */
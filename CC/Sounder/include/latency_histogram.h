@@ -0,0 +1,109 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Log-linear histogram of nanosecond durations with constant time
+ recording, used for the hot path latency statistics
+---------------------------------------------------------------------
+*/
+
+#ifndef LATENCY_HISTOGRAM_H_
+#define LATENCY_HISTOGRAM_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class LatencyHistogram {
+public:
+    // Each power of two is split into 2^kSubBucketBits buckets, reported
+    // values are at most 1/16 above the recorded ones
+    static constexpr size_t kSubBucketBits = 4;
+    static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+    static constexpr size_t kNumBuckets = 64 * kSubBuckets;
+
+    LatencyHistogram(void)
+        : counts_(kNumBuckets, 0)
+        , count_(0)
+        , sum_(0)
+        , max_(0)
+    {
+    }
+
+    inline void record(uint64_t ns)
+    {
+        counts_[bucket(ns)]++;
+        count_++;
+        sum_ += ns;
+        max_ = std::max(max_, ns);
+    }
+
+    void merge(const LatencyHistogram& other)
+    {
+        for (size_t i = 0; i < kNumBuckets; i++)
+            counts_[i] += other.counts_[i];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    void reset(void)
+    {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        count_ = 0;
+        sum_ = 0;
+        max_ = 0;
+    }
+
+    // Upper bound of the bucket holding the given quantile (0 to 1)
+    uint64_t percentile(double quantile) const
+    {
+        if (count_ == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(quantile * count_);
+        rank = std::min(std::max<uint64_t>(rank, 1), count_);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kNumBuckets; i++) {
+            seen += counts_[i];
+            if (seen >= rank)
+                return std::min(upperBound(i), max_);
+        }
+        return max_;
+    }
+
+    inline uint64_t count(void) const { return count_; }
+    inline uint64_t max(void) const { return max_; }
+    inline double mean(void) const
+    {
+        return count_ == 0 ? 0 : static_cast<double>(sum_) / count_;
+    }
+
+private:
+    static inline size_t bucket(uint64_t ns)
+    {
+        if (ns < kSubBuckets)
+            return ns;
+        size_t shift = 63 - __builtin_clzll(ns) - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + ((ns >> shift) - kSubBuckets);
+    }
+
+    static inline uint64_t upperBound(size_t index)
+    {
+        if (index < kSubBuckets)
+            return index;
+        size_t shift = index / kSubBuckets - 1;
+        uint64_t base = static_cast<uint64_t>(
+                            kSubBuckets + index % kSubBuckets)
+            << shift;
+        return base + (uint64_t(1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+};
+
+#endif /* LATENCY_HISTOGRAM_H_ */
@@ -10,6 +10,9 @@ static constexpr bool kUseUHD = false;
 static constexpr size_t kStreamContinuous = 1;
 static constexpr size_t kStreamEndBurst = 2;
 
+// Used to keep data written by different threads on separate cache lines
+static constexpr size_t kCacheLineSize = 64;
+
 #define DEBUG_PRINT (0)
 #define DEBUG_RADIO (0)
 #define DEBUG_PLOT (0)
@@ -17,6 +20,8 @@ static constexpr size_t kStreamEndBurst = 2;
 // TASK & SOCKET thread number
 #define TASK_THREAD_NUM (1)
 #define RX_THREAD_NUM (4)
+// Radio control threads for bring-up and calibration
+#define CTRL_THREAD_NUM (16)
 
 #define MAX_FRAME_INC (2000)
 #define TIME_DELTA (40) //ms
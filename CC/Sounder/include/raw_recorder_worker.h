@@ -0,0 +1,119 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Recorder backend appending fixed size frame records to a preallocated
+ raw capture file with direct I/O, described by a JSON sidecar index
+---------------------------------------------------------------------
+*/
+#ifndef SOUDER_RAW_RECORDER_WORKER_H_
+#define SOUDER_RAW_RECORDER_WORKER_H_
+
+#include "record_backend.h"
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace Sounder {
+// Each frame is one record of kRawAlignment aligned size holding the
+// pilot, noise and uplink blocks of the frame back to back, each laid out
+// as [cell][symbol][antenna][IQ] 16 bit samples in the host byte order.
+// Frame f is at offset f * record size, frames without any packet are
+// left zero.
+class RawRecorderWorker : public RecordBackend {
+public:
+    // Direct I/O alignment of the buffers, file offsets and sizes
+    static const size_t kRawAlignment;
+
+    RawRecorderWorker(Config* in_cfg, size_t antenna_offset,
+        size_t num_antennas, ThreadCounters* counters = nullptr);
+    ~RawRecorderWorker();
+
+    void init(void) override;
+    void finalize(void) override;
+    int record(int tid, Package* pkg,
+        std::chrono::steady_clock::time_point enqueue_time) override;
+
+    inline size_t num_antennas(void) override { return num_antennas_; }
+    inline size_t antenna_offset(void) override { return antenna_offset_; }
+
+private:
+    // number of frame batches open for packets, later batches absorb
+    // packets that arrive ahead of the oldest one
+    static const size_t kStageBatches;
+    // number of batches that may be queued for writing at once
+    static const size_t kWriteBatches;
+    // frames the file grows by when max_frame is not set
+    static const size_t kPreallocFrames;
+
+    struct WriteJob {
+        size_t slot;
+        size_t first_frame;
+        size_t num_frames;
+    };
+
+    void openRaw(void);
+    void closeRaw(void);
+    void writeIndex(void);
+    void reserve(size_t frames);
+
+    char* recordPtr(size_t frame_id);
+    void submitBatch(void);
+    void waitSlot(size_t slot);
+    void waitIdle(void);
+    void writeLate(Package* pkg, size_t block_offset, size_t syms_per_frame,
+        size_t sym_id, std::chrono::steady_clock::time_point enqueue_time);
+    bool writeAt(const char* data, size_t length, size_t offset);
+    void writerLoop(void);
+
+    Config* cfg_;
+    std::string raw_name_;
+    std::string index_name_;
+    int fd_;
+
+    // Byte offsets of the pilot, noise and uplink blocks in a record
+    size_t symbol_bytes_;
+    size_t pilot_offset_;
+    size_t noise_offset_;
+    size_t data_offset_;
+    size_t record_bytes_;
+
+    // Frames at the start of the file holding data, and preallocated
+    size_t num_frames_;
+    size_t reserved_frames_;
+
+    // Staged records as [slot][frame], kStageBatches + kWriteBatches
+    // slots of batch_frames_ records each
+    size_t batch_frames_;
+    size_t num_slots_;
+    std::unique_ptr<char[], decltype(&std::free)> stage_;
+    std::unique_ptr<char[], decltype(&std::free)> late_record_;
+    size_t stage_frame_; // first frame of the oldest open batch
+    size_t stage_packets_;
+    std::vector<size_t> slot_packets_;
+    // Enqueue times of the packets staged in each slot, a queued slot's
+    // are recorded and cleared by writer_
+    std::vector<std::vector<std::chrono::steady_clock::time_point>>
+        slot_enqueue_;
+
+    // Batches are written by writer_ in submission order
+    std::thread writer_;
+    std::mutex write_mutex_;
+    std::condition_variable write_cond_;
+    std::deque<WriteJob> write_queue_;
+    std::vector<bool> slot_busy_;
+    bool writer_running_;
+    size_t write_errors_;
+
+    size_t antenna_offset_;
+    size_t num_antennas_;
+    // Write times and sizes are recorded here if set
+    ThreadCounters* counters_;
+};
+}; /* End namespace Sounder */
+
+#endif /* SOUDER_RAW_RECORDER_WORKER_H_ */
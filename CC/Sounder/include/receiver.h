@@ -12,15 +12,19 @@
 
 #include "BaseRadioSet.h"
 #include "ClientRadioSet.h"
-#include "concurrentqueue.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+#include "tx_data_ring.h"
 #include <algorithm>
 #include <arpa/inet.h>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cstring>
 #include <ctime>
 #include <exception>
 #include <iostream>
+#include <memory>
 #include <netinet/in.h>
 #include <numeric>
 #include <pthread.h>
@@ -34,14 +38,6 @@ class ReceiverException : public std::exception {
     }
 };
 
-enum ReceiverEventType { kEventRxSymbol = 0 };
-
-struct Event_data {
-    ReceiverEventType event_type;
-    int data;
-    int ant_id;
-};
-
 struct Package {
     uint32_t frame_id;
     uint32_t symbol_id;
@@ -57,10 +53,50 @@ struct Package {
     }
 };
 
+// Ownership of one package slot of a SampleBuffer, padded so that the
+// recorder threads releasing neighbouring slots never share a cache line
+struct alignas(kCacheLineSize) SlotState {
+    // Number of times the slot has been released by a recorder thread
+    std::atomic<size_t> seq;
+    // Set by the rx thread before the package is handed to a recorder
+    std::chrono::steady_clock::time_point enqueue_time;
+};
+
 // each thread has a SampleBuffer
 struct SampleBuffer {
     std::vector<char> buffer;
-    std::atomic_int* pkg_buf_inuse;
+    // Packages are addressed by their position in the stream of packages
+    // received by the rx thread, position pos lives in slot
+    // pos % num_slots and is free once the slot was released
+    // pos / num_slots times
+    std::unique_ptr<SlotState[]> slots;
+    size_t num_slots;
+    // Package positions handed to each recorder thread, recorder i owns
+    // antennas [i * ring_antennas, (i + 1) * ring_antennas)
+    std::vector<std::unique_ptr<SpscRing<size_t>>> rings;
+    size_t ring_antennas;
+    // Packages the rx thread dropped because their slot was still in use
+    alignas(kCacheLineSize) std::atomic<size_t> dropped;
+
+    inline size_t slotIndex(size_t pos) const { return pos % num_slots; }
+    // rx thread only, true if the slots of positions [pos, pos + num)
+    // are no longer used by a recorder thread
+    inline bool slotsFree(size_t pos, size_t num) const
+    {
+        for (size_t i = pos; i < pos + num; i++) {
+            if (slots[slotIndex(i)].seq.load(std::memory_order_acquire)
+                != i / num_slots) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // Hands the slot of position pos back to the rx thread
+    inline void releaseSlot(size_t pos)
+    {
+        slots[slotIndex(pos)].seq.store(
+            pos / num_slots + 1, std::memory_order_release);
+    }
 };
 
 class Receiver {
@@ -79,8 +115,7 @@ public:
     };
 
 public:
-    Receiver(int n_rx_threads, Config* config,
-        moodycamel::ConcurrentQueue<Event_data>* in_queue);
+    Receiver(int n_rx_threads, Config* config, Telemetry* telemetry);
     ~Receiver();
 
     std::vector<pthread_t> startRecvThreads(
@@ -98,10 +133,11 @@ private:
     Config* config_;
     ClientRadioSet* clientRadioSet_;
     BaseRadioSet* base_radio_set_;
+    Telemetry* telemetry_;
+    // Uplink data of each client, loaded before the radios start
+    std::vector<std::unique_ptr<TxDataRing>> tx_data_;
 
     int thread_num_;
-    // pointer of message_queue_
-    moodycamel::ConcurrentQueue<Event_data>* message_queue_;
 };
 
 #endif
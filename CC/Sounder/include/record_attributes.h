@@ -0,0 +1,95 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Metadata of a recording as written to the /Data group attributes,
+ shared by the HDF5 and raw recorders and the raw capture converter
+---------------------------------------------------------------------
+*/
+#ifndef SOUDER_RECORD_ATTRIBUTES_H_
+#define SOUDER_RECORD_ATTRIBUTES_H_
+
+#include "H5Cpp.h"
+#include "config.h"
+#include "nlohmann/json.hpp"
+#include <complex>
+#include <string>
+#include <vector>
+
+namespace Sounder {
+// Receives the attributes of a recording one at a time, in file order
+class AttributeSink {
+public:
+    virtual ~AttributeSink() = default;
+    virtual void write(const char name[], double val) = 0;
+    virtual void write(const char name[], const std::vector<double>& val) = 0;
+    virtual void write(
+        const char name[], const std::vector<std::complex<float>>& val)
+        = 0;
+    virtual void write(const char name[], size_t val) = 0;
+    virtual void write(const char name[], int val) = 0;
+    virtual void write(const char name[], const std::vector<size_t>& val) = 0;
+    virtual void write(const char name[], const std::string& val) = 0;
+    virtual void write(
+        const char name[], const std::vector<std::string>& val)
+        = 0;
+};
+
+// Writes the attributes to an HDF5 group
+class Hdf5AttributeSink : public AttributeSink {
+public:
+    explicit Hdf5AttributeSink(H5::Group& group);
+    void write(const char name[], double val) override;
+    void write(const char name[], const std::vector<double>& val) override;
+    void write(const char name[],
+        const std::vector<std::complex<float>>& val) override;
+    void write(const char name[], size_t val) override;
+    void write(const char name[], int val) override;
+    void write(const char name[], const std::vector<size_t>& val) override;
+    void write(const char name[], const std::string& val) override;
+    void write(
+        const char name[], const std::vector<std::string>& val) override;
+
+private:
+    H5::Group& group_;
+};
+
+// Appends the attributes to a JSON array as {"name", "type", "value"}
+// objects, type being the HDF5 attribute type ("f64", "u32", "i32" or
+// "str"). Complex values are stored as interleaved real and imaginary
+// parts like in the HDF5 file.
+class JsonAttributeSink : public AttributeSink {
+public:
+    explicit JsonAttributeSink(nlohmann::json& attributes);
+    void write(const char name[], double val) override;
+    void write(const char name[], const std::vector<double>& val) override;
+    void write(const char name[],
+        const std::vector<std::complex<float>>& val) override;
+    void write(const char name[], size_t val) override;
+    void write(const char name[], int val) override;
+    void write(const char name[], const std::vector<size_t>& val) override;
+    void write(const char name[], const std::string& val) override;
+    void write(
+        const char name[], const std::vector<std::string>& val) override;
+
+private:
+    void add(const char name[], const char type[], nlohmann::json value);
+
+    nlohmann::json& attributes_;
+};
+
+// Byte order of the stored samples ("little" or "big") for the
+// record_byte_order option
+std::string recordByteOrder(const Config* cfg);
+
+// All attributes describing the recording of num_antennas antennas from
+// antenna_offset on
+void writeRecordAttributes(Config* cfg, size_t antenna_offset,
+    size_t num_antennas, AttributeSink& sink);
+
+// Replays attributes gathered by a JsonAttributeSink into another sink
+void replayAttributes(const nlohmann::json& attributes, AttributeSink& sink);
+}; /* End namespace Sounder */
+
+#endif /* SOUDER_RECORD_ATTRIBUTES_H_ */
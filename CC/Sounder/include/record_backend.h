@@ -0,0 +1,38 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Interface of the recorder backends writing the packets of a range of
+ antennas to disk
+---------------------------------------------------------------------
+*/
+#ifndef SOUDER_RECORD_BACKEND_H_
+#define SOUDER_RECORD_BACKEND_H_
+
+#include "config.h"
+#include "receiver.h"
+#include <chrono>
+
+namespace Sounder {
+class RecordBackend {
+public:
+    virtual ~RecordBackend() = default;
+
+    // Creates the output files, called before the first record
+    virtual void init(void) = 0;
+    // Writes out everything still buffered and closes the files
+    virtual void finalize(void) = 0;
+    // Stores one packet of the backend's antennas, returns < 0 on failure.
+    // enqueue_time is when the rx thread handed the packet over, the time
+    // from it until the packet is written is recorded in the counters.
+    virtual int record(int tid, Package* pkg,
+        std::chrono::steady_clock::time_point enqueue_time)
+        = 0;
+
+    virtual size_t num_antennas(void) = 0;
+    virtual size_t antenna_offset(void) = 0;
+};
+}; /* End namespace Sounder */
+
+#endif /* SOUDER_RECORD_BACKEND_H_ */
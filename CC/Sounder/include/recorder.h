@@ -23,28 +23,31 @@ public:
     void do_it();
     int getRecordedFrameNum();
     std::string getTraceFileName() { return this->cfg_->trace_file(); }
+    // Pipeline statistics of the last do_it() call
+    inline const RecorderStats& stats(void) const { return this->stats_; }
 
 private:
     void gc(void);
 
     // buffer length of each rx thread
     static const int kSampleBufferFrameNum;
-    // dequeue bulk size, used to reduce the overhead of dequeue in main thread
-    static const int KDequeueBulkSize;
+    // how often the main thread checks for the end of the recording
+    static const int kStatusPollMs;
 
     Config* cfg_;
+    std::unique_ptr<Telemetry> telemetry_;
     std::unique_ptr<Receiver> receiver_;
     SampleBuffer* rx_buffer_;
     size_t rx_thread_buff_size_;
+    // antennas handled by each recorder thread
+    size_t thread_antennas_;
 
     //RecorderWorker worker_;
     std::vector<Sounder::RecorderThread*> recorders_;
     size_t max_frame_number_;
-
-    moodycamel::ConcurrentQueue<Event_data> message_queue_;
+    RecorderStats stats_;
 
     /* Core assignment start variables */
-    const unsigned int kMainDispatchCore;
     const unsigned int kRecorderCore;
     const unsigned int kRecvCore;
 }; /* class Recorder */
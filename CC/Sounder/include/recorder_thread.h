@@ -3,47 +3,86 @@
  RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
  
 ----------------------------------------------------------------------
-Event based message queue thread class for the recorder worker
+Thread class feeding the recorder worker from the rx thread rings
 ---------------------------------------------------------------------
 */
 #ifndef SOUDER_RECORDER_THREAD_H_
 #define SOUDER_RECORDER_THREAD_H_
 
-#include "recorder_worker.h"
-#include <condition_variable>
-#include <mutex>
+#include "latency_histogram.h"
+#include "record_backend.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
 
 namespace Sounder {
-class RecorderThread {
-public:
-    enum RecordEventType { kThreadTermination, kTaskRecord };
+// Pipeline statistics of the recorder threads, valid once they stopped
+struct RecorderStats {
+    size_t packets;
+    // Packages dropped by the rx threads, filled in by the Recorder
+    size_t dropped;
+    // Most packages found waiting in one ring
+    size_t max_queue_depth;
+    // Time from the rx thread handing a package over until the backend
+    // took it, which may only stage it for a later batch write
+    LatencyHistogram stage_latency;
+    // Duration of each file write of the backend and the bytes written
+    LatencyHistogram write_latency;
+    // Time from the rx thread handing a package over until the write of
+    // its batch returned
+    LatencyHistogram written_latency;
+    size_t written_bytes;
+    std::chrono::steady_clock::time_point first_enqueue;
+    std::chrono::steady_clock::time_point last_record;
+    // Flushing and closing the HDF5 files after the last package
+    std::chrono::steady_clock::duration finalize_time;
 
-    struct RecordEventData {
-        RecordEventType event_type;
-        int data;
-        SampleBuffer* rx_buffer;
-        size_t rx_buff_size;
-    };
+    RecorderStats(void)
+        : packets(0)
+        , dropped(0)
+        , max_queue_depth(0)
+        , written_bytes(0)
+        , first_enqueue(std::chrono::steady_clock::time_point::max())
+        , last_record(std::chrono::steady_clock::time_point::min())
+        , finalize_time(0)
+    {
+    }
+    void merge(const RecorderStats& other);
+    // From the first package handed over until all of them are on disk
+    std::chrono::steady_clock::duration activeTime(void) const;
+};
 
+class RecorderThread {
+public:
     RecorderThread(Config* in_cfg, size_t thread_id, int core,
-        size_t queue_size, size_t antenna_offset, size_t num_antennas,
-        bool wait_signal = true);
+        SampleBuffer* rx_buffer, size_t antenna_offset, size_t num_antennas,
+        Telemetry* telemetry, bool wait_signal = true);
     ~RecorderThread();
 
     void Start(void);
     void Stop(void);
-    bool DispatchWork(RecordEventData event);
+    // Waits for the thread to drain the rings and finalize the files
+    void Finalize(void);
+    inline const RecorderStats& stats(void) const { return this->stats_; }
 
 private:
+    // ring entries handled before the slots are released
+    static const size_t kDequeueBulkSize;
+    // idle wait before polling the rings again
+    static const int kIdleWaitUs;
+
     /*Main threading loop */
     void DoRecording(void);
-    void HandleEvent(RecordEventData event);
-    void Finalize();
+    size_t HandleRing(size_t rx_thread);
 
-    //1 - Producer (dispatcher), 1 - Consumer
-    moodycamel::ConcurrentQueue<RecordEventData> event_queue_;
-    moodycamel::ProducerToken producer_token_;
-    RecorderWorker worker_;
+    // One ring per rx thread, each with a single producer and this thread
+    // as the consumer
+    SampleBuffer* rx_buffer_;
+    size_t rx_thread_num_;
+    std::vector<size_t> slots_;
+    ThreadCounters* counters_;
+    std::unique_ptr<RecordBackend> worker_;
     std::thread thread_;
 
     size_t id_;
@@ -53,16 +92,13 @@ private:
          * <0   to disable thread core assignment */
     int core_alloc_;
 
-    /* Synchronization for startup and sleeping */
-    /* Setting wait signal to false will disable the thread waiting on new message
-         * may cause excessive CPU load for infrequent messages.  
-         * However, when the message processing time ~= queue posting time the mutex could 
-         * become unnecessary work
+    /* Setting wait signal to false will make the thread poll the rings
+         * without sleeping when they are empty, may cause excessive CPU load
+         * for infrequent packets but avoids wake up latency
          */
     bool wait_signal_;
-    std::mutex sync_;
-    std::condition_variable condition_;
-    bool running_;
+    std::atomic<bool> running_;
+    RecorderStats stats_;
 };
 };
 
@@ -10,27 +10,33 @@
 #define SOUDER_RECORDER_WORKER_H_
 
 #include "H5Cpp.h"
-#include "config.h"
-#include "receiver.h"
+#include "csi_extractor.h"
+#include "record_backend.h"
+#include <memory>
 
 namespace Sounder {
-class RecorderWorker {
+class RecorderWorker : public RecordBackend {
 public:
-    RecorderWorker(Config* in_cfg, size_t antenna_offset, size_t num_antennas);
+    RecorderWorker(Config* in_cfg, size_t antenna_offset, size_t num_antennas,
+        ThreadCounters* counters = nullptr);
     ~RecorderWorker();
 
-    void init(void);
-    void finalize(void);
-    herr_t record(int tid, Package* pkg);
+    void init(void) override;
+    void finalize(void) override;
+    herr_t record(int tid, Package* pkg,
+        std::chrono::steady_clock::time_point enqueue_time) override;
 
-    inline size_t num_antennas(void) { return num_antennas_; }
-    inline size_t antenna_offset(void) { return antenna_offset_; }
+    inline size_t num_antennas(void) override { return num_antennas_; }
+    inline size_t antenna_offset(void) override { return antenna_offset_; }
 
 private:
     // pilot dataset size increment
     static const int kConfigPilotExtentStep;
     // data dataset size increment
     static const int kConfigDataExtentStep;
+    // number of frame batches held in the staging buffers, later batches
+    // absorb packets that arrive ahead of the oldest one
+    static const size_t kStageBatches;
 
     void gc(void);
     herr_t initHDF5();
@@ -38,6 +44,16 @@ private:
     void closeHDF5();
     void finishHDF5();
 
+    H5::DSetAccPropList chunkCache(size_t syms_per_frame);
+    // count[kDsPkgDataLen] is the row length of the dataset
+    void writeBlock(H5::DataSet* dataset, size_t& frame_number,
+        int extent_step, size_t syms_per_frame, const hsize_t* offset,
+        const hsize_t* count, const void* data, const H5::PredType& type);
+    // Row of a packet in the staging buffers
+    size_t stageRow(size_t syms_per_frame, size_t frame_id, size_t cell_id,
+        size_t sym_id, size_t ant_id);
+    void flushBatch(void);
+
     Config* cfg_;
     H5std_string hdf5_name_;
 
@@ -46,19 +62,45 @@ private:
     H5::DSetCreatPropList pilot_prop_;
     H5::DSetCreatPropList noise_prop_;
     H5::DSetCreatPropList data_prop_;
+    H5::DSetCreatPropList csi_prop_;
 
     H5::DataSet* pilot_dataset_;
     H5::DataSet* noise_dataset_;
     H5::DataSet* data_dataset_;
+    H5::DataSet* csi_dataset_;
+    // The datasets are open for writing
+    bool open_;
 
     size_t frame_number_pilot_;
     size_t frame_number_noise_;
     size_t frame_number_data_;
+    size_t frame_number_csi_;
 
     size_t max_frame_number_;
 
+    // Packets are staged per dataset as [batch][frame][cell][symbol]
+    // [antenna][IQ] and each batch is written with a single hyperslab
+    size_t batch_frames_;
+    size_t stage_frame_; // first frame of the oldest staged batch
+    size_t stage_packets_;
+    std::vector<size_t> batch_packets_;
+    // Enqueue times of the packets staged in each batch
+    std::vector<std::vector<std::chrono::steady_clock::time_point>>
+        batch_enqueue_;
+    std::vector<short> pilot_stage_;
+    std::vector<short> noise_stage_;
+    std::vector<short> data_stage_;
+    // Interleaved I/Q of the data subcarriers of each pilot
+    std::vector<float> csi_stage_;
+
+    // Set when the CSI of the pilots is recorded
+    std::unique_ptr<CsiExtractor> csi_;
+    std::vector<std::complex<float>> csi_row_;
+
     size_t antenna_offset_;
     size_t num_antennas_;
+    // HDF5 write times and sizes are recorded here if set
+    ThreadCounters* counters_;
 };
 }; /* End namespace Sounder */
 
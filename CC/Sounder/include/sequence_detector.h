@@ -0,0 +1,59 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Detection of a known sequence, such as the LTS or a pilot, in the sign
+ of received samples, behind CommsLib::findLTS and find_pilot_seq
+---------------------------------------------------------------------
+*/
+
+#ifndef SEQUENCE_DETECTOR_H_
+#define SEQUENCE_DETECTOR_H_
+
+#include "fft_correlator.h"
+#include <complex>
+#include <vector>
+
+// Correlation n is that of the L samples of csign(iq) ending at n with the
+// sequence, for the length + L - 1 windows overlapping the buffer, which is
+// what convolving with the flipped conjugate sequence gave. Long buffers
+// are correlated by FFT blocks, short ones directly. The buffers grow to
+// the longest input seen and are reused, so an instance serves every
+// antenna of a frame or of a whole file. An instance is not thread safe.
+class SequenceDetector {
+public:
+    explicit SequenceDetector(const std::vector<std::complex<float>>& seq);
+
+    // First n whose correlation magnitude, and that of n + L, are above
+    // thresh times the largest one, -1 if there is none
+    int findPeakPair(const std::complex<float>* iq, size_t length,
+        float thresh);
+    // n with the largest correlation magnitude
+    size_t findMaxPeak(const std::complex<float>* iq, size_t length);
+
+    // The same on each buffer of iq, e.g. one per antenna
+    std::vector<int> findPeakPair(
+        const std::vector<std::vector<std::complex<float>>>& iq,
+        float thresh);
+    std::vector<size_t> findMaxPeak(
+        const std::vector<std::vector<std::complex<float>>>& iq);
+
+    // Whether the detector was set up for seq
+    bool matches(const std::vector<std::complex<float>>& seq) const;
+    inline size_t seq_len(void) const { return this->seq_.size(); }
+
+private:
+    // Sets power_ to the squared correlation magnitudes of the
+    // length + L - 1 windows and returns the largest
+    float correlate(const std::complex<float>* iq, size_t length);
+
+    std::vector<std::complex<float>> seq_;
+    FftCorrelator correlator_;
+    // L - 1 zeros, csign(iq) and L - 1 zeros
+    std::vector<std::complex<float>> window_;
+    std::vector<std::complex<float>> corr_;
+    std::vector<float> power_;
+};
+
+#endif /* SEQUENCE_DETECTOR_H_ */
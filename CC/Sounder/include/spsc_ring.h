@@ -0,0 +1,93 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Bounded lock-free ring for a single producer and a single consumer
+ thread, the consumer pops in bulk to release entries in batches
+---------------------------------------------------------------------
+*/
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include "macros.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template <typename T> class SpscRing {
+public:
+    // The capacity is rounded up to a power of two
+    explicit SpscRing(size_t min_capacity)
+        : head_(0)
+        , cached_tail_(0)
+        , tail_(0)
+        , cached_head_(0)
+    {
+        capacity_ = 1;
+        while (capacity_ < min_capacity)
+            capacity_ <<= 1;
+        mask_ = capacity_ - 1;
+        items_.resize(capacity_);
+    }
+
+    // Producer only, returns false if the ring is full
+    bool push(const T& item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - cached_tail_ == capacity_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head - cached_tail_ == capacity_)
+                return false;
+        }
+        items_[head & mask_] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only, copies out up to max_items entries and frees them
+    // with a single update of the tail, returns the number popped. The
+    // entries that were available are stored in depth if given.
+    size_t pop(T* items, size_t max_items, size_t* depth = nullptr)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (cached_head_ == tail) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (cached_head_ == tail) {
+                if (depth != nullptr)
+                    *depth = 0;
+                return 0;
+            }
+        }
+        if (depth != nullptr)
+            *depth = cached_head_ - tail;
+        size_t count = std::min(max_items, cached_head_ - tail);
+        for (size_t i = 0; i < count; i++)
+            items[i] = items_[(tail + i) & mask_];
+        tail_.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    inline size_t size(void) const
+    {
+        return head_.load(std::memory_order_acquire)
+            - tail_.load(std::memory_order_acquire);
+    }
+    inline size_t capacity(void) const { return capacity_; }
+
+private:
+    // Producer state
+    alignas(kCacheLineSize) std::atomic<size_t> head_;
+    size_t cached_tail_;
+    // Consumer state
+    alignas(kCacheLineSize) std::atomic<size_t> tail_;
+    size_t cached_head_;
+    // Shared, read only after construction
+    alignas(kCacheLineSize) size_t capacity_;
+    size_t mask_;
+    std::vector<T> items_;
+};
+
+#endif /* SPSC_RING_H_ */
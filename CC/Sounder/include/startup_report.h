@@ -0,0 +1,48 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Timing of the bring-up of a radio set, per stage and per radio
+---------------------------------------------------------------------
+*/
+
+#ifndef STARTUP_REPORT_H_
+#define STARTUP_REPORT_H_
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Stages are timed back to back from construction, each ending with
+// endStage. The stages that run one task per radio also keep the time
+// every radio took, so the report names the slowest one. Only the
+// thread bringing the radio set up uses it.
+class StartupReport {
+public:
+    explicit StartupReport(const std::string& name);
+
+    // Time radio serial took in the current stage
+    void addRadio(const std::string& serial, double seconds);
+    void endStage(const std::string& stage);
+
+    // One line per stage and the total
+    void print(void) const;
+
+private:
+    struct Stage {
+        std::string name;
+        double seconds;
+        std::vector<std::pair<double, std::string>> radios;
+    };
+
+    std::string name_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point lap_;
+    std::vector<Stage> stages_;
+    // Radio times of the current stage
+    std::vector<std::pair<double, std::string>> radios_;
+};
+
+#endif /* STARTUP_REPORT_H_ */
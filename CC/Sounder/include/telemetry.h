@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Per thread hot path counters and a reporter thread writing periodic
+ JSON snapshots of them to a file or a local UNIX datagram socket
+---------------------------------------------------------------------
+*/
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "latency_histogram.h"
+#include "macros.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Counters of one thread. Every counter has a single writer so updates
+// are plain stores, the reporter only reads them. Each thread gets its
+// own cache lines.
+struct alignas(kCacheLineSize) ThreadCounters {
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> short_reads;
+    std::atomic<uint64_t> rx_errors;
+    std::atomic<uint64_t> short_writes;
+    std::atomic<uint64_t> late_tx;
+    std::atomic<uint64_t> resyncs;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> queue_hwm;
+
+    // File write durations and the bytes written, the writers hold the
+    // mutex while recording. A backend may write from its own thread.
+    std::mutex write_time_mutex;
+    LatencyHistogram write_time;
+    uint64_t written_bytes;
+    // Time of each packet from its enqueue until the write holding it
+    // returned, kept under write_time_mutex as well
+    LatencyHistogram written_latency;
+
+    std::string name;
+
+    explicit ThreadCounters(const std::string& thread_name);
+
+    static inline void add(std::atomic<uint64_t>& counter, uint64_t n = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + n,
+            std::memory_order_relaxed);
+    }
+    static inline void max(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        if (value > counter.load(std::memory_order_relaxed))
+            counter.store(value, std::memory_order_relaxed);
+    }
+    void recordWrite(std::chrono::steady_clock::duration duration,
+        size_t bytes);
+    // Records the packets enqueued at enqueue_times as written now
+    void recordWritten(
+        const std::vector<std::chrono::steady_clock::time_point>&
+            enqueue_times);
+};
+
+class Telemetry {
+public:
+    // target is a file the snapshots are appended to as JSON lines, or
+    // unix:<path> to send each snapshot as a datagram to a socket bound
+    // at path. Without a target the counters are kept but not reported.
+    Telemetry(const std::string& target, size_t period_ms);
+    ~Telemetry();
+
+    // Counters for a new thread, valid for the lifetime of this object
+    ThreadCounters* registerThread(const std::string& name);
+
+    void start(void);
+    // Stops the reporter after writing a last snapshot
+    void stop(void);
+    // One line JSON object with the current value of all counters
+    std::string snapshot(void);
+
+private:
+    void report(void);
+    void publish(const std::string& line);
+
+    std::string target_;
+    size_t period_ms_;
+    std::chrono::steady_clock::time_point start_time_;
+
+    std::mutex threads_mutex_;
+    std::vector<std::unique_ptr<ThreadCounters>> threads_;
+
+    std::thread reporter_;
+    std::mutex running_mutex_;
+    std::condition_variable running_cond_;
+    bool running_;
+    int socket_;
+};
+
+#endif /* TELEMETRY_H_ */
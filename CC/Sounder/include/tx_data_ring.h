@@ -0,0 +1,56 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Uplink time domain data of one client loaded in memory ahead of the
+ frame loop, so scheduling its transmissions does no file I/O
+---------------------------------------------------------------------
+*/
+
+#ifndef TX_DATA_RING_H_
+#define TX_DATA_RING_H_
+
+#include "config.h"
+#include <string>
+#include <vector>
+
+// The ul_data_frame_num frames of the client's ul_data_t file, stored in
+// the sample format of its stream. Frame f of the stream sends frame
+// f % frames() of the file, every symbol gets the cl_sdr_ch channel
+// pointers radioTx expects. The samples are read and converted once in
+// the constructor and are only read afterwards, so an instance can be
+// shared by any number of threads.
+class TxDataRing {
+public:
+    // cs16 converts the CF32 file to the CS16 stream format
+    TxDataRing(Config* cfg, size_t client, bool cs16);
+    ~TxDataRing();
+    TxDataRing(const TxDataRing&) = delete;
+    TxDataRing& operator=(const TxDataRing&) = delete;
+
+    // Channel buffers of UL slot slot of frame frame
+    inline const void* const* symbol(size_t frame, size_t slot) const
+    {
+        return &this->channels_[((frame % this->frames_) * this->slots_ + slot)
+            * this->channel_num_];
+    }
+
+    inline size_t frames(void) const { return this->frames_; }
+    inline size_t slots(void) const { return this->slots_; }
+    // Bytes of samples held in memory
+    inline size_t bytes(void) const { return this->bytes_; }
+
+private:
+    size_t frames_;
+    size_t slots_;
+    size_t channel_num_;
+    size_t bytes_;
+    // kCacheLineSize aligned samples in file order:
+    // Frame * UL Slots * Channel * Samples
+    char* samples_;
+    // Frame * UL Slots * Channel pointers into samples_
+    std::vector<const void*> channels_;
+};
+
+#endif /* TX_DATA_RING_H_ */
@@ -43,6 +43,9 @@ public:
         const std::vector<std::complex<int16_t>>& in);
     static std::vector<std::complex<int16_t>> float_to_cint16(
         const std::vector<std::vector<float>>& in);
+    // Rounds x * 32768 and saturates to 16 bits
+    static void cfloat_to_cint16(const std::complex<float>* in,
+        std::complex<int16_t>* out, size_t len);
     // static std::vector<std::complex<float>> doubletocfloat(
     //    const std::vector<std::vector<double>>& in);
     static std::vector<std::complex<float>> uint32tocfloat(
@@ -0,0 +1,65 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Bounded pool of threads running the blocking radio control calls of
+ bring-up and calibration, one radio per task
+---------------------------------------------------------------------
+*/
+
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t num_threads);
+    // Finishes the queued tasks before joining the threads
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Queues task, its result or exception is delivered by the future
+    template <typename F>
+    std::future<typename std::result_of<F()>::type> submit(F task)
+    {
+        typedef typename std::result_of<F()>::type Result;
+        auto packaged
+            = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(this->mutex_);
+            this->tasks_.emplace_back([packaged]() { (*packaged)(); });
+        }
+        this->cond_.notify_one();
+        return result;
+    }
+
+    // Runs body(0) ... body(count - 1) on the pool and waits for all of
+    // them. The first exception thrown by a body is rethrown once every
+    // body has returned. Must not be called from a task of this pool.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    inline size_t num_threads(void) const { return this->threads_.size(); }
+
+private:
+    void run(void);
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::function<void(void)>> tasks_;
+    bool stop_;
+    std::vector<std::thread> threads_;
+};
+
+#endif /* WORKER_POOL_H_ */
@@ -17,6 +17,10 @@
 
 DEFINE_bool(gen_ul_bits, false,
     "Generate random bits for uplink transmissions, otherwise read from file!");
+DEFINE_uint64(gen_ul_seed, 0,
+    "Seed of the generated uplink bits, 0 to take one from the clock");
+DEFINE_uint64(gen_ul_threads, 0,
+    "Threads generating the uplink bits, 0 for one per core");
 DEFINE_string(conf, "files/conf.json", "JSON configuration file name");
 DEFINE_string(storepath, "logs", "Dataset store path");
 
@@ -26,7 +30,7 @@ int main(int argc, char* argv[])
     Config config(FLAGS_conf, FLAGS_storepath);
     int ret = EXIT_SUCCESS;
     if (FLAGS_gen_ul_bits) {
-        DataGenerator dg(&config);
+        DataGenerator dg(&config, FLAGS_gen_ul_seed, FLAGS_gen_ul_threads);
         dg.GenerateData(FLAGS_storepath);
     } else {
         try {
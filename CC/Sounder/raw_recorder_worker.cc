@@ -0,0 +1,467 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Recorder backend appending fixed size frame records to a preallocated
+ raw capture file with direct I/O, described by a JSON sidecar index
+---------------------------------------------------------------------
+*/
+
+#include "include/raw_recorder_worker.h"
+#include "include/logger.h"
+#include "include/macros.h"
+#include "include/record_attributes.h"
+#include "include/utils.h"
+
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace Sounder {
+// direct I/O alignment
+const size_t RawRecorderWorker::kRawAlignment = 4096;
+// open frame batches
+const size_t RawRecorderWorker::kStageBatches = 4;
+// queued frame batches
+const size_t RawRecorderWorker::kWriteBatches = 4;
+// file size increment
+const size_t RawRecorderWorker::kPreallocFrames = MAX_FRAME_INC;
+
+static char* aligned_buffer(size_t size)
+{
+    void* buffer = std::aligned_alloc(RawRecorderWorker::kRawAlignment, size);
+    if (buffer == nullptr)
+        throw std::runtime_error("Raw capture buffer allocation failed");
+    std::memset(buffer, 0, size);
+    return static_cast<char*>(buffer);
+}
+
+RawRecorderWorker::RawRecorderWorker(Config* in_cfg, size_t antenna_offset,
+    size_t num_antennas, ThreadCounters* counters)
+    : cfg_(in_cfg)
+    , fd_(-1)
+    , num_frames_(0)
+    , reserved_frames_(0)
+    , batch_frames_(in_cfg->record_batch_frames())
+    , num_slots_(kStageBatches + kWriteBatches)
+    , stage_(nullptr, &std::free)
+    , late_record_(nullptr, &std::free)
+    , stage_frame_(0)
+    , stage_packets_(0)
+    , slot_packets_(num_slots_, 0)
+    , slot_enqueue_(num_slots_)
+    , slot_busy_(num_slots_, false)
+    , writer_running_(false)
+    , write_errors_(0)
+    , antenna_offset_(antenna_offset)
+    , num_antennas_(num_antennas)
+    , counters_(counters)
+{
+    size_t block = this->cfg_->num_cells() * this->num_antennas_;
+    this->symbol_bytes_ = 2 * this->cfg_->samps_per_symbol() * sizeof(short);
+    this->pilot_offset_ = 0;
+    this->noise_offset_ = this->pilot_offset_
+        + block * this->cfg_->pilot_syms_per_frame() * this->symbol_bytes_;
+    this->data_offset_ = this->noise_offset_
+        + block * this->cfg_->noise_syms_per_frame() * this->symbol_bytes_;
+    size_t used = this->data_offset_
+        + block * this->cfg_->ul_syms_per_frame() * this->symbol_bytes_;
+    this->record_bytes_ = std::max(kRawAlignment,
+        (used + kRawAlignment - 1) / kRawAlignment * kRawAlignment);
+}
+
+RawRecorderWorker::~RawRecorderWorker() { this->finalize(); }
+
+void RawRecorderWorker::init(void)
+{
+    unsigned int end_antenna
+        = (this->antenna_offset_ + this->num_antennas_) - 1;
+
+    // Named like the HDF5 files with a .raw extension
+    this->raw_name_ = this->cfg_->trace_file();
+    size_t found_index = this->raw_name_.find_last_of('.');
+    if (found_index == std::string::npos)
+        found_index = this->raw_name_.size();
+    this->raw_name_ = this->raw_name_.substr(0, found_index) + "_"
+        + std::to_string(this->antenna_offset_) + "_"
+        + std::to_string(end_antenna) + ".raw";
+    this->index_name_ = this->raw_name_ + ".json";
+
+    this->stage_.reset(aligned_buffer(
+        this->num_slots_ * this->batch_frames_ * this->record_bytes_));
+    this->late_record_.reset(aligned_buffer(this->record_bytes_));
+
+    this->openRaw();
+    this->writer_running_ = true;
+    this->writer_ = std::thread(&RawRecorderWorker::writerLoop, this);
+}
+
+void RawRecorderWorker::finalize(void)
+{
+    this->closeRaw();
+    if (this->writer_.joinable() == true) {
+        {
+            std::lock_guard<std::mutex> lock(this->write_mutex_);
+            this->writer_running_ = false;
+        }
+        this->write_cond_.notify_all();
+        this->writer_.join();
+    }
+}
+
+void RawRecorderWorker::openRaw(void)
+{
+    MLPD_INFO("Creating output raw capture file: %s\n",
+        this->raw_name_.c_str());
+    this->fd_ = open(this->raw_name_.c_str(),
+        O_RDWR | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if ((this->fd_ < 0) && (errno == EINVAL)) {
+        MLPD_WARN("Direct I/O not supported for %s, writing through the "
+                  "page cache\n",
+            this->raw_name_.c_str());
+        this->fd_
+            = open(this->raw_name_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    }
+    if (this->fd_ < 0) {
+        MLPD_ERROR("Could not open %s: %s\n", this->raw_name_.c_str(),
+            std::strerror(errno));
+        throw std::runtime_error("Could not init the output file");
+    }
+
+    size_t frames = kPreallocFrames;
+    if (this->cfg_->max_frame() != 0)
+        frames = this->cfg_->max_frame() + 1;
+    this->reserve(frames);
+    // Written again with the frame count once the file is closed
+    this->writeIndex();
+}
+
+void RawRecorderWorker::closeRaw(void)
+{
+    if (this->fd_ < 0)
+        return;
+    MLPD_TRACE("Close raw capture file: %s\n", this->raw_name_.c_str());
+
+    // Write out whatever is still staged
+    while (this->stage_packets_ > 0)
+        this->submitBatch();
+    this->waitIdle();
+
+    // Drop the preallocated space past the last frame
+    if (ftruncate(this->fd_, this->num_frames_ * this->record_bytes_) != 0) {
+        MLPD_WARN("Could not truncate %s: %s\n", this->raw_name_.c_str(),
+            std::strerror(errno));
+    }
+    close(this->fd_);
+    this->fd_ = -1;
+    this->writeIndex();
+
+    if (this->write_errors_ > 0) {
+        MLPD_ERROR("Raw capture %s: %zu failed writes\n",
+            this->raw_name_.c_str(), this->write_errors_);
+    }
+    MLPD_INFO("Saving raw capture: %zu frames saved on CPU %d\n",
+        this->num_frames_, sched_getcpu());
+}
+
+void RawRecorderWorker::writeIndex(void)
+{
+    json index;
+    index["data_file"]
+        = this->raw_name_.substr(this->raw_name_.find_last_of('/') + 1);
+    index["byte_order"]
+        = (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) ? "big" : "little";
+    index["record_bytes"] = this->record_bytes_;
+    index["frames"] = this->num_frames_;
+    index["num_cells"] = this->cfg_->num_cells();
+    index["num_antennas"] = this->num_antennas_;
+    index["samps_per_symbol"] = this->cfg_->samps_per_symbol();
+
+    // Blocks of each frame record, named after the HDF5 datasets
+    struct {
+        const char* name;
+        size_t offset;
+        size_t symbols;
+    } blocks[] = {
+        { "Pilot_Samples", this->pilot_offset_,
+            this->cfg_->pilot_syms_per_frame() },
+        { "Noise_Samples", this->noise_offset_,
+            this->cfg_->noise_syms_per_frame() },
+        { "UplinkData", this->data_offset_, this->cfg_->ul_syms_per_frame() },
+    };
+    index["datasets"] = json::array();
+    for (auto& block : blocks) {
+        json dataset;
+        dataset["name"] = block.name;
+        dataset["offset"] = block.offset;
+        dataset["symbols"] = block.symbols;
+        index["datasets"].push_back(dataset);
+    }
+
+    index["attributes"] = json::array();
+    JsonAttributeSink attributes(index["attributes"]);
+    writeRecordAttributes(
+        this->cfg_, this->antenna_offset_, this->num_antennas_, attributes);
+
+    std::ofstream file(this->index_name_, std::ios::trunc);
+    if (file.is_open() == false) {
+        MLPD_ERROR("Could not write the raw capture index %s\n",
+            this->index_name_.c_str());
+        return;
+    }
+    file << index.dump(4) << std::endl;
+}
+
+// Preallocates the file for the given number of frames so that the
+// writes never have to extend it
+void RawRecorderWorker::reserve(size_t frames)
+{
+    if (frames <= this->reserved_frames_)
+        return;
+    if (this->cfg_->max_frame() == 0) {
+        frames = (frames + kPreallocFrames - 1) / kPreallocFrames
+            * kPreallocFrames;
+    }
+    off_t offset = this->reserved_frames_ * this->record_bytes_;
+    off_t length = (frames - this->reserved_frames_) * this->record_bytes_;
+    if (fallocate(this->fd_, 0, offset, length) != 0) {
+        MLPD_TRACE("Preallocating %s failed: %s\n", this->raw_name_.c_str(),
+            std::strerror(errno));
+    }
+    this->reserved_frames_ = frames;
+}
+
+char* RawRecorderWorker::recordPtr(size_t frame_id)
+{
+    size_t slot = (frame_id / this->batch_frames_) % this->num_slots_;
+    size_t record = slot * this->batch_frames_ + frame_id % this->batch_frames_;
+    return this->stage_.get() + record * this->record_bytes_;
+}
+
+// Queues the oldest open batch for writing and opens the next one
+void RawRecorderWorker::submitBatch(void)
+{
+    size_t slot = (this->stage_frame_ / this->batch_frames_) % this->num_slots_;
+    size_t num_frames = this->batch_frames_;
+    if (this->cfg_->max_frame() != 0) {
+        num_frames = std::min(num_frames,
+            this->cfg_->max_frame() + 1
+                - std::min(this->stage_frame_, this->cfg_->max_frame() + 1));
+    }
+
+    if ((this->slot_packets_.at(slot) > 0) && (num_frames > 0)) {
+        this->reserve(this->stage_frame_ + num_frames);
+        this->num_frames_
+            = std::max(this->num_frames_, this->stage_frame_ + num_frames);
+        {
+            std::lock_guard<std::mutex> lock(this->write_mutex_);
+            this->slot_busy_.at(slot) = true;
+            this->write_queue_.push_back(
+                { slot, this->stage_frame_, num_frames });
+        }
+        this->write_cond_.notify_all();
+    } else {
+        this->slot_enqueue_.at(slot).clear();
+    }
+    this->stage_packets_ -= this->slot_packets_.at(slot);
+    this->slot_packets_.at(slot) = 0;
+    this->stage_frame_ += this->batch_frames_;
+
+    // The batch entering the window reuses a slot written kWriteBatches
+    // batches ago
+    this->waitSlot(
+        (this->stage_frame_ / this->batch_frames_ + kStageBatches - 1)
+        % this->num_slots_);
+}
+
+void RawRecorderWorker::waitSlot(size_t slot)
+{
+    std::unique_lock<std::mutex> lock(this->write_mutex_);
+    this->write_cond_.wait(
+        lock, [this, slot] { return this->slot_busy_.at(slot) == false; });
+}
+
+void RawRecorderWorker::waitIdle(void)
+{
+    std::unique_lock<std::mutex> lock(this->write_mutex_);
+    this->write_cond_.wait(lock, [this] {
+        return std::none_of(this->slot_busy_.begin(), this->slot_busy_.end(),
+            [](bool busy) { return busy; });
+    });
+}
+
+// Patches a packet into a frame that was already written out
+void RawRecorderWorker::writeLate(Package* pkg, size_t block_offset,
+    size_t syms_per_frame, size_t sym_id,
+    std::chrono::steady_clock::time_point enqueue_time)
+{
+    this->waitIdle();
+    this->reserve(pkg->frame_id + 1);
+    char* record = this->late_record_.get();
+    std::memset(record, 0, this->record_bytes_);
+    off_t offset = pkg->frame_id * this->record_bytes_;
+    if (pkg->frame_id < this->num_frames_) {
+        if (pread(this->fd_, record, this->record_bytes_, offset) < 0) {
+            MLPD_WARN("Reading frame %u of %s failed: %s\n", pkg->frame_id,
+                this->raw_name_.c_str(), std::strerror(errno));
+        }
+    }
+    size_t index
+        = (pkg->cell_id * syms_per_frame + sym_id) * this->num_antennas_
+        + (pkg->ant_id - this->antenna_offset_);
+    std::memcpy(record + block_offset + index * this->symbol_bytes_,
+        pkg->data, this->symbol_bytes_);
+    if (this->writeAt(record, this->record_bytes_, offset) == false)
+        this->write_errors_++;
+    else if (this->counters_ != nullptr)
+        this->counters_->recordWritten({ enqueue_time });
+    this->num_frames_ = std::max<size_t>(this->num_frames_, pkg->frame_id + 1);
+}
+
+bool RawRecorderWorker::writeAt(const char* data, size_t length, size_t offset)
+{
+    auto write_start = std::chrono::steady_clock::now();
+    size_t bytes = length;
+    while (length > 0) {
+        ssize_t ret = pwrite(this->fd_, data, length, offset);
+        if ((ret < 0) && (errno == EINTR)) {
+            continue;
+        } else if ((ret < 0) && (errno == EINVAL)
+            && ((fcntl(this->fd_, F_GETFL) & O_DIRECT) != 0)) {
+            // Some file systems accept O_DIRECT on open only
+            MLPD_WARN("Direct I/O write to %s failed, writing through the "
+                      "page cache\n",
+                this->raw_name_.c_str());
+            fcntl(this->fd_, F_SETFL, fcntl(this->fd_, F_GETFL) & ~O_DIRECT);
+            continue;
+        } else if (ret <= 0) {
+            MLPD_ERROR("Writing %s failed: %s\n", this->raw_name_.c_str(),
+                std::strerror(errno));
+            return false;
+        }
+        data += ret;
+        length -= ret;
+        offset += ret;
+    }
+    if (this->counters_ != nullptr) {
+        this->counters_->recordWrite(
+            std::chrono::steady_clock::now() - write_start, bytes);
+    }
+    return true;
+}
+
+void RawRecorderWorker::writerLoop(void)
+{
+    std::unique_lock<std::mutex> lock(this->write_mutex_);
+    while (true) {
+        this->write_cond_.wait(lock, [this] {
+            return (this->write_queue_.empty() == false)
+                || (this->writer_running_ == false);
+        });
+        if (this->write_queue_.empty() == true)
+            break;
+        WriteJob job = this->write_queue_.front();
+        this->write_queue_.pop_front();
+        lock.unlock();
+
+        char* data = this->stage_.get()
+            + job.slot * this->batch_frames_ * this->record_bytes_;
+        bool written = this->writeAt(data, job.num_frames * this->record_bytes_,
+            job.first_frame * this->record_bytes_);
+        std::memset(data, 0, this->batch_frames_ * this->record_bytes_);
+        if ((written == true) && (this->counters_ != nullptr))
+            this->counters_->recordWritten(this->slot_enqueue_.at(job.slot));
+        this->slot_enqueue_.at(job.slot).clear();
+
+        lock.lock();
+        if (written == false)
+            this->write_errors_++;
+        this->slot_busy_.at(job.slot) = false;
+        this->write_cond_.notify_all();
+    }
+}
+
+int RawRecorderWorker::record(int tid, Package* pkg,
+    std::chrono::steady_clock::time_point enqueue_time)
+{
+    (void)tid;
+    size_t end_antenna = (this->antenna_offset_ + this->num_antennas_) - 1;
+    if ((pkg->ant_id < this->antenna_offset_) || (pkg->ant_id > end_antenna)) {
+        MLPD_ERROR(
+            "Antenna id is not within range of this recorder %d, %zu:%zu",
+            pkg->ant_id, this->antenna_offset_, end_antenna);
+        return -1;
+    }
+
+    if ((this->cfg_->max_frame() != 0)
+        && (pkg->frame_id > this->cfg_->max_frame())) {
+        this->closeRaw();
+        MLPD_TRACE("Closing file due to frame id %d : %zu max\n", pkg->frame_id,
+            this->cfg_->max_frame());
+        return 0;
+    } else if (this->fd_ < 0) {
+        MLPD_TRACE("Dropping frame %d, file is already closed\n",
+            pkg->frame_id);
+        return 0;
+    }
+
+    size_t block_offset = 0;
+    size_t syms_per_frame = 0;
+    const Config::SymbolInfo& info
+        = this->cfg_->symbolInfo(pkg->frame_id, pkg->symbol_id);
+    switch (info.type) {
+    case Config::SymbolType::kPilot:
+        block_offset = this->pilot_offset_;
+        syms_per_frame = this->cfg_->pilot_syms_per_frame();
+        break;
+    case Config::SymbolType::kUplink:
+        block_offset = this->data_offset_;
+        syms_per_frame = this->cfg_->ul_syms_per_frame();
+        break;
+    case Config::SymbolType::kNoise:
+        block_offset = this->noise_offset_;
+        syms_per_frame = this->cfg_->noise_syms_per_frame();
+        break;
+    default:
+        break;
+    }
+
+    if (syms_per_frame == 0) {
+        // Not a recorded symbol
+    } else if (pkg->frame_id < this->stage_frame_) {
+        // The batch of this frame was already written out
+        this->writeLate(
+            pkg, block_offset, syms_per_frame, info.index, enqueue_time);
+    } else {
+        size_t stage_end
+            = this->stage_frame_ + kStageBatches * this->batch_frames_;
+        while (pkg->frame_id >= stage_end) {
+            if (this->stage_packets_ == 0) {
+                // Nothing staged, move the window to this frame
+                this->waitIdle();
+                size_t batch = pkg->frame_id / this->batch_frames_;
+                batch -= std::min(batch, kStageBatches - 1);
+                this->stage_frame_ = batch * this->batch_frames_;
+            } else {
+                this->submitBatch();
+            }
+            stage_end
+                = this->stage_frame_ + kStageBatches * this->batch_frames_;
+        }
+        size_t index
+            = (pkg->cell_id * syms_per_frame + info.index) * this->num_antennas_
+            + (pkg->ant_id - this->antenna_offset_);
+        std::memcpy(this->recordPtr(pkg->frame_id) + block_offset
+                + index * this->symbol_bytes_,
+            pkg->data, this->symbol_bytes_);
+        size_t slot = (pkg->frame_id / this->batch_frames_) % this->num_slots_;
+        this->slot_packets_.at(slot)++;
+        this->slot_enqueue_.at(slot).push_back(enqueue_time);
+        this->stage_packets_++;
+    }
+    return 0;
+}
+}; //End namespace Sounder
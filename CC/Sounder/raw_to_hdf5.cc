@@ -0,0 +1,153 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Converts a raw capture written with "record_format": "raw" into the
+ HDF5 layout of the regular recorder (/Data/Pilot_Samples, Noise_Samples
+ and UplinkData with the /Data attributes)
+---------------------------------------------------------------------
+*/
+
+#include "include/record_attributes.h"
+#include "nlohmann/json.hpp"
+#include <fcntl.h>
+#include <fstream>
+#include <gflags/gflags.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+DEFINE_string(index, "", "Sidecar index (.raw.json) of the raw capture");
+DEFINE_string(output, "",
+    "HDF5 file to write, the capture name with .hdf5 if empty");
+DEFINE_uint64(block_frames, 64, "Frames converted at once");
+
+static const size_t kDsDim = 5;
+
+static std::string sample_order(const json& index)
+{
+    for (auto& attribute : index.at("attributes")) {
+        if (attribute.at("name") == "SAMPLE_BYTE_ORDER")
+            return attribute.at("value").get<std::string>();
+    }
+    return index.at("byte_order").get<std::string>();
+}
+
+static const H5::PredType& order_type(const std::string& order)
+{
+    return order == "big" ? H5::PredType::STD_I16BE : H5::PredType::STD_I16LE;
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    if (FLAGS_index.empty() == true) {
+        std::fprintf(stderr, "Usage: raw_to_hdf5 -index CAPTURE.raw.json\n");
+        return EXIT_FAILURE;
+    }
+
+    json index;
+    std::ifstream(FLAGS_index) >> index;
+    std::string dir;
+    size_t slash = FLAGS_index.find_last_of('/');
+    if (slash != std::string::npos)
+        dir = FLAGS_index.substr(0, slash + 1);
+    std::string raw_name = dir + index.at("data_file").get<std::string>();
+    std::string output = FLAGS_output;
+    if (output.empty() == true)
+        output = raw_name.substr(0, raw_name.find_last_of('.')) + ".hdf5";
+
+    int fd = open(raw_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::fprintf(stderr, "Could not open %s: %s\n", raw_name.c_str(),
+            std::strerror(errno));
+        return EXIT_FAILURE;
+    }
+    size_t record_bytes = index.at("record_bytes");
+    size_t frames = index.at("frames");
+    if (frames == 0) {
+        // The index of an interrupted capture has no frame count yet
+        struct stat st;
+        fstat(fd, &st);
+        frames = st.st_size / record_bytes;
+    }
+
+    hsize_t cells = index.at("num_cells");
+    hsize_t antennas = index.at("num_antennas");
+    hsize_t IQ = 2 * index.at("samps_per_symbol").get<hsize_t>();
+    const H5::PredType& file_type = order_type(sample_order(index));
+    const H5::PredType& mem_type
+        = order_type(index.at("byte_order").get<std::string>());
+
+    H5::H5File file(output, H5F_ACC_TRUNC);
+    H5::Group group = file.createGroup("/Data");
+    struct Dataset {
+        H5::DataSet dataset;
+        size_t offset;
+        hsize_t symbols;
+    };
+    std::vector<Dataset> datasets;
+    for (auto& block : index.at("datasets")) {
+        std::string name = block.at("name");
+        hsize_t symbols = block.at("symbols");
+        // The pilot dataset is always present, like in the recorder
+        if ((symbols == 0) && (name != "Pilot_Samples"))
+            continue;
+        hsize_t dims[kDsDim] = { frames, cells, symbols, antennas, IQ };
+        hsize_t max_dims[kDsDim]
+            = { H5S_UNLIMITED, cells, symbols, antennas, IQ };
+        hsize_t chunk[kDsDim]
+            = { 1, cells, std::max<hsize_t>(1, symbols), antennas, IQ };
+        H5::DSetCreatPropList prop;
+        prop.setChunk(kDsDim, chunk);
+        H5::DataSpace space(kDsDim, dims, max_dims);
+        datasets.push_back({ file.createDataSet("/Data/" + name, file_type,
+                                 space, prop),
+            block.at("offset").get<size_t>(), symbols });
+    }
+
+    std::vector<char> records(FLAGS_block_frames * record_bytes);
+    std::vector<char> samples;
+    for (size_t first = 0; first < frames; first += FLAGS_block_frames) {
+        size_t count = std::min<size_t>(FLAGS_block_frames, frames - first);
+        ssize_t ret = pread(fd, records.data(), count * record_bytes,
+            first * record_bytes);
+        if (ret < static_cast<ssize_t>(count * record_bytes)) {
+            std::fprintf(stderr, "Short read of frames %zu to %zu in %s\n",
+                first, first + count - 1, raw_name.c_str());
+            // Frames past the end of the file are left zero
+            std::fill(
+                records.begin() + std::max<ssize_t>(ret, 0), records.end(), 0);
+        }
+        for (auto& ds : datasets) {
+            if (ds.symbols == 0)
+                continue;
+            // Gather the block of the dataset from each record
+            size_t block_bytes
+                = cells * ds.symbols * antennas * IQ * sizeof(short);
+            samples.resize(count * block_bytes);
+            for (size_t i = 0; i < count; i++) {
+                std::memcpy(samples.data() + i * block_bytes,
+                    records.data() + i * record_bytes + ds.offset,
+                    block_bytes);
+            }
+
+            hsize_t offset[kDsDim] = { first, 0, 0, 0, 0 };
+            hsize_t block[kDsDim] = { count, cells, ds.symbols, antennas, IQ };
+            H5::DataSpace memspace(kDsDim, block);
+            H5::DataSpace filespace = ds.dataset.getSpace();
+            filespace.selectHyperslab(H5S_SELECT_SET, block, offset);
+            ds.dataset.write(samples.data(), mem_type, memspace, filespace);
+        }
+    }
+    close(fd);
+
+    Sounder::Hdf5AttributeSink attributes(group);
+    Sounder::replayAttributes(index.at("attributes"), attributes);
+    file.close();
+    std::printf("Converted %zu frames of %s to %s\n", frames,
+        raw_name.c_str(), output.c_str());
+    return EXIT_SUCCESS;
+}
@@ -9,11 +9,13 @@
 
 #include "include/receiver.h"
 #include "include/ClientRadioSet.h"
+#include "include/beacon_detector.h"
 #include "include/comms-lib.h"
 #include "include/logger.h"
 #include "include/macros.h"
 #include "include/utils.h"
 
+#include <SoapySDR/Errors.hpp>
 #include <SoapySDR/Time.hpp>
 #include <atomic>
 #include <random>
@@ -22,17 +24,33 @@
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
 
-Receiver::Receiver(int n_rx_threads, Config* config,
-    moodycamel::ConcurrentQueue<Event_data>* in_queue)
+// A failed transmit either missed its time or wrote fewer samples
+static inline void countTx(ThreadCounters* counters, int ret)
+{
+    if (ret == SOAPY_SDR_TIME_ERROR)
+        ThreadCounters::add(counters->late_tx);
+    else
+        ThreadCounters::add(counters->short_writes);
+}
+
+Receiver::Receiver(int n_rx_threads, Config* config, Telemetry* telemetry)
     : config_(config)
+    , telemetry_(telemetry)
     , thread_num_(n_rx_threads)
-    , message_queue_(in_queue)
 {
     /* initialize random seed: */
     srand(time(NULL));
 
     MLPD_TRACE("Receiver Construction - CL present: %d, BS Present: %d\n",
         config_->client_present(), config_->bs_present());
+    if ((config_->client_present() == true)
+        && (config_->ul_data_sym_present() == true)) {
+        bool cs16 = (config_->cl_stream_format() == "cs16");
+        for (size_t i = 0; i < config_->num_cl_sdrs(); i++) {
+            this->tx_data_.emplace_back(
+                std::make_unique<TxDataRing>(config_, i, cs16));
+        }
+    }
     this->clientRadioSet_
         = config_->client_present() ? new ClientRadioSet(config_) : nullptr;
     this->base_radio_set_
@@ -176,17 +194,14 @@ void Receiver::loopRecv(int tid, int core_id, SampleBuffer* rx_buffer)
         pthread_mutex_unlock(&mutex); // unlocking for all other threads
     }
 
-    // use token to speed up
-    moodycamel::ProducerToken local_ptok(*message_queue_);
-
     const size_t num_channels = config_->bs_channel().length();
     size_t packageLength = sizeof(Package) + config_->getPackageDataLength();
-    int buffer_chunk_size = rx_buffer[0].buffer.size() / packageLength;
 
     // handle two channels at each radio
-    // this is assuming buffer_chunk_size is at least 2
-    std::atomic_int* pkg_buf_inuse = rx_buffer[tid].pkg_buf_inuse;
-    char* buffer = rx_buffer[tid].buffer.data();
+    SampleBuffer& sample_buffer = rx_buffer[tid];
+    char* buffer = sample_buffer.buffer.data();
+    auto& rings = sample_buffer.rings;
+    const size_t ring_antennas = sample_buffer.ring_antennas;
 
     size_t num_radios = config_->num_bs_sdrs_all(); //config_->n_bs_sdrs()[0]
     std::vector<size_t> radio_ids_in_thread;
@@ -263,11 +278,15 @@ void Receiver::loopRecv(int tid, int core_id, SampleBuffer* rx_buffer)
         }
     }
 
-    int cursor = 0;
+    size_t pos = 0;
+    size_t dropped = 0;
     size_t frame_id = 0;
     size_t symbol_id = 0;
     size_t ant_id = 0;
     cell = 0;
+    ThreadCounters* counters
+        = this->telemetry_->registerThread("rx" + std::to_string(tid));
+    const size_t package_bytes = config_->getPackageDataLength();
     MLPD_INFO("Start BS main recv loop in thread %d\n", tid);
     while (config_->running() == true) {
 
@@ -298,30 +317,19 @@ void Receiver::loopRecv(int tid, int core_id, SampleBuffer* rx_buffer)
                 ? 1
                 : num_channels; // receive only on one channel at the ref antenna
 
-            // Set buffer status(es) to full; fail if full already
-            for (size_t ch = 0; ch < num_packets; ++ch) {
-                int bit = 1 << (cursor + ch) % sizeof(std::atomic_int);
-                int offs = (cursor + ch) / sizeof(std::atomic_int);
-                int old = std::atomic_fetch_or(
-                    &pkg_buf_inuse[offs], bit); // now full
-                // if buffer was full, exit
-                if ((old & bit) != 0) {
-                    MLPD_ERROR("thread %d buffer full\n", tid);
-                    throw std::runtime_error("Thread %d buffer full\n");
-                }
-                // Reserved until marked empty by consumer
-            }
+            // If the recorders have not released the next slots yet the
+            // radio is still read to keep its stream going, but into the
+            // dummy buffer and the packages are dropped
+            bool drop = (sample_buffer.slotsFree(pos, num_packets) == false);
 
             // Receive data into buffers
-            size_t packageLength
-                = sizeof(Package) + config_->getPackageDataLength();
             for (size_t ch = 0; ch < num_packets; ++ch) {
-                pkg[ch] = (Package*)(buffer + (cursor + ch) * packageLength);
-                samp[ch] = pkg[ch]->data;
+                pkg[ch] = (Package*)(buffer
+                    + sample_buffer.slotIndex(pos + ch) * packageLength);
+                samp[ch] = drop ? samp_buffer.at(ch) : pkg[ch]->data;
             }
             if (num_packets != num_channels)
-                samp[num_channels - 1]
-                    = std::vector<char>(packageLength).data();
+                samp[num_channels - 1] = samp_buffer.at(num_channels - 1);
 
             assert(this->base_radio_set_ != NULL);
             ant_id = radio_idx * num_channels;
@@ -329,11 +337,18 @@ void Receiver::loopRecv(int tid, int core_id, SampleBuffer* rx_buffer)
             // Schedule BS beacons to be sent from host for USRPs
             if (kUseUHD == false) {
                 long long frameTime;
-                if (this->base_radio_set_->radioRx(
-                        radio_idx, cell, samp, frameTime)
-                    < 0) {
+                int r = this->base_radio_set_->radioRx(
+                    radio_idx, cell, samp, frameTime);
+                if (r == 0) {
+                    // The radio ended its stream
                     config_->running(false);
                     break;
+                } else if (r < 0) {
+                    ThreadCounters::add(counters->rx_errors);
+                    config_->running(false);
+                    break;
+                } else if (r < static_cast<int>(config_->samps_per_symbol())) {
+                    ThreadCounters::add(counters->short_reads);
                 }
 
                 frame_id = (size_t)(frameTime >> 32);
@@ -356,19 +371,26 @@ void Receiver::loopRecv(int tid, int core_id, SampleBuffer* rx_buffer)
 
                 // only write received pilot or data into samp
                 // otherwise use samp_buffer as a dummy buffer
-                if (config_->isPilot(frame_id, symbol_id)
-                    || config_->isData(frame_id, symbol_id))
+                Config::SymbolType type
+                    = config_->symbolInfo(frame_id, symbol_id).type;
+                if ((type == Config::SymbolType::kPilot)
+                    || (type == Config::SymbolType::kUplink))
                     r = this->base_radio_set_->radioRx(
                         radio_idx, cell, samp, rxTimeBs);
                 else
                     r = this->base_radio_set_->radioRx(
                         radio_idx, cell, samp_buffer.data(), rxTimeBs);
 
-                if (r < 0) {
+                if (r == 0) {
+                    config_->running(false);
+                    break;
+                } else if (r < 0) {
+                    ThreadCounters::add(counters->rx_errors);
                     config_->running(false);
                     break;
                 }
                 if (r != rx_len) {
+                    ThreadCounters::add(counters->short_reads);
                     std::cerr << "BAD Receive(" << r << "/" << rx_len
                               << ") at Time " << rxTimeBs << ", frame count "
                               << frame_id << std::endl;
@@ -382,11 +404,13 @@ void Receiver::loopRecv(int tid, int core_id, SampleBuffer* rx_buffer)
                             * config_->symbols_per_frame() * BEACON_INTERVAL;
                     int r_tx = this->base_radio_set_->radioTx(radio_idx, cell,
                         beaconbuff.data(), kStreamEndBurst, txTimeBs);
-                    if (r_tx != (int)config_->samps_per_symbol())
+                    if (r_tx != (int)config_->samps_per_symbol()) {
+                        countTx(counters, r_tx);
                         std::cerr << "BAD Transmit(" << r_tx << "/"
                                   << config_->samps_per_symbol() << ") at Time "
                                   << txTimeBs << ", frame count " << frame_id
                                   << std::endl;
+                    }
                 }
             }
 
@@ -402,24 +426,39 @@ void Receiver::loopRecv(int tid, int core_id, SampleBuffer* rx_buffer)
             }
 #endif
 
+            if (drop == true) {
+                if (dropped == 0) {
+                    MLPD_WARN("Receiver thread %d buffer full, dropping "
+                              "packages\n",
+                        tid);
+                }
+                dropped += num_packets;
+                sample_buffer.dropped.fetch_add(
+                    num_packets, std::memory_order_relaxed);
+                ThreadCounters::add(counters->dropped, num_packets);
+                continue;
+            }
+            auto enqueue_time = std::chrono::steady_clock::now();
             for (size_t ch = 0; ch < num_packets; ++ch) {
                 // new (pkg[ch]) Package(frame_id, symbol_id, 0, ant_id + ch);
                 new (pkg[ch]) Package(frame_id, symbol_id, cell, ant_id + ch);
-                // push kEventRxSymbol event into the queue
-                Event_data package_message;
-                package_message.event_type = kEventRxSymbol;
-                package_message.ant_id = ant_id + ch;
-                // data records the position of this packet in the buffer & tid of this socket
-                // (so that task thread could know which buffer it should visit)
-                package_message.data = cursor + tid * buffer_chunk_size;
-                if (message_queue_->enqueue(local_ptok, package_message)
-                    == false) {
-                    MLPD_ERROR("socket message enqueue failed\n");
-                    throw std::runtime_error("socket message enqueue failed");
+                sample_buffer.slots[sample_buffer.slotIndex(pos)].enqueue_time
+                    = enqueue_time;
+                // hand the position of this packet straight to the recorder
+                // thread that owns the antenna, it releases the slot
+                size_t recorder_id = (ant_id + ch) / ring_antennas;
+                if (rings.at(recorder_id)->push(pos) == false) {
+                    // Cannot happen while the rings hold num_slots entries
+                    sample_buffer.releaseSlot(pos);
+                    sample_buffer.dropped.fetch_add(
+                        1, std::memory_order_relaxed);
+                    ThreadCounters::add(counters->dropped);
+                    dropped++;
                 }
-                cursor++;
-                cursor %= buffer_chunk_size;
+                pos++;
             }
+            ThreadCounters::add(counters->packets, num_packets);
+            ThreadCounters::add(counters->bytes, num_packets * package_bytes);
         }
 
         // for UHD device update symbol_id on host
@@ -427,6 +466,9 @@ void Receiver::loopRecv(int tid, int core_id, SampleBuffer* rx_buffer)
             symbol_id++;
         }
     }
+    if (dropped > 0) {
+        MLPD_WARN("Receiver thread %d dropped %zu packages\n", tid, dropped);
+    }
     MLPD_SYMBOL(
         "Process %d -- Loop Rx Freed memory at: %p\n", tid, zeroes_memory);
     free(zeroes_memory);
@@ -461,7 +503,7 @@ void Receiver::clientTxRx(int tid)
 
     if (config_->core_alloc() == true) {
         int core
-            = tid + 1 + config_->rx_thread_num() + config_->task_thread_num();
+            = tid + config_->rx_thread_num() + config_->task_thread_num();
         MLPD_INFO("Pinning client TxRx thread %d to core %d\n", tid, core);
         if (pin_to_core(core) != 0) {
             MLPD_ERROR(
@@ -472,20 +514,27 @@ void Receiver::clientTxRx(int tid)
         }
     }
 
-    std::vector<std::complex<float>> buffs(NUM_SAMPS, 0);
+    // The radios stream in the client sample format, only its buffer is
+    // allocated
+    bool cs16 = (config_->cl_stream_format() == "cs16");
+    std::vector<std::complex<float>> buffs(cs16 ? 0 : NUM_SAMPS, 0);
+    std::vector<std::complex<int16_t>> buffs_cs16(cs16 ? NUM_SAMPS : 0, 0);
     std::vector<void*> rxbuff(2);
-    rxbuff[0] = buffs.data();
-    rxbuff[1] = buffs.data();
-
-    std::vector<void*> txbuff(2);
+    rxbuff[0] = cs16 ? (void*)buffs_cs16.data() : buffs.data();
+    rxbuff[1] = rxbuff[0];
+
+    // Frame frame_cnt sends UL data frame frame_cnt % ul_data_frame_num,
+    // already in the stream format
+    const TxDataRing* ul_data = config_->ul_data_sym_present()
+        ? this->tx_data_.at(tid).get()
+        : nullptr;
+    if (ul_data == nullptr)
+        txSyms = 0;
     if (txSyms > 0) {
-        size_t txIndex = tid * config_->cl_sdr_ch();
-        txbuff[0] = config_->txdata_time_dom().at(txIndex).data();
-        if (config_->cl_sdr_ch() == 2)
-            txbuff[1] = config_->txdata_time_dom().at(txIndex + 1).data();
         std::cout << txSyms << " uplink symbols will be sent per frame..."
                   << std::endl;
     }
+    size_t frame_cnt = 0;
 
     int all_trigs = 0;
     struct timespec tv, tv2;
@@ -515,6 +564,11 @@ void Receiver::clientTxRx(int tid)
             if (r == NUM_SAMPS) {
                 if (i == 0)
                     firstRxTime = rxTime;
+            } else if (r == 0) {
+                // The radio ended its stream
+                config_->running(false);
+                receiveErrors = true;
+                break;
             } else {
                 std::cerr << "waiting for receive frames... " << std::endl;
                 receiveErrors = true;
@@ -528,12 +582,13 @@ void Receiver::clientTxRx(int tid)
             txTime += ((long long)txStartSym << 16);
             //printf("rxTime %llx, txTime %llx \n", firstRxTime, txTime);
             for (int i = 0; i < txSyms; i++) {
-                int r = clientRadioSet_->radioTx(
-                    tid, txbuff.data(), NUM_SAMPS, 1, txTime);
+                int r = clientRadioSet_->radioTx(tid,
+                    ul_data->symbol(frame_cnt, i), NUM_SAMPS, 1, txTime);
                 if (r == NUM_SAMPS) {
                     txTime += 0x10000;
                 }
             }
+            frame_cnt++;
         } // end receiveErrors == false)
     } // end while config_->running() == true)
 }
@@ -542,7 +597,7 @@ void Receiver::clientSyncTxRx(int tid)
 {
     if (config_->core_alloc() == true) {
         int core
-            = tid + 1 + config_->rx_thread_num() + config_->task_thread_num();
+            = tid + config_->rx_thread_num() + config_->task_thread_num();
 
         MLPD_INFO("Pinning client synctxrx thread %d to core %d\n", tid, core);
         if (pin_to_core(core) != 0) {
@@ -566,10 +621,19 @@ void Receiver::clientSyncTxRx(int tid)
     int SYNC_NUM_SAMPS
         = config_->samps_per_symbol() * config_->symbols_per_frame();
 
-    std::vector<std::complex<float>> syncbuff0(SYNC_NUM_SAMPS, 0);
-    std::vector<std::complex<float>> syncbuff1(SYNC_NUM_SAMPS, 0);
+    // The radios stream in the client sample format, only its buffers are
+    // allocated
+    bool cs16 = (config_->cl_stream_format() == "cs16");
+    size_t sample_size = cs16 ? sizeof(std::complex<int16_t>)
+                              : sizeof(std::complex<float>);
+    size_t cf32_samps = cs16 ? 0 : SYNC_NUM_SAMPS;
+    size_t cs16_samps = cs16 ? SYNC_NUM_SAMPS : 0;
+    std::vector<std::complex<float>> syncbuff0(cf32_samps, 0);
+    std::vector<std::complex<float>> syncbuff1(cf32_samps, 0);
+    std::vector<std::complex<int16_t>> syncbuff0_cs16(cs16_samps, 0);
+    std::vector<std::complex<int16_t>> syncbuff1_cs16(cs16_samps, 0);
     std::vector<void*> syncrxbuff(2);
-    syncrxbuff.at(0) = syncbuff0.data();
+    syncrxbuff.at(0) = cs16 ? (void*)syncbuff0_cs16.data() : syncbuff0.data();
 
     std::vector<void*> pilotbuffA(2);
     std::vector<void*> pilotbuffB(2);
@@ -585,37 +649,25 @@ void Receiver::clientSyncTxRx(int tid)
         }
     }
 
-    pilotbuffA.at(0) = config_->pilot_cf32().data();
+    void* pilot = cs16 ? (void*)config_->pilot_ci16().data()
+                       : config_->pilot_cf32().data();
+    pilotbuffA.at(0) = pilot;
     if (config_->cl_sdr_ch() == 2) {
         pilotbuffA.at(1) = zeros.at(0);
-        pilotbuffB.at(1) = config_->pilot_cf32().data();
+        pilotbuffB.at(1) = pilot;
         pilotbuffB.at(0) = zeros.at(1);
-        syncrxbuff.at(1) = syncbuff1.data();
+        syncrxbuff.at(1)
+            = cs16 ? (void*)syncbuff1_cs16.data() : syncbuff1.data();
     }
 
-    std::vector<void*> txbuff(2);
-    for (size_t ch = 0; ch < config_->cl_sdr_ch(); ch++) {
-        txbuff.at(ch)
-            = std::calloc(config_->samps_per_symbol(), sizeof(float) * 2);
-    }
-    size_t slot_byte_size = config_->samps_per_symbol() * sizeof(float) * 2;
     size_t txSyms = config_->cl_ul_symbols().at(tid).size();
     if (txSyms > 0) {
-        size_t txIndex = tid * config_->cl_sdr_ch();
-        for (size_t ch = 0; ch < config_->cl_sdr_ch(); ch++) {
-            std::memcpy(txbuff.at(ch),
-                config_->txdata_time_dom().at(txIndex + ch).data(),
-                slot_byte_size);
-        }
         MLPD_INFO("%zu uplink symbols will be sent per frame...\n", txSyms);
     }
-
-    FILE* fp = nullptr;
-    if (config_->ul_data_sym_present() == true) {
-        std::printf("Opening UL time-domain data for radio %d to %s\n", tid,
-            config_->tx_td_data_files().at(tid).c_str());
-        fp = std::fopen(config_->tx_td_data_files().at(tid).c_str(), "rb");
-    }
+    // Frame frame_cnt sends UL data frame frame_cnt % ul_data_frame_num
+    const TxDataRing* ul_data = config_->ul_data_sym_present()
+        ? this->tx_data_.at(tid).get()
+        : nullptr;
 
     long long rxTime(0);
     long long txTime(0);
@@ -632,30 +684,41 @@ void Receiver::clientSyncTxRx(int tid)
         }
     }
 
-    // Keep reading one frame worth of data until a beacon is found
-    // Perform initial beacon detection once every BEACON_INTERVAL frames
+    // Keep reading one frame worth of data until a beacon is found. The
+    // reads are scanned as one stream, so a beacon split between two
+    // reads is found as well.
+    BeaconDetector beacon_detector(config_->gold_cf32(), SYNC_NUM_SAMPS);
+    auto detect_beacon = [&](int samples) {
+        return cs16 ? beacon_detector.process(syncbuff0_cs16.data(), samples)
+                    : beacon_detector.process(syncbuff0.data(), samples);
+    };
     while ((config_->running() == true) && (sync_index < 0)) {
-        int r;
-        for (int find_beacon_retry = 0; find_beacon_retry < BEACON_INTERVAL;
-             find_beacon_retry++) {
-            r = clientRadioSet_->radioRx(
-                tid, syncrxbuff.data(), SYNC_NUM_SAMPS, rxTime);
-            if (r != SYNC_NUM_SAMPS) {
-                MLPD_WARN("BAD SYNC Receive( %d / %d ) at Time %lld\n", r,
-                    SYNC_NUM_SAMPS, rxTime);
-            }
+        int r = clientRadioSet_->radioRx(
+            tid, syncrxbuff.data(), SYNC_NUM_SAMPS, rxTime);
+        if (r == 0) {
+            // The radio ended its stream before a beacon was found
+            config_->running(false);
+            break;
+        }
+        if (r != SYNC_NUM_SAMPS) {
+            MLPD_WARN("BAD SYNC Receive( %d / %d ) at Time %lld\n", r,
+                SYNC_NUM_SAMPS, rxTime);
+        }
+        if (r < 0) {
+            beacon_detector.reset();
+            continue;
         }
-        //TODO syncbuff0 is sloppy here since we recevied into syncrxbuff.data(), r bytes.
-#if defined(__x86_64__)
-        sync_index = CommsLib::find_beacon_avx(syncbuff0, config_->gold_cf32());
-#else
-        sync_index = CommsLib::find_beacon(syncbuff0);
-#endif
 
-        if (sync_index >= 0) {
-            MLPD_INFO("Beacon detected at Time %lld, sync_index: %d\n", rxTime,
-                sync_index);
-            rx_offset = sync_index - config_->beacon_size() - config_->prefix();
+        if (detect_beacon(r) == true) {
+            sync_index = beacon_detector.peak_index();
+            MLPD_INFO("Beacon detected at Time %lld, sync_index: %d, "
+                      "confidence: %.1f\n",
+                rxTime, sync_index, beacon_detector.confidence());
+            // Samples from the end of this read to the next frame start,
+            // the detected frame may have started in the previous read
+            rx_offset = sync_index - config_->beacon_size() - config_->prefix()
+                + SYNC_NUM_SAMPS - r;
+            rx_offset = (rx_offset + SYNC_NUM_SAMPS) % SYNC_NUM_SAMPS;
         }
     }
 
@@ -675,6 +738,8 @@ void Receiver::clientSyncTxRx(int tid)
     }
 
     // Main client read/write loop.
+    ThreadCounters* counters
+        = this->telemetry_->registerThread("client" + std::to_string(tid));
     size_t frame_cnt = 0;
     bool resync = false;
     bool resync_enable = (config_->frame_mode() == "continuous_resync");
@@ -693,11 +758,19 @@ void Receiver::clientSyncTxRx(int tid)
             assert((rx_len > 0) && (rx_len < SYNC_NUM_SAMPS));
             int r = clientRadioSet_->radioRx(
                 tid, syncrxbuff.data(), rx_len, rxTime);
-            if (r < 0) {
+            if (r == 0) {
+                // The radio ended its stream
+                config_->running(false);
+                break;
+            } else if (r < 0) {
+                ThreadCounters::add(counters->rx_errors);
                 config_->running(false);
                 break;
             }
+            ThreadCounters::add(counters->packets);
+            ThreadCounters::add(counters->bytes, r * sample_size);
             if (r != rx_len) {
+                ThreadCounters::add(counters->short_reads);
                 MLPD_WARN("BAD Receive(%d/%d) at Time %lld, frame count %zu\n",
                     r, rx_len, rxTime, frame_cnt);
             }
@@ -711,16 +784,11 @@ void Receiver::clientSyncTxRx(int tid)
                 }
                 rx_offset = 0;
                 if (resync == true) {
-                    //Need to bound the beacon detection to the last 'r not the size of the memory (vector)
-                    //TODO: Remove the copy and direct access to syncbuff0
-                    std::vector<std::complex<float>> radio_rx_data(
-                        syncbuff0.begin(), syncbuff0.begin() + r);
-#if defined(__x86_64__)
-                    sync_index = CommsLib::find_beacon_avx(
-                        radio_rx_data, config_->gold_cf32());
-#else
-                    sync_index = CommsLib::find_beacon(radio_rx_data);
-#endif
+                    // Only the first symbol of each frame is scanned, so
+                    // every check starts a new stream
+                    beacon_detector.reset();
+                    detect_beacon(r);
+                    sync_index = beacon_detector.peak_index();
                     if (sync_index >= 0) {
                         rx_offset = sync_index - config_->beacon_size()
                             - config_->prefix();
@@ -728,9 +796,12 @@ void Receiver::clientSyncTxRx(int tid)
                         resync = false;
                         resync_retry_cnt = 0;
                         resync_success++;
+                        ThreadCounters::add(counters->resyncs);
                         MLPD_INFO("Re-syncing with offset: %d, after %zu "
-                                  "tries, index: %d, tid %d\n",
-                            rx_offset, resync_retry_cnt + 1, sync_index, tid);
+                                  "tries, index: %d, confidence: %.1f, "
+                                  "tid %d\n",
+                            rx_offset, resync_retry_cnt + 1, sync_index,
+                            beacon_detector.confidence(), tid);
                     } else {
                         resync_retry_cnt++;
                     }
@@ -755,6 +826,7 @@ void Receiver::clientSyncTxRx(int tid)
                 r = clientRadioSet_->radioTx(
                     tid, pilotbuffA.data(), NUM_SAMPS, flags, txTime);
                 if (r < NUM_SAMPS) {
+                    countTx(counters, r);
                     MLPD_WARN("BAD Write: %d/%d\n", r, NUM_SAMPS);
                 }
                 if (config_->cl_sdr_ch() == 2) {
@@ -765,6 +837,7 @@ void Receiver::clientSyncTxRx(int tid)
                     r = clientRadioSet_->radioTx(tid, pilotbuffB.data(),
                         NUM_SAMPS, kStreamEndBurst, txTime);
                     if (r < NUM_SAMPS) {
+                        countTx(counters, r);
                         MLPD_WARN("BAD Write: %d/%d\n", r, NUM_SAMPS);
                     }
                 }
@@ -773,39 +846,27 @@ void Receiver::clientSyncTxRx(int tid)
                         txTime = rxTime + txTimeDelta
                             + config_->cl_ul_symbols().at(tid).at(s) * NUM_SAMPS
                             - config_->tx_advance();
-                        for (size_t ch = 0; ch < config_->cl_sdr_ch(); ch++) {
-                            size_t read_num
-                                = std::fread(txbuff.at(ch), 2 * sizeof(float),
-                                    config_->samps_per_symbol(), fp);
-                            if (read_num != config_->samps_per_symbol()) {
-                                MLPD_WARN("BAD Uplink Data Read: %zu/%zu\n",
-                                    read_num, config_->samps_per_symbol());
-                            }
-                        }
                         if (kUseUHD && s < (txSyms - 1))
                             flagsTxUlData = 1; // HAS_TIME
                         else
                             flagsTxUlData = 2; // HAS_TIME & END_BURST, fixme
-                        r = clientRadioSet_->radioTx(tid, txbuff.data(),
-                            NUM_SAMPS, flagsTxUlData, txTime);
+                        r = clientRadioSet_->radioTx(tid,
+                            ul_data->symbol(frame_cnt, s), NUM_SAMPS,
+                            flagsTxUlData, txTime);
                         if (r < NUM_SAMPS) {
+                            countTx(counters, r);
                             MLPD_WARN("BAD Write: %d/%d\n", r, NUM_SAMPS);
                         }
                     } // end for
-                    if (frame_cnt % config_->ul_data_frame_num() == 0)
-                        std::fseek(fp, 0, SEEK_SET);
                 } // end if config_->ul_data_sym_present()
             } // end if sf == 0
         } // end for
         frame_cnt++;
     } // end while
-    if (config_->ul_data_sym_present() == true || fp != nullptr) {
-        std::fclose(fp);
-    }
-
-    for (size_t ch = 0; ch < config_->cl_sdr_ch(); ch++) {
-        std::free(txbuff.at(ch));
-    }
+    MLPD_INFO("Client %d sent %zu frames, %zu late and %zu short TX "
+              "writes\n",
+        tid, frame_cnt, static_cast<size_t>(counters->late_tx.load()),
+        static_cast<size_t>(counters->short_writes.load()));
 
     for (auto memory : zeros) {
         MLPD_SYMBOL("Process %d -- Client Sync Tx Rx Freed memory at %p\n", tid,
@@ -0,0 +1,418 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Metadata of a recording as written to the /Data group attributes,
+ shared by the HDF5 and raw recorders and the raw capture converter
+---------------------------------------------------------------------
+*/
+
+#include "include/record_attributes.h"
+
+using json = nlohmann::json;
+
+namespace Sounder {
+Hdf5AttributeSink::Hdf5AttributeSink(H5::Group& group)
+    : group_(group)
+{
+}
+
+void Hdf5AttributeSink::write(const char name[], double val)
+{
+    hsize_t dims[] = { 1 };
+    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
+    H5::Attribute att = this->group_.createAttribute(
+        name, H5::PredType::NATIVE_DOUBLE, attr_ds);
+    att.write(H5::PredType::NATIVE_DOUBLE, &val);
+}
+
+void Hdf5AttributeSink::write(
+    const char name[], const std::vector<double>& val)
+{
+    size_t size = val.size();
+    hsize_t dims[] = { size };
+    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
+    H5::Attribute att = this->group_.createAttribute(
+        name, H5::PredType::NATIVE_DOUBLE, attr_ds);
+    att.write(H5::PredType::NATIVE_DOUBLE, &val[0]);
+}
+
+void Hdf5AttributeSink::write(
+    const char name[], const std::vector<std::complex<float>>& val)
+{
+    size_t size = val.size();
+    hsize_t dims[] = { 2 * size };
+    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
+    H5::Attribute att = this->group_.createAttribute(
+        name, H5::PredType::NATIVE_DOUBLE, attr_ds);
+    double val_pair[2 * size];
+    for (size_t j = 0; j < size; j++) {
+        val_pair[2 * j + 0] = std::real(val[j]);
+        val_pair[2 * j + 1] = std::imag(val[j]);
+    }
+    att.write(H5::PredType::NATIVE_DOUBLE, &val_pair[0]);
+}
+
+void Hdf5AttributeSink::write(const char name[], size_t val)
+{
+    hsize_t dims[] = { 1 };
+    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
+    H5::Attribute att
+        = this->group_.createAttribute(name, H5::PredType::STD_U32BE, attr_ds);
+    uint32_t val_uint = val;
+    att.write(H5::PredType::NATIVE_UINT, &val_uint);
+}
+
+void Hdf5AttributeSink::write(const char name[], int val)
+{
+    hsize_t dims[] = { 1 };
+    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
+    H5::Attribute att
+        = this->group_.createAttribute(name, H5::PredType::STD_I32BE, attr_ds);
+    att.write(H5::PredType::NATIVE_INT, &val);
+}
+
+void Hdf5AttributeSink::write(
+    const char name[], const std::vector<size_t>& val)
+{
+    size_t size = val.size();
+    hsize_t dims[] = { size };
+    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
+    H5::Attribute att
+        = this->group_.createAttribute(name, H5::PredType::STD_U32BE, attr_ds);
+    std::vector<uint32_t> val_uint;
+    for (size_t i = 0; i < val.size(); i++)
+        val_uint.push_back((uint32_t)val.at(i));
+    att.write(H5::PredType::NATIVE_UINT, &val_uint[0]);
+}
+
+void Hdf5AttributeSink::write(const char name[], const std::string& val)
+{
+    hsize_t dims[] = { 1 };
+    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
+    H5::StrType strdatatype(
+        H5::PredType::C_S1, H5T_VARIABLE); // of variable length characters
+    H5::Attribute att
+        = this->group_.createAttribute(name, strdatatype, attr_ds);
+    att.write(strdatatype, val);
+}
+
+void Hdf5AttributeSink::write(
+    const char name[], const std::vector<std::string>& val)
+{
+    if (val.empty())
+        return;
+    size_t size = val.size();
+    H5::StrType strdatatype(
+        H5::PredType::C_S1, H5T_VARIABLE); // of variable length characters
+    hsize_t dims[] = { size };
+    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
+    H5::Attribute att
+        = this->group_.createAttribute(name, strdatatype, attr_ds);
+    const char* cStrArray[size];
+
+    for (size_t i = 0; i < size; ++i)
+        cStrArray[i] = val[i].c_str();
+    att.write(strdatatype, cStrArray);
+}
+
+JsonAttributeSink::JsonAttributeSink(json& attributes)
+    : attributes_(attributes)
+{
+}
+
+void JsonAttributeSink::add(const char name[], const char type[], json value)
+{
+    json attribute;
+    attribute["name"] = name;
+    attribute["type"] = type;
+    attribute["value"] = std::move(value);
+    this->attributes_.push_back(attribute);
+}
+
+void JsonAttributeSink::write(const char name[], double val)
+{
+    this->add(name, "f64", val);
+}
+
+void JsonAttributeSink::write(
+    const char name[], const std::vector<double>& val)
+{
+    this->add(name, "f64", val);
+}
+
+void JsonAttributeSink::write(
+    const char name[], const std::vector<std::complex<float>>& val)
+{
+    json pairs = json::array();
+    for (auto& v : val) {
+        pairs.push_back(static_cast<double>(std::real(v)));
+        pairs.push_back(static_cast<double>(std::imag(v)));
+    }
+    this->add(name, "f64", pairs);
+}
+
+void JsonAttributeSink::write(const char name[], size_t val)
+{
+    this->add(name, "u32", val);
+}
+
+void JsonAttributeSink::write(const char name[], int val)
+{
+    this->add(name, "i32", val);
+}
+
+void JsonAttributeSink::write(
+    const char name[], const std::vector<size_t>& val)
+{
+    this->add(name, "u32", val);
+}
+
+void JsonAttributeSink::write(const char name[], const std::string& val)
+{
+    this->add(name, "str", val);
+}
+
+void JsonAttributeSink::write(
+    const char name[], const std::vector<std::string>& val)
+{
+    if (val.empty())
+        return;
+    this->add(name, "str", val);
+}
+
+std::string recordByteOrder(const Config* cfg)
+{
+    if (cfg->record_byte_order() != "native")
+        return cfg->record_byte_order();
+    return H5::PredType::NATIVE_INT16.getOrder() == H5T_ORDER_BE ? "big"
+                                                                 : "little";
+}
+
+void writeRecordAttributes(Config* cfg, size_t antenna_offset,
+    size_t num_antennas, AttributeSink& sink)
+{
+    // ******* COMMON ******** //
+    // TX/RX Frequencyfile
+    sink.write("FREQ", cfg->freq());
+
+    // BW
+    sink.write("RATE", cfg->rate());
+
+    // Number of samples on each symbol (excluding prefix/postfix)
+    sink.write("SYMBOL_LEN_NO_PAD", cfg->subframe_size());
+
+    // Number of samples for prefix (padding)
+    sink.write("PREFIX_LEN", cfg->prefix());
+
+    // Number of samples for postfix (padding)
+    sink.write("POSTFIX_LEN", cfg->postfix());
+
+    // Number of samples on each symbol including prefix and postfix
+    sink.write("SYMBOL_LEN", cfg->samps_per_symbol());
+
+    // Size of FFT
+    sink.write("FFT_SIZE", cfg->fft_size());
+
+    // Number of data subcarriers in ofdm symbols
+    sink.write("DATA_SUBCARRIER_NUM", cfg->symbol_data_subcarrier_num());
+
+    // Length of cyclic prefix
+    sink.write("CP_LEN", cfg->cp_size());
+
+    // Beacon sequence type (string)
+    sink.write("BEACON_SEQ_TYPE", cfg->beacon_seq());
+
+    // Pilot sequence type (string)
+    sink.write("PILOT_SEQ_TYPE", cfg->pilot_seq());
+
+    // Byte order of the IQ samples ("little" or "big")
+    sink.write("SAMPLE_BYTE_ORDER", recordByteOrder(cfg));
+
+    // ******* Base Station ******** //
+    // Hub IDs (vec of strings)
+    sink.write("BS_HUB_ID", cfg->hub_ids());
+
+    // BS SDR IDs
+    // *** first, how many boards in each cell? ***
+    std::vector<std::string> bs_sdr_num_per_cell(cfg->bs_sdr_ids().size());
+    for (size_t i = 0; i < bs_sdr_num_per_cell.size(); ++i) {
+        bs_sdr_num_per_cell[i]
+            = std::to_string(cfg->bs_sdr_ids().at(i).size());
+    }
+    sink.write("BS_SDR_NUM_PER_CELL", bs_sdr_num_per_cell);
+
+    // *** second, reshape matrix into vector ***
+    std::vector<std::string> bs_sdr_id;
+    for (auto&& v : cfg->bs_sdr_ids()) {
+        bs_sdr_id.insert(bs_sdr_id.end(), v.begin(), v.end());
+    }
+    sink.write("BS_SDR_ID", bs_sdr_id);
+
+    // Number of Base Station Cells
+    sink.write("BS_NUM_CELLS", cfg->num_cells());
+
+    // How many RF channels per Iris board are enabled ("single" or "dual")
+    sink.write("BS_CH_PER_RADIO", cfg->bs_channel().length());
+
+    // Frame schedule (vec of strings for now, this should change to matrix when we go to multi-cell)
+    sink.write("BS_FRAME_SCHED", cfg->frames());
+
+    // RX Gain RF channel A
+    sink.write("BS_RX_GAIN_A", cfg->rx_gain().at(0));
+
+    // TX Gain RF channel A
+    sink.write("BS_TX_GAIN_A", cfg->tx_gain().at(0));
+
+    // RX Gain RF channel B
+    sink.write("BS_RX_GAIN_B", cfg->rx_gain().at(1));
+
+    // TX Gain RF channel B
+    sink.write("BS_TX_GAIN_B", cfg->tx_gain().at(1));
+
+    // Beamsweep (true or false)
+    sink.write("BS_BEAMSWEEP", cfg->beam_sweep() ? 1 : 0);
+
+    // Beacon Antenna
+    sink.write("BS_BEACON_ANT", cfg->beacon_ant());
+
+    // Number of antennas on Base Station (per cell)
+    std::vector<std::string> bs_ant_num_per_cell(cfg->bs_sdr_ids().size());
+    for (size_t i = 0; i < bs_ant_num_per_cell.size(); ++i) {
+        bs_ant_num_per_cell[i] = std::to_string(
+            cfg->bs_sdr_ids().at(i).size() * cfg->bs_channel().length());
+    }
+    sink.write("BS_ANT_NUM_PER_CELL", bs_ant_num_per_cell);
+
+    //If the antennas are non consective this will be an issue.
+    sink.write("ANT_OFFSET", antenna_offset);
+    sink.write("ANT_NUM", num_antennas);
+    sink.write("ANT_TOTAL", cfg->getTotNumAntennas());
+
+    // Number of symbols in a frame
+    sink.write("BS_FRAME_LEN", cfg->symbols_per_frame());
+
+    // Number of uplink symbols per frame
+    sink.write("UL_SYMS", cfg->ul_syms_per_frame());
+
+    // Reciprocal Calibration Mode
+    sink.write("RECIPROCAL_CALIB", cfg->reciprocal_calib() ? 1 : 0);
+
+    // ******* Clients ******** //
+    // Freq. Domain Pilot symbols
+    std::vector<double> split_vec_pilot_f(2 * cfg->pilot_sym_f().at(0).size());
+    for (size_t i = 0; i < cfg->pilot_sym_f().at(0).size(); i++) {
+        split_vec_pilot_f[2 * i + 0] = cfg->pilot_sym_f().at(0).at(i);
+        split_vec_pilot_f[2 * i + 1] = cfg->pilot_sym_f().at(1).at(i);
+    }
+    sink.write("OFDM_PILOT_F", split_vec_pilot_f);
+
+    // Time Domain Pilot symbols
+    std::vector<double> split_vec_pilot(2 * cfg->pilot_sym().at(0).size());
+    for (size_t i = 0; i < cfg->pilot_sym().at(0).size(); i++) {
+        split_vec_pilot[2 * i + 0] = cfg->pilot_sym().at(0).at(i);
+        split_vec_pilot[2 * i + 1] = cfg->pilot_sym().at(1).at(i);
+    }
+    sink.write("OFDM_PILOT", split_vec_pilot);
+
+    // Number of Pilots
+    sink.write("PILOT_NUM", cfg->pilot_syms_per_frame());
+
+    // Subcarriers of the rows of /Data/CSI
+    if (cfg->record_csi() == true)
+        sink.write("CSI_DATA_SC", cfg->data_ind());
+
+    // Number of Client Antennas
+    sink.write("CL_NUM", cfg->num_cl_antennas());
+
+    // Data modulation
+    sink.write("CL_MODULATION", cfg->data_mod());
+
+    if (cfg->client_present() == true) {
+        // Client antenna polarization
+        sink.write("CL_CH_PER_RADIO", cfg->cl_sdr_ch());
+
+        // Client AGC enable flag
+        sink.write("CL_AGC_EN", cfg->cl_agc_en() ? 1 : 0);
+
+        // RX Gain RF channel A
+        sink.write("CL_RX_GAIN_A", cfg->cl_rxgain_vec().at(0));
+
+        // TX Gain RF channel A
+        sink.write("CL_TX_GAIN_A", cfg->cl_txgain_vec().at(0));
+
+        // RX Gain RF channel B
+        sink.write("CL_RX_GAIN_B", cfg->cl_rxgain_vec().at(1));
+
+        // TX Gain RF channel B
+        sink.write("CL_TX_GAIN_B", cfg->cl_txgain_vec().at(1));
+
+        // Number of frames for UL data recorded in bit source files
+        sink.write("UL_DATA_FRAME_NUM", cfg->ul_data_frame_num());
+
+        // Names of Files including uplink tx frequency-domain data
+        if (cfg->tx_fd_data_files().size() > 0) {
+            sink.write("TX_FD_DATA_FILENAMES", cfg->tx_fd_data_files());
+        }
+
+        // Client frame schedule (vec of strings)
+        sink.write("CL_FRAME_SCHED", cfg->cl_frames());
+
+        // Set of client SDR IDs (vec of strings)
+        sink.write("CL_SDR_ID", cfg->cl_sdr_ids());
+    }
+
+    if (cfg->ul_data_sym_present()) {
+        // Data subcarriers
+        if (cfg->data_ind().size() > 0)
+            sink.write("OFDM_DATA_SC", cfg->data_ind());
+
+        // Pilot subcarriers (indexes)
+        if (cfg->pilot_sc_ind().size() > 0)
+            sink.write("OFDM_PILOT_SC", cfg->pilot_sc_ind());
+        if (cfg->pilot_sc().size() > 0)
+            sink.write("OFDM_PILOT_SC_VALS", cfg->pilot_sc());
+
+        // Freq. Domain Data Symbols
+        for (size_t i = 0; i < cfg->txdata_freq_dom().size(); i++) {
+            std::string var = std::string("OFDM_DATA_CL") + std::to_string(i);
+            sink.write(var.c_str(), cfg->txdata_freq_dom().at(i));
+        }
+
+        // Time Domain Data Symbols
+        for (size_t i = 0; i < cfg->txdata_time_dom().size(); i++) {
+            std::string var
+                = std::string("OFDM_DATA_TIME_CL") + std::to_string(i);
+            sink.write(var.c_str(), cfg->txdata_time_dom().at(i));
+        }
+    }
+}
+
+void replayAttributes(const json& attributes, AttributeSink& sink)
+{
+    for (auto& attribute : attributes) {
+        std::string name = attribute.at("name").get<std::string>();
+        std::string type = attribute.at("type").get<std::string>();
+        const json& value = attribute.at("value");
+        if (type == "f64" && value.is_array()) {
+            sink.write(name.c_str(), value.get<std::vector<double>>());
+        } else if (type == "f64") {
+            sink.write(name.c_str(), value.get<double>());
+        } else if (type == "u32" && value.is_array()) {
+            sink.write(name.c_str(), value.get<std::vector<size_t>>());
+        } else if (type == "u32") {
+            sink.write(name.c_str(), value.get<size_t>());
+        } else if (type == "i32" && value.is_array() == false) {
+            sink.write(name.c_str(), value.get<int>());
+        } else if (type == "str" && value.is_array()) {
+            sink.write(name.c_str(), value.get<std::vector<std::string>>());
+        } else if (type == "str") {
+            sink.write(name.c_str(), value.get<std::string>());
+        } else {
+            throw std::runtime_error(
+                "Unsupported attribute type " + type + " for " + name);
+        }
+    }
+}
+}; //End namespace Sounder
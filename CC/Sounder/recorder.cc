@@ -15,19 +15,17 @@
 namespace Sounder {
 // buffer length of each rx thread
 const int Recorder::kSampleBufferFrameNum = 80;
-// dequeue bulk size, used to reduce the overhead of dequeue in main thread
-const int Recorder::KDequeueBulkSize = 5;
+// main thread polling period, the recorder threads are fed directly by
+// the rx threads
+const int Recorder::kStatusPollMs = 10;
 
 #if (DEBUG_PRINT)
 const int kDsSim = 5;
 #endif
 
-static const int kQueueSize = 36;
-
 Recorder::Recorder(Config* in_cfg, unsigned int core_start)
     : cfg_(in_cfg)
-    , kMainDispatchCore(core_start)
-    , kRecorderCore(kMainDispatchCore + 1)
+    , kRecorderCore(core_start)
     , kRecvCore(kRecorderCore + in_cfg->task_thread_num())
 {
     size_t rx_thread_num = cfg_->rx_thread_num();
@@ -37,8 +35,17 @@ Recorder::Recorder(Config* in_cfg, unsigned int core_start)
     rx_thread_buff_size_
         = kSampleBufferFrameNum * cfg_->symbols_per_frame() * ant_per_rx_thread;
 
-    message_queue_ = moodycamel::ConcurrentQueue<Event_data>(
-        rx_thread_buff_size_ * kQueueSize);
+    size_t recorder_threads = cfg_->task_thread_num();
+    size_t total_antennas = cfg_->getTotNumAntennas();
+    thread_antennas_ = 0;
+    if (recorder_threads > 0) {
+        thread_antennas_ = (total_antennas / recorder_threads);
+        // If antennas are left, distribute them over the threads. This may assign antennas that don't
+        // exist to the threads at the end. This isn't a concern.
+        if ((total_antennas % recorder_threads) != 0) {
+            thread_antennas_ = (thread_antennas_ + 1);
+        }
+    }
 
     MLPD_TRACE("Recorder construction: rx threads: %zu, recorder threads: %u, "
                "chunk size: %zu\n",
@@ -47,19 +54,27 @@ Recorder::Recorder(Config* in_cfg, unsigned int core_start)
     if (rx_thread_num > 0) {
         // initialize rx buffers
         rx_buffer_ = new SampleBuffer[rx_thread_num];
-        size_t intsize = sizeof(std::atomic_int);
-        size_t arraysize = (rx_thread_buff_size_ + intsize - 1) / intsize;
         size_t packageLength = sizeof(Package) + cfg_->getPackageDataLength();
         for (size_t i = 0; i < rx_thread_num; i++) {
             rx_buffer_[i].buffer.resize(rx_thread_buff_size_ * packageLength);
-            rx_buffer_[i].pkg_buf_inuse = new std::atomic_int[arraysize];
-            std::fill_n(rx_buffer_[i].pkg_buf_inuse, arraysize, 0);
+            rx_buffer_[i].slots.reset(new SlotState[rx_thread_buff_size_]());
+            rx_buffer_[i].num_slots = rx_thread_buff_size_;
+            rx_buffer_[i].dropped = 0;
+            // A ring never holds more packages than the buffer has slots
+            rx_buffer_[i].ring_antennas = thread_antennas_;
+            for (size_t j = 0; j < recorder_threads; j++) {
+                rx_buffer_[i].rings.emplace_back(
+                    new SpscRing<size_t>(rx_thread_buff_size_));
+            }
         }
     }
 
+    telemetry_.reset(
+        new Telemetry(cfg_->telemetry(), cfg_->telemetry_period_ms()));
+
     // Receiver object will be used for both BS and clients
     try {
-        receiver_.reset(new Receiver(rx_thread_num, cfg_, &message_queue_));
+        receiver_.reset(new Receiver(rx_thread_num, cfg_, telemetry_.get()));
     } catch (std::exception& e) {
         std::cout << e.what() << '\n';
         gc();
@@ -72,9 +87,6 @@ void Recorder::gc(void)
     MLPD_TRACE("Garbage collect\n");
     this->receiver_.reset();
     if (this->cfg_->rx_thread_num() > 0) {
-        for (size_t i = 0; i < this->cfg_->rx_thread_num(); i++) {
-            delete[] this->rx_buffer_[i].pkg_buf_inuse;
-        }
         delete[] this->rx_buffer_;
     }
 }
@@ -84,31 +96,18 @@ Recorder::~Recorder() { this->gc(); }
 void Recorder::do_it()
 {
     size_t recorder_threads = this->cfg_->task_thread_num();
-    size_t total_antennas = cfg_->getTotNumAntennas();
-    size_t thread_antennas = 0;
+    size_t thread_antennas = this->thread_antennas_;
     std::vector<pthread_t> recv_threads;
+    std::vector<pthread_t> client_threads;
 
+    // The main thread only polls the rings, so it is not given a core
     MLPD_TRACE("Recorder work thread\n");
-    if ((this->cfg_->core_alloc() == true)
-        && (pin_to_core(kMainDispatchCore) != 0)) {
-        MLPD_ERROR("Pinning main recorder thread to core 0 failed");
-        throw std::runtime_error(
-            "Pinning main recorder thread to core 0 failed");
-    }
-
+    this->telemetry_->start();
     if (this->cfg_->client_present() == true) {
-        auto client_threads = this->receiver_->startClientThreads();
+        client_threads = this->receiver_->startClientThreads();
     }
 
     if (this->cfg_->rx_thread_num() > 0) {
-
-        thread_antennas = (total_antennas / recorder_threads);
-        // If antennas are left, distribute them over the threads. This may assign antennas that don't
-        // exist to the threads at the end. This isn't a concern.
-        if ((total_antennas % recorder_threads) != 0) {
-            thread_antennas = (thread_antennas + 1);
-        }
-
         for (unsigned int i = 0u; i < recorder_threads; i++) {
             int thread_core = -1;
             if (this->cfg_->core_alloc() == true) {
@@ -121,8 +120,8 @@ void Recorder::do_it()
                 thread_antennas);
             Sounder::RecorderThread* new_recorder
                 = new Sounder::RecorderThread(this->cfg_, i, thread_core,
-                    (this->rx_thread_buff_size_ * kQueueSize),
-                    (i * thread_antennas), thread_antennas, true);
+                    this->rx_buffer_, (i * thread_antennas), thread_antennas,
+                    this->telemetry_.get(), true);
             new_recorder->Start();
             this->recorders_.push_back(new_recorder);
         }
@@ -133,51 +132,24 @@ void Recorder::do_it()
     } else
         this->receiver_->go(); // only beamsweeping
 
-    moodycamel::ConsumerToken ctok(this->message_queue_);
-
-    Event_data events_list[KDequeueBulkSize];
-    int ret = 0;
-
-    /* TODO : we can probably remove the dispatch function and pass directly to the recievers */
+    // The rx threads hand packets directly to the recorder threads, watch
+    // their rings here until the recording stops
+    ThreadCounters* counters = this->telemetry_->registerThread("main");
     while ((this->cfg_->running() == true)
         && (SignalHandler::gotExitSignal() == false)) {
-        // get a bulk of events from the receivers
-        ret = this->message_queue_.try_dequeue_bulk(
-            ctok, events_list, KDequeueBulkSize);
-        //if (ret > 0)
-        //{
-        //    MLPD_TRACE("Message(s) received: %d\n", ret );
-        //}
-        // handle each event
-        for (int bulk_count = 0; bulk_count < ret; bulk_count++) {
-            Event_data& event = events_list[bulk_count];
-
-            // if kEventRxSymbol, dispatch to proper worker
-            if (event.event_type == kEventRxSymbol) {
-                size_t thread_index = event.ant_id / thread_antennas;
-                int offset = event.data;
-                Sounder::RecorderThread::RecordEventData do_record_task;
-                do_record_task.event_type
-                    = Sounder::RecorderThread::RecordEventType::kTaskRecord;
-                do_record_task.data = offset;
-                do_record_task.rx_buffer = this->rx_buffer_;
-                do_record_task.rx_buff_size = this->rx_thread_buff_size_;
-                // Pass the work off to the applicable worker
-                // Worker must free the buffer, future work would involve making this cleaner
-
-                //If no worker threads, it is possible to handle the event directly.
-                //this->worker_.handleEvent(do_record_task, 0);
-                if (this->recorders_.at(thread_index)
-                        ->DispatchWork(do_record_task)
-                    == false) {
-                    MLPD_ERROR("Record task enqueue failed\n");
-                    throw std::runtime_error("Record task enqueue failed");
-                }
-            }
+        std::this_thread::sleep_for(std::chrono::milliseconds(kStatusPollMs));
+        size_t dropped = 0;
+        for (size_t i = 0; i < this->cfg_->rx_thread_num(); i++) {
+            for (auto& ring : this->rx_buffer_[i].rings)
+                ThreadCounters::max(counters->queue_hwm, ring->size());
+            dropped += this->rx_buffer_[i].dropped.load();
         }
+        counters->dropped.store(dropped, std::memory_order_relaxed);
     }
     this->cfg_->running(false);
     this->receiver_->completeRecvThreads(recv_threads);
+    // Client threads use the radios owned by the receiver
+    this->receiver_->completeRecvThreads(client_threads);
     this->receiver_.reset();
 
     /* Force the recorders to process all of the data they have left and exit cleanly
@@ -185,10 +157,18 @@ void Recorder::do_it()
     for (auto recorder : this->recorders_) {
         recorder->Stop();
     }
+    this->stats_ = RecorderStats();
     for (auto recorder : this->recorders_) {
+        recorder->Finalize();
+        this->stats_.merge(recorder->stats());
         delete recorder;
     }
     this->recorders_.clear();
+    for (size_t i = 0; i < this->cfg_->rx_thread_num(); i++) {
+        this->stats_.dropped += this->rx_buffer_[i].dropped.load();
+    }
+    counters->dropped.store(this->stats_.dropped, std::memory_order_relaxed);
+    this->telemetry_->stop();
 }
 
 int Recorder::getRecordedFrameNum() { return this->max_frame_number_; }
@@ -0,0 +1,217 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Replays a recorded trace through RecorderWorker once per HDF5 filter
+ chain and reports the write throughput against the compression ratio
+---------------------------------------------------------------------
+*/
+
+#include "include/recorder_worker.h"
+#include "include/utils.h"
+#include "nlohmann/json.hpp"
+#include <gflags/gflags.h>
+
+using json = nlohmann::json;
+
+DEFINE_string(conf, "files/conf.json",
+    "JSON configuration file the trace was recorded with");
+DEFINE_string(trace, "", "Recorded HDF5 trace file to replay");
+DEFINE_string(storepath, "logs", "Directory for the benchmark output files");
+DEFINE_string(filters,
+    "none,shuffle+deflate,deflate,lz4,shuffle+lz4,blosc",
+    "Comma separated list of filter chains to compare");
+DEFINE_string(byte_orders, "native",
+    "Comma separated list of sample byte orders (native, little, big)");
+DEFINE_uint64(frames, 200, "Maximum number of trace frames to replay");
+DEFINE_bool(keep, false, "Keep the output files");
+
+static const size_t kNumDatasets = 3;
+static const char* kDatasetNames[kNumDatasets]
+    = { "/Data/Pilot_Samples", "/Data/Noise_Samples", "/Data/UplinkData" };
+
+// Samples of one dataset as {frame, cell, symbol, antenna, IQ}
+struct TraceDataset {
+    bool present;
+    hsize_t dims[5];
+    std::vector<short> samples;
+};
+
+static size_t frame_size(const TraceDataset& ds)
+{
+    return ds.dims[1] * ds.dims[2] * ds.dims[3] * ds.dims[4];
+}
+
+// Read up to max_frames frames of each dataset in the trace and drop the
+// trailing frames that were never written
+static size_t load_trace(const std::string& filename, size_t max_frames,
+    std::vector<TraceDataset>& trace)
+{
+    H5::H5File file(filename, H5F_ACC_RDONLY);
+    size_t num_frames = 0;
+    trace.resize(kNumDatasets);
+    for (size_t i = 0; i < kNumDatasets; i++) {
+        TraceDataset& ds = trace.at(i);
+        ds.present = H5Lexists(file.getId(), kDatasetNames[i], H5P_DEFAULT) > 0;
+        if (ds.present == false)
+            continue;
+        H5::DataSet dataset = file.openDataSet(kDatasetNames[i]);
+        H5::DataSpace filespace = dataset.getSpace();
+        filespace.getSimpleExtentDims(ds.dims);
+        ds.dims[0] = std::min<hsize_t>(ds.dims[0], max_frames);
+        hsize_t offset[5] = { 0, 0, 0, 0, 0 };
+        filespace.selectHyperslab(H5S_SELECT_SET, ds.dims, offset);
+        H5::DataSpace memspace(5, ds.dims, NULL);
+        ds.samples.resize(ds.dims[0] * frame_size(ds));
+        dataset.read(ds.samples.data(), H5::PredType::NATIVE_INT16, memspace,
+            filespace);
+
+        size_t last = ds.samples.size();
+        while ((last > 0) && (ds.samples.at(last - 1) == 0))
+            last--;
+        num_frames = std::max(num_frames,
+            (last + frame_size(ds) - 1) / std::max<size_t>(1, frame_size(ds)));
+    }
+    return num_frames;
+}
+
+// Replay num_frames frames of the trace in the order the receiver delivers
+// them. Returns the number of sample bytes recorded.
+static size_t replay(Config* cfg, Sounder::RecorderWorker& worker,
+    const std::vector<TraceDataset>& trace, size_t num_frames)
+{
+    size_t IQ = 2 * cfg->samps_per_symbol();
+    std::vector<char> buffer(sizeof(Package) + IQ * sizeof(short));
+    size_t bytes = 0;
+    for (size_t frame = 0; frame < num_frames; frame++) {
+        for (size_t cell = 0; cell < cfg->num_cells(); cell++) {
+            for (size_t sym = 0; sym < cfg->symbols_per_frame(); sym++) {
+                const Config::SymbolInfo& info = cfg->symbolInfo(frame, sym);
+                size_t sym_index = info.index;
+                size_t ds_index;
+                if (info.type == Config::SymbolType::kPilot) {
+                    ds_index = 0;
+                } else if (info.type == Config::SymbolType::kUplink) {
+                    ds_index = 2;
+                } else if (info.type == Config::SymbolType::kNoise) {
+                    ds_index = 1;
+                } else {
+                    continue;
+                }
+                const TraceDataset& ds = trace.at(ds_index);
+                if ((ds.present == false) || (frame >= ds.dims[0]))
+                    continue;
+                for (size_t ant = 0; ant < ds.dims[3]; ant++) {
+                    Package* pkg
+                        = new (buffer.data()) Package(frame, sym, cell, ant);
+                    size_t offset = frame * frame_size(ds)
+                        + ((cell * ds.dims[2] + sym_index) * ds.dims[3] + ant)
+                            * IQ;
+                    std::memcpy(pkg->data, &ds.samples.at(offset),
+                        IQ * sizeof(short));
+                    worker.record(0, pkg, std::chrono::steady_clock::now());
+                    bytes += IQ * sizeof(short);
+                }
+            }
+        }
+    }
+    return bytes;
+}
+
+// Compare the recorded file against the trace, returns the bytes the
+// datasets take on disk or 0 on a mismatch
+static size_t check_output(const std::string& filename,
+    const std::vector<TraceDataset>& trace, size_t num_frames)
+{
+    H5::H5File file(filename, H5F_ACC_RDONLY);
+    size_t storage = 0;
+    for (size_t i = 0; i < kNumDatasets; i++) {
+        const TraceDataset& ds = trace.at(i);
+        if (ds.present == false)
+            continue;
+        H5::DataSet dataset = file.openDataSet(kDatasetNames[i]);
+        storage += dataset.getStorageSize();
+
+        hsize_t count[5] = { std::min<hsize_t>(num_frames, ds.dims[0]),
+            ds.dims[1], ds.dims[2], ds.dims[3], ds.dims[4] };
+        hsize_t offset[5] = { 0, 0, 0, 0, 0 };
+        H5::DataSpace filespace = dataset.getSpace();
+        filespace.selectHyperslab(H5S_SELECT_SET, count, offset);
+        H5::DataSpace memspace(5, count, NULL);
+        std::vector<short> samples(count[0] * frame_size(ds));
+        dataset.read(
+            samples.data(), H5::PredType::NATIVE_INT16, memspace, filespace);
+        if (std::equal(samples.begin(), samples.end(), ds.samples.begin())
+            == false) {
+            return 0;
+        }
+    }
+    return storage;
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    if (FLAGS_trace.empty() == true) {
+        std::cerr << "Usage: recorder_bench -conf <json> -trace <hdf5>"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<TraceDataset> trace;
+    size_t num_frames = load_trace(FLAGS_trace, FLAGS_frames, trace);
+    std::printf("Replaying %zu frames of %s\n", num_frames,
+        FLAGS_trace.c_str());
+
+    std::string conf;
+    Utils::loadTDDConfig(FLAGS_conf, conf);
+    json jConf = json::parse(conf, nullptr, true, true);
+    std::string bench_conf = FLAGS_storepath + "/recorder-bench.json";
+    std::string bench_trace = FLAGS_storepath + "/recorder-bench.hdf5";
+
+    std::printf("%-8s %-20s %10s %10s %10s\n", "order", "filters", "MB/s",
+        "ratio", "stored MB");
+    for (auto& order : Utils::split(FLAGS_byte_orders, ',')) {
+        for (auto& filters : Utils::split(FLAGS_filters, ',')) {
+            jConf["BaseStations"]["record_byte_order"] = order;
+            jConf["BaseStations"]["record_compression"] = filters;
+            jConf["BaseStations"]["trace_file"] = bench_trace;
+            jConf["BaseStations"]["max_frame"] = 0;
+            std::ofstream(bench_conf) << jConf.dump(4);
+
+            Config cfg(bench_conf, FLAGS_storepath);
+            if ((trace.at(0).dims[4] != 2 * cfg.samps_per_symbol())
+                || (trace.at(0).dims[1] != cfg.num_cells())) {
+                std::cerr << "Trace does not match " << FLAGS_conf << std::endl;
+                return EXIT_FAILURE;
+            }
+            size_t num_antennas = trace.at(0).dims[3];
+            Sounder::RecorderWorker worker(&cfg, 0, num_antennas);
+            worker.init();
+
+            auto start = std::chrono::steady_clock::now();
+            size_t bytes = replay(&cfg, worker, trace, num_frames);
+            worker.finalize();
+            std::chrono::duration<double> elapsed
+                = std::chrono::steady_clock::now() - start;
+
+            std::string filename = bench_trace;
+            filename.insert(filename.find_last_of('.'),
+                "_0_" + std::to_string(num_antennas - 1));
+            size_t storage = check_output(filename, trace, num_frames);
+            if (storage == 0) {
+                std::printf("%-8s %-20s %10s\n", order.c_str(), filters.c_str(),
+                    "MISMATCH");
+            } else {
+                std::printf("%-8s %-20s %10.1f %10.2f %10.1f\n", order.c_str(),
+                    filters.c_str(), bytes / elapsed.count() / 1e6,
+                    static_cast<double>(bytes) / storage, storage / 1e6);
+            }
+            if (FLAGS_keep == false)
+                std::remove(filename.c_str());
+        }
+    }
+    std::remove(bench_conf.c_str());
+    return EXIT_SUCCESS;
+}
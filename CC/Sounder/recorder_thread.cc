@@ -3,30 +3,73 @@
  RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
 
 ---------------------------------------------------------------------
- Event based message queue thread class for the recorder worker
+ Thread class feeding the recorder worker from the rx thread rings
 ---------------------------------------------------------------------
 */
 
 #include "include/recorder_thread.h"
 #include "include/logger.h"
 #include "include/macros.h"
+#include "include/raw_recorder_worker.h"
+#include "include/recorder_worker.h"
 #include "include/utils.h"
 
 namespace Sounder {
+void RecorderStats::merge(const RecorderStats& other)
+{
+    this->packets += other.packets;
+    this->dropped += other.dropped;
+    this->max_queue_depth
+        = std::max(this->max_queue_depth, other.max_queue_depth);
+    this->stage_latency.merge(other.stage_latency);
+    this->write_latency.merge(other.write_latency);
+    this->written_latency.merge(other.written_latency);
+    this->written_bytes += other.written_bytes;
+    this->first_enqueue = std::min(this->first_enqueue, other.first_enqueue);
+    this->last_record = std::max(this->last_record, other.last_record);
+    this->finalize_time = std::max(this->finalize_time, other.finalize_time);
+}
+
+std::chrono::steady_clock::duration RecorderStats::activeTime(void) const
+{
+    if (this->packets == 0)
+        return std::chrono::steady_clock::duration(0);
+    return (this->last_record - this->first_enqueue) + this->finalize_time;
+}
+
+static RecordBackend* create_backend(Config* cfg, size_t antenna_offset,
+    size_t num_antennas, ThreadCounters* counters)
+{
+    if (cfg->record_format() == "raw") {
+        return new RawRecorderWorker(
+            cfg, antenna_offset, num_antennas, counters);
+    }
+    return new RecorderWorker(cfg, antenna_offset, num_antennas, counters);
+}
+
+// ring entries handled before the slots are released
+const size_t RecorderThread::kDequeueBulkSize = 64;
+// idle wait before polling the rings again
+const int RecorderThread::kIdleWaitUs = 100;
+
 RecorderThread::RecorderThread(Config* in_cfg, size_t thread_id, int core,
-    size_t queue_size, size_t antenna_offset, size_t num_antennas,
-    bool wait_signal)
-    : event_queue_(queue_size)
-    , producer_token_(event_queue_)
-    , worker_(in_cfg, antenna_offset, num_antennas)
+    SampleBuffer* rx_buffer, size_t antenna_offset, size_t num_antennas,
+    Telemetry* telemetry, bool wait_signal)
+    : rx_buffer_(rx_buffer)
+    , rx_thread_num_(in_cfg->rx_thread_num())
+    , slots_(kDequeueBulkSize)
+    , counters_(
+          telemetry->registerThread("recorder" + std::to_string(thread_id)))
+    , worker_(
+          create_backend(in_cfg, antenna_offset, num_antennas, counters_))
     , thread_()
     , id_(thread_id)
     , core_alloc_(core)
     , wait_signal_(wait_signal)
+    , running_(false)
 {
     package_data_length_ = in_cfg->getPackageDataLength();
-    worker_.init();
-    running_ = false;
+    worker_->init();
 }
 
 RecorderThread::~RecorderThread() { Finalize(); }
@@ -37,25 +80,16 @@ void RecorderThread::Start(void)
 {
     MLPD_INFO("Launching recorder task thread with id: %zu and core %d\n",
         this->id_, this->core_alloc_);
-    {
-        std::lock_guard<std::mutex> thread_lock(this->sync_);
-        this->thread_ = std::thread(&RecorderThread::DoRecording, this);
-        this->running_ = true;
-    }
-    this->condition_.notify_all();
+    this->running_ = true;
+    this->thread_ = std::thread(&RecorderThread::DoRecording, this);
 }
 
-/* Cleanly allows the thread to exit */
-void RecorderThread::Stop(void)
-{
-    RecordEventData event;
-    event.event_type = kThreadTermination;
-    this->DispatchWork(event);
-}
+/* Cleanly allows the thread to exit once the rings are drained */
+void RecorderThread::Stop(void) { this->running_ = false; }
 
 void RecorderThread::Finalize(void)
 {
-    //Wait for thread to cleanly finish the messages in the queue
+    //Wait for thread to cleanly finish the packets in the rings
     if (this->thread_.joinable() == true) {
         MLPD_TRACE("Joining Recorder Thread on CPU %d \n", sched_getcpu());
         this->Stop();
@@ -63,103 +97,84 @@ void RecorderThread::Finalize(void)
     }
 }
 
-/* TODO:  handle producer token better */
-//Returns true for success, false otherwise
-bool RecorderThread::DispatchWork(RecordEventData event)
-{
-    //MLPD_TRACE("Dispatching work\n");
-    bool ret = true;
-    if (this->event_queue_.try_enqueue(this->producer_token_, event) == 0) {
-        MLPD_WARN("Queue limit has reached! try to increase queue size.\n");
-        if (this->event_queue_.enqueue(this->producer_token_, event) == 0) {
-            MLPD_ERROR("Record task enqueue failed\n");
-            throw std::runtime_error("Record task enqueue failed");
-            ret = false;
-        }
-    }
-
-    if (this->wait_signal_ == true) {
-        if (ret == true) {
-            std::lock_guard<std::mutex> thread_lock(this->sync_);
-        }
-        this->condition_.notify_all();
-    }
-    return ret;
-}
-
 void RecorderThread::DoRecording(void)
 {
-    //Sync the start
-    {
-        std::unique_lock<std::mutex> thread_wait(this->sync_);
-        this->condition_.wait(thread_wait, [this] { return this->running_; });
-    }
-
     if (this->core_alloc_ >= 0) {
         MLPD_INFO("Pinning recording thread %zu to core %d\n", this->id_,
             this->core_alloc_);
-        pthread_t this_thread = this->thread_.native_handle();
-        if (pin_thread_to_core(this->core_alloc_, this_thread) != 0) {
+        if (pin_to_core(this->core_alloc_) != 0) {
             MLPD_ERROR("Pin recording thread %zu to core %d failed\n",
                 this->id_, this->core_alloc_);
             throw std::runtime_error("Pin recording thread to core failed");
         }
     }
 
-    moodycamel::ConsumerToken ctok(this->event_queue_);
     MLPD_INFO("Recording thread %zu has %zu antennas starting at %zu\n",
-        this->id_, this->worker_.num_antennas(),
-        this->worker_.antenna_offset());
-
-    RecordEventData event;
-    bool ret = false;
-    while (this->running_ == true) {
-        ret = this->event_queue_.try_dequeue(ctok, event);
-
-        if (ret == false) /* Queue empty */
-        {
-            if (this->wait_signal_ == true) {
-                std::unique_lock<std::mutex> thread_wait(this->sync_);
-                /* Wait until a new message exists, should eliminate the CPU polling */
-                this->condition_.wait(thread_wait, [this, &ctok, &event] {
-                    return this->event_queue_.try_dequeue(ctok, event);
-                });
-                /* return from here with a valid event to process */
-                ret = true;
-            }
+        this->id_, this->worker_->num_antennas(),
+        this->worker_->antenna_offset());
+
+    while (true) {
+        // Packets pushed before Stop() are drained before exiting
+        bool stopping = (this->running_ == false);
+        size_t handled = 0;
+        for (size_t i = 0; i < this->rx_thread_num_; i++) {
+            handled += this->HandleRing(i);
         }
-
-        if (ret == true) {
-            this->HandleEvent(event);
+        if (handled == 0) {
+            if (stopping == true) {
+                break;
+            } else if (this->wait_signal_ == true) {
+                std::this_thread::sleep_for(
+                    std::chrono::microseconds(kIdleWaitUs));
+            }
         }
     }
-    this->worker_.finalize();
+    auto finalize_start = std::chrono::steady_clock::now();
+    this->worker_->finalize();
+    this->stats_.finalize_time
+        = std::chrono::steady_clock::now() - finalize_start;
+
+    std::lock_guard<std::mutex> lock(this->counters_->write_time_mutex);
+    this->stats_.write_latency.merge(this->counters_->write_time);
+    this->stats_.written_latency.merge(this->counters_->written_latency);
+    this->stats_.written_bytes = this->counters_->written_bytes;
 }
 
-void RecorderThread::HandleEvent(RecordEventData event)
+size_t RecorderThread::HandleRing(size_t rx_thread)
 {
-    if (event.event_type == kThreadTermination) {
-        this->running_ = false;
-    } else {
-        size_t offset = event.data;
-        size_t buffer_id = (offset / event.rx_buff_size);
-        size_t buffer_offset = offset - (buffer_id * event.rx_buff_size);
-        if (event.event_type == kTaskRecord) {
-            // read info
-            size_t package_length
-                = sizeof(Package) + this->package_data_length_;
-            char* cur_ptr_buffer = event.rx_buffer[buffer_id].buffer.data()
-                + (buffer_offset * package_length);
-
-            this->worker_.record(
-                this->id_, reinterpret_cast<Package*>(cur_ptr_buffer));
-        }
-
-        /* Free up the buffer memory */
-        int bit = 1 << (buffer_offset % sizeof(std::atomic_int));
-        int offs = (buffer_offset / sizeof(std::atomic_int));
-        std::atomic_fetch_and(
-            &event.rx_buffer[buffer_id].pkg_buf_inuse[offs], ~bit); // now empty
+    SampleBuffer& rx_buffer = this->rx_buffer_[rx_thread];
+    size_t depth;
+    size_t count = rx_buffer.rings.at(this->id_)->pop(
+        this->slots_.data(), kDequeueBulkSize, &depth);
+    size_t package_length = sizeof(Package) + this->package_data_length_;
+    if (count == 0)
+        return 0;
+    this->stats_.max_queue_depth
+        = std::max(this->stats_.max_queue_depth, depth);
+    this->stats_.first_enqueue = std::min(this->stats_.first_enqueue,
+        rx_buffer.slots[rx_buffer.slotIndex(this->slots_.at(0))]
+            .enqueue_time);
+
+    for (size_t i = 0; i < count; i++) {
+        size_t pos = this->slots_.at(i);
+        SlotState& slot = rx_buffer.slots[rx_buffer.slotIndex(pos)];
+        char* cur_ptr_buffer = rx_buffer.buffer.data()
+            + (rx_buffer.slotIndex(pos) * package_length);
+        this->worker_->record(this->id_,
+            reinterpret_cast<Package*>(cur_ptr_buffer), slot.enqueue_time);
+        auto staged = std::chrono::steady_clock::now();
+        this->stats_.stage_latency.record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                staged - slot.enqueue_time)
+                .count());
+        rx_buffer.releaseSlot(pos); // now empty
     }
+    this->stats_.packets += count;
+    ThreadCounters::add(this->counters_->packets, count);
+    ThreadCounters::add(
+        this->counters_->bytes, count * this->package_data_length_);
+    ThreadCounters::max(this->counters_->queue_hwm, depth);
+    this->stats_.last_record = std::chrono::steady_clock::now();
+    return count;
 }
-}; //End namespace Sounder
\ No newline at end of file
+}; //End namespace Sounder
@@ -10,6 +10,7 @@
 #include "include/recorder_worker.h"
 #include "include/logger.h"
 #include "include/macros.h"
+#include "include/record_attributes.h"
 #include "include/utils.h"
 
 namespace Sounder {
@@ -17,21 +18,39 @@ namespace Sounder {
 const int RecorderWorker::kConfigPilotExtentStep = 400;
 // data dataset size increment
 const int RecorderWorker::kConfigDataExtentStep = 400;
+// staged frame batches
+const size_t RecorderWorker::kStageBatches = 4;
+
+// Registered ids of the dynamically loaded HDF5 filter plugins
+static const H5Z_filter_t kFilterBlosc = 32001;
+static const H5Z_filter_t kFilterLz4 = 32004;
 
 #if (DEBUG_PRINT)
 const int kDsSim = 5;
 #endif
 
-RecorderWorker::RecorderWorker(
-    Config* in_cfg, size_t antenna_offset, size_t num_antennas)
+RecorderWorker::RecorderWorker(Config* in_cfg, size_t antenna_offset,
+    size_t num_antennas, ThreadCounters* counters)
     : cfg_(in_cfg)
+    , counters_(counters)
 {
     file_ = nullptr;
     pilot_dataset_ = nullptr;
     noise_dataset_ = nullptr;
     data_dataset_ = nullptr;
+    csi_dataset_ = nullptr;
+    open_ = false;
     antenna_offset_ = antenna_offset;
     num_antennas_ = num_antennas;
+    batch_frames_ = in_cfg->record_batch_frames();
+    stage_frame_ = 0;
+    stage_packets_ = 0;
+    batch_packets_.resize(kStageBatches, 0);
+    batch_enqueue_.resize(kStageBatches);
+    if (in_cfg->record_csi() == true) {
+        csi_.reset(new CsiExtractor(in_cfg));
+        csi_row_.resize(csi_->data_sc_num());
+    }
 }
 
 RecorderWorker::~RecorderWorker() { gc(); }
@@ -61,6 +80,13 @@ void RecorderWorker::gc(void)
         this->data_dataset_ = nullptr;
     }
 
+    if (this->csi_dataset_ != nullptr) {
+        MLPD_TRACE("CSI dataset exists during garbage collection\n");
+        this->csi_dataset_->close();
+        delete this->csi_dataset_;
+        this->csi_dataset_ = nullptr;
+    }
+
     if (this->file_ != nullptr) {
         MLPD_TRACE("File exists exists during garbage collection\n");
         this->file_->close();
@@ -84,6 +110,22 @@ void RecorderWorker::init(void)
         throw std::runtime_error("Could not init the output file");
     }
     this->openHDF5();
+
+    size_t frame_samples = this->cfg_->num_cells() * this->num_antennas_ * 2
+        * this->cfg_->samps_per_symbol();
+    size_t stage_frames = kStageBatches * this->batch_frames_;
+    this->pilot_stage_.resize(
+        stage_frames * this->cfg_->pilot_syms_per_frame() * frame_samples, 0);
+    this->noise_stage_.resize(
+        stage_frames * this->cfg_->noise_syms_per_frame() * frame_samples, 0);
+    this->data_stage_.resize(
+        stage_frames * this->cfg_->ul_syms_per_frame() * frame_samples, 0);
+    if (this->csi_ != nullptr) {
+        this->csi_stage_.resize(stage_frames * this->cfg_->num_cells()
+                * this->cfg_->pilot_syms_per_frame() * this->num_antennas_
+                * 2 * this->csi_row_.size(),
+            0);
+    }
 }
 
 void RecorderWorker::finalize(void)
@@ -102,102 +144,40 @@ void RecorderWorker::finishHDF5()
     }
 }
 
-static void write_attribute(H5::Group& g, const char name[], double val)
-{
-    hsize_t dims[] = { 1 };
-    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
-    H5::Attribute att
-        = g.createAttribute(name, H5::PredType::NATIVE_DOUBLE, attr_ds);
-    att.write(H5::PredType::NATIVE_DOUBLE, &val);
-}
-
-static void write_attribute(
-    H5::Group& g, const char name[], const std::vector<double>& val)
+// Add the filter chain described by a "shuffle+deflate" style string to a
+// dataset creation property list. Plugin filters that are not installed are
+// skipped with a warning.
+static void set_filters(
+    H5::DSetCreatPropList& prop, const std::string& filters, int level)
 {
-    size_t size = val.size();
-    hsize_t dims[] = { size };
-    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
-    H5::Attribute att
-        = g.createAttribute(name, H5::PredType::NATIVE_DOUBLE, attr_ds);
-    att.write(H5::PredType::NATIVE_DOUBLE, &val[0]);
-}
-
-static void write_attribute(H5::Group& g, const char name[],
-    const std::vector<std::complex<float>>& val)
-{
-    size_t size = val.size();
-    hsize_t dims[] = { 2 * size };
-    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
-    H5::Attribute att
-        = g.createAttribute(name, H5::PredType::NATIVE_DOUBLE, attr_ds);
-    double val_pair[2 * size];
-    for (size_t j = 0; j < size; j++) {
-        val_pair[2 * j + 0] = std::real(val[j]);
-        val_pair[2 * j + 1] = std::imag(val[j]);
+    std::stringstream ss(filters);
+    std::string filter;
+    while (std::getline(ss, filter, '+')) {
+        if (filter == "none" || filter.empty()) {
+            continue;
+        } else if (filter == "shuffle") {
+            prop.setShuffle();
+        } else if (filter == "deflate") {
+            prop.setDeflate(level);
+        } else if (filter == "lz4" || filter == "blosc") {
+            H5Z_filter_t id = (filter == "lz4") ? kFilterLz4 : kFilterBlosc;
+            if (H5Zfilter_avail(id) <= 0) {
+                MLPD_WARN("HDF5 %s filter plugin not available, check "
+                          "HDF5_PLUGIN_PATH. Writing without it\n",
+                    filter.c_str());
+            } else if (id == kFilterLz4) {
+                prop.setFilter(id, H5Z_FLAG_MANDATORY, 0, nullptr);
+            } else {
+                // Reserved slots are filled in by the plugin, then level,
+                // byte shuffle and the lz4 compressor
+                const unsigned int cd_values[]
+                    = { 0, 0, 0, 0, static_cast<unsigned int>(level), 1, 1 };
+                prop.setFilter(id, H5Z_FLAG_MANDATORY, 7, cd_values);
+            }
+        } else {
+            throw std::invalid_argument("Unknown HDF5 filter: " + filter);
+        }
     }
-    att.write(H5::PredType::NATIVE_DOUBLE, &val_pair[0]);
-}
-
-static void write_attribute(H5::Group& g, const char name[], size_t val)
-{
-    hsize_t dims[] = { 1 };
-    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
-    H5::Attribute att
-        = g.createAttribute(name, H5::PredType::STD_U32BE, attr_ds);
-    uint32_t val_uint = val;
-    att.write(H5::PredType::NATIVE_UINT, &val_uint);
-}
-
-static void write_attribute(H5::Group& g, const char name[], int val)
-{
-    hsize_t dims[] = { 1 };
-    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
-    H5::Attribute att
-        = g.createAttribute(name, H5::PredType::STD_I32BE, attr_ds);
-    att.write(H5::PredType::NATIVE_INT, &val);
-}
-
-static void write_attribute(
-    H5::Group& g, const char name[], const std::vector<size_t>& val)
-{
-    size_t size = val.size();
-    hsize_t dims[] = { size };
-    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
-    H5::Attribute att
-        = g.createAttribute(name, H5::PredType::STD_U32BE, attr_ds);
-    std::vector<uint32_t> val_uint;
-    for (size_t i = 0; i < val.size(); i++)
-        val_uint.push_back((uint32_t)val.at(i));
-    att.write(H5::PredType::NATIVE_UINT, &val_uint[0]);
-}
-
-static void write_attribute(
-    H5::Group& g, const char name[], const std::string& val)
-{
-    hsize_t dims[] = { 1 };
-    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
-    H5::StrType strdatatype(
-        H5::PredType::C_S1, H5T_VARIABLE); // of variable length characters
-    H5::Attribute att = g.createAttribute(name, strdatatype, attr_ds);
-    att.write(strdatatype, val);
-}
-
-static void write_attribute(
-    H5::Group& g, const char name[], const std::vector<std::string>& val)
-{
-    if (val.empty())
-        return;
-    size_t size = val.size();
-    H5::StrType strdatatype(
-        H5::PredType::C_S1, H5T_VARIABLE); // of variable length characters
-    hsize_t dims[] = { size };
-    H5::DataSpace attr_ds = H5::DataSpace(1, dims);
-    H5::Attribute att = g.createAttribute(name, strdatatype, attr_ds);
-    const char* cStrArray[size];
-
-    for (size_t i = 0; i < size; ++i)
-        cStrArray[i] = val[i].c_str();
-    att.write(strdatatype, cStrArray);
 }
 
 enum {
@@ -216,8 +196,22 @@ herr_t RecorderWorker::initHDF5()
 
     // dataset dimension
     hsize_t IQ = 2 * this->cfg_->samps_per_symbol();
-    DataspaceIndex cdims
-        = { 1, 1, 1, 1, IQ }; // pilot chunk size, TODO: optimize size
+    // By default chunks hold one write batch (all symbols of this worker's
+    // antennas over batch_frames_ frames) so that each flush fills whole
+    // chunks
+    hsize_t chunk_frames = this->cfg_->record_chunk_frames();
+    hsize_t chunk_antennas = this->cfg_->record_chunk_antennas();
+    if ((chunk_antennas == 0) || (chunk_antennas > this->num_antennas_))
+        chunk_antennas = this->num_antennas_;
+    DataspaceIndex cdims_pilot = { chunk_frames, this->cfg_->num_cells(),
+        std::max<hsize_t>(1, this->cfg_->pilot_syms_per_frame()),
+        chunk_antennas, IQ };
+    DataspaceIndex cdims_noise = { chunk_frames, this->cfg_->num_cells(),
+        std::max<hsize_t>(1, this->cfg_->noise_syms_per_frame()),
+        chunk_antennas, IQ };
+    DataspaceIndex cdims_data = { chunk_frames, this->cfg_->num_cells(),
+        std::max<hsize_t>(1, this->cfg_->ul_syms_per_frame()), chunk_antennas,
+        IQ };
     this->frame_number_pilot_ = MAX_FRAME_INC;
     // pilots
     DataspaceIndex dims_pilot
@@ -239,252 +233,79 @@ herr_t RecorderWorker::initHDF5()
               this->cfg_->ul_syms_per_frame(), this->num_antennas_, IQ };
     DataspaceIndex max_dims_data = { H5S_UNLIMITED, this->cfg_->num_cells(),
         this->cfg_->ul_syms_per_frame(), this->num_antennas_, IQ };
+    // CSI of the pilots
+    hsize_t csi_len = 2 * this->csi_row_.size();
+    this->frame_number_csi_ = MAX_FRAME_INC;
+    DataspaceIndex cdims_csi = { chunk_frames, this->cfg_->num_cells(),
+        std::max<hsize_t>(1, this->cfg_->pilot_syms_per_frame()),
+        chunk_antennas, csi_len };
+    DataspaceIndex dims_csi = { this->frame_number_csi_,
+        this->cfg_->num_cells(), this->cfg_->pilot_syms_per_frame(),
+        this->num_antennas_, csi_len };
+    DataspaceIndex max_dims_csi = { H5S_UNLIMITED, this->cfg_->num_cells(),
+        this->cfg_->pilot_syms_per_frame(), this->num_antennas_, csi_len };
 
     try {
         H5::Exception::dontPrint();
 
-        this->file_ = new H5::H5File(this->hdf5_name_, H5F_ACC_TRUNC);
-        auto mainGroup = this->file_->createGroup("/Data");
-        this->pilot_prop_.setChunk(kDsDim, cdims);
-
-        H5::DataSpace pilot_dataspace(kDsDim, dims_pilot, max_dims_pilot);
-        this->file_->createDataSet("/Data/Pilot_Samples",
-            H5::PredType::STD_I16BE, pilot_dataspace, this->pilot_prop_);
-
-        // ******* COMMON ******** //
-        // TX/RX Frequencyfile
-        write_attribute(mainGroup, "FREQ", this->cfg_->freq());
-
-        // BW
-        write_attribute(mainGroup, "RATE", this->cfg_->rate());
-
-        // Number of samples on each symbol (excluding prefix/postfix)
-        write_attribute(
-            mainGroup, "SYMBOL_LEN_NO_PAD", this->cfg_->subframe_size());
-
-        // Number of samples for prefix (padding)
-        write_attribute(mainGroup, "PREFIX_LEN", this->cfg_->prefix());
-
-        // Number of samples for postfix (padding)
-        write_attribute(mainGroup, "POSTFIX_LEN", this->cfg_->postfix());
-
-        // Number of samples on each symbol including prefix and postfix
-        write_attribute(
-            mainGroup, "SYMBOL_LEN", this->cfg_->samps_per_symbol());
-
-        // Size of FFT
-        write_attribute(mainGroup, "FFT_SIZE", this->cfg_->fft_size());
-
-        // Number of data subcarriers in ofdm symbols
-        write_attribute(mainGroup, "DATA_SUBCARRIER_NUM",
-            this->cfg_->symbol_data_subcarrier_num());
-
-        // Length of cyclic prefix
-        write_attribute(mainGroup, "CP_LEN", this->cfg_->cp_size());
-
-        // Beacon sequence type (string)
-        write_attribute(mainGroup, "BEACON_SEQ_TYPE", this->cfg_->beacon_seq());
-
-        // Pilot sequence type (string)
-        write_attribute(mainGroup, "PILOT_SEQ_TYPE", this->cfg_->pilot_seq());
-
-        // ******* Base Station ******** //
-        // Hub IDs (vec of strings)
-        write_attribute(mainGroup, "BS_HUB_ID", this->cfg_->hub_ids());
-
-        // BS SDR IDs
-        // *** first, how many boards in each cell? ***
-        std::vector<std::string> bs_sdr_num_per_cell(
-            this->cfg_->bs_sdr_ids().size());
-        for (size_t i = 0; i < bs_sdr_num_per_cell.size(); ++i) {
-            bs_sdr_num_per_cell[i]
-                = std::to_string(this->cfg_->bs_sdr_ids().at(i).size());
-        }
-        write_attribute(mainGroup, "BS_SDR_NUM_PER_CELL", bs_sdr_num_per_cell);
-
-        // *** second, reshape matrix into vector ***
-        std::vector<std::string> bs_sdr_id;
-        for (auto&& v : this->cfg_->bs_sdr_ids()) {
-            bs_sdr_id.insert(bs_sdr_id.end(), v.begin(), v.end());
+        // Samples stored in the host byte order are written without
+        // swapping, readers get the order from the dataset type
+        const H5::PredType* sample_type = &H5::PredType::NATIVE_INT16;
+        const H5::PredType* csi_type = &H5::PredType::NATIVE_FLOAT;
+        if (this->cfg_->record_byte_order() == "little") {
+            sample_type = &H5::PredType::STD_I16LE;
+            csi_type = &H5::PredType::IEEE_F32LE;
+        } else if (this->cfg_->record_byte_order() == "big") {
+            sample_type = &H5::PredType::STD_I16BE;
+            csi_type = &H5::PredType::IEEE_F32BE;
         }
-        write_attribute(mainGroup, "BS_SDR_ID", bs_sdr_id);
-
-        // Number of Base Station Cells
-        write_attribute(mainGroup, "BS_NUM_CELLS", this->cfg_->num_cells());
-
-        // How many RF channels per Iris board are enabled ("single" or "dual")
-        write_attribute(
-            mainGroup, "BS_CH_PER_RADIO", this->cfg_->bs_channel().length());
-
-        // Frame schedule (vec of strings for now, this should change to matrix when we go to multi-cell)
-        write_attribute(mainGroup, "BS_FRAME_SCHED", this->cfg_->frames());
-
-        // RX Gain RF channel A
-        write_attribute(mainGroup, "BS_RX_GAIN_A", this->cfg_->rx_gain().at(0));
-
-        // TX Gain RF channel A
-        write_attribute(mainGroup, "BS_TX_GAIN_A", this->cfg_->tx_gain().at(0));
-
-        // RX Gain RF channel B
-        write_attribute(mainGroup, "BS_RX_GAIN_B", this->cfg_->rx_gain().at(1));
-
-        // TX Gain RF channel B
-        write_attribute(mainGroup, "BS_TX_GAIN_B", this->cfg_->tx_gain().at(1));
-
-        // Beamsweep (true or false)
-        write_attribute(
-            mainGroup, "BS_BEAMSWEEP", this->cfg_->beam_sweep() ? 1 : 0);
-
-        // Beacon Antenna
-        write_attribute(mainGroup, "BS_BEACON_ANT", this->cfg_->beacon_ant());
-
-        // Number of antennas on Base Station (per cell)
-        std::vector<std::string> bs_ant_num_per_cell(
-            this->cfg_->bs_sdr_ids().size());
-        for (size_t i = 0; i < bs_ant_num_per_cell.size(); ++i) {
-            bs_ant_num_per_cell[i]
-                = std::to_string(this->cfg_->bs_sdr_ids().at(i).size()
-                    * this->cfg_->bs_channel().length());
-        }
-        write_attribute(mainGroup, "BS_ANT_NUM_PER_CELL", bs_ant_num_per_cell);
-
-        //If the antennas are non consective this will be an issue.
-        write_attribute(mainGroup, "ANT_OFFSET", this->antenna_offset_);
-        write_attribute(mainGroup, "ANT_NUM", this->num_antennas_);
-        write_attribute(
-            mainGroup, "ANT_TOTAL", this->cfg_->getTotNumAntennas());
-
-        // Number of symbols in a frame
-        write_attribute(
-            mainGroup, "BS_FRAME_LEN", this->cfg_->symbols_per_frame());
-
-        // Number of uplink symbols per frame
-        write_attribute(mainGroup, "UL_SYMS", this->cfg_->ul_syms_per_frame());
-
-        // Reciprocal Calibration Mode
-        write_attribute(mainGroup, "RECIPROCAL_CALIB",
-            this->cfg_->reciprocal_calib() ? 1 : 0);
-
-        // ******* Clients ******** //
-        // Freq. Domain Pilot symbols
-        std::vector<double> split_vec_pilot_f(
-            2 * this->cfg_->pilot_sym_f().at(0).size());
-        for (size_t i = 0; i < this->cfg_->pilot_sym_f().at(0).size(); i++) {
-            split_vec_pilot_f[2 * i + 0]
-                = this->cfg_->pilot_sym_f().at(0).at(i);
-            split_vec_pilot_f[2 * i + 1]
-                = this->cfg_->pilot_sym_f().at(1).at(i);
-        }
-        write_attribute(mainGroup, "OFDM_PILOT_F", split_vec_pilot_f);
-
-        // Time Domain Pilot symbols
-        std::vector<double> split_vec_pilot(
-            2 * this->cfg_->pilot_sym().at(0).size());
-        for (size_t i = 0; i < this->cfg_->pilot_sym().at(0).size(); i++) {
-            split_vec_pilot[2 * i + 0] = this->cfg_->pilot_sym().at(0).at(i);
-            split_vec_pilot[2 * i + 1] = this->cfg_->pilot_sym().at(1).at(i);
-        }
-        write_attribute(mainGroup, "OFDM_PILOT", split_vec_pilot);
-
-        // Number of Pilots
-        write_attribute(
-            mainGroup, "PILOT_NUM", this->cfg_->pilot_syms_per_frame());
-
-        // Number of Client Antennas
-        write_attribute(mainGroup, "CL_NUM", this->cfg_->num_cl_antennas());
-
-        // Data modulation
-        write_attribute(mainGroup, "CL_MODULATION", this->cfg_->data_mod());
-
-        if (this->cfg_->client_present() == true) {
-            // Client antenna polarization
-            write_attribute(
-                mainGroup, "CL_CH_PER_RADIO", this->cfg_->cl_sdr_ch());
-
-            // Client AGC enable flag
-            write_attribute(
-                mainGroup, "CL_AGC_EN", this->cfg_->cl_agc_en() ? 1 : 0);
-
-            // RX Gain RF channel A
-            write_attribute(
-                mainGroup, "CL_RX_GAIN_A", this->cfg_->cl_rxgain_vec().at(0));
-
-            // TX Gain RF channel A
-            write_attribute(
-                mainGroup, "CL_TX_GAIN_A", this->cfg_->cl_txgain_vec().at(0));
-
-            // RX Gain RF channel B
-            write_attribute(
-                mainGroup, "CL_RX_GAIN_B", this->cfg_->cl_rxgain_vec().at(1));
-
-            // TX Gain RF channel B
-            write_attribute(
-                mainGroup, "CL_TX_GAIN_B", this->cfg_->cl_txgain_vec().at(1));
-
-            // Number of frames for UL data recorded in bit source files
-            write_attribute(mainGroup, "UL_DATA_FRAME_NUM",
-                this->cfg_->ul_data_frame_num());
 
-            // Names of Files including uplink tx frequency-domain data
-            if (this->cfg_->tx_fd_data_files().size() > 0) {
-                write_attribute(mainGroup, "TX_FD_DATA_FILENAMES",
-                    this->cfg_->tx_fd_data_files());
-            }
-
-            // Client frame schedule (vec of strings)
-            write_attribute(
-                mainGroup, "CL_FRAME_SCHED", this->cfg_->cl_frames());
-
-            // Set of client SDR IDs (vec of strings)
-            write_attribute(mainGroup, "CL_SDR_ID", this->cfg_->cl_sdr_ids());
+        this->file_ = new H5::H5File(this->hdf5_name_, H5F_ACC_TRUNC);
+        auto mainGroup = this->file_->createGroup("/Data");
+        Hdf5AttributeSink attributes(mainGroup);
+        writeRecordAttributes(
+            this->cfg_, this->antenna_offset_, this->num_antennas_, attributes);
+
+        if (this->cfg_->record_pilot_samples() == true) {
+            H5::DataSpace pilot_dataspace(kDsDim, dims_pilot, max_dims_pilot);
+            this->pilot_prop_.setChunk(kDsDim, cdims_pilot);
+            set_filters(this->pilot_prop_,
+                this->cfg_->record_pilot_compression(),
+                this->cfg_->record_compression_level());
+            this->file_->createDataSet("/Data/Pilot_Samples",
+                *sample_type, pilot_dataspace, this->pilot_prop_);
+            this->pilot_prop_.close();
         }
 
-        if (this->cfg_->ul_data_sym_present()) {
-            // Data subcarriers
-            if (this->cfg_->data_ind().size() > 0)
-                write_attribute(
-                    mainGroup, "OFDM_DATA_SC", this->cfg_->data_ind());
-
-            // Pilot subcarriers (indexes)
-            if (this->cfg_->pilot_sc_ind().size() > 0)
-                write_attribute(
-                    mainGroup, "OFDM_PILOT_SC", this->cfg_->pilot_sc_ind());
-            if (this->cfg_->pilot_sc().size() > 0)
-                write_attribute(
-                    mainGroup, "OFDM_PILOT_SC_VALS", this->cfg_->pilot_sc());
-
-            // Freq. Domain Data Symbols
-            for (size_t i = 0; i < this->cfg_->txdata_freq_dom().size(); i++) {
-                std::string var
-                    = std::string("OFDM_DATA_CL") + std::to_string(i);
-                write_attribute(mainGroup, var.c_str(),
-                    this->cfg_->txdata_freq_dom().at(i));
-            }
-
-            // Time Domain Data Symbols
-            for (size_t i = 0; i < this->cfg_->txdata_time_dom().size(); i++) {
-                std::string var
-                    = std::string("OFDM_DATA_TIME_CL") + std::to_string(i);
-                write_attribute(mainGroup, var.c_str(),
-                    this->cfg_->txdata_time_dom().at(i));
-            }
+        if (this->csi_ != nullptr) {
+            H5::DataSpace csi_dataspace(kDsDim, dims_csi, max_dims_csi);
+            this->csi_prop_.setChunk(kDsDim, cdims_csi);
+            set_filters(this->csi_prop_,
+                this->cfg_->record_pilot_compression(),
+                this->cfg_->record_compression_level());
+            this->file_->createDataSet(
+                "/Data/CSI", *csi_type, csi_dataspace, this->csi_prop_);
+            this->csi_prop_.close();
         }
-        // ********************* //
 
-        this->pilot_prop_.close();
         if (this->cfg_->noise_syms_per_frame() > 0) {
             H5::DataSpace noise_dataspace(kDsDim, dims_noise, max_dims_noise);
-            this->noise_prop_.setChunk(kDsDim, cdims);
+            this->noise_prop_.setChunk(kDsDim, cdims_noise);
+            set_filters(this->noise_prop_,
+                this->cfg_->record_noise_compression(),
+                this->cfg_->record_compression_level());
             this->file_->createDataSet("/Data/Noise_Samples",
-                H5::PredType::STD_I16BE, noise_dataspace, this->noise_prop_);
+                *sample_type, noise_dataspace, this->noise_prop_);
             this->noise_prop_.close();
         }
 
         if (this->cfg_->ul_syms_per_frame() > 0) {
             H5::DataSpace data_dataspace(kDsDim, dims_data, max_dims_data);
-            this->data_prop_.setChunk(kDsDim, cdims);
+            this->data_prop_.setChunk(kDsDim, cdims_data);
+            set_filters(this->data_prop_, this->cfg_->record_data_compression(),
+                this->cfg_->record_compression_level());
             this->file_->createDataSet("/Data/UplinkData",
-                H5::PredType::STD_I16BE, data_dataspace, this->data_prop_);
+                *sample_type, data_dataspace, this->data_prop_);
             this->data_prop_.close();
         }
         this->file_->close();
@@ -514,36 +335,48 @@ void RecorderWorker::openHDF5()
 {
     MLPD_TRACE("Open HDF5 file: %s\n", this->hdf5_name_.c_str());
     this->file_->openFile(this->hdf5_name_, H5F_ACC_RDWR);
-    assert(this->pilot_dataset_ == nullptr);
-    // Get Dataset for pilot and check the shape of it
-    this->pilot_dataset_
-        = new H5::DataSet(this->file_->openDataSet("/Data/Pilot_Samples"));
-
-    // Get the dataset's dataspace and creation property list.
-    H5::DataSpace pilot_filespace(this->pilot_dataset_->getSpace());
-    this->pilot_prop_.copy(this->pilot_dataset_->getCreatePlist());
-
+    assert(this->open_ == false);
+    this->open_ = true;
 #if DEBUG_PRINT
     hsize_t IQ = 2 * this->cfg_->samps_per_symbol();
-    int cndims_pilot = 0;
-    int ndims = pilot_filespace.getSimpleExtentNdims();
-    DataspaceIndex dims_pilot
-        = { this->frame_number_pilot_, this->cfg_->num_cells(),
-              this->cfg_->pilot_syms_per_frame(), this->num_antennas(), IQ };
-    if (H5D_CHUNKED == this->pilot_prop_.getLayout())
-        cndims_pilot = this->pilot_prop_.getChunk(ndims, dims_pilot);
     using std::cout;
-    cout << "dim pilot chunk = " << cndims_pilot << std::endl;
-    cout << "New Pilot Dataset Dimension: [";
-    for (auto i = 0; i < kDsSim - 1; ++i)
-        cout << dims_pilot[i] << ",";
-    cout << dims_pilot[kDsSim - 1] << "]" << std::endl;
 #endif
-    pilot_filespace.close();
+    if (this->cfg_->record_pilot_samples() == true) {
+        // Get Dataset for pilot and check the shape of it
+        this->pilot_dataset_ = new H5::DataSet(
+            this->file_->openDataSet("/Data/Pilot_Samples",
+                chunkCache(this->cfg_->pilot_syms_per_frame())));
+
+        // Get the dataset's dataspace and creation property list.
+        H5::DataSpace pilot_filespace(this->pilot_dataset_->getSpace());
+        this->pilot_prop_.copy(this->pilot_dataset_->getCreatePlist());
+
+#if DEBUG_PRINT
+        int cndims_pilot = 0;
+        int ndims = pilot_filespace.getSimpleExtentNdims();
+        DataspaceIndex dims_pilot = { this->frame_number_pilot_,
+            this->cfg_->num_cells(), this->cfg_->pilot_syms_per_frame(),
+            this->num_antennas(), IQ };
+        if (H5D_CHUNKED == this->pilot_prop_.getLayout())
+            cndims_pilot = this->pilot_prop_.getChunk(ndims, dims_pilot);
+        cout << "dim pilot chunk = " << cndims_pilot << std::endl;
+        cout << "New Pilot Dataset Dimension: [";
+        for (auto i = 0; i < kDsSim - 1; ++i)
+            cout << dims_pilot[i] << ",";
+        cout << dims_pilot[kDsSim - 1] << "]" << std::endl;
+#endif
+        pilot_filespace.close();
+    }
+
+    if (this->csi_ != nullptr) {
+        this->csi_dataset_ = new H5::DataSet(this->file_->openDataSet(
+            "/Data/CSI", chunkCache(this->cfg_->pilot_syms_per_frame())));
+        this->csi_prop_.copy(this->csi_dataset_->getCreatePlist());
+    }
     // Get Dataset for DATA (If Enabled) and check the shape of it
     if (this->cfg_->ul_syms_per_frame() > 0) {
-        this->data_dataset_
-            = new H5::DataSet(this->file_->openDataSet("/Data/UplinkData"));
+        this->data_dataset_ = new H5::DataSet(this->file_->openDataSet(
+            "/Data/UplinkData", chunkCache(this->cfg_->ul_syms_per_frame())));
 
         H5::DataSpace data_filespace(this->data_dataset_->getSpace());
         this->data_prop_.copy(this->data_dataset_->getCreatePlist());
@@ -570,8 +403,9 @@ void RecorderWorker::openHDF5()
 
     // Get Dataset for NOISE (If Enabled) and check the shape of it
     if (this->cfg_->noise_syms_per_frame() > 0) {
-        this->noise_dataset_
-            = new H5::DataSet(this->file_->openDataSet("/Data/Noise_Samples"));
+        this->noise_dataset_ = new H5::DataSet(
+            this->file_->openDataSet("/Data/Noise_Samples",
+                chunkCache(this->cfg_->noise_syms_per_frame())));
         H5::DataSpace noise_filespace(this->noise_dataset_->getSpace());
         this->noise_prop_.copy(this->noise_dataset_->getCreatePlist());
 
@@ -595,6 +429,24 @@ void RecorderWorker::openHDF5()
     }
 }
 
+H5::DSetAccPropList RecorderWorker::chunkCache(size_t syms_per_frame)
+{
+    size_t cache_bytes = this->cfg_->record_cache_mb() * 1024 * 1024;
+    if (cache_bytes == 0) {
+        // Room for two rows of chunks across all antennas so that chunks
+        // filled over several batches stay cached until they are complete
+        size_t frames = std::max(
+            this->cfg_->record_chunk_frames(), this->batch_frames_);
+        cache_bytes = 2 * frames * this->cfg_->num_cells()
+            * std::max<size_t>(1, syms_per_frame) * this->num_antennas_ * 2
+            * this->cfg_->samps_per_symbol() * sizeof(short);
+    }
+    H5::DSetAccPropList access;
+    access.setChunkCache(H5D_CHUNK_CACHE_NSLOTS_DEFAULT, cache_bytes,
+        H5D_CHUNK_CACHE_W0_DEFAULT);
+    return access;
+}
+
 void RecorderWorker::closeHDF5()
 {
     MLPD_TRACE("Close HD5F file: %s\n", this->hdf5_name_.c_str());
@@ -602,21 +454,41 @@ void RecorderWorker::closeHDF5()
     if (this->file_ == nullptr) {
         MLPD_WARN("File does not exist while calling close: %s\n",
             this->hdf5_name_.c_str());
+    } else if (this->open_ == false) {
+        MLPD_TRACE("HD5F file already closed: %s\n", this->hdf5_name_.c_str());
     } else {
         unsigned frame_number = this->max_frame_number_;
         hsize_t IQ = 2 * this->cfg_->samps_per_symbol();
 
-        assert(this->pilot_dataset_ != nullptr);
-        // Resize Pilot Dataset
-        this->frame_number_pilot_ = frame_number;
-        DataspaceIndex dims_pilot
-            = { this->frame_number_pilot_, this->cfg_->num_cells(),
-                  this->cfg_->pilot_syms_per_frame(), this->num_antennas_, IQ };
-        this->pilot_dataset_->extend(dims_pilot);
-        this->pilot_prop_.close();
-        this->pilot_dataset_->close();
-        delete this->pilot_dataset_;
-        this->pilot_dataset_ = nullptr;
+        // Write out whatever is still staged
+        while (this->stage_packets_ > 0)
+            this->flushBatch();
+
+        // Resize Pilot Dataset (If Needed)
+        if (this->pilot_dataset_ != nullptr) {
+            this->frame_number_pilot_ = frame_number;
+            DataspaceIndex dims_pilot = { this->frame_number_pilot_,
+                this->cfg_->num_cells(), this->cfg_->pilot_syms_per_frame(),
+                this->num_antennas_, IQ };
+            this->pilot_dataset_->extend(dims_pilot);
+            this->pilot_prop_.close();
+            this->pilot_dataset_->close();
+            delete this->pilot_dataset_;
+            this->pilot_dataset_ = nullptr;
+        }
+
+        // Resize CSI Dataset (If Needed)
+        if (this->csi_dataset_ != nullptr) {
+            this->frame_number_csi_ = frame_number;
+            DataspaceIndex dims_csi = { this->frame_number_csi_,
+                this->cfg_->num_cells(), this->cfg_->pilot_syms_per_frame(),
+                this->num_antennas_, 2 * this->csi_row_.size() };
+            this->csi_dataset_->extend(dims_csi);
+            this->csi_prop_.close();
+            this->csi_dataset_->close();
+            delete this->csi_dataset_;
+            this->csi_dataset_ = nullptr;
+        }
 
         // Resize Data Dataset (If Needed)
         if (this->cfg_->ul_syms_per_frame() > 0) {
@@ -647,12 +519,131 @@ void RecorderWorker::closeHDF5()
         }
 
         this->file_->close();
+        this->open_ = false;
         MLPD_INFO("Saving HD5F: %d frames saved on CPU %d\n", frame_number,
             sched_getcpu());
     }
 }
 
-herr_t RecorderWorker::record(int tid, Package* pkg)
+void RecorderWorker::writeBlock(H5::DataSet* dataset, size_t& frame_number,
+    int extent_step, size_t syms_per_frame, const hsize_t* offset,
+    const hsize_t* count, const void* data, const H5::PredType& type)
+{
+    // Are we going to extend the dataset?
+    size_t end_frame = offset[kDsFrameNumber] + count[kDsFrameNumber];
+    if (end_frame > frame_number) {
+        while (frame_number < end_frame)
+            frame_number += extent_step;
+        if (this->cfg_->max_frame() != 0) {
+            frame_number = std::min(frame_number, this->cfg_->max_frame() + 1);
+        }
+        DataspaceIndex dims = { frame_number, this->cfg_->num_cells(),
+            syms_per_frame, this->num_antennas_, count[kDsPkgDataLen] };
+        dataset->extend(dims);
+#if DEBUG_PRINT
+        std::cout << "FrameId " << offset[kDsFrameNumber] << ", Extent to "
+                  << frame_number << " Frames" << std::endl;
+#endif
+    }
+
+    // Select a hyperslab in extended portion of the dataset
+    H5::DataSpace filespace(dataset->getSpace());
+    filespace.selectHyperslab(H5S_SELECT_SET, count, offset);
+    // define memory space
+    H5::DataSpace memspace(kDsDim, count, NULL);
+    auto write_start = std::chrono::steady_clock::now();
+    dataset->write(data, type, memspace, filespace);
+    if (this->counters_ != nullptr) {
+        size_t bytes = type.getSize();
+        for (int i = 0; i < kDsDim; i++)
+            bytes *= count[i];
+        this->counters_->recordWrite(
+            std::chrono::steady_clock::now() - write_start, bytes);
+    }
+    filespace.close();
+}
+
+size_t RecorderWorker::stageRow(size_t syms_per_frame, size_t frame_id,
+    size_t cell_id, size_t sym_id, size_t ant_id)
+{
+    size_t frame = frame_id % (kStageBatches * this->batch_frames_);
+    size_t index = frame * this->cfg_->num_cells() + cell_id;
+    return (index * syms_per_frame + sym_id) * this->num_antennas_ + ant_id;
+}
+
+void RecorderWorker::flushBatch(void)
+{
+    size_t batch = (this->stage_frame_ / this->batch_frames_) % kStageBatches;
+    size_t num_frames = this->batch_frames_;
+    if (this->cfg_->max_frame() != 0) {
+        num_frames = std::min(num_frames,
+            this->cfg_->max_frame() + 1
+                - std::min(this->stage_frame_, this->cfg_->max_frame() + 1));
+    }
+
+    if ((this->batch_packets_.at(batch) > 0) && (num_frames > 0)) {
+        hsize_t IQ = 2 * this->cfg_->samps_per_symbol();
+        DataspaceIndex hdfoffset = { this->stage_frame_, 0, 0, 0, 0 };
+        DataspaceIndex count = { num_frames, this->cfg_->num_cells(), 0,
+            this->num_antennas_, 0 };
+        struct {
+            H5::DataSet* dataset;
+            char* stage;
+            const H5::PredType& type;
+            size_t row_len;
+            size_t row_bytes;
+            size_t& frame_number;
+            int extent_step;
+            size_t syms_per_frame;
+        } datasets[] = {
+            { this->pilot_dataset_,
+                reinterpret_cast<char*>(this->pilot_stage_.data()),
+                H5::PredType::NATIVE_INT16, IQ, IQ * sizeof(short),
+                this->frame_number_pilot_, kConfigPilotExtentStep,
+                this->cfg_->pilot_syms_per_frame() },
+            { this->noise_dataset_,
+                reinterpret_cast<char*>(this->noise_stage_.data()),
+                H5::PredType::NATIVE_INT16, IQ, IQ * sizeof(short),
+                this->frame_number_noise_, kConfigDataExtentStep,
+                this->cfg_->noise_syms_per_frame() },
+            { this->data_dataset_,
+                reinterpret_cast<char*>(this->data_stage_.data()),
+                H5::PredType::NATIVE_INT16, IQ, IQ * sizeof(short),
+                this->frame_number_data_, kConfigDataExtentStep,
+                this->cfg_->ul_syms_per_frame() },
+            { this->csi_dataset_,
+                reinterpret_cast<char*>(this->csi_stage_.data()),
+                H5::PredType::NATIVE_FLOAT, 2 * this->csi_row_.size(),
+                2 * this->csi_row_.size() * sizeof(float),
+                this->frame_number_csi_, kConfigPilotExtentStep,
+                this->cfg_->pilot_syms_per_frame() },
+        };
+        for (auto& ds : datasets) {
+            if ((ds.dataset == nullptr) || (ds.syms_per_frame == 0))
+                continue;
+            char* data = ds.stage
+                + ds.row_bytes
+                    * this->stageRow(
+                        ds.syms_per_frame, this->stage_frame_, 0, 0, 0);
+            count[kDsSymsPerFrame] = ds.syms_per_frame;
+            count[kDsPkgDataLen] = ds.row_len;
+            this->writeBlock(ds.dataset, ds.frame_number, ds.extent_step,
+                ds.syms_per_frame, hdfoffset, count, data, ds.type);
+            std::memset(data, 0,
+                this->batch_frames_ * this->cfg_->num_cells()
+                    * ds.syms_per_frame * this->num_antennas_ * ds.row_bytes);
+        }
+        if (this->counters_ != nullptr)
+            this->counters_->recordWritten(this->batch_enqueue_.at(batch));
+    }
+    this->stage_packets_ -= this->batch_packets_.at(batch);
+    this->batch_packets_.at(batch) = 0;
+    this->batch_enqueue_.at(batch).clear();
+    this->stage_frame_ += this->batch_frames_;
+}
+
+herr_t RecorderWorker::record(int tid, Package* pkg,
+    std::chrono::steady_clock::time_point enqueue_time)
 {
     (void)tid;
     /* TODO: remove TEMP check */
@@ -684,6 +675,9 @@ herr_t RecorderWorker::record(int tid, Package* pkg)
         closeHDF5();
         MLPD_TRACE("Closing file due to frame id %d : %zu max\n", pkg->frame_id,
             this->cfg_->max_frame());
+    } else if (this->open_ == false) {
+        MLPD_TRACE("Dropping frame %d, file is already closed\n",
+            pkg->frame_id);
     } else {
         try {
             H5::Exception::dontPrint();
@@ -697,114 +691,100 @@ herr_t RecorderWorker::record(int tid, Package* pkg)
                     = this->max_frame_number_ + MAX_FRAME_INC;
             }
 
+            H5::DataSet* dataset = nullptr;
+            std::vector<short>* stage = nullptr;
+            size_t* frame_number = nullptr;
+            int extent_step = kConfigDataExtentStep;
+            size_t syms_per_frame = 0;
+            const Config::SymbolInfo& info
+                = this->cfg_->symbolInfo(pkg->frame_id, pkg->symbol_id);
+            size_t sym_id = info.index;
+            switch (info.type) {
+            case Config::SymbolType::kPilot:
+                // Without record_pilot_samples only the CSI is recorded
+                dataset = this->pilot_dataset_;
+                stage = &this->pilot_stage_;
+                frame_number = &this->frame_number_pilot_;
+                extent_step = kConfigPilotExtentStep;
+                syms_per_frame = this->cfg_->pilot_syms_per_frame();
+                break;
+            case Config::SymbolType::kUplink:
+                assert(this->data_dataset_ != nullptr);
+                dataset = this->data_dataset_;
+                stage = &this->data_stage_;
+                frame_number = &this->frame_number_data_;
+                syms_per_frame = this->cfg_->ul_syms_per_frame();
+                break;
+            case Config::SymbolType::kNoise:
+                assert(this->noise_dataset_ != nullptr);
+                dataset = this->noise_dataset_;
+                stage = &this->noise_stage_;
+                frame_number = &this->frame_number_noise_;
+                syms_per_frame = this->cfg_->noise_syms_per_frame();
+                break;
+            default:
+                break;
+            }
+
+            bool csi = (info.type == Config::SymbolType::kPilot)
+                && (this->csi_dataset_ != nullptr);
+            if (csi == true)
+                this->csi_->extract(pkg->data, this->csi_row_.data());
+            hsize_t csi_len = 2 * this->csi_row_.size();
+
             uint32_t antenna_index = pkg->ant_id - this->antenna_offset_;
-            DataspaceIndex hdfoffset
-                = { pkg->frame_id, pkg->cell_id, 0, antenna_index, 0 };
-            if ((this->cfg_->reciprocal_calib() == true)
-                || (this->cfg_->isPilot(pkg->frame_id, pkg->symbol_id)
-                       == true)) {
-                assert(this->pilot_dataset_ != nullptr);
-                // Are we going to extend the dataset?
-                if (pkg->frame_id >= this->frame_number_pilot_) {
-                    this->frame_number_pilot_ += kConfigPilotExtentStep;
-                    if (this->cfg_->max_frame() != 0) {
-                        this->frame_number_pilot_
-                            = std::min(this->frame_number_pilot_,
-                                this->cfg_->max_frame() + 1);
+            if ((dataset == nullptr) && (csi == false)) {
+                // Not a recorded symbol
+            } else if (pkg->frame_id < this->stage_frame_) {
+                // The batch of this frame was already written out, so
+                // write the late packet on its own
+                DataspaceIndex hdfoffset
+                    = { pkg->frame_id, pkg->cell_id, sym_id, antenna_index, 0 };
+                if (dataset != nullptr) {
+                    DataspaceIndex count = { 1, 1, 1, 1, IQ };
+                    this->writeBlock(dataset, *frame_number, extent_step,
+                        syms_per_frame, hdfoffset, count, pkg->data,
+                        H5::PredType::NATIVE_INT16);
+                }
+                if (csi == true) {
+                    DataspaceIndex count = { 1, 1, 1, 1, csi_len };
+                    this->writeBlock(this->csi_dataset_,
+                        this->frame_number_csi_, kConfigPilotExtentStep,
+                        syms_per_frame, hdfoffset, count,
+                        this->csi_row_.data(), H5::PredType::NATIVE_FLOAT);
+                }
+                if (this->counters_ != nullptr)
+                    this->counters_->recordWritten({ enqueue_time });
+            } else {
+                size_t stage_end
+                    = this->stage_frame_ + kStageBatches * this->batch_frames_;
+                while (pkg->frame_id >= stage_end) {
+                    if (this->stage_packets_ == 0) {
+                        // Nothing staged, move the window to this frame
+                        size_t batch = pkg->frame_id / this->batch_frames_;
+                        batch -= std::min(batch, kStageBatches - 1);
+                        this->stage_frame_ = batch * this->batch_frames_;
+                    } else {
+                        this->flushBatch();
                     }
-                    DataspaceIndex dims_pilot
-                        = { this->frame_number_pilot_, this->cfg_->num_cells(),
-                              this->cfg_->pilot_syms_per_frame(),
-                              this->num_antennas_, IQ };
-                    this->pilot_dataset_->extend(dims_pilot);
-#if DEBUG_PRINT
-                    std::cout
-                        << "FrameId " << pkg->frame_id << ", (Pilot) Extent to "
-                        << this->frame_number_pilot_ << " Frames" << std::endl;
-#endif
+                    stage_end = this->stage_frame_
+                        + kStageBatches * this->batch_frames_;
                 }
-                hdfoffset[kDsSymsPerFrame]
-                    = this->cfg_->getClientId(pkg->frame_id, pkg->symbol_id);
-
-                // Select a hyperslab in extended portion of the dataset
-                H5::DataSpace pilot_filespace(this->pilot_dataset_->getSpace());
-                DataspaceIndex count = { 1, 1, 1, 1, IQ };
-                pilot_filespace.selectHyperslab(
-                    H5S_SELECT_SET, count, hdfoffset);
-                // define memory space
-                H5::DataSpace pilot_memspace(kDsDim, count, NULL);
-                this->pilot_dataset_->write(pkg->data,
-                    H5::PredType::NATIVE_INT16, pilot_memspace,
-                    pilot_filespace);
-                pilot_filespace.close();
-            } else if (this->cfg_->isData(pkg->frame_id, pkg->symbol_id)
-                == true) {
-                assert(this->data_dataset_ != nullptr);
-                // Are we going to extend the dataset?
-                if (pkg->frame_id >= this->frame_number_data_) {
-                    this->frame_number_data_ += kConfigDataExtentStep;
-                    if (this->cfg_->max_frame() != 0)
-                        this->frame_number_data_
-                            = std::min(this->frame_number_data_,
-                                this->cfg_->max_frame() + 1);
-                    DataspaceIndex dims_data
-                        = { this->frame_number_data_, this->cfg_->num_cells(),
-                              this->cfg_->ul_syms_per_frame(),
-                              this->num_antennas_, IQ };
-                    this->data_dataset_->extend(dims_data);
-#if DEBUG_PRINT
-                    std::cout
-                        << "FrameId " << pkg->frame_id << ", (Data) Extent to "
-                        << this->frame_number_data_ << " Frames" << std::endl;
-#endif
+                size_t row = this->stageRow(syms_per_frame, pkg->frame_id,
+                    pkg->cell_id, sym_id, antenna_index);
+                if (dataset != nullptr) {
+                    std::memcpy(stage->data() + row * IQ, pkg->data,
+                        IQ * sizeof(short));
                 }
-                hdfoffset[kDsSymsPerFrame]
-                    = this->cfg_->getUlSFIndex(pkg->frame_id, pkg->symbol_id);
-                // Select a hyperslab in extended portion of the dataset
-                H5::DataSpace data_filespace(this->data_dataset_->getSpace());
-                DataspaceIndex count = { 1, 1, 1, 1, IQ };
-                data_filespace.selectHyperslab(
-                    H5S_SELECT_SET, count, hdfoffset);
-                // define memory space
-                H5::DataSpace data_memspace(kDsDim, count, NULL);
-                this->data_dataset_->write(pkg->data,
-                    H5::PredType::NATIVE_INT16, data_memspace, data_filespace);
-                data_filespace.close();
-
-            } else if (this->cfg_->isNoise(pkg->frame_id, pkg->symbol_id)
-                == true) {
-                assert(this->noise_dataset_ != nullptr);
-                // Are we going to extend the dataset?
-                if (pkg->frame_id >= this->frame_number_noise_) {
-                    this->frame_number_noise_ += kConfigDataExtentStep;
-                    if (this->cfg_->max_frame() != 0)
-                        this->frame_number_noise_
-                            = std::min(this->frame_number_noise_,
-                                this->cfg_->max_frame() + 1);
-                    DataspaceIndex dims_noise
-                        = { this->frame_number_noise_, this->cfg_->num_cells(),
-                              this->cfg_->noise_syms_per_frame(),
-                              this->num_antennas_, IQ };
-                    this->noise_dataset_->extend(dims_noise);
-#if DEBUG_PRINT
-                    std::cout
-                        << "FrameId " << pkg->frame_id << ", (Noise) Extent to "
-                        << this->frame_number_noise_ << " Frames" << std::endl;
-#endif
+                if (csi == true) {
+                    std::memcpy(this->csi_stage_.data() + row * csi_len,
+                        this->csi_row_.data(), csi_len * sizeof(float));
                 }
-                hdfoffset[kDsSymsPerFrame] = this->cfg_->getNoiseSFIndex(
-                    pkg->frame_id, pkg->symbol_id);
-                // Select a hyperslab in extended portion of the dataset
-                H5::DataSpace noise_filespace(this->noise_dataset_->getSpace());
-                DataspaceIndex count = { 1, 1, 1, 1, IQ };
-                noise_filespace.selectHyperslab(
-                    H5S_SELECT_SET, count, hdfoffset);
-                // define memory space
-                H5::DataSpace noise_memspace(kDsDim, count, NULL);
-                this->noise_dataset_->write(pkg->data,
-                    H5::PredType::NATIVE_INT16, noise_memspace,
-                    noise_filespace);
-                noise_filespace.close();
+                size_t batch
+                    = (pkg->frame_id / this->batch_frames_) % kStageBatches;
+                this->batch_packets_.at(batch)++;
+                this->batch_enqueue_.at(batch).push_back(enqueue_time);
+                this->stage_packets_++;
             }
         }
         // catch failure caused by the H5File operations
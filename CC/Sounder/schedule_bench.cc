@@ -0,0 +1,135 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Measures the per packet cost of classifying a received symbol with
+ the Config schedule table against the former linear schedule search
+---------------------------------------------------------------------
+*/
+
+#include "include/config.h"
+#include "include/utils.h"
+#include "nlohmann/json.hpp"
+#include <gflags/gflags.h>
+
+DEFINE_string(conf, "files/conf.json", "JSON configuration file name");
+DEFINE_uint64(packets, 10000000, "Packets classified by each method");
+
+// Dataset and symbol index of a packet the way the recorder needs it
+struct Lookup {
+    int dataset;
+    int index;
+};
+
+// Classification as done before the schedule table, by searching the
+// frame schedule and the per type symbol lists for every packet
+class LinearSchedule {
+public:
+    explicit LinearSchedule(const std::string& conf)
+    {
+        const auto jConf = nlohmann::json::parse(conf, nullptr, true, true);
+        auto frames = jConf.at("BaseStations").at("frame_schedule");
+        frames_.assign(frames.begin(), frames.end());
+        pilot_symbols_ = Utils::loadSymbols(frames_, 'P');
+        noise_symbols_ = Utils::loadSymbols(frames_, 'N');
+        ul_symbols_ = Utils::loadSymbols(frames_, 'U');
+    }
+
+    Lookup lookup(int frame_id, int symbol_id)
+    {
+        if (isType(frame_id, symbol_id, 'P'))
+            return { 0, find(pilot_symbols_, frame_id, symbol_id) };
+        if (isType(frame_id, symbol_id, 'U'))
+            return { 2, find(ul_symbols_, frame_id, symbol_id) };
+        if (isType(frame_id, symbol_id, 'N'))
+            return { 1, find(noise_symbols_, frame_id, symbol_id) };
+        return { -1, -1 };
+    }
+
+private:
+    bool isType(int frame_id, int symbol_id, char type)
+    {
+        try {
+            return frames_[frame_id % frames_.size()].at(symbol_id) == type;
+        } catch (const std::out_of_range&) {
+            return false;
+        }
+    }
+
+    int find(std::vector<std::vector<size_t>>& symbols, int frame_id,
+        int symbol_id)
+    {
+        int fid = frame_id % frames_.size();
+        auto it = std::find(
+            symbols.at(fid).begin(), symbols.at(fid).end(), symbol_id);
+        if (it != symbols.at(fid).end())
+            return it - symbols.at(fid).begin();
+        return -1;
+    }
+
+    std::vector<std::string> frames_;
+    std::vector<std::vector<size_t>> pilot_symbols_;
+    std::vector<std::vector<size_t>> noise_symbols_;
+    std::vector<std::vector<size_t>> ul_symbols_;
+};
+
+static Lookup table_lookup(const Config& cfg, int frame_id, int symbol_id)
+{
+    const Config::SymbolInfo& info = cfg.symbolInfo(frame_id, symbol_id);
+    switch (info.type) {
+    case Config::SymbolType::kPilot:
+        return { 0, info.index };
+    case Config::SymbolType::kUplink:
+        return { 2, info.index };
+    case Config::SymbolType::kNoise:
+        return { 1, info.index };
+    default:
+        return { -1, -1 };
+    }
+}
+
+// Runs lookup over the packets of consecutive frames in receive order,
+// returns the nanoseconds per packet and a checksum of the results
+template <typename F>
+static double time_lookups(size_t symbols, F lookup, long& checksum)
+{
+    auto start = std::chrono::steady_clock::now();
+    checksum = 0;
+    for (size_t i = 0; i < FLAGS_packets; i++) {
+        Lookup l = lookup(i / symbols, i % symbols);
+        checksum += l.dataset * 31 + l.index;
+    }
+    std::chrono::duration<double, std::nano> elapsed
+        = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / FLAGS_packets;
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    std::string conf;
+    Utils::loadTDDConfig(FLAGS_conf, conf);
+    Config cfg(FLAGS_conf, "");
+    LinearSchedule linear(conf);
+    size_t symbols = cfg.symbols_per_frame();
+
+    long linear_sum;
+    long table_sum;
+    double linear_ns = time_lookups(
+        symbols, [&](int f, int s) { return linear.lookup(f, s); },
+        linear_sum);
+    double table_ns = time_lookups(
+        symbols, [&](int f, int s) { return table_lookup(cfg, f, s); },
+        table_sum);
+
+    std::printf("%zu symbols per frame, %zu packets\n", symbols,
+        static_cast<size_t>(FLAGS_packets));
+    std::printf("linear search: %8.2f ns/packet\n", linear_ns);
+    std::printf("table lookup:  %8.2f ns/packet\n", table_ns);
+    if (linear_sum != table_sum) {
+        std::printf("Lookup results differ\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Detection of a known sequence, such as the LTS or a pilot, in the sign
+ of received samples, behind CommsLib::findLTS and find_pilot_seq
+---------------------------------------------------------------------
+*/
+
+#include "include/sequence_detector.h"
+#include "include/comms-kernels.h"
+#include "include/comms-lib.h"
+#include <algorithm>
+
+SequenceDetector::SequenceDetector(
+    const std::vector<std::complex<float>>& seq)
+    : seq_(seq)
+    , correlator_(seq)
+{
+}
+
+bool SequenceDetector::matches(
+    const std::vector<std::complex<float>>& seq) const
+{
+    return seq == this->seq_;
+}
+
+float SequenceDetector::correlate(const std::complex<float>* iq, size_t length)
+{
+    const CommsKernels& kernels = CommsLib::kernels();
+    size_t pad = seq_.size() - 1;
+    size_t padded = length + 2 * pad;
+    size_t count = length + pad;
+    if (window_.size() < padded) {
+        window_.resize(padded);
+        corr_.resize(count);
+        power_.resize(count);
+    }
+
+    std::fill(window_.begin(), window_.begin() + pad, 0);
+    kernels.csign(iq, length, window_.data() + pad);
+    std::fill(window_.begin() + pad + length, window_.begin() + padded, 0);
+    if (CommsLib::use_fft_correlation(length, seq_.size()) == true)
+        correlator_.correlateValid(window_.data(), padded, corr_.data());
+    else
+        kernels.correlate_cf32(
+            window_.data(), count, seq_.data(), seq_.size(), corr_.data());
+    kernels.abs2_cf32(corr_.data(), count, power_.data());
+    return *std::max_element(power_.begin(), power_.begin() + count);
+}
+
+int SequenceDetector::findPeakPair(
+    const std::complex<float>* iq, size_t length, float thresh)
+{
+    size_t seq_len = seq_.size();
+    size_t count = length + seq_len - 1;
+    float limit = thresh * thresh * correlate(iq, length);
+    for (size_t i = seq_len; i < count; i++) {
+        if ((power_[i] > limit) && (power_[i - seq_len] > limit))
+            return i - seq_len;
+    }
+    return -1;
+}
+
+size_t SequenceDetector::findMaxPeak(
+    const std::complex<float>* iq, size_t length)
+{
+    size_t count = length + seq_.size() - 1;
+    correlate(iq, length);
+    return std::max_element(power_.begin(), power_.begin() + count)
+        - power_.begin();
+}
+
+std::vector<int> SequenceDetector::findPeakPair(
+    const std::vector<std::vector<std::complex<float>>>& iq, float thresh)
+{
+    std::vector<int> peaks(iq.size());
+    for (size_t i = 0; i < iq.size(); i++)
+        peaks[i] = findPeakPair(iq[i].data(), iq[i].size(), thresh);
+    return peaks;
+}
+
+std::vector<size_t> SequenceDetector::findMaxPeak(
+    const std::vector<std::vector<std::complex<float>>>& iq)
+{
+    std::vector<size_t> peaks(iq.size());
+    for (size_t i = 0; i < iq.size(); i++)
+        peaks[i] = findMaxPeak(iq[i].data(), iq[i].size());
+    return peaks;
+}
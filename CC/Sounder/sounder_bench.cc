@@ -0,0 +1,181 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Runs the receive to record pipeline on simulated base station radios
+ over a sweep of array and thread sizes and reports the sustained
+ throughput, queue depth, staging latency, file write latency and the
+ latency from enqueue until written as JSON
+---------------------------------------------------------------------
+*/
+
+#include "include/recorder.h"
+#include "include/utils.h"
+#include "nlohmann/json.hpp"
+#include <gflags/gflags.h>
+
+using json = nlohmann::json;
+
+DEFINE_string(antennas, "8,32,64",
+    "Comma separated list of base station antenna counts");
+DEFINE_string(rx_threads, "1,2,4", "Comma separated list of rx thread counts");
+DEFINE_string(task_threads, "1,2,4",
+    "Comma separated list of recorder thread counts");
+DEFINE_string(ofdm_symbols, "10",
+    "Comma separated list of OFDM symbols per subframe, sets the symbol size");
+DEFINE_string(frame_schedule, "BGPPUUUUUUUUUUUUUUUU",
+    "Base station frame schedule of the simulated radios");
+DEFINE_uint64(frames, 1000, "Frames recorded in each run");
+DEFINE_uint64(batch_frames, 1, "Frames the recorders write at once");
+DEFINE_string(record_format, "hdf5", "Recorder backend, hdf5 or raw");
+DEFINE_string(storepath, "logs", "Directory for the benchmark output files");
+DEFINE_string(output, "", "JSON results file, printed to stdout if empty");
+DEFINE_bool(keep, false, "Keep the recorded files");
+
+static const size_t kChannelsPerRadio = 2;
+
+// Base station only configuration with simulated radios producing
+// samples as fast as the pipeline takes them
+static json bench_config(size_t antennas, size_t rx_threads,
+    size_t task_threads, size_t ofdm_symbols, const std::string& trace_file)
+{
+    json bs;
+    bs["simulation"] = true;
+    bs["sim_max_speed"] = true;
+    bs["sim_sdr_num"] = { (antennas + kChannelsPerRadio - 1)
+        / kChannelsPerRadio };
+    bs["cells"] = 1;
+    bs["channel"] = "AB";
+    bs["frequency"] = 2.5e9;
+    bs["rate"] = 5e6;
+    bs["frame_schedule"] = { FLAGS_frame_schedule };
+    bs["max_frame"] = FLAGS_frames;
+    bs["ofdm_symbol_per_subframe"] = ofdm_symbols;
+    bs["fft_size"] = 64;
+    bs["cp_size"] = 16;
+    bs["prefix"] = 160;
+    bs["postfix"] = 160;
+    bs["beamsweep"] = true;
+    bs["beacon_antenna"] = 0;
+    bs["rx_thread"] = rx_threads;
+    bs["task_thread"] = task_threads;
+    bs["record_batch_frames"] = FLAGS_batch_frames;
+    bs["record_format"] = FLAGS_record_format;
+    bs["trace_file"] = trace_file;
+    json conf;
+    conf["BaseStations"] = bs;
+    return conf;
+}
+
+// Files written by the recorder threads, named as in RecorderWorker and
+// RawRecorderWorker
+static void remove_traces(Config* cfg)
+{
+    size_t threads = cfg->task_thread_num();
+    size_t total_antennas = cfg->getTotNumAntennas();
+    size_t thread_antennas = (total_antennas + threads - 1) / threads;
+    for (size_t i = 0; i < threads; i++) {
+        std::string filename = cfg->trace_file();
+        filename.insert(filename.find_last_of('.'),
+            "_" + std::to_string(i * thread_antennas) + "_"
+                + std::to_string((i + 1) * thread_antennas - 1));
+        if (cfg->record_format() == "raw") {
+            filename = filename.substr(0, filename.find_last_of('.')) + ".raw";
+            std::remove((filename + ".json").c_str());
+        }
+        std::remove(filename.c_str());
+    }
+}
+
+static json run(size_t antennas, size_t rx_threads, size_t task_threads,
+    size_t ofdm_symbols)
+{
+    std::string bench_conf = FLAGS_storepath + "/sounder-bench.json";
+    std::string bench_trace = FLAGS_storepath + "/sounder-bench.hdf5";
+    std::ofstream(bench_conf) << bench_config(antennas, rx_threads,
+                                     task_threads, ofdm_symbols, bench_trace)
+                                     .dump(4);
+
+    Config cfg(bench_conf, FLAGS_storepath);
+    Sounder::Recorder recorder(&cfg);
+    recorder.do_it();
+    const Sounder::RecorderStats& stats = recorder.stats();
+
+    double seconds
+        = std::chrono::duration<double>(stats.activeTime()).count();
+    json result;
+    result["antennas"] = cfg.getTotNumAntennas();
+    result["rx_threads"] = cfg.rx_thread_num();
+    result["task_threads"] = cfg.task_thread_num();
+    result["samps_per_symbol"] = cfg.samps_per_symbol();
+    result["frames"] = FLAGS_frames;
+    result["packets"] = stats.packets;
+    result["dropped"] = stats.dropped;
+    result["seconds"] = seconds;
+    result["packets_per_sec"] = seconds > 0 ? stats.packets / seconds : 0;
+    // Bytes the backends wrote to the files, batch padding and CSI
+    // included
+    result["mb_per_sec"]
+        = seconds > 0 ? stats.written_bytes / seconds / 1e6 : 0;
+    result["max_queue_depth"] = stats.max_queue_depth;
+    // Staging and file writes are timed apart, a staged package only
+    // reaches the file with the write of its batch. written_latency_us
+    // covers each package from its enqueue until that write returned.
+    struct {
+        const char* name;
+        const LatencyHistogram& hist;
+    } latencies[] = {
+        { "stage_latency_us", stats.stage_latency },
+        { "write_latency_us", stats.write_latency },
+        { "written_latency_us", stats.written_latency },
+    };
+    for (auto& latency : latencies) {
+        json& hist = result[latency.name];
+        hist["p50"] = latency.hist.percentile(0.5) / 1e3;
+        hist["p99"] = latency.hist.percentile(0.99) / 1e3;
+        hist["p999"] = latency.hist.percentile(0.999) / 1e3;
+        hist["max"] = latency.hist.max() / 1e3;
+    }
+
+    if (FLAGS_keep == false)
+        remove_traces(&cfg);
+    std::remove(bench_conf.c_str());
+    return result;
+}
+
+static std::vector<size_t> parse_list(const std::string& list)
+{
+    std::vector<size_t> values;
+    for (auto& value : Utils::split(list, ','))
+        values.push_back(std::stoul(value));
+    return values;
+}
+
+int main(int argc, char* argv[])
+{
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+    json results;
+    results["frame_schedule"] = FLAGS_frame_schedule;
+    results["batch_frames"] = FLAGS_batch_frames;
+    results["record_format"] = FLAGS_record_format;
+    results["runs"] = json::array();
+    for (size_t ofdm_symbols : parse_list(FLAGS_ofdm_symbols)) {
+        for (size_t antennas : parse_list(FLAGS_antennas)) {
+            for (size_t rx_threads : parse_list(FLAGS_rx_threads)) {
+                for (size_t task_threads : parse_list(FLAGS_task_threads)) {
+                    results["runs"].push_back(run(
+                        antennas, rx_threads, task_threads, ofdm_symbols));
+                }
+            }
+        }
+    }
+
+    if (FLAGS_output.empty() == true) {
+        std::cout << results.dump(4) << std::endl;
+    } else {
+        std::ofstream(FLAGS_output) << results.dump(4) << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,53 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Timing of the bring-up of a radio set, per stage and per radio
+---------------------------------------------------------------------
+*/
+
+#include "include/startup_report.h"
+#include <algorithm>
+#include <cstdio>
+
+StartupReport::StartupReport(const std::string& name)
+    : name_(name)
+    , start_(std::chrono::steady_clock::now())
+    , lap_(start_)
+{
+}
+
+void StartupReport::addRadio(const std::string& serial, double seconds)
+{
+    this->radios_.emplace_back(seconds, serial);
+}
+
+void StartupReport::endStage(const std::string& stage)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - this->lap_;
+    this->lap_ = now;
+    std::sort(this->radios_.begin(), this->radios_.end());
+    this->stages_.push_back({ stage, elapsed.count(), this->radios_ });
+    this->radios_.clear();
+}
+
+void StartupReport::print(void) const
+{
+    std::chrono::duration<double> total = this->lap_ - this->start_;
+    std::printf("%s bring-up took %.2f s\n", this->name_.c_str(),
+        total.count());
+    for (const Stage& stage : this->stages_) {
+        std::printf("  %-20s %8.3f s", stage.name.c_str(), stage.seconds);
+        const auto& radios = stage.radios;
+        if (radios.empty() == false) {
+            std::printf(", %zu radios: min %.3f s, median %.3f s, "
+                        "max %.3f s (%s)",
+                radios.size(), radios.front().first,
+                radios.at(radios.size() / 2).first, radios.back().first,
+                radios.back().second.c_str());
+        }
+        std::printf("\n");
+    }
+}
@@ -0,0 +1,193 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Per thread hot path counters and a reporter thread writing periodic
+ JSON snapshots of them to a file or a local UNIX datagram socket
+---------------------------------------------------------------------
+*/
+
+#include "include/telemetry.h"
+#include "include/logger.h"
+#include "nlohmann/json.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+static const std::string kUnixPrefix = "unix:";
+
+ThreadCounters::ThreadCounters(const std::string& thread_name)
+    : packets(0)
+    , bytes(0)
+    , short_reads(0)
+    , rx_errors(0)
+    , short_writes(0)
+    , late_tx(0)
+    , resyncs(0)
+    , dropped(0)
+    , queue_hwm(0)
+    , written_bytes(0)
+    , name(thread_name)
+{
+}
+
+void ThreadCounters::recordWrite(
+    std::chrono::steady_clock::duration duration, size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(this->write_time_mutex);
+    this->write_time.record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+            .count());
+    this->written_bytes += bytes;
+}
+
+void ThreadCounters::recordWritten(
+    const std::vector<std::chrono::steady_clock::time_point>& enqueue_times)
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(this->write_time_mutex);
+    for (auto& enqueue_time : enqueue_times) {
+        this->written_latency.record(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                now - enqueue_time)
+                .count());
+    }
+}
+
+Telemetry::Telemetry(const std::string& target, size_t period_ms)
+    : target_(target)
+    , period_ms_(period_ms)
+    , start_time_(std::chrono::steady_clock::now())
+    , running_(false)
+    , socket_(-1)
+{
+    if (this->target_.compare(0, kUnixPrefix.size(), kUnixPrefix) == 0) {
+        this->socket_ = socket(AF_UNIX, SOCK_DGRAM, 0);
+        if (this->socket_ < 0) {
+            MLPD_WARN("Telemetry socket creation failed: %s\n",
+                std::strerror(errno));
+        }
+    }
+}
+
+Telemetry::~Telemetry()
+{
+    this->stop();
+    if (this->socket_ >= 0)
+        close(this->socket_);
+}
+
+ThreadCounters* Telemetry::registerThread(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(this->threads_mutex_);
+    this->threads_.emplace_back(new ThreadCounters(name));
+    return this->threads_.back().get();
+}
+
+void Telemetry::start(void)
+{
+    if ((this->target_.empty() == true) || (this->reporter_.joinable()))
+        return;
+    MLPD_INFO("Reporting telemetry to %s every %zu ms\n",
+        this->target_.c_str(), this->period_ms_);
+    this->running_ = true;
+    this->reporter_ = std::thread(&Telemetry::report, this);
+}
+
+void Telemetry::stop(void)
+{
+    if (this->reporter_.joinable() == false)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(this->running_mutex_);
+        this->running_ = false;
+    }
+    this->running_cond_.notify_all();
+    this->reporter_.join();
+}
+
+std::string Telemetry::snapshot(void)
+{
+    json snap;
+    snap["time_ms"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - this->start_time_)
+                          .count();
+    snap["threads"] = json::array();
+
+    std::lock_guard<std::mutex> lock(this->threads_mutex_);
+    for (auto& counters : this->threads_) {
+        json thread;
+        thread["name"] = counters->name;
+        thread["packets"] = counters->packets.load();
+        thread["bytes"] = counters->bytes.load();
+        thread["short_reads"] = counters->short_reads.load();
+        thread["rx_errors"] = counters->rx_errors.load();
+        thread["short_writes"] = counters->short_writes.load();
+        thread["late_tx"] = counters->late_tx.load();
+        thread["resyncs"] = counters->resyncs.load();
+        thread["dropped"] = counters->dropped.load();
+        thread["queue_hwm"] = counters->queue_hwm.load();
+
+        LatencyHistogram write_time;
+        uint64_t written_bytes;
+        {
+            std::lock_guard<std::mutex> write_lock(
+                counters->write_time_mutex);
+            write_time.merge(counters->write_time);
+            written_bytes = counters->written_bytes;
+        }
+        if (write_time.count() > 0) {
+            thread["written_bytes"] = written_bytes;
+            json& hist = thread["write_us"];
+            hist["count"] = write_time.count();
+            hist["mean"] = write_time.mean() / 1e3;
+            hist["p50"] = write_time.percentile(0.5) / 1e3;
+            hist["p99"] = write_time.percentile(0.99) / 1e3;
+            hist["max"] = write_time.max() / 1e3;
+        }
+        snap["threads"].push_back(thread);
+    }
+    return snap.dump();
+}
+
+void Telemetry::report(void)
+{
+    std::unique_lock<std::mutex> lock(this->running_mutex_);
+    while (this->running_ == true) {
+        this->running_cond_.wait_for(lock,
+            std::chrono::milliseconds(this->period_ms_),
+            [this] { return this->running_ == false; });
+        lock.unlock();
+        this->publish(this->snapshot());
+        lock.lock();
+    }
+}
+
+void Telemetry::publish(const std::string& line)
+{
+    if (this->socket_ < 0) {
+        std::ofstream file(this->target_, std::ios::app);
+        if (file.is_open() == false) {
+            MLPD_WARN("Telemetry file %s could not be opened\n",
+                this->target_.c_str());
+            return;
+        }
+        file << line << std::endl;
+        return;
+    }
+
+    // Snapshots are dropped while nobody listens on the socket
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::string path = this->target_.substr(kUnixPrefix.size());
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    sendto(this->socket_, line.data(), line.size(), MSG_DONTWAIT,
+        reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+}
@@ -0,0 +1,172 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Checks the DC offset and IQ imbalance optimizers of the calibration
+ on simulated radios, the golden search reaching the levels of the
+ exhaustive sweep with fewer tone measurements
+---------------------------------------------------------------------
+*/
+
+#include "comms-lib.h"
+#include "dciq_optimizer.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+static const size_t kRadios = 50;
+static const size_t kFftSize = 1024;
+// The calibration tone, in fractions of the sample rate. magnitudeFFT
+// mirrors the spectrum, its image reads at kToneBin.
+static const double kToneBin = 1.0 / 7;
+static const double kToneAmplitude = 0.3;
+// Scale of a DC offset of 1 in the correction units of the radio
+static const double kDcScale = 0.25;
+// Largest final level above the exhaustive one, in dB
+static const float kLevelMargin = 1;
+
+// A receive path with a DC offset and an IQ imbalance, the snooped
+// samples holding the calibration tone, its image, the DC residual and
+// noise, measured like dciqMinimize does
+class SimRadio {
+public:
+    SimRadio(std::mt19937& gen, float noise)
+        : gen_(gen)
+        , noise_(0, noise)
+        , win_(CommsLib::hannWindowFunction(kFftSize))
+        , win_gain_(CommsLib::windowFunctionPower(win_))
+    {
+        std::uniform_real_distribution<double> offset(-0.8, 0.8);
+        std::uniform_real_distribution<double> gain(0.9, 1.1);
+        std::uniform_real_distribution<double> phase(-0.15, 0.15);
+        dc_ = std::complex<double>(offset(gen), offset(gen));
+        imbalance_ = std::polar(gain(gen), phase(gen));
+        dc_corr_ = 0;
+        iq_corr_ = 1;
+    }
+
+    // Like the setDCOffset of dciqMinimize with fixedScale
+    void setDc(int q, int i, int fixed_scale)
+    {
+        dc_corr_ = std::complex<double>(
+            double(i) / fixed_scale, double(q) / fixed_scale);
+    }
+    // Like setIQBalance
+    void setIq(int gcorr, int iqcorr)
+    {
+        auto gcorri = (gcorr < 0) ? 2047 - std::abs(gcorr) : 2047;
+        auto gcorrq = (gcorr > 0) ? 2047 - std::abs(gcorr) : 2047;
+        double gain_iq = double(gcorrq) / double(gcorri);
+        double phase_iq = 2 * std::atan(iqcorr / 2047.0);
+        iq_corr_ = std::polar(gain_iq, phase_iq);
+    }
+
+    float measure(double bin, bool noisy)
+    {
+        std::complex<double> image = (imbalance_ - iq_corr_) / 2.0;
+        std::complex<double> dc = (dc_ - dc_corr_) * kDcScale;
+        std::vector<std::complex<float>> samps(kFftSize);
+        for (size_t n = 0; n < kFftSize; n++) {
+            std::complex<double> tone
+                = std::polar(1.0, 2 * M_PI * kToneBin * n);
+            std::complex<double> s
+                = kToneAmplitude * (tone + image * std::conj(tone)) + dc;
+            if (noisy == true)
+                s += std::complex<double>(noise_(gen_), noise_(gen_));
+            samps[n] = std::complex<float>(s);
+        }
+        return CommsLib::measureTone(samps, win_, win_gain_, bin, kFftSize);
+    }
+
+private:
+    std::mt19937& gen_;
+    std::normal_distribution<double> noise_;
+    std::vector<float> win_;
+    double win_gain_;
+    std::complex<double> dc_;
+    std::complex<double> imbalance_;
+    std::complex<double> dc_corr_;
+    std::complex<double> iq_corr_;
+};
+
+struct Outcome {
+    float dc_level;
+    float iq_level;
+    size_t measurements;
+};
+
+// The DC and IQ searches of dciqMinimize, the levels are measured
+// without noise at the corrections found
+static Outcome calibrate(
+    const DciqOptimizer& optimizer, SimRadio& radio, int fixed_scale)
+{
+    radio.setDc(0, 0, fixed_scale);
+    radio.setIq(0, 0);
+    auto dc = optimizer.minimize(
+        [&](int q, int i) {
+            radio.setDc(q, i, fixed_scale);
+            return radio.measure(0, true);
+        },
+        -fixed_scale, fixed_scale);
+    radio.setDc(dc.x, dc.y, fixed_scale);
+    auto iq = optimizer.minimize(
+        [&](int gcorr, int iqcorr) {
+            radio.setIq(gcorr, iqcorr);
+            return radio.measure(kToneBin, true);
+        },
+        -512, 512);
+    radio.setIq(iq.x, iq.y);
+    return { radio.measure(0, false), radio.measure(kToneBin, false),
+        dc.measurements + iq.measurements };
+}
+
+int main(void)
+{
+    auto exhaustive = DciqOptimizer::create("exhaustive");
+    auto golden = DciqOptimizer::create("golden");
+    bool pass = true;
+    std::printf("%-8s %-4s %12s %12s %12s %12s %8s %8s\n", "noise", "path",
+        "dc exh (dB)", "dc gold (dB)", "iq exh (dB)", "iq gold (dB)",
+        "meas exh", "meas gold");
+    for (float noise : { 0.f, 1e-4f, 1e-3f }) {
+        // RX and TX paths differ in their DC correction scale
+        for (int fixed_scale : { 64, 128 }) {
+            std::mt19937 gen(1);
+            double sums[6] = { 0 };
+            float worst = -INFINITY;
+            for (size_t r = 0; r < kRadios; r++) {
+                SimRadio radio(gen, noise);
+                SimRadio twin = radio;
+                Outcome ref = calibrate(*exhaustive, radio, fixed_scale);
+                Outcome out = calibrate(*golden, twin, fixed_scale);
+                worst = std::max(worst, out.dc_level - ref.dc_level);
+                worst = std::max(worst, out.iq_level - ref.iq_level);
+                sums[0] += ref.dc_level;
+                sums[1] += out.dc_level;
+                sums[2] += ref.iq_level;
+                sums[3] += out.iq_level;
+                sums[4] += ref.measurements;
+                sums[5] += out.measurements;
+            }
+            std::printf("%-8g %-4s %12.1f %12.1f %12.1f %12.1f %8.0f %8.0f\n",
+                noise, fixed_scale == 64 ? "RX" : "TX", sums[0] / kRadios,
+                sums[1] / kRadios, sums[2] / kRadios, sums[3] / kRadios,
+                sums[4] / kRadios, sums[5] / kRadios);
+            // The worst radio may end a little above the sweep in noise,
+            // on average the levels and half the measurements must hold
+            bool same_levels = (sums[1] <= sums[0] + kLevelMargin * kRadios)
+                && (sums[3] <= sums[2] + kLevelMargin * kRadios);
+            bool cheaper = sums[5] * 2 < sums[4];
+            if ((same_levels == false) || (cheaper == false)) {
+                std::printf("golden search mismatch, worst radio %.1f dB "
+                            "above the sweep\n",
+                    worst);
+                pass = false;
+            }
+        }
+    }
+    std::printf("\n%s\n", pass ? "PASSED" : "FAILED");
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,242 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Checks every CommsLib kernel table the CPU supports against the scalar
+ one, on lengths that leave vector remainders, and times each kernel
+---------------------------------------------------------------------
+*/
+
+#include "comms-kernels.h"
+#include "comms-lib.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+typedef std::vector<std::complex<float>> Samples;
+typedef std::vector<std::complex<int16_t>> SamplesCs16;
+
+static const size_t kLengths[] = { 1, 7, 15, 16, 33, 257, 4099 };
+static const size_t kTimedLength = 4096;
+static const size_t kIterations = 200;
+
+// Microseconds per call of run
+template <typename F> static double time_calls(F run)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; i++)
+        run();
+    std::chrono::duration<double, std::micro> elapsed
+        = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / kIterations;
+}
+
+// Largest difference relative to the largest scalar magnitude
+template <typename T>
+static double rel_err(const std::vector<T>& ref, const std::vector<T>& out)
+{
+    double peak = 0;
+    double err = 0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        peak = std::max<double>(peak, std::abs(ref[i]));
+        err = std::max<double>(err, std::abs(ref[i] - out[i]));
+    }
+    return peak > 0 ? err / peak : err;
+}
+
+struct TestData {
+    Samples cf32;
+    SamplesCs16 cs16;
+    Samples seq_cf32;
+    SamplesCs16 seq_cs16;
+    std::vector<uint32_t> taps_cs16;
+    std::vector<float> real;
+};
+
+static TestData make_data(size_t len, size_t seq_len, std::mt19937& gen)
+{
+    std::normal_distribution<float> normal(0, 1);
+    std::uniform_int_distribution<int> full(-32768, 32767);
+    TestData d;
+    d.cf32.resize(len + seq_len);
+    d.cs16.resize(len + seq_len);
+    d.real.resize(len);
+    for (auto& s : d.cf32)
+        s = std::complex<float>(normal(gen), normal(gen));
+    // Zero parts for the sign function
+    for (size_t i = 0; i < d.cf32.size(); i += 5)
+        d.cf32[i].real(0);
+    for (size_t i = 0; i < d.cf32.size(); i += 10)
+        d.cf32[i].imag(0);
+    for (auto& s : d.cs16)
+        s = std::complex<int16_t>(full(gen), full(gen));
+    // The saturating corners
+    d.cs16[0] = std::complex<int16_t>(-32768, -32768);
+    if (len > 1)
+        d.cs16[1] = std::complex<int16_t>(32767, -32768);
+    for (auto& r : d.real)
+        r = std::abs(normal(gen));
+    for (size_t j = 0; j < seq_len; j++) {
+        d.seq_cf32.push_back(std::complex<float>(normal(gen), normal(gen)));
+        d.seq_cs16.push_back(std::complex<int16_t>(full(gen), full(gen)));
+    }
+    d.taps_cs16.resize(2 * seq_len);
+    correlate_cs16_taps(d.seq_cs16.data(), seq_len, d.taps_cs16.data());
+    return d;
+}
+
+// Runs every kernel of table on d, the outputs in the order of the checks
+struct Outputs {
+    Samples corr_cf32;
+    SamplesCs16 corr_cs16;
+    Samples mult_cf32[2];
+    SamplesCs16 mult_cs16[2];
+    std::vector<float> abs2_cf32;
+    std::vector<int32_t> abs2_cs16;
+    Samples csign;
+    std::vector<float> moving_sum;
+};
+
+static Outputs run_kernels(const CommsKernels& k, const TestData& d,
+    size_t len, size_t seq_len, size_t window)
+{
+    Outputs o;
+    o.corr_cf32.resize(len);
+    k.correlate_cf32(d.cf32.data(), len, d.seq_cf32.data(), seq_len,
+        o.corr_cf32.data());
+    o.corr_cs16.resize(len);
+    k.correlate_cs16(d.cs16.data(), len, d.taps_cs16.data(), seq_len, 8, 8,
+        o.corr_cs16.data());
+    for (int conj = 0; conj < 2; conj++) {
+        o.mult_cf32[conj].resize(len);
+        k.complex_mult_cf32(d.cf32.data(), d.cf32.data() + seq_len, len,
+            conj == 1, o.mult_cf32[conj].data());
+        o.mult_cs16[conj].resize(len);
+        k.complex_mult_cs16(d.cs16.data(), d.cs16.data() + seq_len, len,
+            conj == 1, o.mult_cs16[conj].data());
+    }
+    o.abs2_cf32.resize(len);
+    k.abs2_cf32(d.cf32.data(), len, o.abs2_cf32.data());
+    o.abs2_cs16.resize(len);
+    k.abs2_cs16(d.cs16.data(), len, o.abs2_cs16.data());
+    o.csign.resize(len);
+    k.csign(d.cf32.data(), len, o.csign.data());
+    o.moving_sum.resize(len);
+    k.moving_sum(d.real.data(), len, window, o.moving_sum.data());
+    return o;
+}
+
+static bool check(const char* table, const char* kernel, size_t len,
+    double err, double tolerance)
+{
+    if (err <= tolerance)
+        return true;
+    std::printf("%s %s mismatch for %zu samples, error %.3e\n", table,
+        kernel, len, err);
+    return false;
+}
+
+static bool compare(
+    const char* table, const Outputs& ref, const Outputs& out, size_t len)
+{
+    bool pass = true;
+    pass &= check(table, "correlate_cf32", len,
+        rel_err(ref.corr_cf32, out.corr_cf32), 1e-5);
+    pass &= check(table, "correlate_cs16", len,
+        ref.corr_cs16 == out.corr_cs16 ? 0 : 1, 0);
+    for (int conj = 0; conj < 2; conj++) {
+        pass &= check(table, "complex_mult_cf32", len,
+            rel_err(ref.mult_cf32[conj], out.mult_cf32[conj]), 1e-6);
+        pass &= check(table, "complex_mult_cs16", len,
+            ref.mult_cs16[conj] == out.mult_cs16[conj] ? 0 : 1, 0);
+    }
+    pass &= check(
+        table, "abs2_cf32", len, rel_err(ref.abs2_cf32, out.abs2_cf32), 1e-6);
+    pass &= check(table, "abs2_cs16", len,
+        ref.abs2_cs16 == out.abs2_cs16 ? 0 : 1, 0);
+    pass &= check(table, "csign", len, ref.csign == out.csign ? 0 : 1, 0);
+    pass &= check(table, "moving_sum", len,
+        rel_err(ref.moving_sum, out.moving_sum), 1e-6);
+    return pass;
+}
+
+int main(void)
+{
+    std::vector<const CommsKernels*> tables = { &kScalarKernels };
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        tables.push_back(&kAvx2Kernels);
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        tables.push_back(&kAvx512Kernels);
+#endif
+    std::printf("Selected kernels: %s\n", CommsLib::kernels().name);
+
+    std::mt19937 gen(1);
+    bool pass = true;
+    const size_t seq_lens[] = { 1, 3, 128 };
+    for (size_t len : kLengths) {
+        for (size_t seq_len : seq_lens) {
+            TestData d = make_data(len, seq_len, gen);
+            size_t window = std::min<size_t>(seq_len, len);
+            Outputs ref = run_kernels(kScalarKernels, d, len, seq_len, window);
+            for (size_t t = 1; t < tables.size(); t++) {
+                Outputs out = run_kernels(*tables[t], d, len, seq_len, window);
+                pass &= compare(tables[t]->name, ref, out, len);
+            }
+        }
+    }
+
+    // Timings on a frame against a gold sized sequence
+    size_t len = kTimedLength;
+    size_t seq_len = 128;
+    TestData d = make_data(len, seq_len, gen);
+    Samples out_cf32(len);
+    SamplesCs16 out_cs16(len);
+    std::vector<float> out_real(len);
+    std::vector<int32_t> out_int(len);
+    std::printf("\nMicroseconds per call on %zu samples\n", len);
+    std::printf("%-18s", "kernel");
+    for (auto* t : tables)
+        std::printf(" %10s", t->name);
+    std::printf("\n");
+    auto report = [&](const char* kernel, auto run) {
+        std::printf("%-18s", kernel);
+        for (auto* t : tables)
+            std::printf(" %10.2f", time_calls([&]() { run(*t); }));
+        std::printf("\n");
+    };
+    report("correlate_cf32", [&](const CommsKernels& k) {
+        k.correlate_cf32(
+            d.cf32.data(), len, d.seq_cf32.data(), seq_len, out_cf32.data());
+    });
+    report("correlate_cs16", [&](const CommsKernels& k) {
+        k.correlate_cs16(d.cs16.data(), len, d.taps_cs16.data(), seq_len, 8,
+            8, out_cs16.data());
+    });
+    report("complex_mult_cf32", [&](const CommsKernels& k) {
+        k.complex_mult_cf32(
+            d.cf32.data(), d.cf32.data() + 1, len, true, out_cf32.data());
+    });
+    report("complex_mult_cs16", [&](const CommsKernels& k) {
+        k.complex_mult_cs16(
+            d.cs16.data(), d.cs16.data() + 1, len, true, out_cs16.data());
+    });
+    report("abs2_cf32", [&](const CommsKernels& k) {
+        k.abs2_cf32(d.cf32.data(), len, out_real.data());
+    });
+    report("abs2_cs16", [&](const CommsKernels& k) {
+        k.abs2_cs16(d.cs16.data(), len, out_int.data());
+    });
+    report("csign", [&](const CommsKernels& k) {
+        k.csign(d.cf32.data(), len, out_cf32.data());
+    });
+    report("moving_sum", [&](const CommsKernels& k) {
+        k.moving_sum(d.real.data(), len, seq_len, out_real.data());
+    });
+
+    std::printf("\n%s\n", pass ? "PASSED" : "FAILED");
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,191 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Checks the QAM modulator and demodulators of every CommsLib kernel
+ table the CPU supports, and their throughput in symbols per second
+---------------------------------------------------------------------
+*/
+
+#include "comms-kernels.h"
+#include "comms-lib.h"
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+typedef std::vector<std::complex<float>> Samples;
+
+static const size_t kLengths[] = { 1, 7, 15, 16, 33, 257, 4099 };
+// A frame of data subcarriers for 64 antennas
+static const size_t kAntennas = 64;
+static const size_t kSubcarriers = 1200;
+static const size_t kIterations = 20;
+static const int kOrders[] = { CommsLib::QPSK, CommsLib::QAM16,
+    CommsLib::QAM64 };
+
+// The per call table the modulator used to build
+static Samples reference_points(int type)
+{
+    size_t axis_len = 1 << (type / 2);
+    std::vector<float> axis(axis_len);
+    if (type == CommsLib::QPSK) {
+        float scale = 1 / sqrt(2);
+        axis = { -scale, scale };
+    } else if (type == CommsLib::QAM16) {
+        float scale = 1 / sqrt(10);
+        axis = { -3 * scale, -1 * scale, 3 * scale, scale };
+    } else {
+        float scale = 1 / sqrt(42);
+        axis = { -7 * scale, -5 * scale, -3 * scale, -1 * scale, scale,
+            3 * scale, 5 * scale, 7 * scale };
+    }
+    Samples points(axis_len * axis_len);
+    for (size_t i = 0; i < points.size(); i++)
+        points[i] = std::complex<float>(axis[i / axis_len], axis[i % axis_len]);
+    return points;
+}
+
+static bool check(const char* what, int type, size_t len, bool ok)
+{
+    if (!ok)
+        std::printf("%s mismatch for order %d, %zu samples\n", what, type, len);
+    return ok;
+}
+
+// Max-log LLRs over the whole constellation
+static std::vector<float> brute_force_llr(
+    const Samples& in, const Samples& points, int type, float noise_var)
+{
+    std::vector<float> llr(in.size() * type);
+    for (size_t i = 0; i < in.size(); i++) {
+        for (int j = 0; j < type; j++) {
+            float min0 = INFINITY;
+            float min1 = INFINITY;
+            for (size_t p = 0; p < points.size(); p++) {
+                float dist = std::norm(in[i] - points[p]);
+                if (((p >> (type - 1 - j)) & 1) != 0)
+                    min1 = std::min(min1, dist);
+                else
+                    min0 = std::min(min0, dist);
+            }
+            llr[i * type + j] = (min1 - min0) / noise_var;
+        }
+    }
+    return llr;
+}
+
+// Microseconds per call of run
+template <typename F> static double time_calls(F run)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; i++)
+        run();
+    std::chrono::duration<double, std::micro> elapsed
+        = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / kIterations;
+}
+
+int main(void)
+{
+    std::vector<const CommsKernels*> tables = { &kScalarKernels };
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        tables.push_back(&kAvx2Kernels);
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+        tables.push_back(&kAvx512Kernels);
+#endif
+    std::printf("Selected kernels: %s\n", CommsLib::kernels().name);
+
+    std::mt19937 gen(1);
+    std::normal_distribution<float> noise(0, 0.1);
+    const float noise_var = 2 * 0.1 * 0.1;
+    bool pass = true;
+    for (int type : kOrders) {
+        Samples points = reference_points(type);
+        std::uniform_int_distribution<int> labels(0, points.size() - 1);
+        for (size_t len : kLengths) {
+            std::vector<uint8_t> bits(len);
+            for (auto& b : bits)
+                b = labels(gen);
+            Samples tx = CommsLib::modulate(bits, type);
+            bool same = true;
+            for (size_t i = 0; i < len; i++)
+                same &= tx[i] == points[bits[i]];
+            pass &= check("modulate", type, len, same);
+            pass &= check("noiseless demodulate", type, len,
+                CommsLib::demodulate(tx, type) == bits);
+
+            Samples rx(len);
+            for (size_t i = 0; i < len; i++)
+                rx[i] = tx[i] + std::complex<float>(noise(gen), noise(gen));
+            std::vector<float> llr
+                = CommsLib::demodulateSoft(rx, type, noise_var);
+            std::vector<float> ref
+                = brute_force_llr(rx, points, type, noise_var);
+            double err = 0;
+            for (size_t i = 0; i < llr.size(); i++)
+                err = std::max<double>(err, std::abs(llr[i] - ref[i]));
+            pass &= check("demodulateSoft", type, len, err < 1e-3);
+
+            // Every table gives the scalar outputs
+            const QamAxis& axis = *CommsLib::qamAxis(type);
+            for (size_t t = 1; t < tables.size(); t++) {
+                Samples t_tx(len);
+                std::vector<uint8_t> ref_hard(len), t_hard(len);
+                std::vector<float> ref_soft(len * type), t_soft(len * type);
+                kScalarKernels.qam_demod_hard(
+                    rx.data(), len, axis, ref_hard.data());
+                tables[t]->qam_modulate(bits.data(), len, axis, t_tx.data());
+                tables[t]->qam_demod_hard(rx.data(), len, axis, t_hard.data());
+                kScalarKernels.qam_demod_soft(
+                    rx.data(), len, axis, 1, ref_soft.data());
+                tables[t]->qam_demod_soft(
+                    rx.data(), len, axis, 1, t_soft.data());
+                pass &= check(tables[t]->name, type, len,
+                    (t_tx == tx) && (t_hard == ref_hard)
+                        && (t_soft == ref_soft));
+            }
+        }
+    }
+
+    // Throughput on one frame of all antennas
+    size_t len = kAntennas * kSubcarriers;
+    std::printf("\nMsymbols/s on %zu antennas x %zu subcarriers\n", kAntennas,
+        kSubcarriers);
+    std::printf("%-18s", "kernel");
+    for (auto* t : tables)
+        std::printf(" %10s", t->name);
+    std::printf("\n");
+    for (int type : kOrders) {
+        const QamAxis& axis = *CommsLib::qamAxis(type);
+        std::uniform_int_distribution<int> labels(0, (1 << type) - 1);
+        std::vector<uint8_t> bits(len);
+        for (auto& b : bits)
+            b = labels(gen);
+        Samples tx(len);
+        std::vector<float> llr(len * type);
+        auto report = [&](const char* kernel, auto run) {
+            std::printf("%-12s %5d", kernel, type);
+            for (auto* t : tables) {
+                double us = time_calls([&]() { run(*t); });
+                std::printf(" %10.1f", len / us);
+            }
+            std::printf("\n");
+        };
+        report("modulate", [&](const CommsKernels& k) {
+            k.qam_modulate(bits.data(), len, axis, tx.data());
+        });
+        report("demod_hard", [&](const CommsKernels& k) {
+            k.qam_demod_hard(tx.data(), len, axis, bits.data());
+        });
+        report("demod_soft", [&](const CommsKernels& k) {
+            k.qam_demod_soft(tx.data(), len, axis, 1, llr.data());
+        });
+    }
+
+    std::printf("\n%s\n", pass ? "PASSED" : "FAILED");
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
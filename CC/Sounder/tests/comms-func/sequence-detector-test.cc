@@ -0,0 +1,176 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Checks that findLTS and find_pilot_seq, now on a SequenceDetector,
+ return the indices of the convolution based search they replaced on
+ noisy receive buffers holding the sequence at various offsets
+---------------------------------------------------------------------
+*/
+
+#include "comms-lib.h"
+#include "constants.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <queue>
+#include <random>
+#include <vector>
+
+typedef std::vector<std::complex<float>> Samples;
+
+static const size_t kBufferLen = 1024;
+static const int kLtsSeqLen = 160;
+static const size_t kTrials = 20;
+// Receive SNRs in dB, the last ones below the detection threshold
+static const float kSnrs[] = { 30, 10, 3, 0, -6, -20 };
+
+static Samples to_complex(const std::vector<std::vector<float>>& seq)
+{
+    Samples out(seq[0].size());
+    for (size_t i = 0; i < out.size(); i++)
+        out[i] = std::complex<float>(seq[0][i], seq[1][i]);
+    return out;
+}
+
+// findLTS as it was, convolving csign(iq) with the flipped conjugate of
+// the last LTS symbol
+static int convolution_find_lts(const Samples& iq, int seqLen)
+{
+    float lts_thresh = 0.8;
+    auto lts_seq = CommsLib::getSequence(CommsLib::LTS_SEQ, seqLen);
+
+    const size_t lts_symbol_len = Consts::kFftSize_80211;
+    Samples lts_sym_conj(lts_symbol_len);
+    for (size_t i = 0; i < lts_sym_conj.size(); i++) {
+        lts_sym_conj[i] = std::conj(std::complex<float>(
+            lts_seq[0][seqLen - 1 - i], lts_seq[1][seqLen - 1 - i]));
+    }
+
+    auto iq_sign = CommsLib::csign(iq);
+    auto lts_corr = CommsLib::convolve(iq_sign, lts_sym_conj);
+    std::vector<float> lts_corr_abs(lts_corr.size());
+    std::transform(
+        lts_corr.begin(), lts_corr.end(), lts_corr_abs.begin(), computeAbs);
+    double lts_limit = lts_thresh
+        * *std::max_element(lts_corr_abs.begin(), lts_corr_abs.end());
+
+    std::queue<int> valid_peaks;
+    for (size_t i = lts_symbol_len; i < lts_corr.size(); i++) {
+        if (lts_corr_abs[i] > lts_limit
+            && lts_corr_abs[i - lts_symbol_len] > lts_limit)
+            valid_peaks.push(i - lts_symbol_len);
+    }
+    return valid_peaks.empty() ? -1 : valid_peaks.front();
+}
+
+// find_pilot_seq as it was
+static size_t convolution_find_pilot(
+    const Samples& iq, const Samples& pilot, size_t seq_len)
+{
+    Samples pilot_conj;
+    for (size_t i = 0; i < seq_len; i++)
+        pilot_conj.push_back(std::conj(pilot[seq_len - i - 1]));
+
+    auto iq_sign = CommsLib::csign(iq);
+    auto pilot_corr = CommsLib::convolve(iq_sign, pilot_conj);
+    std::vector<float> pilot_corr_abs(pilot_corr.size());
+    for (size_t i = 0; i < pilot_corr_abs.size(); i++)
+        pilot_corr_abs[i] = computePower(pilot_corr[i]);
+    return std::max_element(pilot_corr_abs.begin(), pilot_corr_abs.end())
+        - pilot_corr_abs.begin();
+}
+
+// seq at offset with a random gain and phase in complex Gaussian noise of
+// unit power, the sequence scaled to the SNR
+static Samples receive(
+    const Samples& seq, size_t offset, float snr, std::mt19937& gen)
+{
+    std::normal_distribution<float> noise(0, std::sqrt(0.5f));
+    std::uniform_real_distribution<float> phase(-M_PI, M_PI);
+    std::uniform_real_distribution<float> gain_db(-3, 3);
+    double power = 0;
+    for (auto& s : seq)
+        power += std::norm(s);
+    power /= seq.size();
+    std::complex<float> gain = std::polar(
+        std::pow(10.f, (snr + gain_db(gen)) / 20) / float(std::sqrt(power)),
+        phase(gen));
+
+    Samples iq(kBufferLen);
+    for (auto& s : iq)
+        s = std::complex<float>(noise(gen), noise(gen));
+    for (size_t i = 0; (i < seq.size()) && (offset + i < kBufferLen); i++)
+        iq[offset + i] += gain * seq[i];
+    return iq;
+}
+
+int main(void)
+{
+    Samples lts = to_complex(
+        CommsLib::getSequence(CommsLib::LTS_SEQ, kLtsSeqLen));
+    Samples gold = to_complex(CommsLib::getSequence(CommsLib::GOLD_IFFT));
+    const struct {
+        const char* name;
+        const Samples& seq;
+    } pilots[] = { { "lts", lts }, { "gold", gold } };
+
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<size_t> offset(0, kBufferLen - kLtsSeqLen);
+    bool pass = true;
+    std::printf("%-8s %8s %10s %10s\n", "snr (dB)", "buffers", "lts found",
+        "mismatches");
+    for (float snr : kSnrs) {
+        std::vector<Samples> buffers;
+        std::vector<int> expected;
+        size_t found = 0;
+        size_t mismatches = 0;
+        for (size_t t = 0; t < kTrials; t++) {
+            // The buffer edges and a sequence cut short by the end of
+            // the buffer, then random offsets
+            size_t at = (t == 0) ? 0
+                : (t == 1)       ? kBufferLen - kLtsSeqLen
+                : (t == 2)       ? kBufferLen - kLtsSeqLen / 2
+                                 : offset(gen);
+            Samples iq = receive(lts, at, snr, gen);
+            int ref = convolution_find_lts(iq, kLtsSeqLen);
+            int out = CommsLib::findLTS(iq, kLtsSeqLen);
+            if (ref != out) {
+                std::printf("findLTS at offset %zu, SNR %g dB: %d, "
+                            "convolution %d\n",
+                    at, snr, out, ref);
+                mismatches++;
+            }
+            found += (ref >= 0) ? 1 : 0;
+            buffers.push_back(iq);
+            expected.push_back(ref);
+
+            for (auto& pilot : pilots) {
+                Samples rx = receive(pilot.seq, at, snr, gen);
+                size_t ref_pilot
+                    = convolution_find_pilot(rx, pilot.seq, pilot.seq.size());
+                size_t out_pilot
+                    = CommsLib::find_pilot_seq(rx, pilot.seq, pilot.seq.size());
+                if (ref_pilot != out_pilot) {
+                    std::printf("find_pilot_seq of %s at offset %zu, SNR %g "
+                                "dB: %zu, convolution %zu\n",
+                        pilot.name, at, snr, out_pilot, ref_pilot);
+                    mismatches++;
+                }
+            }
+        }
+        // The overload over one buffer per antenna
+        if (CommsLib::findLTS(buffers, kLtsSeqLen) != expected) {
+            std::printf("findLTS over %zu buffers differs at SNR %g dB\n",
+                buffers.size(), snr);
+            mismatches++;
+        }
+        std::printf("%-8g %8zu %10zu %10zu\n", snr, kTrials, found,
+            mismatches);
+        pass &= (mismatches == 0);
+    }
+
+    std::printf("\n%s\n", pass ? "PASSED" : "FAILED");
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,81 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Loads the uplink time domain data of one client in memory
+---------------------------------------------------------------------
+*/
+
+#include "include/tx_data_ring.h"
+#include "include/logger.h"
+#include "include/macros.h"
+#include "include/utils.h"
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+TxDataRing::TxDataRing(Config* cfg, size_t client, bool cs16)
+    : frames_(cfg->ul_data_frame_num())
+    , slots_(cfg->cl_ul_symbols().at(client).size())
+    , channel_num_(cfg->cl_sdr_ch())
+    , bytes_(0)
+    , samples_(nullptr)
+{
+    if (this->frames_ == 0)
+        throw std::invalid_argument("ul_data_frame_num must be at least 1");
+
+    size_t samps = cfg->samps_per_symbol();
+    size_t symbols = this->frames_ * this->slots_ * this->channel_num_;
+    size_t sample_size = cs16 ? sizeof(std::complex<int16_t>)
+                              : sizeof(std::complex<float>);
+    size_t symbol_bytes = samps * sample_size;
+    this->bytes_ = symbols * symbol_bytes;
+    if (symbols == 0)
+        return;
+
+    const std::string& filename = cfg->tx_td_data_files().at(client);
+    std::printf("Loading %zu frames of UL time-domain data for radio %zu "
+                "from %s\n",
+        this->frames_, client, filename.c_str());
+    FILE* fp = std::fopen(filename.c_str(), "rb");
+    if (fp == nullptr)
+        throw std::runtime_error(filename + std::string(" not found!"));
+
+    size_t alloc_bytes = (this->bytes_ + kCacheLineSize - 1) / kCacheLineSize
+        * kCacheLineSize;
+    this->samples_
+        = static_cast<char*>(std::aligned_alloc(kCacheLineSize, alloc_bytes));
+    if (this->samples_ == nullptr) {
+        std::fclose(fp);
+        throw std::bad_alloc();
+    }
+
+    // The file is CF32, CS16 streams get it converted one symbol at a time
+    size_t read_num;
+    if (cs16 == false) {
+        read_num = std::fread(this->samples_, symbol_bytes, symbols, fp);
+    } else {
+        std::vector<std::complex<float>> cf32(samps);
+        auto* out = reinterpret_cast<std::complex<int16_t>*>(this->samples_);
+        for (read_num = 0; read_num < symbols; read_num++) {
+            if (std::fread(cf32.data(), sizeof(cf32[0]), samps, fp) != samps)
+                break;
+            Utils::cfloat_to_cint16(cf32.data(), out + read_num * samps, samps);
+        }
+    }
+    std::fclose(fp);
+    if (read_num != symbols) {
+        std::free(this->samples_);
+        throw std::runtime_error(filename + " holds " + std::to_string(read_num)
+            + " of " + std::to_string(symbols) + " UL symbols");
+    }
+
+    this->channels_.resize(symbols);
+    for (size_t s = 0; s < symbols; s++)
+        this->channels_[s] = this->samples_ + s * symbol_bytes;
+    MLPD_INFO("UL data of radio %zu: %zu frames x %zu slots in %.1f MB\n",
+        client, this->frames_, this->slots_, this->bytes_ / 1e6);
+}
+
+TxDataRing::~TxDataRing() { std::free(this->samples_); }
@@ -9,6 +9,8 @@
 */
 
 #include "include/utils.h"
+#include <algorithm>
+#include <cmath>
 
 int pin_to_core(int core_id)
 {
@@ -60,6 +62,18 @@ std::vector<std::complex<int16_t>> Utils::float_to_cint16(
     return out;
 }
 
+void Utils::cfloat_to_cint16(
+    const std::complex<float>* in, std::complex<int16_t>* out, size_t len)
+{
+    auto to_int16 = [](float x) {
+        return (int16_t)std::min(
+            std::max(std::round(x * 32768.f), -32768.f), 32767.f);
+    };
+    for (size_t i = 0; i < len; i++)
+        out[i] = std::complex<int16_t>(
+            to_int16(in[i].real()), to_int16(in[i].imag()));
+}
+
 std::vector<std::complex<float>> Utils::cint16_to_cfloat(
     const std::vector<std::complex<int16_t>>& in)
 {
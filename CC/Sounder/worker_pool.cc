@@ -0,0 +1,69 @@
+/*
+ Copyright (c) 2018-2020, Rice University
+ RENEW OPEN SOURCE LICENSE: http://renew-wireless.org/license
+
+---------------------------------------------------------------------
+ Bounded pool of threads running the blocking radio control calls of
+ bring-up and calibration
+---------------------------------------------------------------------
+*/
+
+#include "include/worker_pool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t num_threads)
+    : stop_(false)
+{
+    num_threads = std::max<size_t>(1, num_threads);
+    for (size_t i = 0; i < num_threads; i++)
+        this->threads_.emplace_back(&WorkerPool::run, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->mutex_);
+        this->stop_ = true;
+    }
+    this->cond_.notify_all();
+    for (auto& thread : this->threads_)
+        thread.join();
+}
+
+void WorkerPool::run(void)
+{
+    for (;;) {
+        std::function<void(void)> task;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex_);
+            this->cond_.wait(lock, [this]() {
+                return (this->stop_ == true) || (this->tasks_.empty() == false);
+            });
+            if (this->tasks_.empty() == true)
+                return;
+            task = std::move(this->tasks_.front());
+            this->tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void WorkerPool::parallelFor(
+    size_t count, const std::function<void(size_t)>& body)
+{
+    std::vector<std::future<void>> results;
+    results.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        results.push_back(this->submit([&body, i]() { body(i); }));
+    std::exception_ptr error;
+    for (auto& result : results) {
+        try {
+            result.get();
+        } catch (...) {
+            if (error == nullptr)
+                error = std::current_exception();
+        }
+    }
+    if (error != nullptr)
+        std::rethrow_exception(error);
+}